@@ -0,0 +1,468 @@
+/*
+ Copyright (c) Meta Platforms, Inc. and affiliates.
+
+ This source code is licensed under the BSD3 license found in the
+ LICENSE file in the root directory of this source tree.
+ */
+
+/*
+ * Kernel microbenchmark
+ *
+ * Times every moments.h kernel in its C version, its dispatched Highway
+ * version and its version for each Highway target the CPU supports, on
+ * padded 1080p and 2160p frame strides. Warm runs call the kernel on one
+ * block, which stays in L1. Cold runs walk the blocks of a pool of frames
+ * larger than the last level cache in raster order, so the pixels come
+ * from memory as they do in a search over a real clip.
+ *
+ * The results are written as JSON, and as a table on stderr.
+ *
+ * Usage: motion_search_bench [--json=<file>] [--min_time_ms=<n>]
+ *                            [--cold_mb=<n>] [--filter=<kernel substring>]
+ */
+
+#include "common.h"
+#include "memory.h"
+#include "moments.h"
+
+#if USE_HIGHWAY_SIMD
+#include <hwy/targets.h>
+#endif
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Pixels of one kernel call
+struct call_t {
+  const uint8_t *current;
+  const uint8_t *ref1;
+  const uint8_t *ref2;
+  ptrdiff_t stride;
+};
+
+typedef int (*kernel_fn)(const call_t &);
+
+// Candidates of the batched SADs: the large diamond around ref1
+const int kDiamond[FAST_SAD_MAX_REFS][2] = {
+    {0, 2}, {-1, 1}, {-2, 0}, {-1, -1}, {0, -2}, {1, -1}, {2, 0}, {1, 1}};
+
+// Adapters calling each kernel family with the arguments of a search. The
+// SADs never exit early, so every row is read.
+template <int (*F)(FAST_SAD_FORMAL_ARGS), int W, int H>
+int sad(const call_t &a) {
+  return F(a.current, a.ref1, a.stride, W, H, INT_MAX);
+}
+
+template <void (*F)(FAST_SAD_XN_FORMAL_ARGS), int W, int H>
+int sad_xN(const call_t &a) {
+  const uint8_t *refs[FAST_SAD_MAX_REFS];
+  int SADs[FAST_SAD_MAX_REFS];
+
+  for (int k = 0; k < FAST_SAD_MAX_REFS; k++) {
+    refs[k] = a.ref1 + kDiamond[k][0] * a.stride + kDiamond[k][1];
+  }
+  F(a.current, refs, FAST_SAD_MAX_REFS, a.stride, W, H, INT_MAX, SADs);
+  return SADs[0] + SADs[FAST_SAD_MAX_REFS - 1];
+}
+
+// The row of positions centred on ref1, as the exhaustive search scores them
+template <void (*F)(FAST_SAD_SPAN_FORMAL_ARGS), int W, int H>
+int sad_span(const call_t &a) {
+  int SADs[16];
+
+  F(a.current, a.ref1 - 8, a.stride, W, H, 16, SADs);
+  return SADs[0] + SADs[15];
+}
+
+template <int (*F)(FAST_VARIANCE_FORMAL_ARGS), int W, int H>
+int variance(const call_t &a) {
+  return F(a.current, a.stride, W, H);
+}
+
+template <int (*F)(FAST_VARIANCE_SPLIT_FORMAL_ARGS)>
+int variance_split(const call_t &a) {
+  int split[4];
+  return F(a.current, a.stride, 16, split) + split[3];
+}
+
+template <int (*F)(FAST_MSE_FORMAL_ARGS), int W, int H>
+int mse(const call_t &a) {
+  return F(a.current, a.ref1, a.stride, W, H);
+}
+
+template <int (*F)(FAST_MSE_SPLIT_FORMAL_ARGS)>
+int mse_split(const call_t &a) {
+  int split[4];
+  return F(a.current, a.ref1, a.stride, 16, split) + split[3];
+}
+
+template <int (*F)(FAST_BIDIR_MSE_FORMAL_ARGS), int W, int H>
+int bidir_mse(const call_t &a) {
+  // Halfway between the references
+  MV td = {16384, 16384};
+  return F(a.current, a.ref1, a.ref2, a.stride, W, H, &td);
+}
+
+// Decimates the block to a quarter of its area
+template <void (*F)(DECIMATE_FORMAL_ARGS), int W, int H>
+int decimate(const call_t &a) {
+  uint8_t out[(W / 2) * (H / 2)];
+  F(out, W / 2, a.current, a.stride, W / 2, H / 2);
+  return out[0] + out[sizeof(out) - 1];
+}
+
+struct kernel_t {
+  const char *name;
+  int size;   // Block width and height
+  int blocks; // Blocks compared per call
+  kernel_fn c;
+  kernel_fn hwy; // NULL without Highway
+};
+
+// The 64 and 32 pixel wide kernels have no Highway version of their own; their
+// Highway rows time the dispatched entry points, which run the batched SADs
+// in 16 pixel strips and the variances and MSEs in C.
+#if USE_HIGHWAY_SIMD
+#define WITH_HWY(adapter) adapter
+#else
+#define WITH_HWY(adapter) nullptr
+#endif
+
+const kernel_t kKernels[] = {
+    {"fastSAD16", 16, 1, sad<fastSAD16_c, 16, 16>,
+     WITH_HWY((sad<fastSAD16_hwy, 16, 16>))},
+    {"fastSAD8", 8, 1, sad<fastSAD8_c, 8, 8>,
+     WITH_HWY((sad<fastSAD8_hwy, 8, 8>))},
+    {"fastSAD4", 4, 1, sad<fastSAD4_c, 4, 4>,
+     WITH_HWY((sad<fastSAD4_hwy, 4, 4>))},
+    {"fastSAD16_early", 16, 1, sad<fastSAD16_c, 16, 16>,
+     WITH_HWY((sad<fastSAD16_early_hwy, 16, 16>))},
+    {"fastSAD8_early", 8, 1, sad<fastSAD8_c, 8, 8>,
+     WITH_HWY((sad<fastSAD8_early_hwy, 8, 8>))},
+    {"fastSAD4_early", 4, 1, sad<fastSAD4_c, 4, 4>,
+     WITH_HWY((sad<fastSAD4_early_hwy, 4, 4>))},
+    {"fastSAD64_xN", 64, FAST_SAD_MAX_REFS, sad_xN<fastSAD64_xN_c, 64, 64>,
+     WITH_HWY((sad_xN<fastSAD64_xN, 64, 64>))},
+    {"fastSAD32_xN", 32, FAST_SAD_MAX_REFS, sad_xN<fastSAD32_xN_c, 32, 32>,
+     WITH_HWY((sad_xN<fastSAD32_xN, 32, 32>))},
+    {"fastSAD16_xN", 16, FAST_SAD_MAX_REFS, sad_xN<fastSAD16_xN_c, 16, 16>,
+     WITH_HWY((sad_xN<fastSAD16_xN_hwy, 16, 16>))},
+    {"fastSAD8_xN", 8, FAST_SAD_MAX_REFS, sad_xN<fastSAD8_xN_c, 8, 8>,
+     WITH_HWY((sad_xN<fastSAD8_xN_hwy, 8, 8>))},
+    {"fastSAD4_xN", 4, FAST_SAD_MAX_REFS, sad_xN<fastSAD4_xN_c, 4, 4>,
+     WITH_HWY((sad_xN<fastSAD4_xN_hwy, 4, 4>))},
+    {"fastSAD32_span", 32, 16, sad_span<fastSAD32_span_c, 32, 32>,
+     WITH_HWY((sad_span<fastSAD32_span_hwy, 32, 32>))},
+    {"fastSAD16_span", 16, 16, sad_span<fastSAD16_span_c, 16, 16>,
+     WITH_HWY((sad_span<fastSAD16_span_hwy, 16, 16>))},
+    {"fastSAD8_span", 8, 16, sad_span<fastSAD8_span_c, 8, 8>,
+     WITH_HWY((sad_span<fastSAD8_span_hwy, 8, 8>))},
+    {"fastSAD4_span", 4, 16, sad_span<fastSAD4_span_c, 4, 4>,
+     WITH_HWY((sad_span<fastSAD4_span_hwy, 4, 4>))},
+    {"fast_variance64", 64, 1, variance<fast_variance64_c, 64, 64>,
+     WITH_HWY((variance<fast_variance64, 64, 64>))},
+    {"fast_variance32", 32, 1, variance<fast_variance32_c, 32, 32>,
+     WITH_HWY((variance<fast_variance32, 32, 32>))},
+    {"fast_variance16", 16, 1, variance<fast_variance16_c, 16, 16>,
+     WITH_HWY((variance<fast_variance16_hwy, 16, 16>))},
+    {"fast_variance8", 8, 1, variance<fast_variance8_c, 8, 8>,
+     WITH_HWY((variance<fast_variance8_hwy, 8, 8>))},
+    {"fast_variance4", 4, 1, variance<fast_variance4_c, 4, 4>,
+     WITH_HWY((variance<fast_variance4_hwy, 4, 4>))},
+    {"fast_variance16_split", 16, 1, variance_split<fast_variance16_split_c>,
+     WITH_HWY((variance_split<fast_variance16_split_hwy>))},
+    {"fast_calc_mse64", 64, 1, mse<fast_calc_mse64_c, 64, 64>,
+     WITH_HWY((mse<fast_calc_mse64, 64, 64>))},
+    {"fast_calc_mse32", 32, 1, mse<fast_calc_mse32_c, 32, 32>,
+     WITH_HWY((mse<fast_calc_mse32, 32, 32>))},
+    {"fast_calc_mse16", 16, 1, mse<fast_calc_mse16_c, 16, 16>,
+     WITH_HWY((mse<fast_calc_mse16_hwy, 16, 16>))},
+    {"fast_calc_mse8", 8, 1, mse<fast_calc_mse8_c, 8, 8>,
+     WITH_HWY((mse<fast_calc_mse8_hwy, 8, 8>))},
+    {"fast_calc_mse4", 4, 1, mse<fast_calc_mse4_c, 4, 4>,
+     WITH_HWY((mse<fast_calc_mse4_hwy, 4, 4>))},
+    {"fast_calc_mse16_split", 16, 1, mse_split<fast_calc_mse16_split_c>,
+     WITH_HWY((mse_split<fast_calc_mse16_split_hwy>))},
+    {"fast_bidir_mse64", 64, 1, bidir_mse<fast_bidir_mse64_c, 64, 64>,
+     WITH_HWY((bidir_mse<fast_bidir_mse64, 64, 64>))},
+    {"fast_bidir_mse32", 32, 1, bidir_mse<fast_bidir_mse32_c, 32, 32>,
+     WITH_HWY((bidir_mse<fast_bidir_mse32, 32, 32>))},
+    {"fast_bidir_mse16", 16, 1, bidir_mse<fast_bidir_mse16_c, 16, 16>,
+     WITH_HWY((bidir_mse<fast_bidir_mse16_hwy, 16, 16>))},
+    {"fast_bidir_mse8", 8, 1, bidir_mse<fast_bidir_mse8_c, 8, 8>,
+     WITH_HWY((bidir_mse<fast_bidir_mse8_hwy, 8, 8>))},
+    {"fast_bidir_mse4", 4, 1, bidir_mse<fast_bidir_mse4_c, 4, 4>,
+     WITH_HWY((bidir_mse<fast_bidir_mse4_hwy, 4, 4>))},
+    {"decimate2x2", 16, 1, decimate<decimate2x2_c, 16, 16>,
+     WITH_HWY((decimate<decimate2x2_hwy, 16, 16>))},
+};
+
+// Frame sizes timed, with the padding of YUVFrame around them
+const DIM kSizes[] = {{1920, 1080}, {3840, 2160}};
+
+// An implementation of the kernels: the C one, or the Highway one limited
+// to a set of targets
+struct variant_t {
+  std::string name;
+  bool hwy;
+  int64_t targets; // 0 for every supported target
+};
+
+// Blocks visited by the calls of a measurement
+struct walk_t {
+  const uint8_t *pool;
+  size_t frame_size;
+  int frames;
+  ptrdiff_t stride;
+  DIM dim;
+  int size;
+  bool cold;
+
+  int frame = 0;
+  int x = 0;
+  int y = 0;
+  const uint8_t *frames_at[3] = {};
+
+  // The current block in frame f is compared to the blocks one pixel below
+  // and right in frame f + 1, and one pixel above and left in frame f + 2
+  void seek(int f) {
+    frame = f;
+    for (int k = 0; k < 3; k++) {
+      frames_at[k] = pool + (size_t)((f + k) % frames) * frame_size +
+                     (size_t)VERTICAL_PADDING * stride + HORIZONTAL_PADDING;
+    }
+  }
+
+  call_t next() {
+    if (cold) {
+      x += size;
+      if (x + size > dim.width) {
+        x = 0;
+        y += size;
+        if (y + size > dim.height) {
+          y = 0;
+          seek((frame + 1) % frames);
+        }
+      }
+    }
+
+    const ptrdiff_t offset = y * stride + x;
+    return {frames_at[0] + offset, frames_at[1] + offset + stride + 1,
+            frames_at[2] + offset - stride - 1, stride};
+  }
+};
+
+const int kRepetitions = 5;
+
+volatile int g_sink;
+
+double time_calls(kernel_fn fn, walk_t &walk, long long calls) {
+  const auto begin = std::chrono::steady_clock::now();
+
+  int sum = 0;
+  for (long long i = 0; i < calls; i++) {
+    sum += fn(walk.next());
+  }
+
+  const auto end = std::chrono::steady_clock::now();
+  g_sink = g_sink + sum;
+  return std::chrono::duration<double, std::nano>(end - begin).count();
+}
+
+// Nanoseconds per call: the best of several runs of at least min_time_ns.
+// The calibration runs warm the caches and the branch predictors up.
+double measure(kernel_fn fn, walk_t &walk, double min_time_ns) {
+  long long calls = 256;
+  double elapsed;
+  while ((elapsed = time_calls(fn, walk, calls)) < min_time_ns) {
+    calls *= 2;
+  }
+
+  double best = elapsed / (double)calls;
+  for (int r = 0; r < kRepetitions; r++) {
+    best = std::min(best, time_calls(fn, walk, calls) / (double)calls);
+  }
+  return best;
+}
+
+void select_variant(const variant_t &variant) {
+#if USE_HIGHWAY_SIMD
+  if (variant.hwy) {
+    hwy::SetSupportedTargetsForTest(variant.targets);
+  }
+#else
+  UNUSED(variant);
+#endif
+}
+
+std::vector<variant_t> get_variants(nlohmann::json &targets) {
+  std::vector<variant_t> variants = {{"c", false, 0}};
+
+#if USE_HIGHWAY_SIMD
+  variants.push_back({"hwy", true, 0});
+  for (int64_t target : hwy::SupportedAndGeneratedTargets()) {
+    const std::string name = hwy::TargetName(target);
+    targets.push_back(name);
+    variants.push_back({"hwy:" + name, true, target});
+  }
+#else
+  UNUSED(targets);
+#endif
+
+  return variants;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::string json_path = "-";
+  double min_time_ms = 10;
+  size_t cold_mb = 256;
+  std::string filter;
+
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    const size_t eq = arg.find('=');
+    const std::string name = arg.substr(0, eq);
+    const std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+
+    if (name == "--json") {
+      json_path = value;
+    } else if (name == "--min_time_ms") {
+      min_time_ms = atof(value.c_str());
+    } else if (name == "--cold_mb") {
+      cold_mb = (size_t)atoi(value.c_str());
+    } else if (name == "--filter") {
+      filter = value;
+    } else {
+      fprintf(stderr,
+              "Usage: %s [--json=<file>] [--min_time_ms=<n>] [--cold_mb=<n>] "
+              "[--filter=<kernel substring>]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+
+  nlohmann::json report;
+  report["benchmark"] = "motion_search_bench";
+#if USE_HIGHWAY_SIMD
+  report["highway"] = true;
+#else
+  report["highway"] = false;
+#endif
+  report["targets"] = nlohmann::json::array();
+  report["min_time_ms"] = min_time_ms;
+  report["repetitions"] = kRepetitions;
+  report["cold_pool_mb"] = cold_mb;
+  report["results"] = nlohmann::json::array();
+
+  const std::vector<variant_t> variants = get_variants(report["targets"]);
+
+  // One pool holds the frames of every size; three frames at least, for the
+  // current block and its two references
+  size_t pool_size = cold_mb << 20;
+  for (const DIM &dim : kSizes) {
+    const size_t frame_size = (size_t)(dim.width + 2 * HORIZONTAL_PADDING) *
+                              (dim.height + 2 * VERTICAL_PADDING);
+    pool_size = std::max(pool_size, 3 * frame_size);
+  }
+  memory::aligned_unique_ptr<uint8_t> pool =
+      memory::AlignedAlloc<uint8_t>(pool_size);
+  if (!pool) {
+    fprintf(stderr, "Can't allocate %zu MB for the frame pool\n",
+            pool_size >> 20);
+    return 1;
+  }
+  uint32_t seed = 1;
+  for (size_t i = 0; i < pool_size; i++) {
+    seed = seed * 1664525 + 1013904223;
+    pool.get()[i] = (uint8_t)(seed >> 24);
+  }
+
+  fprintf(stderr, "%-22s %-6s %-12s %6s %-5s %10s %10s %8s\n", "kernel",
+          "block", "variant", "stride", "cache", "ns/call", "Mpixel/s",
+          "vs c");
+
+  for (const DIM &dim : kSizes) {
+    const ptrdiff_t stride = dim.width + 2 * HORIZONTAL_PADDING;
+    const size_t frame_size =
+        (size_t)stride * (dim.height + 2 * VERTICAL_PADDING);
+
+    for (bool cold : {false, true}) {
+      for (const kernel_t &kernel : kKernels) {
+        if (!filter.empty() &&
+            std::string(kernel.name).find(filter) == std::string::npos) {
+          continue;
+        }
+
+        double c_time = 0;
+        for (const variant_t &variant : variants) {
+          kernel_fn fn = variant.hwy ? kernel.hwy : kernel.c;
+          if (!fn) {
+            continue;
+          }
+          select_variant(variant);
+
+          walk_t walk = {pool.get(), frame_size,
+                         (int)(pool_size / frame_size), stride, dim,
+                         kernel.size, cold};
+          walk.seek(0);
+          const double ns = measure(fn, walk, min_time_ms * 1e6);
+          if (!variant.hwy) {
+            c_time = ns;
+          }
+          const double pixels =
+              (double)kernel.size * kernel.size * kernel.blocks;
+          const double mpixels = pixels / ns * 1e3;
+          const double speedup = c_time / ns;
+
+          const std::string block =
+              std::to_string(kernel.size) + "x" + std::to_string(kernel.size);
+          fprintf(stderr, "%-22s %-6s %-12s %6d %-5s %10.2f %10.1f %7.2fx\n",
+                  kernel.name, block.c_str(), variant.name.c_str(),
+                  (int)stride, cold ? "cold" : "warm", ns, mpixels, speedup);
+
+          nlohmann::json result;
+          result["kernel"] = kernel.name;
+          result["block"] = block;
+          result["refs"] = kernel.blocks;
+          result["variant"] = variant.name;
+          result["width"] = dim.width;
+          result["height"] = dim.height;
+          result["stride"] = stride;
+          result["cache"] = cold ? "cold" : "warm";
+          result["ns_per_call"] = ns;
+          result["mpixels_per_s"] = mpixels;
+          result["speedup_vs_c"] = speedup;
+          report["results"].push_back(result);
+        }
+        select_variant({"hwy", true, 0});
+      }
+    }
+  }
+
+  if (json_path == "-") {
+    std::cout << report.dump(2) << "\n";
+  } else {
+    std::ofstream out(json_path);
+    out << report.dump(2) << "\n";
+    if (!out) {
+      fprintf(stderr, "Can't write %s\n", json_path.c_str());
+      return 1;
+    }
+  }
+
+  return 0;
+}
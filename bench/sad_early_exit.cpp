@@ -0,0 +1,276 @@
+/*
+ Copyright (c) Meta Platforms, Inc. and affiliates.
+
+ This source code is licensed under the BSD3 license found in the
+ LICENSE file in the root directory of this source tree.
+ */
+
+/*
+ * Early-exit SAD benchmark
+ *
+ * Replays a diamond search over every macroblock of a real clip, recording
+ * each candidate SAD with the running min_SAD it was evaluated against. It
+ * then reports how many block rows an early-exit kernel skips for several
+ * check intervals, and times the dispatched fastSAD16/fastSAD8 with and
+ * without a min_SAD to stop at.
+ *
+ * Usage: sad_early_exit <input.y4m> [frames]
+ *        sad_early_exit <input.yuv> <width> <height> [frames]
+ */
+
+#include "EOFException.h"
+#include "Y4MSequenceReader.h"
+#include "YUVFrame.h"
+#include "YUVSequenceReader.h"
+#include "moments.h"
+
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+// One SAD evaluation of the replayed search
+struct candidate_t {
+  const uint8_t *current;
+  const uint8_t *reference;
+  int block_size;
+  int min_SAD;
+};
+
+const int kIntervals[] = {1, 2, 4, 8, 16};
+const int kNumIntervals = sizeof(kIntervals) / sizeof(kIntervals[0]);
+
+struct row_stats_t {
+  long long total_rows = 0;
+  long long rows[kNumIntervals] = {0};
+};
+
+// Rows an early-exit kernel reads when it checks min_SAD every interval rows
+int rows_read(const candidate_t &c, ptrdiff_t stride, int interval) {
+  int sad = 0;
+
+  for (int i = 0; i < c.block_size; i++) {
+    for (int j = 0; j < c.block_size; j++) {
+      sad += abs(c.current[i * stride + j] - c.reference[i * stride + j]);
+    }
+    if ((i + 1) % interval == 0 && sad >= c.min_SAD) {
+      return i + 1;
+    }
+  }
+
+  return c.block_size;
+}
+
+// Large then small diamond search around the zero vector, recording every
+// candidate in evaluation order, as diamond_search() does
+void search_block(const uint8_t *current, const uint8_t *reference,
+                  ptrdiff_t stride, int block_size, int max_x, int max_y,
+                  std::vector<candidate_t> &out) {
+  static const int large[8][2] = {{0, 2},  {-1, 1}, {-2, 0}, {-1, -1},
+                                  {0, -2}, {1, -1}, {2, 0},  {1, 1}};
+  static const int small[4][2] = {{0, 1}, {-1, 0}, {0, -1}, {1, 0}};
+  int y = 0;
+  int x = 0;
+
+  int (*sad_fn)(FAST_SAD_FORMAL_ARGS) =
+      block_size == 16 ? fastSAD16_c : fastSAD8_c;
+  int min_SAD =
+      sad_fn(current, reference, stride, block_size, block_size, INT_MAX);
+  out.push_back({current, reference, block_size, INT_MAX});
+
+  for (int pass = 0; pass < 2; pass++) {
+    const int(*pattern)[2] = pass ? small : large;
+    const int points = pass ? 4 : 8;
+    bool moved = true;
+
+    while (moved) {
+      int best_y = y;
+      int best_x = x;
+
+      moved = false;
+      for (int k = 0; k < points; k++) {
+        int cy = y + pattern[k][0];
+        int cx = x + pattern[k][1];
+        if (abs(cy) > max_y || abs(cx) > max_x) {
+          continue;
+        }
+
+        const uint8_t *ref = reference + cy * stride + cx;
+        out.push_back({current, ref, block_size, min_SAD});
+        int sad =
+            sad_fn(current, ref, stride, block_size, block_size, min_SAD);
+        if (sad < min_SAD) {
+          min_SAD = sad;
+          best_y = cy;
+          best_x = cx;
+          moved = true;
+        }
+      }
+      y = best_y;
+      x = best_x;
+    }
+  }
+}
+
+double time_replay(const std::vector<candidate_t> &candidates,
+                   ptrdiff_t stride, bool early_exit, int &checksum) {
+  const auto begin = std::chrono::high_resolution_clock::now();
+
+  checksum = 0;
+  for (const candidate_t &c : candidates) {
+    int min_SAD = early_exit ? c.min_SAD : INT_MAX;
+    if (c.block_size == 16) {
+      checksum += fastSAD16(c.current, c.reference, stride, 16, 16, min_SAD);
+    } else {
+      checksum += fastSAD8(c.current, c.reference, stride, 8, 8, min_SAD);
+    }
+  }
+
+  const auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr,
+            "Usage: %s <input.y4m> [frames]\n"
+            "       %s <input.yuv> <width> <height> [frames]\n",
+            argv[0], argv[0]);
+    return 1;
+  }
+
+  const std::string path = argv[1];
+  const bool is_y4m =
+      path.size() > 4 && path.substr(path.size() - 4) == ".y4m";
+  int max_frames = 30;
+
+  unique_file_t file(fopen(path.c_str(), "rb"));
+  if (!file) {
+    fprintf(stderr, "Can't open %s\n", path.c_str());
+    return 1;
+  }
+
+  std::unique_ptr<YUVSequenceReader> reader;
+  if (is_y4m) {
+    std::unique_ptr<Y4MSequenceReader> p(new Y4MSequenceReader());
+    if (!p->Open(std::move(file), path)) {
+      fprintf(stderr, "Can't parse the Y4M header of %s\n", path.c_str());
+      return 1;
+    }
+    reader = std::move(p);
+    if (argc > 2) {
+      max_frames = atoi(argv[2]);
+    }
+  } else {
+    if (argc < 4) {
+      fprintf(stderr, "Raw .yuv input needs a width and a height\n");
+      return 1;
+    }
+    DIM dim = {atoi(argv[2]), atoi(argv[3])};
+    reader.reset(new YUVSequenceReader());
+    reader->Open(std::move(file), path, dim);
+    if (argc > 4) {
+      max_frames = atoi(argv[4]);
+    }
+  }
+
+  // The frames stay in memory for the timed replay
+  std::vector<std::unique_ptr<YUVFrame>> frames;
+  try {
+    while ((int)frames.size() < max_frames) {
+      std::unique_ptr<YUVFrame> frame(new YUVFrame(reader.get(), true));
+      frame->readNextFrame();
+      frame->boundaryExtend();
+      frames.push_back(std::move(frame));
+    }
+  } catch (EOFException &) {
+  }
+
+  const DIM dim = reader->dim();
+  const int pairs = (int)frames.size() - 1;
+
+  // Keep candidates inside the padded area around the reference frame
+  const int max_x = HORIZONTAL_PADDING - 2;
+  const int max_y = VERTICAL_PADDING - 2;
+
+  std::vector<candidate_t> candidates;
+  ptrdiff_t stride = 0;
+  for (int f = 0; f < pairs; f++) {
+    YUVFrame *ref_frame = frames[(size_t)f].get();
+    YUVFrame *cur_frame = frames[(size_t)f + 1].get();
+    stride = cur_frame->stride();
+
+    for (int i = 0; i + 16 <= dim.height; i += 16) {
+      for (int j = 0; j + 16 <= dim.width; j += 16) {
+        const uint8_t *cur = cur_frame->y() + i * stride + j;
+        const uint8_t *ref = ref_frame->y() + i * stride + j;
+
+        search_block(cur, ref, stride, 16, max_x, max_y, candidates);
+        for (int k = 0; k < 4; k++) {
+          const ptrdiff_t offset = (k >> 1) * 8 * stride + (k & 1) * 8;
+          search_block(cur + offset, ref + offset, stride, 8, max_x, max_y,
+                       candidates);
+        }
+      }
+    }
+  }
+
+  if (candidates.empty()) {
+    fprintf(stderr, "Need at least two frames of at least 16x16 pixels\n");
+    return 1;
+  }
+
+  row_stats_t stats[2];
+  for (const candidate_t &c : candidates) {
+    row_stats_t &s = stats[c.block_size == 16 ? 0 : 1];
+    s.total_rows += c.block_size;
+    for (int k = 0; k < kNumIntervals; k++) {
+      s.rows[k] += rows_read(c, stride, kIntervals[k]);
+    }
+  }
+
+  printf("Input: %s (%dx%d), %d frame pairs, %zu SAD candidates\n",
+         path.c_str(), dim.width, dim.height, pairs, candidates.size());
+  printf("\nRows skipped by early exit (kernel interval: %d rows)\n",
+         FAST_SAD_EXIT_ROWS);
+  printf("%-10s %12s", "block", "rows");
+  for (int k = 0; k < kNumIntervals; k++) {
+    printf("   every %-3d", kIntervals[k]);
+  }
+  printf("\n");
+  for (int b = 0; b < 2; b++) {
+    printf("%-10s %12lld", b ? "8x8" : "16x16", stats[b].total_rows);
+    for (int k = 0; k < kNumIntervals; k++) {
+      const long long skipped = stats[b].total_rows - stats[b].rows[k];
+      printf("   %8.1f%%",
+             100.0 * (double)skipped / (double)stats[b].total_rows);
+    }
+    printf("\n");
+  }
+
+  int checksum_full = 0;
+  int checksum_early = 0;
+  double full_ms = 0.0;
+  double early_ms = 0.0;
+  const int repeats = 5;
+  for (int r = 0; r < repeats; r++) {
+    full_ms += time_replay(candidates, stride, false, checksum_full);
+    early_ms += time_replay(candidates, stride, true, checksum_early);
+  }
+
+  printf("\nReplay through fastSAD16/fastSAD8, %d runs\n", repeats);
+  printf("  full SAD:       %9.2f msec\n", full_ms / repeats);
+  printf("  early exit:     %9.2f msec (%.2fx)\n", early_ms / repeats,
+         full_ms / early_ms);
+  printf("  sum of results: %d / %d\n", checksum_full, checksum_early);
+
+  return 0;
+}
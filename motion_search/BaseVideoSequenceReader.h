@@ -22,6 +22,8 @@ public:
 protected:
   virtual void readPicture(uint8_t *pY, uint8_t *pU, uint8_t *pV) = 0;
 
+  void setCount(int count) { m_count = count; }
+
 private:
   int m_count = 0;
 };
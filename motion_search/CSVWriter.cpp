@@ -18,8 +18,11 @@ void CSVWriter::writeFrameHeader() {
   out_ << "picNum,picType,count_I,count_P,count_B,error,bits\n";
 }
 
+// The sampled column is only there when sampling, so the output of a full
+// analysis is unchanged
 void CSVWriter::writeGOPHeader() {
-  out_ << "gop,frames,total_bits,avg_complexity,i_frames,p_frames,b_frames\n";
+  out_ << "gop,frames,total_bits,avg_complexity,i_frames,p_frames,b_frames"
+       << (sampling_ ? ",sampled\n" : "\n");
 }
 
 void CSVWriter::writeFrameData(const FrameData &frame) {
@@ -34,23 +37,37 @@ void CSVWriter::writeGOPData(const GOPData &gop) {
   out_ << gop.gop_num << "," << frame_count << "," << gop.total_bits << ","
        << std::fixed << std::setprecision(2) << gop.avg_complexity << ","
        << gop.i_frame_count << "," << gop.p_frame_count << ","
-       << gop.b_frame_count << "\n";
+       << gop.b_frame_count;
+  if (sampling_) {
+    out_ << "," << (gop.sampled ? 1 : 0);
+  }
+  out_ << "\n";
 }
 
-void CSVWriter::write(const AnalysisResults &results) {
+void CSVWriter::begin(const VideoMetadata &metadata) {
+  sampling_ = metadata.sampling;
   if (detail_level_ == DetailLevel::FRAME) {
     // Frame-level output (backward compatible)
     writeFrameHeader();
-    for (const auto &frame : results.frames) {
-      writeFrameData(frame);
-    }
   } else {
     // GOP-level output
     writeGOPHeader();
-    for (const auto &gop : results.gops) {
-      writeGOPData(gop);
-    }
   }
 }
 
+void CSVWriter::onFrame(const FrameData &frame) {
+  if (detail_level_ == DetailLevel::FRAME) {
+    writeFrameData(frame);
+  }
+}
+
+void CSVWriter::onGOPComplete(const GOPData &gop) {
+  if (detail_level_ == DetailLevel::GOP) {
+    writeGOPData(gop);
+  }
+  out_.flush();
+}
+
+void CSVWriter::end(const VideoMetadata & /* metadata */) { out_.flush(); }
+
 } // namespace motion_search
@@ -22,9 +22,14 @@ public:
   CSVWriter(std::ostream &out, DetailLevel detail_level);
   ~CSVWriter() override = default;
 
-  void write(const AnalysisResults &results) override;
+  void begin(const VideoMetadata &metadata) override;
+  void onFrame(const FrameData &frame) override;
+  void onGOPComplete(const GOPData &gop) override;
+  void end(const VideoMetadata &metadata) override;
 
 private:
+  bool sampling_ = false;
+
   void writeFrameHeader();
   void writeGOPHeader();
   void writeFrameData(const FrameData &frame);
@@ -10,41 +10,115 @@
 
 #include "moments.h"
 
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+// Budgeted GOPs are the centers of budget equal strata of the title
+bool is_sampled_gop(const gop_sampling_t &sampling, int gop, int num_gops) {
+  if (sampling.interval > 1) {
+    return gop % sampling.interval == 0;
+  }
+  if (sampling.budget <= 0 || sampling.budget >= num_gops) {
+    return true;
+  }
+
+  // Smallest stratum i whose center (2 * i + 1) * N / (2 * B) is >= gop
+  const int64_t N = num_gops;
+  const int64_t B = sampling.budget;
+  const int64_t i = (2 * gop * B + N - 1) / (2 * N);
+  return i < B && (2 * i + 1) * N < 2 * (gop + 1) * B;
+}
+
+void check_block_size(const DIM &dim, int block_size, bool pyramid) {
+  if (block_size != 8 && block_size != 16 && block_size != 32 &&
+      block_size != 64) {
+    throw std::invalid_argument("Unsupported block size " +
+                                std::to_string(block_size) +
+                                " (supported: 8, 16, 32, 64)");
+  }
+  if (pyramid && block_size < 16) {
+    throw std::invalid_argument("The pyramid requires a block size of 16 or "
+                                "more");
+  }
+  const int overhang = (block_size - dim.width % block_size) % block_size;
+  if (overhang > HORIZONTAL_PADDING) {
+    throw std::invalid_argument("The width " + std::to_string(dim.width) +
+                                " is not supported with a block size of " +
+                                std::to_string(block_size));
+  }
+}
+
 ComplexityAnalyzer::ComplexityAnalyzer(IVideoSequenceReader *reader,
                                        int gop_size, int num_frames,
-                                       int b_frames)
+                                       int b_frames, bool pipelined,
+                                       int row_threads, int block_size)
     : m_dim(reader->dim()),
       m_stride(reader->dim().width + 2 * HORIZONTAL_PADDING),
       m_padded_height(reader->dim().height + 2 * VERTICAL_PADDING),
-      m_num_frames(num_frames), m_GOP_size(gop_size),
-      m_subGOP_size(b_frames + 1), m_pReader(reader), m_pReorderedInfo(NULL) {
+      m_block_size(block_size), m_num_frames(num_frames), m_GOP_size(gop_size),
+      m_subGOP_size(b_frames + 1), m_pReader(reader),
+      m_info_base(reader->count()) {
+  check_block_size(m_dim, m_block_size, false);
+
   m_GOP_error = 0;
   m_GOP_bits = 0;
   m_GOP_count = 0;
 
-  for (int i = 0; i <= m_subGOP_size; i++)
-    pics.push_back(new YUVFrame(m_pReader));
+  // The anchor and one sub-GOP are in use at any time; read-ahead gets room
+  // for one more sub-GOP. Only luma is searched, so chroma is never stored.
+  pics.resize((size_t)m_subGOP_size + 1, NULL);
+  m_pRing.reset(new FrameRing(m_pReader,
+                              (m_subGOP_size + 1) * (pipelined ? 2 : 1),
+                              pipelined, true, m_block_size));
 
-  m_pPmv = new MotionVectorField(m_dim, m_stride, m_padded_height, MB_WIDTH);
-  m_pB1mv = new MotionVectorField(m_dim, m_stride, m_padded_height, MB_WIDTH);
-  m_pB2mv = new MotionVectorField(m_dim, m_stride, m_padded_height, MB_WIDTH);
+  m_pPmv =
+      new MotionVectorField(m_dim, m_stride, m_padded_height, m_block_size);
+  m_pB1mv =
+      new MotionVectorField(m_dim, m_stride, m_padded_height, m_block_size);
+  m_pB2mv =
+      new MotionVectorField(m_dim, m_stride, m_padded_height, m_block_size);
 
-  int stride_MB = m_dim.width / MB_WIDTH + 2;
-  int padded_height_MB = (m_dim.height + MB_WIDTH - 1) / MB_WIDTH + 2;
+  m_mses = alloc_MB_plane<int>("m_mses");
+  m_MB_modes = alloc_MB_plane<unsigned char>("m_MB_modes");
 
-  const size_t numItems = (size_t)(stride_MB) * (padded_height_MB);
-  m_mses = memory::AlignedAlloc<int>(numItems);
-  if (m_mses == NULL) {
-    fprintf(stderr, "Not enough memory (%zu bytes) for %s\n",
-            numItems * sizeof(int), "m_mses");
-    exit(-1);
+  if (pipelined && b_frames > 0) {
+    for (int i = 0; i < b_frames; i++) {
+      std::unique_ptr<BPictureContext> ctx(new BPictureContext);
+      ctx->pmv.reset(new MotionVectorField(m_dim, m_stride, m_padded_height,
+                                           m_block_size));
+      ctx->b1mv.reset(new MotionVectorField(m_dim, m_stride, m_padded_height,
+                                            m_block_size));
+      ctx->b2mv.reset(new MotionVectorField(m_dim, m_stride, m_padded_height,
+                                            m_block_size));
+      ctx->mses = alloc_MB_plane<int>("mses");
+      ctx->MB_modes = alloc_MB_plane<unsigned char>("MB_modes");
+      ctx->error = 0;
+      m_BContexts.push_back(std::move(ctx));
+    }
+    m_pPool.reset(new ThreadPool(b_frames));
+  }
+
+  if (row_threads > 1) {
+    m_pRowPool.reset(new ThreadPool(row_threads));
+    m_pPmv->setThreadPool(m_pRowPool.get());
   }
-  m_MB_modes = memory::AlignedAlloc<unsigned char>(numItems);
-  if (m_MB_modes == NULL) {
+}
+
+template <typename data_t>
+memory::aligned_unique_ptr<data_t>
+ComplexityAnalyzer::alloc_MB_plane(const char *name) {
+  int stride_MB = m_dim.width / m_block_size + 2;
+  int padded_height_MB = (m_dim.height + m_block_size - 1) / m_block_size + 2;
+
+  const size_t numItems = (size_t)(stride_MB) * (padded_height_MB);
+  memory::aligned_unique_ptr<data_t> p = memory::AlignedAlloc<data_t>(numItems);
+  if (p == NULL) {
     fprintf(stderr, "Not enough memory (%zu bytes) for %s\n",
-            numItems * sizeof(unsigned char), "m_MB_modes");
+            numItems * sizeof(data_t), name);
     exit(-1);
   }
+  return p;
 }
 
 ComplexityAnalyzer::~ComplexityAnalyzer(void) {
@@ -59,34 +133,184 @@ void ComplexityAnalyzer::reset_gop_start(void) {
   m_pPmv->reset();
   m_pB1mv->reset();
   m_pB2mv->reset();
+  for (auto &ctx : m_BContexts) {
+    ctx->b1mv->reset();
+    ctx->b2mv->reset();
+  }
 }
 
 void ComplexityAnalyzer::add_info(int num, char p, int err, int count_I,
-                                  int count_P, int count_B, int bits) {
-  complexity_info_t *i = new complexity_info_t;
-
+                                  int count_P, int count_B, int count_skip,
+                                  int bits) {
   // Convert all numbering to 0..N-1
-  i->picNum = num - 1;
-  i->picType = p;
-  i->error = err;
-  i->count_I = count_I;
-  i->count_P = count_P;
-  i->count_B = count_B;
-  i->bits = bits;
+  const int index = num - 1 - m_info_base;
+  if (index >= (int)m_info.size()) {
+    m_info.resize((size_t)index + 1);
+  }
+
+  complexity_info_t &i = m_info[(size_t)index];
+  i.picNum = num - 1;
+  i.picType = p;
+  i.error = err;
+  i.count_I = count_I;
+  i.count_P = count_P;
+  i.count_B = count_B;
+  i.count_skip = count_skip;
+  i.bits = bits;
 
+  // B-pictures come in display order once their backward reference is in
   if (p == 'I' || p == 'P') {
-    if (m_pReorderedInfo != NULL)
-      m_info.push_back(m_pReorderedInfo);
-    m_pReorderedInfo = i;
+    if (m_reordered >= 0)
+      m_complete = m_reordered + 1;
+    m_reordered = index;
   } else {
-    m_info.push_back(i);
+    m_complete = index + 1;
+  }
+
+  emit_info();
+}
+
+// Hand the final frames to the callback and drop them from the store
+void ComplexityAnalyzer::emit_info(void) {
+  if (!m_callback || m_complete == 0) {
+    return;
+  }
+
+  for (int i = 0; i < m_complete; i++) {
+    m_callback(m_info[(size_t)i]);
+  }
+  m_info.erase(m_info.begin(), m_info.begin() + m_complete);
+  m_info_base += m_complete;
+  if (m_reordered >= 0) {
+    m_reordered -= m_complete;
+  }
+  m_complete = 0;
+}
+
+// mses and MB_modes are the planes passed to the search, before the offset of
+// the first macroblock
+void ComplexityAnalyzer::add_mb_info(YUVFrame *pict, char p, int err, int bits,
+                                     MotionVectorField *fwd,
+                                     MotionVectorField *bwd, int *mses,
+                                     unsigned char *MB_modes) {
+  if (!m_mb_callback) {
+    return;
+  }
+
+  const int firstMB = m_pPmv->firstMB();
+  mb_frame_info_t info;
+  info.picNum = pict->pos();
+  info.picType = p;
+  info.bits = bits;
+  info.error = err;
+  info.mbs_x = (m_dim.width + m_block_size - 1) / m_block_size;
+  info.mbs_y = (m_dim.height + m_block_size - 1) / m_block_size;
+  info.stride_MB = m_dim.width / m_block_size + 2;
+  info.modes = &MB_modes[firstMB];
+  info.mses = &mses[firstMB];
+  info.mvs[0] = fwd ? fwd->MVs() : NULL;
+  info.sads[0] = fwd ? fwd->SADs() : NULL;
+  info.mvs[1] = bwd ? bwd->MVs() : NULL;
+  info.sads[1] = bwd ? bwd->SADs() : NULL;
+  m_mb_callback(info);
+}
+
+stage_times_t ComplexityAnalyzer::getTimes(void) {
+  stage_times_t times = m_times;
+  times.add(m_pRing->times());
+  return times;
+}
+
+bool ComplexityAnalyzer::enablePerfCounters(void) {
+  std::unique_ptr<PerfCounters> counters(new PerfCounters);
+  if (!counters->available()) {
+    return false;
+  }
+
+  for (int e = 0; e < NUM_PERF_EVENTS; e++) {
+    m_counts.available[e] = counters->available(e);
+  }
+  m_pCounters = std::move(counters);
+  return true;
+}
+
+void ComplexityAnalyzer::setPyramid(bool enable) {
+  check_block_size(m_dim, m_block_size, enable);
+  m_pyramid = enable;
+  m_pPmv->setPyramid(enable);
+  m_pB1mv->setPyramid(enable);
+  m_pB2mv->setPyramid(enable);
+  for (auto &ctx : m_BContexts) {
+    ctx->b1mv->setPyramid(enable);
+    ctx->b2mv->setPyramid(enable);
+  }
+}
+
+void ComplexityAnalyzer::setSkipThreshold(int threshold) {
+  // Only the P-pictures are searched by m_pPmv
+  m_pPmv->setSkipThreshold(threshold);
+}
+
+void ComplexityAnalyzer::setPartitionPruning(bool enable) {
+  m_pPmv->setPartitionPruning(enable);
+  for (auto &ctx : m_BContexts) {
+    ctx->pmv->setPartitionPruning(enable);
+  }
+}
+
+void ComplexityAnalyzer::setSearchMethod(me_method_t method) {
+  m_pPmv->setSearchMethod(method);
+  for (auto &ctx : m_BContexts) {
+    ctx->pmv->setSearchMethod(method);
+  }
+}
+
+// The reader thread may have extended the borders already. The pyramid of a
+// reference is built here, before the B-pictures searched concurrently read
+// it.
+void ComplexityAnalyzer::extend(YUVFrame *pict) {
+  if (!pict->isExtended()) {
+    StageTimer timer(m_times, STAGE_BOUNDARY_EXTEND);
+    pict->boundaryExtend();
+  }
+  if (m_pyramid) {
+    pict->pyramid();
+  }
+}
+
+// GOPs are closed, so the frames before a skipped GOP are final
+void ComplexityAnalyzer::skip_gop(int frames) {
+  m_pRing->release(pics[0]);
+  pics[0] = NULL;
+
+  if (m_reordered >= 0)
+    m_complete = m_reordered + 1;
+  m_reordered = -1;
+  emit_info();
+
+  const int first = m_pRing->position();
+  m_pRing->skip(frames);
+  m_info_base += frames;
+  if (m_skip_callback) {
+    m_skip_callback(first, frames);
   }
 }
 
+// Macroblocks searched in every picture
+int ComplexityAnalyzer::num_MBs(void) {
+  return ((m_dim.width + m_block_size - 1) / m_block_size) *
+         ((m_dim.height + m_block_size - 1) / m_block_size);
+}
+
 void ComplexityAnalyzer::process_i_picture(YUVFrame *pict) {
+  CounterScope counters(m_pCounters.get(), m_counts, 'I', 1, num_MBs());
   reset_gop_start();
-  int error = m_pPmv->predictSpatial(pict, &m_mses.get()[m_pPmv->firstMB()],
-                                     &m_MB_modes.get()[m_pPmv->firstMB()]);
+  int error;
+  {
+    StageTimer timer(m_times, STAGE_PREDICT_SPATIAL, 'I');
+    error = m_pPmv->predictSpatial(pict, &m_mses.get()[m_pPmv->firstMB()],
+                                   &m_MB_modes.get()[m_pPmv->firstMB()]);
+  }
   int bits = m_pPmv->bits();
 
   // We are weighting I-frames by 10% more bits (282/256), since the QP needs to
@@ -94,17 +318,24 @@ void ComplexityAnalyzer::process_i_picture(YUVFrame *pict) {
   bits = (I_FRAME_BIT_WEIGHT * bits + 128) >> 8;
   m_GOP_bits += bits;
   m_GOP_error += error;
-  add_info(m_pReader->count(), 'I', error, m_pPmv->count_I(), 0, 0, bits);
+  add_info(pict->pos() + 1, 'I', error, m_pPmv->count_I(), 0, 0, 0, bits);
+  add_mb_info(pict, 'I', error, bits, NULL, NULL, m_mses.get(),
+              m_MB_modes.get());
   // for debugging
   // fprintf(stderr, "Frame %6d (I), I:%6d, P:%6d, B:%6d, MSE = %9d, bits =
   // %7d\n",pict->pos()+1,m_pPmv->count_I(),0,0,error,bits);
-  pict->boundaryExtend();
+  extend(pict);
 }
 
 void ComplexityAnalyzer::process_p_picture(YUVFrame *pict, YUVFrame *ref) {
-  int error =
-      m_pPmv->predictTemporal(pict, ref, &m_mses.get()[m_pPmv->firstMB()],
-                              &m_MB_modes.get()[m_pPmv->firstMB()]);
+  CounterScope counters(m_pCounters.get(), m_counts, 'P', 1, num_MBs());
+  int error;
+  {
+    StageTimer timer(m_times, STAGE_PREDICT_TEMPORAL, 'P');
+    error =
+        m_pPmv->predictTemporal(pict, ref, &m_mses.get()[m_pPmv->firstMB()],
+                                &m_MB_modes.get()[m_pPmv->firstMB()]);
+  }
   int bits = m_pPmv->bits();
 
   // We are weighting P-frames by 5% more bits (269/256), since the QP needs to
@@ -112,77 +343,183 @@ void ComplexityAnalyzer::process_p_picture(YUVFrame *pict, YUVFrame *ref) {
   bits = (P_FRAME_BIT_WEIGHT * bits + 128) >> 8;
   m_GOP_bits += bits;
   m_GOP_error += error;
-  add_info(m_pReader->count(), 'P', error, m_pPmv->count_I(), m_pPmv->count_P(),
-           0, bits);
+  add_info(pict->pos() + 1, 'P', error, m_pPmv->count_I(), m_pPmv->count_P(),
+           0, m_pPmv->count_skip(), bits);
+  add_mb_info(pict, 'P', error, bits, m_pPmv, NULL, m_mses.get(),
+              m_MB_modes.get());
   // for debugging
   // fprintf(stderr, "Frame %6d (P), I:%6d, P:%6d, B:%6d, MSE = %9d, bits =
   // %7d\n",pict->pos()+1,m_pPmv->count_I(),m_pPmv->count_P(),0,error,bits);
-  pict->boundaryExtend();
+  extend(pict);
 }
 
 void ComplexityAnalyzer::process_b_picture(YUVFrame *pict, YUVFrame *fwdref,
                                            YUVFrame *backref) {
-  int error = m_pPmv->predictBidirectional(
-      pict, fwdref, backref, m_pB1mv, m_pB2mv, &m_mses.get()[m_pPmv->firstMB()],
-      &m_MB_modes.get()[m_pPmv->firstMB()]);
-  int bits = m_pPmv->bits();
+  CounterScope counters(m_pCounters.get(), m_counts, 'B', 1, num_MBs());
+  int error;
+  {
+    StageTimer timer(m_times, STAGE_PREDICT_BIDIRECTIONAL, 'B');
+    error = m_pPmv->predictBidirectional(
+        pict, fwdref, backref, m_pB1mv, m_pB2mv,
+        &m_mses.get()[m_pPmv->firstMB()], &m_MB_modes.get()[m_pPmv->firstMB()]);
+  }
+  add_b_info(pict, m_pPmv, m_pB1mv, m_pB2mv, m_mses.get(), m_MB_modes.get(),
+             error);
+}
+
+// Search the B-pictures pics[1 .. num_pictures] of the current sub-GOP
+// concurrently, then book them in display order
+void ComplexityAnalyzer::process_b_pictures(int num_pictures) {
+  YUVFrame *fwdref = pics[0];
+  YUVFrame *backref = pics[(size_t)num_pictures + 1];
+
+  m_pPool->parallelFor(num_pictures, [&](int i) {
+    BPictureContext *ctx = m_BContexts[(size_t)i].get();
+    // The counters only follow the thread that opened them, so each pool
+    // thread opens its own the first time it searches a B-picture
+    const PerfCounters *worker_counters = nullptr;
+    if (m_pCounters) {
+      thread_local std::unique_ptr<PerfCounters> thread_counters;
+      if (!thread_counters) {
+        thread_counters.reset(new PerfCounters);
+      }
+      worker_counters = thread_counters.get();
+    }
+    CounterScope counters(worker_counters, ctx->counts, 'B', 1, num_MBs());
+    ctx->pmv->copyVectors(m_pPmv);
+    StageTimer timer(ctx->times, STAGE_PREDICT_BIDIRECTIONAL, 'B');
+    ctx->error = ctx->pmv->predictBidirectional(
+        pics[(size_t)i + 1], fwdref, backref, ctx->b1mv.get(), ctx->b2mv.get(),
+        &ctx->mses.get()[ctx->pmv->firstMB()],
+        &ctx->MB_modes.get()[ctx->pmv->firstMB()]);
+  });
+
+  for (int i = 0; i < num_pictures; i++) {
+    BPictureContext *ctx = m_BContexts[(size_t)i].get();
+    add_b_info(pics[(size_t)i + 1], ctx->pmv.get(), ctx->b1mv.get(),
+               ctx->b2mv.get(), ctx->mses.get(), ctx->MB_modes.get(),
+               ctx->error);
+    m_times.add(ctx->times);
+    ctx->times = stage_times_t();
+    m_counts.add(ctx->counts);
+    ctx->counts = frame_counts_t();
+  }
+}
+
+void ComplexityAnalyzer::add_b_info(YUVFrame *pict, MotionVectorField *pmv,
+                                    MotionVectorField *b1mv,
+                                    MotionVectorField *b2mv, int *mses,
+                                    unsigned char *MB_modes, int error) {
+  int bits = pmv->bits();
 
   // We are weighting B-frames by 0% more bits (256/256), since QP needs to be
   // highest among I/P/B
   bits = (B_FRAME_BIT_WEIGHT * bits + 128) >> 8;
   m_GOP_bits += bits;
   m_GOP_error += error;
-  add_info(m_pReader->count() - (backref->pos() - pict->pos()), 'B', error,
-           m_pPmv->count_I(), m_pPmv->count_P(), m_pPmv->count_B(), bits);
+  add_info(pict->pos() + 1, 'B', error, pmv->count_I(), pmv->count_P(),
+           pmv->count_B(), 0, bits);
+  add_mb_info(pict, 'B', error, bits, b1mv, b2mv, mses, MB_modes);
   // for debugging
   // fprintf(stderr, "Frame %6d (B), I:%6d, P:%6d, B:%6d, MSE = %9d, bits =
-  // %7d\n",pict->pos()+1,m_pPmv->count_I(),m_pPmv->count_P(),m_pPmv->count_B(),error,bits);
+  // %7d\n",pict->pos()+1,pmv->count_I(),pmv->count_P(),pmv->count_B(),error,
+  // bits);
 }
 
 void ComplexityAnalyzer::analyze() {
   int td = 0;
   int td_ref;
 
+  int expected = m_pReader->nframes();
+  if (m_num_frames > 0 && (expected <= 0 || m_num_frames < expected)) {
+    expected = m_num_frames;
+  }
+  if (!m_callback) {
+    m_info.reserve((size_t)std::max(expected, 0));
+  }
+
+  const bool sampling = m_sampling.interval > 1 || m_sampling.budget > 0;
+  if (sampling && expected <= 0) {
+    if (m_verbose) {
+      fprintf(stderr, "Unknown frame count, analyzing every GOP\n");
+    }
+    m_sampling = {0, 0};
+  }
+  const int num_GOPs = (std::max(expected, 0) + m_GOP_size - 1) / m_GOP_size;
+
   try {
-    while (m_num_frames > 0 ? m_pReader->count() < m_num_frames
-                            : !m_pReader->eof()) {
-      fprintf(stderr, "Picture count: %d\r", m_pReader->count() - 1);
+    while (m_num_frames > 0 ? m_pRing->count() < m_num_frames
+                            : !m_pRing->eof()) {
+      if (m_verbose) {
+        fprintf(stderr, "Picture count: %d\r", m_pRing->count() - 1);
+      }
 
-      if ((m_pReader->count() % m_GOP_size) == 0) {
-        if (m_pReader->count()) {
-          fprintf(stderr, "GOP: %d, GOP-bits: %d\n", m_GOP_count, m_GOP_bits);
+      if ((m_pRing->count() % m_GOP_size) == 0) {
+        if (m_pRing->count()) {
+          if (m_verbose && m_GOP_sampled) {
+            fprintf(stderr, "GOP: %d, GOP-bits: %d\n", m_GOP_count,
+                    m_GOP_bits);
+          }
           m_GOP_count++;
         }
         m_GOP_error = 0;
         m_GOP_bits = 0;
 
+        m_GOP_sampled = is_sampled_gop(m_sampling, m_GOP_count, num_GOPs);
+        if (!m_GOP_sampled) {
+          const int frames =
+              std::min(m_GOP_size, expected - m_pRing->count());
+          if (frames <= 0) {
+            break;
+          }
+          skip_gop(frames);
+          continue;
+        }
+
         td = 0;
-        pics[0]->readNextFrame();
+        m_pRing->release(pics[0]);
+        pics[0] = m_pRing->acquire();
         process_i_picture(pics[0]);
-      } else {
-        pics[0]->swapFrame(pics[(size_t)m_subGOP_size]);
       }
 
       for (td_ref = td; td < (m_GOP_size - 1) && (td - td_ref) < m_subGOP_size;
            td++) {
-        pics[(size_t)(td + 1 - td_ref)]->readNextFrame();
+        pics[(size_t)(td + 1 - td_ref)] = m_pRing->acquire();
       }
 
       process_p_picture(/* target    */ pics[(size_t)(td - td_ref)],
                         /* reference */ pics[0]);
 
-      for (int j = 1; j < td - td_ref; j++) {
-        process_b_picture(/* target  */ pics[(size_t)j],
-                          /* forward */ pics[0],
-                          /* reverse */ pics[(size_t)(td - td_ref)]);
+      if (m_pPool && td - td_ref > 1) {
+        process_b_pictures(td - td_ref - 1);
+      } else {
+        for (int j = 1; j < td - td_ref; j++) {
+          process_b_picture(/* target  */ pics[(size_t)j],
+                            /* forward */ pics[0],
+                            /* reverse */ pics[(size_t)(td - td_ref)]);
+        }
+      }
+
+      // The P-picture becomes the forward reference of the next sub-GOP
+      if (td > td_ref) {
+        for (int j = 0; j < td - td_ref; j++) {
+          m_pRing->release(pics[(size_t)j]);
+        }
+        pics[0] = pics[(size_t)(td - td_ref)];
       }
     }
   } catch (EOFException &e) {
-    fprintf(stderr, "\n%s\n", e.what());
+    if (m_verbose) {
+      fprintf(stderr, "\n%s\n", e.what());
+    }
   }
 
-  if (m_pReorderedInfo != NULL)
-    m_info.push_back(m_pReorderedInfo);
+  if (m_reordered >= 0)
+    m_complete = m_reordered + 1;
+  m_reordered = -1;
+  emit_info();
 
-  fprintf(stderr, "Processed frames: %d\n", m_pReader->count());
+  if (m_verbose) {
+    fprintf(stderr, "Processed frames: %d\n", m_pRing->count());
+  }
 }
@@ -9,10 +9,16 @@
 
 #include "common.h"
 
+#include "FrameRing.h"
 #include "IVideoSequenceReader.h"
 #include "MotionVectorField.h"
+#include "PerfCounters.h"
+#include "StageTimer.h"
+#include "ThreadPool.h"
 #include "memory.h"
 
+#include <functional>
+#include <memory>
 #include <vector>
 
 using std::vector;
@@ -23,25 +29,143 @@ typedef struct {
   int count_I;
   int count_P;
   int count_B;
+  int count_skip; // P macroblocks that skipped the search
   int bits;
   int error;
 } complexity_info_t;
 
+// Receives the result of every frame, in display order
+typedef std::function<void(const complexity_info_t &)> frame_callback_t;
+
+// GOPs analyzed when sampling a title: every interval-th GOP, starting with
+// the first, or budget GOPs spread evenly over it. The other GOPs are
+// skipped, to be estimated from the analyzed ones. All GOPs are analyzed
+// when both are 0.
+typedef struct {
+  int interval;
+  int budget;
+} gop_sampling_t;
+
+// Whether GOP gop of the num_gops of a title is analyzed
+bool is_sampled_gop(const gop_sampling_t &sampling, int gop, int num_gops);
+
+// Receives the frames of every GOP skipped by sampling, in display order
+// with the frames of the analyzed GOPs
+typedef std::function<void(int first_frame, int frames)> skip_callback_t;
+
+// Per-macroblock results of one frame. The planes hold mbs_y rows of mbs_x
+// macroblocks, stride_MB entries apart, starting at the first macroblock.
+// mvs[0] and sads[0] are the P-picture or forward B-picture search, mvs[1]
+// and sads[1] the backward B-picture search; unused ones are NULL. Modes are
+// 0 for intra, 1 for P or forward, 2 for backward, 3 for bidirectional and
+// 4 for 8x8 bidirectional blocks.
+typedef struct {
+  int picNum;
+  int picType;
+  int bits;
+  int error;
+  int mbs_x;
+  int mbs_y;
+  int stride_MB;
+  const unsigned char *modes;
+  const int *mses;
+  const MV *mvs[2];
+  const int *sads[2];
+} mb_frame_info_t;
+
+// Receives the macroblocks of every frame, in decode order; the planes are
+// only valid during the call
+typedef std::function<void(const mb_frame_info_t &)> mb_callback_t;
+
+// Throws std::invalid_argument unless pictures of dimensions dim can be
+// searched in macroblocks of block_size pixels: 8, 16, 32 or 64, with the last
+// macroblock of a row overhanging the picture into its padding only. The
+// quarter resolution blocks of the pyramid are 4 pixels wide at least, so it
+// needs a block size of 16 or more.
+void check_block_size(const DIM &dim, int block_size, bool pyramid);
+
 class ComplexityAnalyzer {
 public:
+  // In pipelined mode a reader thread fills the frame ring ahead of the
+  // search, and the B-pictures of a sub-GOP are searched concurrently. With
+  // row_threads > 1 the macroblock rows of P-pictures, and of B-pictures
+  // searched one at a time, are searched in wavefront order. The results are
+  // identical to the serial mode. The pictures are searched in square
+  // macroblocks of block_size pixels (see motion_search.h); an unsupported
+  // block size throws std::invalid_argument (see check_block_size()).
   ComplexityAnalyzer(IVideoSequenceReader *reader, int gop_size, int num_frames,
-                     int b_frames);
+                     int b_frames, bool pipelined = false,
+                     int row_threads = 1, int block_size = MB_WIDTH);
 
   ~ComplexityAnalyzer(void);
 
   void analyze(void);
 
-  vector<complexity_info_t *> getInfo() { return m_info; }
+  // Results of every frame in display order, stored contiguously
+  const vector<complexity_info_t> &getInfo() const { return m_info; }
+
+  // Pass every frame to the callback as soon as it is complete in display
+  // order, instead of keeping it for getInfo()
+  void setFrameCallback(frame_callback_t callback) {
+    m_callback = std::move(callback);
+  }
+
+  // Pass the macroblock planes of every frame to the callback once the frame
+  // is searched
+  void setMacroblockCallback(mb_callback_t callback) {
+    m_mb_callback = std::move(callback);
+  }
+
+  // Analyze only the GOPs of the sampling plan, and seek past the others
+  // when the reader can. Sampling needs the frame count of the input; it is
+  // ignored when the reader doesn't know it.
+  void setSampling(const gop_sampling_t &sampling) { m_sampling = sampling; }
+
+  // Pass the GOPs skipped by sampling to the callback
+  void setSkipCallback(skip_callback_t callback) {
+    m_skip_callback = std::move(callback);
+  }
+
+  // Progress and per-GOP messages on stderr (default: on)
+  void setVerbose(bool verbose) { m_verbose = verbose; }
+
+  // Time spent in the read, border extension and search stages so far
+  stage_times_t getTimes(void);
+
+  // Count hardware events around the processing of each I-, P- and
+  // B-picture. The counters follow the calling thread, which must be the one
+  // calling analyze(), and the B-pictures searched concurrently are counted
+  // on the pool thread that searches them; the work of the --pipeline reader
+  // and of the row threads is not counted. Returns false, and counts
+  // nothing, when the counters are unavailable.
+  bool enablePerfCounters(void);
+
+  // Event counts of the frames of each type
+  const frame_counts_t &getCounts() const { return m_counts; }
+
+  // Search a 1/4 and 1/16 luma pyramid of every picture first, and add the
+  // vector it finds to the predictors of each macroblock (default: off).
+  // Throws std::invalid_argument with blocks smaller than 16 pixels.
+  void setPyramid(bool enable);
+
+  // Code the P-picture macroblocks whose SAD along the zero or the predicted
+  // vector is below threshold per pixel as P with that vector, without the
+  // search, the 8x8 modes and the intra cost (default: 0, off)
+  void setSkipThreshold(int threshold);
+
+  // Leave out the 8x8 searches of the macroblocks whose 16x16 MSE is low or
+  // spread evenly over their quadrants, in P- and B-pictures (default: off)
+  void setPartitionPruning(bool enable);
+
+  // Search the P- and B-pictures with the given strategy (default:
+  // ME_PMVFAST); the I-pictures keep their spatial search
+  void setSearchMethod(me_method_t method);
 
 private:
   DIM m_dim;
   int m_stride;
   int m_padded_height;
+  int m_block_size;
   int m_num_frames;
 
   int m_GOP_size;
@@ -50,6 +174,12 @@ private:
   int m_GOP_error;
   int m_GOP_bits;
   int m_GOP_count;
+  bool m_GOP_sampled = true;
+
+  gop_sampling_t m_sampling = {0, 0};
+  skip_callback_t m_skip_callback;
+
+  bool m_verbose = true;
 
   vector<YUVFrame *> pics;
 
@@ -62,13 +192,53 @@ private:
 
   IVideoSequenceReader *m_pReader;
 
-  vector<complexity_info_t *> m_info;
-  complexity_info_t *m_pReorderedInfo;
+  std::unique_ptr<FrameRing> m_pRing;
+
+  // Search state of one B-picture slot of a sub-GOP. The pipelined mode owns
+  // one per B-picture, with a private copy of the P-picture vectors.
+  struct BPictureContext {
+    std::unique_ptr<MotionVectorField> pmv;
+    std::unique_ptr<MotionVectorField> b1mv;
+    std::unique_ptr<MotionVectorField> b2mv;
+    memory::aligned_unique_ptr<int> mses;
+    memory::aligned_unique_ptr<unsigned char> MB_modes;
+    int error;
+    stage_times_t times;
+    frame_counts_t counts;
+  };
+
+  vector<std::unique_ptr<BPictureContext>> m_BContexts;
+  std::unique_ptr<ThreadPool> m_pPool;
+  std::unique_ptr<ThreadPool> m_pRowPool;
+
+  // Frames are stored at their display index, relative to m_info_base. The
+  // I- or P-picture at index m_reordered waits for the B-pictures before it;
+  // the frames before m_complete are final.
+  vector<complexity_info_t> m_info;
+  int m_info_base;
+  int m_reordered = -1;
+  int m_complete = 0;
+  frame_callback_t m_callback;
+  mb_callback_t m_mb_callback;
+
+  stage_times_t m_times;
+
+  bool m_pyramid = false;
+
+  std::unique_ptr<PerfCounters> m_pCounters;
+  frame_counts_t m_counts;
+
+  template <typename data_t>
+  memory::aligned_unique_ptr<data_t> alloc_MB_plane(const char *name);
 
   void reset_gop_start(void);
 
   void add_info(int num, char p, int err, int count_I, int count_P, int count_B,
-                int bits);
+                int count_skip, int bits);
+
+  void emit_info(void);
+
+  void skip_gop(int frames);
 
   void process_i_picture(YUVFrame *pict);
 
@@ -76,6 +246,20 @@ private:
 
   void process_b_picture(YUVFrame *pict, YUVFrame *fwdref, YUVFrame *backref);
 
+  void process_b_pictures(int num_pictures);
+
+  void extend(YUVFrame *pict);
+
+  int num_MBs(void);
+
+  void add_b_info(YUVFrame *pict, MotionVectorField *pmv,
+                  MotionVectorField *b1mv, MotionVectorField *b2mv, int *mses,
+                  unsigned char *MB_modes, int error);
+
+  void add_mb_info(YUVFrame *pict, char p, int err, int bits,
+                   MotionVectorField *fwd, MotionVectorField *bwd, int *mses,
+                   unsigned char *MB_modes);
+
   ComplexityAnalyzer(ComplexityAnalyzer &) = delete;
 
   ComplexityAnalyzer &operator=(ComplexityAnalyzer &) = delete;
@@ -7,23 +7,25 @@
 
 #include "DataConverter.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 
 namespace motion_search {
 
-FrameData DataConverter::convertFrame(const complexity_info_t *info, int width,
+FrameData DataConverter::convertFrame(const complexity_info_t &info, int width,
                                       int height) {
   FrameData frame;
 
-  frame.frame_num = info->picNum;
-  frame.type = charToFrameType(static_cast<char>(info->picType));
+  frame.frame_num = info.picNum;
+  frame.type = charToFrameType(static_cast<char>(info.picType));
 
-  frame.count_intra = info->count_I;
-  frame.count_inter_p = info->count_P;
-  frame.count_inter_b = info->count_B;
+  frame.count_intra = info.count_I;
+  frame.count_inter_p = info.count_P;
+  frame.count_inter_b = info.count_B;
 
-  frame.estimated_bits = info->bits;
-  frame.error = info->error;
+  frame.estimated_bits = info.bits;
+  frame.error = info.error;
 
   // Compute complexity metrics
   // For now, use simple heuristics based on available data
@@ -70,6 +72,35 @@ FrameData DataConverter::convertFrame(const complexity_info_t *info, int width,
   return frame;
 }
 
+void DataConverter::addFrameToGOP(GOPData &gop, const FrameData &frame) {
+  if (gop.frames.empty()) {
+    gop.start_frame = frame.frame_num;
+  }
+  gop.end_frame = frame.frame_num;
+
+  // Accumulate stats
+  gop.total_bits += frame.estimated_bits;
+  gop.total_error += frame.error;
+  gop.avg_complexity += frame.complexity.unified_complexity;
+
+  if (frame.type == FrameType::I)
+    gop.i_frame_count++;
+  else if (frame.type == FrameType::P)
+    gop.p_frame_count++;
+  else if (frame.type == FrameType::B)
+    gop.b_frame_count++;
+
+  // Add frame reference to GOP (for frame-level detail)
+  gop.frames.push_back(frame);
+}
+
+void DataConverter::finishGOP(GOPData &gop) {
+  // Average complexity
+  if (!gop.frames.empty()) {
+    gop.avg_complexity /= gop.frames.size();
+  }
+}
+
 void DataConverter::computeGOPData(AnalysisResults &results, int gop_size) {
   results.gops.clear();
 
@@ -91,30 +122,11 @@ void DataConverter::computeGOPData(AnalysisResults &results, int gop_size) {
       // Finish current GOP
       GOPData gop;
       gop.gop_num = current_gop_num;
-      gop.start_frame = results.frames[current_gop_start].frame_num;
-      gop.end_frame = results.frames[i - 1].frame_num;
 
-      // Accumulate stats
       for (size_t j = current_gop_start; j < i; ++j) {
-        gop.total_bits += results.frames[j].estimated_bits;
-        gop.avg_complexity += results.frames[j].complexity.unified_complexity;
-
-        if (results.frames[j].type == FrameType::I)
-          gop.i_frame_count++;
-        else if (results.frames[j].type == FrameType::P)
-          gop.p_frame_count++;
-        else if (results.frames[j].type == FrameType::B)
-          gop.b_frame_count++;
-
-        // Add frame reference to GOP (for frame-level detail)
-        gop.frames.push_back(results.frames[j]);
-      }
-
-      // Average complexity
-      int frame_count = i - current_gop_start;
-      if (frame_count > 0) {
-        gop.avg_complexity /= frame_count;
+        addFrameToGOP(gop, results.frames[j]);
       }
+      finishGOP(gop);
 
       results.gops.push_back(gop);
 
@@ -127,33 +139,17 @@ void DataConverter::computeGOPData(AnalysisResults &results, int gop_size) {
   // Add final GOP
   GOPData gop;
   gop.gop_num = current_gop_num;
-  gop.start_frame = results.frames[current_gop_start].frame_num;
-  gop.end_frame = results.frames.back().frame_num;
 
   for (size_t j = current_gop_start; j < results.frames.size(); ++j) {
-    gop.total_bits += results.frames[j].estimated_bits;
-    gop.avg_complexity += results.frames[j].complexity.unified_complexity;
-
-    if (results.frames[j].type == FrameType::I)
-      gop.i_frame_count++;
-    else if (results.frames[j].type == FrameType::P)
-      gop.p_frame_count++;
-    else if (results.frames[j].type == FrameType::B)
-      gop.b_frame_count++;
-
-    gop.frames.push_back(results.frames[j]);
-  }
-
-  int frame_count = results.frames.size() - current_gop_start;
-  if (frame_count > 0) {
-    gop.avg_complexity /= frame_count;
+    addFrameToGOP(gop, results.frames[j]);
   }
+  finishGOP(gop);
 
   results.gops.push_back(gop);
 }
 
 AnalysisResults
-DataConverter::convert(const std::vector<complexity_info_t *> &info_vec,
+DataConverter::convert(const std::vector<complexity_info_t> &info_vec,
                        int width, int height, int gop_size, int bframes,
                        const std::string &input_format,
                        const std::string &input_filename) {
@@ -171,7 +167,7 @@ DataConverter::convert(const std::vector<complexity_info_t *> &info_vec,
 
   // Convert each frame
   results.frames.reserve(info_vec.size());
-  for (const auto *info : info_vec) {
+  for (const auto &info : info_vec) {
     results.frames.push_back(convertFrame(info, width, height));
   }
 
@@ -181,4 +177,186 @@ DataConverter::convert(const std::vector<complexity_info_t *> &info_vec,
   return results;
 }
 
+void DataConverter::convertTimings(const stage_times_t &times,
+                                   VideoMetadata &metadata) {
+  metadata.stage_timings.clear();
+  for (int i = 0; i < NUM_STAGES; i++) {
+    StageTiming stage;
+    stage.stage = stage_name(i);
+    stage.calls = times.calls[i];
+    stage.total_ms = static_cast<double>(times.ns[i]) / 1e6;
+    metadata.stage_timings.push_back(stage);
+  }
+
+  static const char types[NUM_FRAME_TYPES] = {'I', 'P', 'B'};
+  metadata.frame_type_timings.clear();
+  for (int i = 0; i < NUM_FRAME_TYPES; i++) {
+    FrameTypeTiming type;
+    type.type = charToFrameType(types[i]);
+    type.frames = times.type_frames[i];
+    type.total_ms = static_cast<double>(times.type_ns[i]) / 1e6;
+    if (type.frames > 0) {
+      type.avg_ms = type.total_ms / type.frames;
+    }
+    metadata.frame_type_timings.push_back(type);
+  }
+}
+
+namespace {
+
+// Two-sided 95% quantile of Student's t distribution
+double tQuantile(int degrees) {
+  static const double table[30] = {
+      12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+      2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+      2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+  return degrees <= 30 ? table[degrees - 1] : 1.960;
+}
+
+} // namespace
+
+void SampleEstimator::add(Sums &sums, double y, double frames) {
+  sums.y += y;
+  sums.yy += y * y;
+  sums.yf += y * frames;
+}
+
+void SampleEstimator::addSampled(const GOPData &gop) {
+  const double frames = static_cast<double>(gop.frames.size());
+
+  add(bits_, static_cast<double>(gop.total_bits), frames);
+  add(error_, static_cast<double>(gop.total_error), frames);
+  frames_ += frames;
+  frames_squared_ += frames * frames;
+  sampled_gops_++;
+  sampled_frames_ += static_cast<int>(gop.frames.size());
+}
+
+void SampleEstimator::addEstimated(int frames) {
+  estimated_gops_++;
+  estimated_frames_ += frames;
+}
+
+// Ratio estimate of the total over all frames. Its standard error uses the
+// residuals of the sampled GOPs around the ratio, with the finite population
+// correction, so it is 0 when every GOP was sampled.
+void SampleEstimator::extrapolate(const Sums &sums, double &total,
+                                  double &low, double &high) const {
+  const double n = sampled_gops_;
+  const double N = sampled_gops_ + estimated_gops_;
+  const double ratio = frames_ > 0.0 ? sums.y / frames_ : 0.0;
+
+  total = ratio * (sampled_frames_ + estimated_frames_);
+  low = high = total;
+  if (sampled_gops_ < 2) {
+    return;
+  }
+
+  const double residuals =
+      sums.yy - 2.0 * ratio * sums.yf + ratio * ratio * frames_squared_;
+  const double variance = std::max(residuals, 0.0) / (n - 1.0);
+  const double error = N * std::sqrt((1.0 - n / N) / n * variance) *
+                       tQuantile(sampled_gops_ - 1);
+
+  // The skipped GOPs can't take away from the sampled ones
+  low = std::max(total - error, sums.y);
+  high = total + error;
+}
+
+SamplingEstimate SampleEstimator::estimate() const {
+  SamplingEstimate estimate;
+
+  estimate.sampled_gops = sampled_gops_;
+  estimate.estimated_gops = estimated_gops_;
+  estimate.sampled_frames = sampled_frames_;
+  estimate.total_frames = sampled_frames_ + estimated_frames_;
+  estimate.has_bounds = sampled_gops_ >= 2 || estimated_gops_ == 0;
+  extrapolate(bits_, estimate.total_bits, estimate.bits_low,
+              estimate.bits_high);
+  extrapolate(error_, estimate.total_error, estimate.error_low,
+              estimate.error_high);
+  return estimate;
+}
+
+StreamingConverter::StreamingConverter(OutputWriter &writer,
+                                       const VideoMetadata &metadata)
+    : writer_(writer), metadata_(metadata) {}
+
+void StreamingConverter::begin() {
+  StageTimer timer(times_, STAGE_WRITE);
+  writer_.begin(metadata_);
+}
+
+void StreamingConverter::addFrame(const complexity_info_t &info) {
+  FrameData frame;
+  {
+    StageTimer timer(times_, STAGE_CONVERT);
+    frame =
+        DataConverter::convertFrame(info, metadata_.width, metadata_.height);
+  }
+
+  // Start a new GOP when we see an I-frame
+  if (frame.type == FrameType::I && !gop_.frames.empty()) {
+    completeGOP();
+  }
+
+  DataConverter::addFrameToGOP(gop_, frame);
+  {
+    StageTimer timer(times_, STAGE_WRITE);
+    writer_.onFrame(frame);
+  }
+  frame_count_++;
+}
+
+void StreamingConverter::completeGOP() {
+  {
+    StageTimer timer(times_, STAGE_CONVERT);
+    DataConverter::finishGOP(gop_);
+    estimator_.addSampled(gop_);
+  }
+  {
+    StageTimer timer(times_, STAGE_WRITE);
+    writer_.onGOPComplete(gop_);
+  }
+
+  const int gop_num = gop_.gop_num + 1;
+  gop_ = GOPData();
+  gop_.gop_num = gop_num;
+}
+
+void StreamingConverter::skipGOP(int first_frame, int frames) {
+  if (!gop_.frames.empty()) {
+    completeGOP();
+  }
+
+  GOPData gop;
+  gop.gop_num = gop_.gop_num;
+  gop.start_frame = first_frame;
+  gop.end_frame = first_frame + frames - 1;
+  gop.sampled = false;
+  estimator_.addEstimated(frames);
+  {
+    StageTimer timer(times_, STAGE_WRITE);
+    writer_.onGOPComplete(gop);
+  }
+  gop_.gop_num++;
+}
+
+void StreamingConverter::end(const stage_times_t *analysis) {
+  if (!gop_.frames.empty()) {
+    completeGOP();
+  }
+  if (metadata_.sampling) {
+    metadata_.sampling_estimate = estimator_.estimate();
+  }
+
+  // The time of writing the end itself is not included
+  if (analysis) {
+    stage_times_t times = *analysis;
+    times.add(times_);
+    DataConverter::convertTimings(times, metadata_);
+  }
+  writer_.end(metadata_);
+}
+
 } // namespace motion_search
@@ -9,6 +9,8 @@
 
 #include "ComplexityAnalyzer.h"
 #include "OutputData.h"
+#include "OutputWriter.h"
+#include "StageTimer.h"
 
 #include <vector>
 
@@ -21,7 +23,7 @@ class DataConverter {
 public:
   /**
    * @brief Convert complexity info vector to AnalysisResults
-   * @param info_vec Vector of complexity_info_t pointers
+   * @param info_vec Vector of complexity_info_t records in display order
    * @param width Video width
    * @param height Video height
    * @param gop_size GOP size
@@ -31,14 +33,147 @@ public:
    * @return AnalysisResults structure
    */
   static AnalysisResults
-  convert(const std::vector<complexity_info_t *> &info_vec, int width,
+  convert(const std::vector<complexity_info_t> &info_vec, int width,
           int height, int gop_size, int bframes,
           const std::string &input_format, const std::string &input_filename);
 
-private:
-  static FrameData convertFrame(const complexity_info_t *info, int width,
+  /**
+   * @brief Convert one complexity_info_t record to FrameData
+   */
+  static FrameData convertFrame(const complexity_info_t &info, int width,
                                 int height);
+
+  /**
+   * @brief Add a frame to the statistics and frames of a GOP
+   */
+  static void addFrameToGOP(GOPData &gop, const FrameData &frame);
+
+  /**
+   * @brief Complete the statistics of a GOP once all its frames were added
+   */
+  static void finishGOP(GOPData &gop);
+
+  /**
+   * @brief Fill the stage timings of the metadata
+   */
+  static void convertTimings(const stage_times_t &times,
+                             VideoMetadata &metadata);
+
+private:
   static void computeGOPData(AnalysisResults &results, int gop_size);
 };
 
+/**
+ * @brief Extrapolate the totals of the input from the sampled GOPs
+ *
+ * Only running sums are kept, so memory does not grow with the number of
+ * GOPs. The bits and error per frame of the sampled GOPs are taken as a
+ * simple random sample of the GOPs of the input, which overstates the
+ * variance of evenly spread samples on smoothly varying content.
+ */
+class SampleEstimator {
+public:
+  /**
+   * @brief Add a sampled GOP, with its frames
+   */
+  void addSampled(const GOPData &gop);
+
+  /**
+   * @brief Add a GOP skipped by sampling
+   */
+  void addEstimated(int frames);
+
+  /**
+   * @brief Totals of the GOPs added so far
+   */
+  SamplingEstimate estimate() const;
+
+private:
+  struct Sums {
+    double y = 0.0;  // Sum of the GOP totals
+    double yy = 0.0; // Sum of their squares
+    double yf = 0.0; // Sum of their products with the frame counts
+  };
+
+  Sums bits_;
+  Sums error_;
+  double frames_ = 0.0;
+  double frames_squared_ = 0.0;
+  int sampled_gops_ = 0;
+  int sampled_frames_ = 0;
+  int estimated_gops_ = 0;
+  int estimated_frames_ = 0;
+
+  static void add(Sums &sums, double y, double frames);
+  void extrapolate(const Sums &sums, double &total, double &low,
+                   double &high) const;
+};
+
+/**
+ * @brief Convert complexity_info_t records into an OutputWriter as they come
+ *
+ * Records are expected in display order, as ComplexityAnalyzer reports them.
+ * A GOP is passed to the writer when the next I-frame or end() arrives, so
+ * only the frames of the current GOP are kept.
+ */
+class StreamingConverter {
+public:
+  /**
+   * @param writer Writer receiving the frames and GOPs
+   * @param metadata Metadata passed to the writer; total_frames is the
+   *                 expected number of frames
+   */
+  StreamingConverter(OutputWriter &writer, const VideoMetadata &metadata);
+
+  /**
+   * @brief Start the output
+   */
+  void begin();
+
+  /**
+   * @brief Convert and pass on the next frame in display order
+   */
+  void addFrame(const complexity_info_t &info);
+
+  /**
+   * @brief Pass on a GOP skipped by sampling, in display order with the
+   *        frames
+   */
+  void skipGOP(int first_frame, int frames);
+
+  /**
+   * @brief Pass on the last GOP and finish the output
+   * @param analysis Time spent in the stages of the analysis; when given,
+   *                 the output gets the stage timings, with the time spent
+   *                 converting and writing the results
+   */
+  void end(const stage_times_t *analysis = nullptr);
+
+  /**
+   * @brief Number of frames passed on so far
+   */
+  int frameCount() const { return frame_count_; }
+
+  /**
+   * @brief Totals extrapolated from the GOPs passed on so far
+   */
+  SamplingEstimate estimate() const { return estimator_.estimate(); }
+
+  /**
+   * @brief Time spent converting and writing the results so far
+   */
+  const stage_times_t &times() const { return times_; }
+
+private:
+  OutputWriter &writer_;
+  VideoMetadata metadata_;
+  GOPData gop_;
+  int frame_count_ = 0;
+  stage_times_t times_;
+  SampleEstimator estimator_;
+
+  // Pass on the current GOP and start the next one
+  void completeGOP();
+};
+
 } // namespace motion_search
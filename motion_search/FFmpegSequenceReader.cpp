@@ -246,26 +246,32 @@ void FFmpegSequenceReader::readPicture(uint8_t *pY, uint8_t *pU, uint8_t *pV) {
     throw EOFException();
   }
 
-  // Convert frame to YUV420p
-  sws_scale(sws_ctx_, frame_->data, frame_->linesize, 0, codec_ctx_->height,
-            frame_yuv_->data, frame_yuv_->linesize);
+  // A YUV420p luma plane is taken as decoded when chroma is not wanted
+  AVFrame *src = frame_;
+  if (pU != NULL || codec_ctx_->pix_fmt != AV_PIX_FMT_YUV420P) {
+    // Convert frame to YUV420p
+    sws_scale(sws_ctx_, frame_->data, frame_->linesize, 0, codec_ctx_->height,
+              frame_yuv_->data, frame_yuv_->linesize);
+    src = frame_yuv_;
+  }
 
   // Copy Y plane
   for (int y = 0; y < m_dim.height; y++) {
-    memcpy(pY + y * m_stride, frame_yuv_->data[0] + y * frame_yuv_->linesize[0],
-           m_dim.width);
+    memcpy(pY + y * m_stride, src->data[0] + y * src->linesize[0], m_dim.width);
   }
 
   // Copy U plane (half resolution)
-  int uv_width = m_dim.width / 2;
-  int uv_height = m_dim.height / 2;
-  ptrdiff_t uv_stride = m_stride / 2;
-
-  for (int y = 0; y < uv_height; y++) {
-    memcpy(pU + y * uv_stride,
-           frame_yuv_->data[1] + y * frame_yuv_->linesize[1], uv_width);
-    memcpy(pV + y * uv_stride,
-           frame_yuv_->data[2] + y * frame_yuv_->linesize[2], uv_width);
+  if (pU != NULL) {
+    int uv_width = m_dim.width / 2;
+    int uv_height = m_dim.height / 2;
+    ptrdiff_t uv_stride = m_stride / 2;
+
+    for (int y = 0; y < uv_height; y++) {
+      memcpy(pU + y * uv_stride,
+             frame_yuv_->data[1] + y * frame_yuv_->linesize[1], uv_width);
+      memcpy(pV + y * uv_stride,
+             frame_yuv_->data[2] + y * frame_yuv_->linesize[2], uv_width);
+    }
   }
 
   frame_count_++;
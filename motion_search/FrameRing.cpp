@@ -0,0 +1,190 @@
+/*
+ Copyright (c) Meta Platforms, Inc. and affiliates.
+
+ This source code is licensed under the BSD3 license found in the
+ LICENSE file in the root directory of this source tree.
+ */
+
+#include "FrameRing.h"
+#include "EOFException.h"
+#include "YUVSequenceReader.h"
+
+#include <algorithm>
+
+FrameRing::FrameRing(IVideoSequenceReader *reader, int depth, bool read_ahead,
+                     bool luma_only, int block_size)
+    : m_pReader(reader), m_first_pos(reader->count()) {
+  for (int i = 0; i < depth; i++) {
+    m_frames.emplace_back(new YUVFrame(reader, luma_only, block_size));
+    m_free.push_back(m_frames.back().get());
+  }
+
+  if (read_ahead) {
+    m_thread = std::thread(&FrameRing::readerLoop, this);
+  }
+}
+
+FrameRing::~FrameRing(void) {
+  if (m_thread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+  }
+}
+
+YUVFrame *FrameRing::acquire(void) {
+  YUVFrame *frame;
+
+  if (!m_thread.joinable()) {
+    frame = m_free.front();
+    {
+      StageTimer timer(m_times, STAGE_READ);
+      frame->readNextFrame();
+    }
+    m_free.pop_front();
+  } else {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this] { return !m_ready.empty() || m_finished; });
+    if (m_ready.empty()) {
+      // The reader may have stopped on eof() without a failed read
+      if (!m_error) {
+        throw EOFException();
+      }
+      std::rethrow_exception(m_error);
+    }
+    frame = m_ready.front();
+    m_ready.pop_front();
+  }
+
+  m_count++;
+  return frame;
+}
+
+void FrameRing::release(YUVFrame *frame) {
+  if (frame == NULL) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_free.push_back(frame);
+  }
+  m_cv.notify_all();
+}
+
+void FrameRing::skip(int frames) {
+  if (frames <= 0) {
+    return;
+  }
+  m_count += frames;
+
+  if (!m_thread.joinable()) {
+    discard(m_free.front(), frames, m_times);
+    return;
+  }
+
+  // The reader thread skips what was not read ahead yet, including a frame
+  // it may be reading now
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_skip_to = m_count;
+    while (!m_ready.empty() && index(m_ready.front()) < m_skip_to) {
+      m_free.push_back(m_ready.front());
+      m_ready.pop_front();
+    }
+  }
+  m_cv.notify_all();
+}
+
+void FrameRing::discard(YUVFrame *frame, int frames, stage_times_t &times) {
+  StageTimer timer(times, STAGE_READ);
+
+  YUVSequenceReader *seekable = dynamic_cast<YUVSequenceReader *>(m_pReader);
+  if (seekable) {
+    int target = seekable->count() + frames;
+    if (seekable->nframes() > 0) {
+      target = std::min(target, seekable->nframes());
+    }
+    if (seekable->seek(target)) {
+      return;
+    }
+  }
+
+  for (int i = 0; i < frames && !m_pReader->eof(); i++) {
+    frame->readNextFrame();
+  }
+}
+
+stage_times_t FrameRing::times(void) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_times;
+}
+
+bool FrameRing::eof(void) {
+  if (!m_thread.joinable()) {
+    return m_pReader->eof();
+  }
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_cv.wait(lock, [this] { return !m_ready.empty() || m_finished; });
+  return m_ready.empty() && !m_error;
+}
+
+void FrameRing::readerLoop(void) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  for (;;) {
+    m_cv.wait(lock, [this] { return !m_free.empty() || m_stop; });
+    if (m_stop) {
+      break;
+    }
+
+    YUVFrame *frame = m_free.front();
+    m_free.pop_front();
+    const int skip = m_skip_to - (m_pReader->count() - m_first_pos);
+
+    lock.unlock();
+    stage_times_t times;
+    bool end;
+    try {
+      if (skip > 0) {
+        discard(frame, skip, times);
+      }
+      end = m_pReader->eof();
+      if (!end) {
+        {
+          StageTimer timer(times, STAGE_READ);
+          frame->readNextFrame();
+        }
+        {
+          StageTimer timer(times, STAGE_BOUNDARY_EXTEND);
+          frame->boundaryExtend();
+        }
+        StageTimer timer(times, STAGE_INTRA_COSTS);
+        frame->intraCosts();
+      }
+    } catch (...) {
+      lock.lock();
+      m_error = std::current_exception();
+      break;
+    }
+    lock.lock();
+    m_times.add(times);
+
+    if (end) {
+      break;
+    }
+    if (index(frame) < m_skip_to) {
+      m_free.push_back(frame);
+      continue;
+    }
+    m_ready.push_back(frame);
+    m_cv.notify_all();
+  }
+
+  m_finished = true;
+  m_cv.notify_all();
+}
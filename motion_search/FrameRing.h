@@ -0,0 +1,93 @@
+/*
+ Copyright (c) Meta Platforms, Inc. and affiliates.
+
+ This source code is licensed under the BSD3 license found in the
+ LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "IVideoSequenceReader.h"
+#include "StageTimer.h"
+#include "YUVFrame.h"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Ring of YUVFrame buffers handed out in decode order.
+///
+/// Without read-ahead, acquire() reads the next frame on the calling thread.
+/// With read-ahead, a background thread fills free buffers as soon as they
+/// are released, so decoding overlaps with motion search. The reader thread
+/// also extends the borders and computes the intra costs of each frame it
+/// reads, so acquire() hands out frames ready for the search. Reader exceptions
+/// (including EOFException) are rethrown by acquire() once every frame read
+/// before the failure has been handed out. With luma_only, the buffers hold
+/// only the Y plane and the reader skips the chroma. The intra costs are those
+/// of the block_size macroblocks.
+class FrameRing {
+public:
+  FrameRing(IVideoSequenceReader *reader, int depth, bool read_ahead,
+            bool luma_only = false, int block_size = MB_WIDTH);
+  ~FrameRing(void);
+
+  /// Next frame in decode order; the caller owns it until release()
+  YUVFrame *acquire(void);
+
+  /// Give a frame buffer back to the ring; NULL is ignored
+  void release(YUVFrame *frame);
+
+  /// Drop the next frames in decode order without handing them out. A
+  /// seekable reader seeks past them; other readers read them and throw them
+  /// away. Frames read ahead are dropped first. The skipped frames are
+  /// counted by count().
+  void skip(int frames);
+
+  /// True when the reader reached the end and every frame was handed out
+  bool eof(void);
+
+  /// Number of frames handed out so far
+  inline int count(void) { return m_count; }
+
+  /// Reader position of the next frame to hand out
+  inline int position(void) { return m_first_pos + m_count; }
+
+  /// Time spent reading frames, and preparing them on the reader thread
+  stage_times_t times(void);
+
+private:
+  IVideoSequenceReader *m_pReader;
+  std::vector<std::unique_ptr<YUVFrame>> m_frames;
+  int m_count = 0;
+
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::deque<YUVFrame *> m_free;
+  std::deque<YUVFrame *> m_ready;
+  std::exception_ptr m_error;
+  stage_times_t m_times;
+  bool m_finished = false;
+  bool m_stop = false;
+  std::thread m_thread;
+
+  // Frames are numbered from the reader position at construction; those
+  // before m_skip_to are dropped
+  int m_first_pos = 0;
+  int m_skip_to = 0;
+
+  void readerLoop(void);
+
+  inline int index(YUVFrame *frame) { return frame->pos() - m_first_pos; }
+
+  // Move the reader past the next frames, reading them into frame when it
+  // can't seek
+  void discard(YUVFrame *frame, int frames, stage_times_t &times);
+
+  FrameRing(FrameRing &) = delete;
+  FrameRing &operator=(FrameRing &) = delete;
+};
@@ -0,0 +1,121 @@
+/*
+ Copyright (c) Meta Platforms, Inc. and affiliates.
+
+ This source code is licensed under the BSD3 license found in the
+ LICENSE file in the root directory of this source tree.
+ */
+
+#include "GOPParallelAnalyzer.h"
+#include "ScaledSequenceReader.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+
+GOPParallelAnalyzer::GOPParallelAnalyzer(YUVSequenceReader *reader,
+                                         int gop_size, int num_frames,
+                                         int b_frames, int threads,
+                                         bool pipelined, int row_threads)
+    : m_pReader(reader), m_GOP_size(gop_size), m_num_frames(num_frames),
+      m_b_frames(b_frames), m_threads(threads), m_pipelined(pipelined),
+      m_row_threads(row_threads) {}
+
+void GOPParallelAnalyzer::analyze(void) {
+  // Rejected before any range starts, rather than on the pool threads
+  check_block_size(m_pReader->dim() / m_scale, m_block_size, m_pyramid);
+
+  int total = m_pReader->nframes();
+  if (m_num_frames > 0 && m_num_frames < total) {
+    total = m_num_frames;
+  }
+  const int num_ranges = (total + m_GOP_size - 1) / m_GOP_size;
+
+  if (!m_callback) {
+    m_info.reserve((size_t)total);
+  }
+
+  std::mutex mutex;
+  std::condition_variable turn;
+  int next_range = 0;
+  bool failed = false;
+
+  ThreadPool pool(std::max(1, std::min(m_threads, num_ranges)));
+  pool.parallelFor(num_ranges, [&](int i) {
+    const int first = i * m_GOP_size;
+    const int frames = std::min(m_GOP_size, total - first);
+    const bool sampled = is_sampled_gop(m_sampling, i, num_ranges);
+
+    vector<complexity_info_t> info;
+    stage_times_t times;
+    frame_counts_t counts;
+    bool opened = false;
+    std::unique_ptr<YUVSequenceReader> reader;
+    if (sampled) {
+      reader = m_pReader->reopen();
+    }
+    if (reader && reader->seek(first)) {
+      IVideoSequenceReader *input = reader.get();
+      std::unique_ptr<ScaledSequenceReader> scaled;
+      if (m_scale > 1) {
+        scaled.reset(new ScaledSequenceReader(reader.get(), m_scale));
+        input = scaled.get();
+      }
+      ComplexityAnalyzer analyzer(input, m_GOP_size, frames, m_b_frames,
+                                  m_pipelined, m_row_threads, m_block_size);
+      analyzer.setVerbose(false);
+      analyzer.setMacroblockCallback(m_mb_callback);
+      analyzer.setPyramid(m_pyramid);
+      analyzer.setSkipThreshold(m_skip_threshold);
+      analyzer.setPartitionPruning(m_prune);
+      analyzer.setSearchMethod(m_method);
+      if (m_perf_counters) {
+        analyzer.enablePerfCounters();
+      }
+      analyzer.analyze();
+      info = analyzer.getInfo();
+      times = analyzer.getTimes();
+      counts = analyzer.getCounts();
+      opened = true;
+    }
+
+    // Hand the ranges on in order. Tasks are started in index order, so the
+    // range waited for is always in flight.
+    std::unique_lock<std::mutex> lock(mutex);
+    turn.wait(lock, [&] { return next_range == i; });
+    if (sampled && !opened && !failed) {
+      fprintf(stderr, "Can't reopen the input for GOP %d\n", i);
+      failed = true;
+    }
+    if (!failed && !sampled) {
+      if (m_skip_callback) {
+        m_skip_callback(first, frames);
+      }
+    } else if (!failed) {
+      int GOP_bits = 0;
+      for (const complexity_info_t &frame : info) {
+        GOP_bits += frame.bits;
+        if (m_callback) {
+          m_callback(frame);
+        }
+      }
+      if (!m_callback) {
+        m_info.insert(m_info.end(), info.begin(), info.end());
+      }
+      fprintf(stderr, "GOP: %d, GOP-bits: %d\n", i, GOP_bits);
+      m_frame_count += (int)info.size();
+      m_times.add(times);
+      m_counts.add(counts);
+    }
+    next_range++;
+    turn.notify_all();
+  });
+
+  if (failed) {
+    exit(-1);
+  }
+
+  fprintf(stderr, "Processed frames: %d\n", m_frame_count);
+}
@@ -0,0 +1,126 @@
+/*
+ Copyright (c) Meta Platforms, Inc. and affiliates.
+
+ This source code is licensed under the BSD3 license found in the
+ LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "ComplexityAnalyzer.h"
+#include "YUVSequenceReader.h"
+
+#include <vector>
+
+using std::vector;
+
+/// Analyzes the GOPs of a seekable input concurrently.
+///
+/// Every GOP starts with an I-picture that resets the motion state, so GOPs
+/// are independent. The input is split into GOP-sized frame ranges, and each
+/// range is analyzed by its own ComplexityAnalyzer reading from its own
+/// file handle. The per-range results are concatenated in order, which gives
+/// the same output as a single ComplexityAnalyzer over the whole input. A
+/// range is handed on as soon as it and all the ranges before it completed,
+/// so only the ranges in flight are held in memory when a frame callback is
+/// set.
+class GOPParallelAnalyzer {
+public:
+  GOPParallelAnalyzer(YUVSequenceReader *reader, int gop_size, int num_frames,
+                      int b_frames, int threads, bool pipelined = false,
+                      int row_threads = 1);
+
+  ~GOPParallelAnalyzer(void) = default;
+
+  void analyze(void);
+
+  // Results of every frame in display order, stored contiguously
+  const vector<complexity_info_t> &getInfo() const { return m_info; }
+
+  // Pass every frame to the callback in display order, from the thread that
+  // completed its range, instead of keeping it for getInfo()
+  void setFrameCallback(frame_callback_t callback) {
+    m_callback = std::move(callback);
+  }
+
+  // Time spent in the stages of every range, summed over the threads
+  const stage_times_t &getTimes() const { return m_times; }
+
+  // Count hardware events in every range, on the thread analyzing it (see
+  // ComplexityAnalyzer::enablePerfCounters())
+  void enablePerfCounters(void) { m_perf_counters = true; }
+
+  // Analyze the frames decimated by 2 or 4 (see ScaledSequenceReader)
+  void setScale(int scale) { m_scale = scale; }
+
+  // Seed the search of every range from a luma pyramid (see
+  // ComplexityAnalyzer::setPyramid())
+  void setPyramid(bool enable) { m_pyramid = enable; }
+
+  // Skip the search of static P-picture macroblocks in every range (see
+  // ComplexityAnalyzer::setSkipThreshold())
+  void setSkipThreshold(int threshold) { m_skip_threshold = threshold; }
+
+  // Prune the 8x8 searches in every range (see
+  // ComplexityAnalyzer::setPartitionPruning())
+  void setPartitionPruning(bool enable) { m_prune = enable; }
+
+  // Search every range with the given strategy (see
+  // ComplexityAnalyzer::setSearchMethod())
+  void setSearchMethod(me_method_t method) { m_method = method; }
+
+  // Search every range in square macroblocks of block_size pixels (see
+  // ComplexityAnalyzer::ComplexityAnalyzer()). analyze() throws
+  // std::invalid_argument when the block size, the pyramid and the scaled
+  // dimensions don't fit (see check_block_size()).
+  void setBlockSize(int block_size) { m_block_size = block_size; }
+
+  // Analyze only the ranges of the sampling plan (see
+  // ComplexityAnalyzer::setSampling()); the others are never read
+  void setSampling(const gop_sampling_t &sampling) { m_sampling = sampling; }
+
+  // Pass the ranges skipped by sampling to the callback, in order with the
+  // frames of the analyzed ranges
+  void setSkipCallback(skip_callback_t callback) {
+    m_skip_callback = std::move(callback);
+  }
+
+  // Event counts of the frames of each type, summed over the ranges; no
+  // event is available when the counters could not be opened
+  const frame_counts_t &getCounts() const { return m_counts; }
+
+  // Pass the macroblock planes of every frame to the callback; ranges run
+  // concurrently, so it is called from several threads at once
+  void setMacroblockCallback(mb_callback_t callback) {
+    m_mb_callback = std::move(callback);
+  }
+
+private:
+  YUVSequenceReader *m_pReader;
+  int m_GOP_size;
+  int m_num_frames;
+  int m_b_frames;
+  int m_threads;
+  bool m_pipelined;
+  int m_row_threads;
+
+  vector<complexity_info_t> m_info;
+  frame_callback_t m_callback;
+  mb_callback_t m_mb_callback;
+  int m_frame_count = 0;
+  stage_times_t m_times;
+  bool m_perf_counters = false;
+  int m_scale = 1;
+  bool m_pyramid = false;
+  int m_skip_threshold = 0;
+  bool m_prune = false;
+  me_method_t m_method = ME_PMVFAST;
+  int m_block_size = MB_WIDTH;
+  gop_sampling_t m_sampling = {0, 0};
+  skip_callback_t m_skip_callback;
+  frame_counts_t m_counts;
+
+  GOPParallelAnalyzer(GOPParallelAnalyzer &) = delete;
+
+  GOPParallelAnalyzer &operator=(GOPParallelAnalyzer &) = delete;
+};
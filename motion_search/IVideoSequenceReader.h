@@ -12,6 +12,8 @@
 class IVideoSequenceReader {
 public:
   virtual ~IVideoSequenceReader(){};
+  // Read the next frame into the given planes. pU and pV may both be NULL to
+  // skip the chroma planes.
   virtual void read(uint8_t *pY, uint8_t *pU, uint8_t *pV) = 0;
   virtual bool eof(void) = 0;
   virtual int nframes(void) = 0;
@@ -13,83 +13,156 @@ using json = nlohmann::json;
 
 namespace motion_search {
 
+namespace {
+
+// Write a value with the layout of json::dump(2), nested by indent spaces.
+// The caller writes the indentation of the first line.
+void writeIndented(std::ostream &out, const json &value, int indent) {
+  const std::string text = value.dump(2);
+  const std::string margin((size_t)indent, ' ');
+
+  size_t start = 0;
+  size_t eol;
+  while ((eol = text.find('\n', start)) != std::string::npos) {
+    out.write(text.data() + start, (std::streamsize)(eol + 1 - start));
+    out << margin;
+    start = eol + 1;
+  }
+  out.write(text.data() + start, (std::streamsize)(text.size() - start));
+}
+
+} // namespace
+
 JSONWriter::JSONWriter(std::ostream &out, DetailLevel detail_level)
     : OutputWriter(out, detail_level) {}
 
-void JSONWriter::write(const AnalysisResults &results) {
-  json j;
+void JSONWriter::begin(const VideoMetadata &metadata) {
+  frame_count_ = 0;
+  gop_count_ = 0;
+  sampling_ = metadata.sampling;
+
+  // Keys are written in the sorted order of json::dump(), so the GOPs come
+  // before the metadata
+  out_ << "{\n  \"gops\": [";
+}
+
+void JSONWriter::onFrame(const FrameData & /* frame */) { frame_count_++; }
+
+void JSONWriter::onGOPComplete(const GOPData &gop) {
+  json gop_obj = {
+      {"gop_num", gop.gop_num},
+      {"start_frame", gop.start_frame},
+      {"end_frame", gop.end_frame},
+      {"total_bits", gop.total_bits},
+      {"avg_complexity", gop.avg_complexity},
+      {"i_frame_count", gop.i_frame_count},
+      {"p_frame_count", gop.p_frame_count},
+      {"b_frame_count", gop.b_frame_count},
+  };
+  if (sampling_) {
+    gop_obj["sampled"] = gop.sampled;
+  }
+
+  // Add frames if detail level is FRAME
+  if (detail_level_ == DetailLevel::FRAME && !gop.frames.empty()) {
+    gop_obj["frames"] = json::array();
+    for (const auto &frame : gop.frames) {
+      json frame_obj = {
+          {"frame_num", frame.frame_num},
+          {"type", frameTypeToString(frame.type)},
+          {"complexity",
+           {
+               {"spatial", frame.complexity.spatial_complexity},
+               {"motion", frame.complexity.motion_complexity},
+               {"residual", frame.complexity.residual_complexity},
+               {"error_mse", frame.complexity.error_mse},
+               {"unified", frame.complexity.unified_complexity},
+           }},
+          {"block_modes",
+           {
+               {"intra", frame.count_intra},
+               {"inter_p", frame.count_inter_p},
+               {"inter_b", frame.count_inter_b},
+           }},
+          {"error", frame.error},
+          {"estimated_bits", frame.estimated_bits},
+          {"mv_stats",
+           {
+               {"mean_magnitude", frame.mv_stats.mean_magnitude},
+               {"max_magnitude", frame.mv_stats.max_magnitude},
+               {"zero_mv_count", frame.mv_stats.zero_mv_count},
+               {"total_mv_count", frame.mv_stats.total_mv_count},
+           }},
+      };
+      gop_obj["frames"].push_back(frame_obj);
+    }
+  }
+
+  out_ << (gop_count_ ? ",\n    " : "\n    ");
+  writeIndented(out_, gop_obj, 4);
+  out_.flush();
+  gop_count_++;
+}
 
+void JSONWriter::end(const VideoMetadata &metadata) {
   // Write metadata
   auto time_t_val =
-      std::chrono::system_clock::to_time_t(results.metadata.analysis_time);
+      std::chrono::system_clock::to_time_t(metadata.analysis_time);
   char time_str[100];
   std::strftime(time_str, sizeof(time_str), "%Y-%m-%dT%H:%M:%SZ",
                 std::gmtime(&time_t_val));
 
-  j["metadata"] = {{"width", results.metadata.width},
-                   {"height", results.metadata.height},
-                   {"frames", results.metadata.total_frames},
-                   {"gop_size", results.metadata.gop_size},
-                   {"bframes", results.metadata.bframes},
-                   {"input_format", results.metadata.input_format},
-                   {"input_filename", results.metadata.input_filename},
-                   {"analysis_timestamp", time_str},
-                   {"version", results.metadata.version}};
-
-  // Write GOPs
-  j["gops"] = json::array();
-  for (const auto &gop : results.gops) {
-    json gop_obj = {
-        {"gop_num", gop.gop_num},
-        {"start_frame", gop.start_frame},
-        {"end_frame", gop.end_frame},
-        {"total_bits", gop.total_bits},
-        {"avg_complexity", gop.avg_complexity},
-        {"i_frame_count", gop.i_frame_count},
-        {"p_frame_count", gop.p_frame_count},
-        {"b_frame_count", gop.b_frame_count},
-    };
-
-    // Add frames if detail level is FRAME
-    if (detail_level_ == DetailLevel::FRAME && !gop.frames.empty()) {
-      gop_obj["frames"] = json::array();
-      for (const auto &frame : gop.frames) {
-        json frame_obj = {
-            {"frame_num", frame.frame_num},
-            {"type", frameTypeToString(frame.type)},
-            {"complexity",
-             {
-                 {"spatial", frame.complexity.spatial_complexity},
-                 {"motion", frame.complexity.motion_complexity},
-                 {"residual", frame.complexity.residual_complexity},
-                 {"error_mse", frame.complexity.error_mse},
-                 {"unified", frame.complexity.unified_complexity},
-             }},
-            {"block_modes",
-             {
-                 {"intra", frame.count_intra},
-                 {"inter_p", frame.count_inter_p},
-                 {"inter_b", frame.count_inter_b},
-             }},
-            {"error", frame.error},
-            {"estimated_bits", frame.estimated_bits},
-            {"mv_stats",
-             {
-                 {"mean_magnitude", frame.mv_stats.mean_magnitude},
-                 {"max_magnitude", frame.mv_stats.max_magnitude},
-                 {"zero_mv_count", frame.mv_stats.zero_mv_count},
-                 {"total_mv_count", frame.mv_stats.total_mv_count},
-             }},
-        };
-        gop_obj["frames"].push_back(frame_obj);
-      }
+  json metadata_obj = {{"width", metadata.width},
+                       {"height", metadata.height},
+                       {"frames", frame_count_},
+                       {"gop_size", metadata.gop_size},
+                       {"bframes", metadata.bframes},
+                       {"input_format", metadata.input_format},
+                       {"input_filename", metadata.input_filename},
+                       {"analysis_timestamp", time_str},
+                       {"version", metadata.version}};
+
+  // Stage timings, in stage order
+  if (!metadata.stage_timings.empty()) {
+    json stages = json::array();
+    for (const auto &stage : metadata.stage_timings) {
+      stages.push_back({{"stage", stage.stage},
+                        {"calls", stage.calls},
+                        {"total_ms", stage.total_ms}});
+    }
+    json frame_types = json::array();
+    for (const auto &type : metadata.frame_type_timings) {
+      frame_types.push_back({{"type", frameTypeToString(type.type)},
+                             {"frames", type.frames},
+                             {"total_ms", type.total_ms},
+                             {"avg_ms", type.avg_ms}});
     }
+    metadata_obj["timing"] = {{"stages", stages},
+                              {"frame_types", frame_types}};
+  }
 
-    j["gops"].push_back(gop_obj);
+  // Totals extrapolated from the sampled GOPs
+  if (metadata.sampling) {
+    const SamplingEstimate &estimate = metadata.sampling_estimate;
+    json bits = {{"estimate", estimate.total_bits}};
+    json error = {{"estimate", estimate.total_error}};
+    if (estimate.has_bounds) {
+      bits["low"] = estimate.bits_low;
+      bits["high"] = estimate.bits_high;
+      error["low"] = estimate.error_low;
+      error["high"] = estimate.error_high;
+    }
+    metadata_obj["sampling"] = {{"sampled_gops", estimate.sampled_gops},
+                                {"estimated_gops", estimate.estimated_gops},
+                                {"sampled_frames", estimate.sampled_frames},
+                                {"total_frames", estimate.total_frames},
+                                {"bits", bits},
+                                {"error", error}};
   }
 
-  // Write to output stream with pretty formatting
-  out_ << j.dump(2) << std::endl;
+  out_ << (gop_count_ ? "\n  ],\n  \"metadata\": " : "],\n  \"metadata\": ");
+  writeIndented(out_, metadata_obj, 2);
+  out_ << "\n}" << std::endl;
 }
 
 } // namespace motion_search
@@ -15,14 +15,24 @@ namespace motion_search {
  * @brief JSON output writer
  *
  * Writes analysis results in JSON format with rich metadata.
- * Supports both frame-level and GOP-level detail.
+ * Supports both frame-level and GOP-level detail. Each GOP is written
+ * when it completes; the metadata follows the GOPs, with the number of
+ * frames actually written.
  */
 class JSONWriter : public OutputWriter {
 public:
   JSONWriter(std::ostream &out, DetailLevel detail_level);
   ~JSONWriter() override = default;
 
-  void write(const AnalysisResults &results) override;
+  void begin(const VideoMetadata &metadata) override;
+  void onFrame(const FrameData &frame) override;
+  void onGOPComplete(const GOPData &gop) override;
+  void end(const VideoMetadata &metadata) override;
+
+private:
+  int frame_count_ = 0;
+  int gop_count_ = 0;
+  bool sampling_ = false;
 };
 
 } // namespace motion_search
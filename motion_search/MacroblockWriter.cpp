@@ -0,0 +1,106 @@
+/*
+ Copyright (c) Meta Platforms, Inc. and affiliates.
+
+ This source code is licensed under the BSD3 license found in the
+ LICENSE file in the root directory of this source tree.
+ */
+
+#include "MacroblockWriter.h"
+#include "common.h"
+
+#include <cstring>
+
+namespace motion_search {
+
+MacroblockWriter::~MacroblockWriter() { close(); }
+
+bool MacroblockWriter::open(const std::string &path, int width, int height,
+                            int gop_size, int bframes, int mb_size) {
+  out_.open(path, std::ios::binary | std::ios::trunc);
+  if (!out_) {
+    return false;
+  }
+
+  header_ = MacroblockFileHeader();
+  memcpy(header_.magic, "MSMBDUMP", sizeof(header_.magic));
+  header_.version = MacroblockLayout::VERSION;
+  header_.header_size = sizeof(MacroblockFileHeader);
+  header_.width = width;
+  header_.height = height;
+  header_.mb_size = mb_size;
+  header_.mbs_x = (width + mb_size - 1) / mb_size;
+  header_.mbs_y = (height + mb_size - 1) / mb_size;
+  header_.frame_size =
+      (uint32_t)MacroblockLayout(header_.mbs_x * header_.mbs_y).frameSize();
+  header_.gop_size = gop_size;
+  header_.bframes = bframes;
+
+  out_.write(reinterpret_cast<const char *>(&header_), sizeof(header_));
+  return (bool)out_;
+}
+
+// Copy a plane of mbs_y rows, stride entries apart, into consecutive rows
+template <typename data_t>
+static char *packPlane(char *dst, const data_t *src, int mbs_x, int mbs_y,
+                       int stride) {
+  const size_t row_size = (size_t)mbs_x * sizeof(data_t);
+  for (int i = 0; i < mbs_y; i++) {
+    if (src) {
+      memcpy(dst, &src[(size_t)i * stride], row_size);
+    }
+    dst += row_size;
+  }
+  return dst;
+}
+
+void MacroblockWriter::writeFrame(const mb_frame_info_t &info) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!out_.is_open() || info.mbs_x != header_.mbs_x ||
+      info.mbs_y != header_.mbs_y) {
+    return;
+  }
+
+  // Unused planes are left as zeros
+  record_.assign(header_.frame_size, '\0');
+  char *dst = &record_[0];
+
+  MacroblockFrameHeader frame = {};
+  frame.frame_num = info.picNum;
+  frame.type = info.picType;
+  frame.bits = info.bits;
+  frame.error = info.error;
+  memcpy(dst, &frame, sizeof(frame));
+  dst += sizeof(frame);
+
+  dst = packPlane(dst, info.mses, info.mbs_x, info.mbs_y, info.stride_MB);
+  for (int dir = 0; dir < 2; dir++) {
+    dst = packPlane(dst, info.sads[dir], info.mbs_x, info.mbs_y,
+                    info.stride_MB);
+  }
+  for (int dir = 0; dir < 2; dir++) {
+    dst =
+        packPlane(dst, info.mvs[dir], info.mbs_x, info.mbs_y, info.stride_MB);
+  }
+  packPlane(dst, info.modes, info.mbs_x, info.mbs_y, info.stride_MB);
+
+  out_.seekp((std::streamoff)header_.header_size +
+             (std::streamoff)info.picNum * header_.frame_size);
+  out_.write(record_.data(), (std::streamsize)record_.size());
+
+  if (info.picNum >= header_.frame_count) {
+    header_.frame_count = info.picNum + 1;
+  }
+}
+
+void MacroblockWriter::close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!out_.is_open()) {
+    return;
+  }
+
+  out_.seekp(0);
+  out_.write(reinterpret_cast<const char *>(&header_), sizeof(header_));
+  out_.close();
+}
+
+} // namespace motion_search
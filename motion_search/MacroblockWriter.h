@@ -0,0 +1,127 @@
+/*
+ Copyright (c) Meta Platforms, Inc. and affiliates.
+
+ This source code is licensed under the BSD3 license found in the
+ LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "ComplexityAnalyzer.h"
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+namespace motion_search {
+
+/**
+ * @brief Header at the start of a per-macroblock dump
+ *
+ * The structures are written as they are in memory, so every field is in the
+ * byte order of the host that wrote the file, as for memory-mapping it there;
+ * a reader on a host of the other byte order must swap them. The header is
+ * followed by one record of frame_size bytes per frame in display order, so
+ * frame n starts at header_size + n * frame_size.
+ */
+struct MacroblockFileHeader {
+  char magic[8];        // "MSMBDUMP"
+  uint32_t version;     // MacroblockLayout::VERSION
+  uint32_t header_size; // sizeof(MacroblockFileHeader)
+  int32_t width;
+  int32_t height;
+  int32_t mb_size;  // Macroblock width and height in pixels
+  int32_t mbs_x;    // Macroblocks per row
+  int32_t mbs_y;    // Macroblock rows
+  uint32_t frame_size;
+  int32_t frame_count; // Frame records in the file
+  int32_t gop_size;
+  int32_t bframes;
+  int32_t reserved[3];
+};
+
+static_assert(sizeof(MacroblockFileHeader) == 64,
+              "the header layout is part of the file format");
+
+/**
+ * @brief Header at the start of each frame record
+ *
+ * A record that was never written is all zeros, with type 0.
+ */
+struct MacroblockFrameHeader {
+  int32_t frame_num; // Display order, from 0
+  int32_t type; // 'I', 'P' or 'B'
+  int32_t bits;
+  int32_t error;
+};
+
+/**
+ * @brief Layout of a frame record
+ *
+ * The frame header is followed by one plane per field, each with
+ * mbs_x * mbs_y entries in raster order:
+ *   int32_t mse[], int32_t sad_fwd[], int32_t sad_bwd[],
+ *   MV mv_fwd[], MV mv_bwd[], uint8_t mode[]
+ * The mode plane is padded to a multiple of 4 bytes. Forward vectors and
+ * SADs are those of P-pictures and of the forward search of B-pictures;
+ * fields a frame type does not have are zero. Modes are those of
+ * mb_frame_info_t.
+ */
+struct MacroblockLayout {
+  static constexpr uint32_t VERSION = 1;
+
+  int num_mbs = 0;
+
+  explicit MacroblockLayout(int num_mbs) : num_mbs(num_mbs) {}
+
+  size_t mseOffset() const { return sizeof(MacroblockFrameHeader); }
+  size_t sadOffset(int dir) const {
+    return mseOffset() + (size_t)(1 + dir) * num_mbs * sizeof(int32_t);
+  }
+  size_t mvOffset(int dir) const {
+    return sadOffset(2) + (size_t)dir * num_mbs * sizeof(MV);
+  }
+  size_t modeOffset() const { return mvOffset(2); }
+  size_t frameSize() const {
+    return modeOffset() + (((size_t)num_mbs + 3) & ~(size_t)3);
+  }
+};
+
+/**
+ * @brief Writes the per-macroblock results of an analysis to a binary file
+ *
+ * Frames may arrive in any order and from several threads; each record is
+ * written at the offset of its frame number. The file must be seekable.
+ */
+class MacroblockWriter {
+public:
+  MacroblockWriter() = default;
+  ~MacroblockWriter();
+
+  /**
+   * @brief Create the file and write its header
+   * @param mb_size Width and height of the macroblocks of the search
+   * @return false if the file can't be created
+   */
+  bool open(const std::string &path, int width, int height, int gop_size,
+            int bframes, int mb_size = MB_WIDTH);
+
+  /**
+   * @brief Write the record of one frame
+   */
+  void writeFrame(const mb_frame_info_t &info);
+
+  /**
+   * @brief Write the frame count to the header and close the file
+   */
+  void close();
+
+private:
+  std::ofstream out_;
+  std::mutex mutex_;
+  MacroblockFileHeader header_ = {};
+  std::string record_;
+};
+
+} // namespace motion_search
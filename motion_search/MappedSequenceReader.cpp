@@ -0,0 +1,222 @@
+/*
+ Copyright (c) Meta Platforms, Inc. and affiliates.
+
+ This source code is licensed under the BSD3 license found in the
+ LICENSE file in the root directory of this source tree.
+ */
+
+#include "MappedSequenceReader.h"
+
+#ifdef HAVE_MMAP
+
+#include "EOFException.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char *const Signature = "YUV4MPEG2 ";
+const char *const Frame = "FRAME";
+
+// Parse the Y4M stream header. Returns the offset of the first frame header,
+// or 0 if the header is not valid.
+size_t parseY4MHeader(const uint8_t *data, size_t size, DIM &dim) {
+  const size_t len = strlen(Signature);
+  if (size < len || memcmp(data, Signature, len) != 0) {
+    return 0;
+  }
+  auto end = (const uint8_t *)memchr(data, '\n', size);
+  if (!end) {
+    return 0;
+  }
+
+  // parameters are separated by spaces and start with their tag letter
+  dim = {0, 0};
+  for (const uint8_t *p = data + len - 1; p < end; p++) {
+    if (*p != ' ') {
+      continue;
+    }
+    if (p[1] == 'W') {
+      dim.width = atoi((const char *)p + 2);
+    } else if (p[1] == 'H') {
+      dim.height = atoi((const char *)p + 2);
+    }
+  }
+  if (dim.width <= 0 || dim.height <= 0) {
+    return 0;
+  }
+
+  return (size_t)(end - data) + 1;
+}
+
+} // namespace
+
+struct MappedSequenceReader::Mapping {
+  ~Mapping(void) {
+    if (data) {
+      munmap(data, size);
+    }
+  }
+
+  uint8_t *data = nullptr;
+  size_t size = 0;
+
+  // offset of the luma plane of each frame
+  std::vector<size_t> frames;
+};
+
+bool MappedSequenceReader::map(FILE *file, std::shared_ptr<Mapping> &mapping) {
+  if (!file) {
+    return false;
+  }
+
+  struct stat buf;
+  if (fstat(fileno(file), &buf) != 0) {
+    return false;
+  }
+
+  mapping.reset(new Mapping());
+  mapping->size = (size_t)buf.st_size;
+  if (mapping->size == 0) {
+    return true;
+  }
+
+  void *data =
+      mmap(nullptr, mapping->size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+  if (data == MAP_FAILED) {
+    mapping.reset();
+    return false;
+  }
+  mapping->data = (uint8_t *)data;
+  madvise(data, mapping->size, MADV_SEQUENTIAL);
+
+  return true;
+}
+
+bool MappedSequenceReader::Open(unique_file_t file, const std::string &path,
+                                const DIM dim) {
+  std::shared_ptr<Mapping> mapping;
+  if (!map(file.get(), mapping)) {
+    return false;
+  }
+  YUVSequenceReader::Open(nullptr, path, dim);
+
+  const size_t picture = frameSize();
+  for (size_t pos = 0; picture && mapping->size - pos >= picture;
+       pos += picture) {
+    mapping->frames.push_back(pos);
+  }
+  m_mapping = mapping;
+
+  return true;
+}
+
+bool MappedSequenceReader::Open(unique_file_t file, const std::string &path) {
+  std::shared_ptr<Mapping> mapping;
+  if (!map(file.get(), mapping)) {
+    return false;
+  }
+
+  DIM dim;
+  size_t pos = parseY4MHeader(mapping->data, mapping->size, dim);
+  if (!pos) {
+    return false;
+  }
+  YUVSequenceReader::Open(nullptr, path, dim);
+
+  // every frame header is "FRAME", optional parameters and a newline
+  const size_t picture = frameSize();
+  const size_t tag = strlen(Frame);
+  while (mapping->size - pos >= tag &&
+         memcmp(mapping->data + pos, Frame, tag) == 0) {
+    auto end = (const uint8_t *)memchr(mapping->data + pos + tag, '\n',
+                                       mapping->size - pos - tag);
+    if (!end) {
+      break;
+    }
+    pos = (size_t)(end - mapping->data) + 1;
+    if (mapping->size - pos < picture) {
+      break;
+    }
+    mapping->frames.push_back(pos);
+    pos += picture;
+  }
+  m_mapping = mapping;
+
+  return true;
+}
+
+bool MappedSequenceReader::seek(int frame) {
+  if (frame < 0 || frame > nframes()) {
+    return false;
+  }
+  setCount(frame);
+
+  return true;
+}
+
+std::unique_ptr<YUVSequenceReader> MappedSequenceReader::reopen(void) {
+  std::unique_ptr<MappedSequenceReader> reader(new MappedSequenceReader());
+  reader->YUVSequenceReader::Open(nullptr, filename(), dim());
+  reader->m_mapping = m_mapping;
+
+  return reader;
+}
+
+bool MappedSequenceReader::eof(void) { return count() >= nframes(); }
+
+int MappedSequenceReader::nframes(void) {
+  return m_mapping ? (int)m_mapping->frames.size() : 0;
+}
+
+void MappedSequenceReader::willNeed(int frame) {
+  if (frame >= nframes()) {
+    return;
+  }
+
+  static const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  const size_t offset = m_mapping->frames[(size_t)frame];
+  const size_t start = offset & ~(page - 1);
+
+  madvise(m_mapping->data + start, offset + frameSize() - start,
+          MADV_WILLNEED);
+}
+
+void MappedSequenceReader::copyComponent(uint8_t *pData, const uint8_t *pSrc,
+                                         bool isLuma) {
+  const int div = isLuma ? 1 : 2;
+  const int height = dim().height / div;
+  const size_t width = (size_t)(dim().width / div);
+  const ptrdiff_t stride = this->stride() / div;
+
+  for (int i = 0; i < height; i++) {
+    memcpy(pData + i * stride, pSrc + i * width, width);
+  }
+}
+
+void MappedSequenceReader::readPicture(uint8_t *pY, uint8_t *pU,
+                                       uint8_t *pV) {
+  const int frame = count();
+  if (frame >= nframes()) {
+    throw EOFException();
+  }
+  willNeed(frame + 1);
+
+  const size_t luma = (size_t)dim().width * dim().height;
+  const size_t chroma = (size_t)(dim().width / 2) * (dim().height / 2);
+  const uint8_t *pSrc = m_mapping->data + m_mapping->frames[(size_t)frame];
+
+  copyComponent(pY, pSrc, true);
+  if (pU != NULL) {
+    copyComponent(pU, pSrc + luma, false);
+    copyComponent(pV, pSrc + luma + chroma, false);
+  }
+}
+
+#endif // HAVE_MMAP
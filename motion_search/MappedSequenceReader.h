@@ -0,0 +1,63 @@
+/*
+ Copyright (c) Meta Platforms, Inc. and affiliates.
+
+ This source code is licensed under the BSD3 license found in the
+ LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "YUVSequenceReader.h"
+
+#include <memory>
+#include <string>
+
+#ifdef HAVE_MMAP
+
+/// Reads .yuv and .y4m files through a read-only memory mapping.
+///
+/// The offset of every frame is indexed when the file is opened, so reading
+/// or seeking to a frame is a memory copy without any system call. The kernel
+/// is told the mapping is read sequentially, and the pages of the next frame
+/// are requested while the current one is copied. The file is closed once
+/// it is mapped; readers returned by reopen() share the mapping and the
+/// index. It is only built on POSIX systems (HAVE_MMAP).
+class MappedSequenceReader : public YUVSequenceReader {
+public:
+  MappedSequenceReader(void) = default;
+  ~MappedSequenceReader(void) = default;
+
+  // Open a raw .yuv file of the given dimensions
+  bool Open(unique_file_t file, const std::string &path, const DIM dim);
+
+  // Open a .y4m file, taking the dimensions from its stream header
+  bool Open(unique_file_t file, const std::string &path);
+
+  bool seek(int frame) override;
+
+  std::unique_ptr<YUVSequenceReader> reopen(void) override;
+
+  bool eof(void) override;
+  int nframes(void) override;
+
+  bool isOpen(void) override {
+    return m_mapping && dim().width && dim().height;
+  }
+
+protected:
+  void readPicture(uint8_t *pY, uint8_t *pU, uint8_t *pV) override;
+
+private:
+  struct Mapping;
+
+  std::shared_ptr<const Mapping> m_mapping;
+
+  bool map(FILE *file, std::shared_ptr<Mapping> &mapping);
+  void copyComponent(uint8_t *pData, const uint8_t *pSrc, bool isLuma);
+  void willNeed(int frame);
+
+  MappedSequenceReader(MappedSequenceReader &) = delete;
+  MappedSequenceReader &operator=(MappedSequenceReader &) = delete;
+};
+
+#endif // HAVE_MMAP
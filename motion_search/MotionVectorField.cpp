@@ -7,17 +7,52 @@
 
 #include "MotionVectorField.h"
 
+#include "Wavefront.h"
 #include "motion_search.h"
+#include <climits>
 #include <cstdlib>
 #include <cstring>
+#include <vector>
+
+namespace {
+
+// Results of one macroblock row of a wavefront search
+struct row_stats_t {
+  int mse;
+  int count_I;
+  int count_P;
+  int count_B;
+  int count_skip;
+  int bits;
+};
+
+int reduce_rows(const std::vector<row_stats_t> &stats, int *count_I,
+                int *count_P, int *count_B, int *count_skip, int *bits) {
+  int mse = 0;
+
+  *count_I = *count_P = *count_B = *count_skip = 0;
+  *bits = 0;
+  for (const row_stats_t &row : stats) {
+    mse += row.mse;
+    *count_I += row.count_I;
+    *count_P += row.count_P;
+    *count_B += row.count_B;
+    *count_skip += row.count_skip;
+    *bits += row.bits;
+  }
+
+  return mse;
+}
+
+} // namespace
 
 MotionVectorField::MotionVectorField(const DIM dim, int stride,
                                      int padded_height, int blocksize)
-    : m_firstMB(dim.width / MB_WIDTH + 2 + 1), m_blocksize(blocksize),
+    : m_firstMB(dim.width / blocksize + 2 + 1), m_blocksize(blocksize),
       m_count_I(0), m_count_P(0), m_count_B(0) {
   int i, j;
-  int stride_MB = dim.width / MB_WIDTH + 2;
-  int padded_height_MB = (dim.height + MB_WIDTH - 1) / MB_WIDTH + 2;
+  int stride_MB = dim.width / blocksize + 2;
+  int padded_height_MB = (dim.height + blocksize - 1) / blocksize + 2;
   m_num_blocks = (size_t)stride_MB * padded_height_MB;
 
   m_pMVs = memory::AlignedAlloc<MV>(m_num_blocks);
@@ -46,6 +81,23 @@ MotionVectorField::MotionVectorField(const DIM dim, int stride,
   }
 }
 
+void MotionVectorField::setPyramid(bool enable) {
+  if (!enable) {
+    m_pSeeds.reset();
+    return;
+  }
+
+  if (m_pSeeds == NULL) {
+    m_pSeeds = memory::AlignedAlloc<MV>(m_num_blocks);
+    if (m_pSeeds == NULL) {
+      fprintf(stderr, "Not enough memory (%zu bytes) for pyramid vectors\n",
+              m_num_blocks * sizeof(MV));
+      exit(-1);
+    }
+    memset(m_pSeeds.get(), 0, m_num_blocks * sizeof(MV));
+  }
+}
+
 int MotionVectorField::predictSpatial(YUVFrame *pFrm, int *mses,
                                       unsigned char *MB_modes) {
   return spatial_search(pFrm->y(), pFrm->y(), pFrm->stride(), pFrm->dim(),
@@ -56,10 +108,42 @@ int MotionVectorField::predictSpatial(YUVFrame *pFrm, int *mses,
 
 int MotionVectorField::predictTemporal(YUVFrame *pCurFrm, YUVFrame *pRefFrm,
                                        int *mses, unsigned char *MB_modes) {
-  return motion_search(pCurFrm->y(), pRefFrm->y(), pCurFrm->stride(),
-                       pCurFrm->dim(), m_blocksize, m_blocksize,
-                       &m_pMVs.get()[m_firstMB], &m_pSADs.get()[m_firstMB],
-                       mses, MB_modes, &m_count_I, &m_count_P, &m_bits);
+  if (m_pSeeds) {
+    pyramid_search(pCurFrm->pyramid(), pRefFrm->pyramid(), pCurFrm->dim(),
+                   m_blocksize, seeds());
+  }
+
+  if (m_pPool == NULL) {
+    // Skipped macroblocks don't need their intra cost, so the costs that
+    // are not cached yet are only computed for the others
+    const int *intra = pCurFrm->hasIntraCosts() || m_skip_threshold == 0
+                           ? pCurFrm->intraCosts()
+                           : NULL;
+    m_count_I = m_count_P = m_count_skip = 0;
+    m_bits = 0;
+    return motion_search_rows(
+        pCurFrm->y(), pRefFrm->y(), pCurFrm->stride(), pCurFrm->dim(),
+        m_blocksize, m_blocksize, 0, INT_MAX, MVs(), SADs(), mses, MB_modes,
+        intra, seeds(), m_method, m_prune, m_skip_threshold, &m_count_I,
+        &m_count_P, &m_count_skip, &m_bits, NULL, NULL);
+  }
+
+  // Intra costs that are not cached yet are computed row by row, in parallel
+  const int *intra = pCurFrm->hasIntraCosts() ? pCurFrm->intraCosts() : NULL;
+  Wavefront wavefront(m_pPool, pCurFrm->dim(), m_blocksize, m_blocksize);
+  std::vector<row_stats_t> stats((size_t)wavefront.rows(), row_stats_t());
+
+  wavefront.run([&](int row) {
+    row_stats_t &rs = stats[(size_t)row];
+    rs.mse = motion_search_rows(
+        pCurFrm->y(), pRefFrm->y(), pCurFrm->stride(), pCurFrm->dim(),
+        m_blocksize, m_blocksize, row, row + 1, MVs(), SADs(), mses, MB_modes,
+        intra, seeds(), m_method, m_prune, m_skip_threshold, &rs.count_I,
+        &rs.count_P, &rs.count_skip, &rs.bits, Wavefront::sync, &wavefront);
+  });
+
+  return reduce_rows(stats, &m_count_I, &m_count_P, &m_count_B,
+                     &m_count_skip, &m_bits);
 }
 
 int MotionVectorField::predictBidirectional(
@@ -72,13 +156,50 @@ int MotionVectorField::predictBidirectional(
 
   td1 = (short)((pos * 32768 + total / 2) / total);
   td2 = (short)(32768 - td1);
-  return bidir_motion_search(
-      pCurFrm->y(), pRefFrm1->y(), pRefFrm2->y(), pCurFrm->stride(),
-      pCurFrm->dim(), m_blocksize, m_blocksize, this->MVs(), fwdref->MVs(),
-      bckref->MVs(), fwdref->SADs(), bckref->SADs(), mses, MB_modes, td1, td2,
-      &m_count_I, &m_count_P, &m_count_B, &m_bits);
+  if (fwdref->m_pSeeds) {
+    pyramid_search(pCurFrm->pyramid(), pRefFrm1->pyramid(), pCurFrm->dim(),
+                   m_blocksize, fwdref->seeds());
+  }
+  if (bckref->m_pSeeds) {
+    pyramid_search(pCurFrm->pyramid(), pRefFrm2->pyramid(), pCurFrm->dim(),
+                   m_blocksize, bckref->seeds());
+  }
+
+  if (m_pPool == NULL) {
+    m_count_I = m_count_P = m_count_B = m_count_skip = 0;
+    m_bits = 0;
+    return bidir_motion_search_rows(
+        pCurFrm->y(), pRefFrm1->y(), pRefFrm2->y(), pCurFrm->stride(),
+        pCurFrm->dim(), m_blocksize, m_blocksize, 0, INT_MAX, this->MVs(),
+        fwdref->MVs(), bckref->MVs(), fwdref->SADs(), bckref->SADs(), mses,
+        MB_modes, pCurFrm->intraCosts(), fwdref->seeds(), bckref->seeds(),
+        m_method, m_prune, td1, td2, &m_count_I, &m_count_P, &m_count_B,
+        &m_bits, NULL, NULL);
+  }
+
+  const int *intra = pCurFrm->hasIntraCosts() ? pCurFrm->intraCosts() : NULL;
+  Wavefront wavefront(m_pPool, pCurFrm->dim(), m_blocksize, m_blocksize);
+  std::vector<row_stats_t> stats((size_t)wavefront.rows(), row_stats_t());
+
+  wavefront.run([&](int row) {
+    row_stats_t &rs = stats[(size_t)row];
+    rs.mse = bidir_motion_search_rows(
+        pCurFrm->y(), pRefFrm1->y(), pRefFrm2->y(), pCurFrm->stride(),
+        pCurFrm->dim(), m_blocksize, m_blocksize, row, row + 1, this->MVs(),
+        fwdref->MVs(), bckref->MVs(), fwdref->SADs(), bckref->SADs(), mses,
+        MB_modes, intra, fwdref->seeds(), bckref->seeds(), m_method, m_prune,
+        td1, td2, &rs.count_I, &rs.count_P, &rs.count_B, &rs.bits,
+        Wavefront::sync, &wavefront);
+  });
+
+  return reduce_rows(stats, &m_count_I, &m_count_P, &m_count_B,
+                     &m_count_skip, &m_bits);
 }
 
 void MotionVectorField::reset(void) {
   memset(m_pMVs.get(), 0, m_num_blocks * sizeof(MV));
 }
+
+void MotionVectorField::copyVectors(MotionVectorField *other) {
+  memory::Copy(m_pMVs.get(), other->m_pMVs.get(), m_num_blocks);
+}
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include "ThreadPool.h"
 #include "YUVFrame.h"
 
 #include "memory.h"
@@ -29,6 +30,28 @@ public:
 
   void reset(void);
 
+  void copyVectors(MotionVectorField *other);
+
+  // Search the macroblock rows of temporal and bidirectional predictions in
+  // wavefront order on the given pool; NULL searches them serially
+  void setThreadPool(ThreadPool *pool) { m_pPool = pool; }
+
+  // Seed the temporal and bidirectional searches with the pyramid_search()
+  // vectors of every macroblock, held by the field of each reference
+  void setPyramid(bool enable);
+
+  // Code the macroblocks of temporal predictions whose SAD along the zero or
+  // the predicted vector is below threshold per pixel as P right away (see
+  // motion_search_rows()); 0 searches every macroblock
+  void setSkipThreshold(int threshold) { m_skip_threshold = threshold; }
+
+  // Leave out the 8x8 searches of the macroblocks that are unlikely to be
+  // split (see prune_8x8() in motion_search.cpp)
+  void setPartitionPruning(bool enable) { m_prune = enable; }
+
+  // Strategy of the temporal and bidirectional searches
+  void setSearchMethod(me_method_t method) { m_method = method; }
+
   inline int blocksize(void) { return m_blocksize; }
 
   inline int count_I(void) { return m_count_I; }
@@ -37,6 +60,9 @@ public:
 
   inline int count_B(void) { return m_count_B; }
 
+  // P macroblocks of the last temporal prediction that skipped the search
+  inline int count_skip(void) { return m_count_skip; }
+
   inline int bits(void) { return m_bits; }
 
   inline int firstMB(void) { return m_firstMB; }
@@ -45,9 +71,15 @@ public:
 
   inline int *SADs(void) { return &m_pSADs.get()[m_firstMB]; }
 
+  // Pyramid vectors of the last search, or NULL without pyramid seeding
+  inline MV *seeds(void) {
+    return m_pSeeds ? &m_pSeeds.get()[m_firstMB] : NULL;
+  }
+
 private:
   memory::aligned_unique_ptr<MV> m_pMVs;
   memory::aligned_unique_ptr<int> m_pSADs;
+  memory::aligned_unique_ptr<MV> m_pSeeds;
   size_t m_num_blocks = 0;
   int m_firstMB = 0;
 
@@ -56,7 +88,13 @@ private:
   int m_count_I = 0;
   int m_count_P = 0;
   int m_count_B = 0;
+  int m_count_skip = 0;
   int m_bits = 0;
+  int m_skip_threshold = 0;
+  bool m_prune = false;
+  me_method_t m_method = ME_PMVFAST;
+
+  ThreadPool *m_pPool = NULL;
 
   MotionVectorField(MotionVectorField &) = delete;
   MotionVectorField &operator=(MotionVectorField &) = delete;
@@ -95,8 +95,7 @@ struct FrameData {
   // Motion vector statistics
   MVStats mv_stats;
 
-  // Per-macroblock data (optional, for JSON/XML only)
-  // std::vector<MacroblockData> macroblocks;  // Future enhancement
+  // Per-macroblock data is written separately, see MacroblockWriter
 };
 
 /**
@@ -111,11 +110,57 @@ struct GOPData {
   int i_frame_count = 0;
   int p_frame_count = 0;
   int b_frame_count = 0;
+  int64_t total_error = 0;
+
+  // False for a GOP skipped by sampling, which has no frames and is only
+  // accounted for in the extrapolated totals
+  bool sampled = true;
 
   // Frames in this GOP (only populated if detail_level == "frame")
   std::vector<FrameData> frames;
 };
 
+/**
+ * @brief Time spent in one stage of the analysis
+ */
+struct StageTiming {
+  std::string stage;
+  int64_t calls = 0;
+  double total_ms = 0.0;
+};
+
+/**
+ * @brief Search time of the frames of one type
+ */
+struct FrameTypeTiming {
+  FrameType type = FrameType::UNKNOWN;
+  int frames = 0;
+  double total_ms = 0.0;
+  double avg_ms = 0.0;
+};
+
+/**
+ * @brief Bits and error of the whole input, extrapolated from the sampled
+ *        GOPs, with 95% confidence bounds
+ *
+ * The totals are ratio estimates over the frames of the input; the bounds
+ * need at least two sampled GOPs, and are equal to the totals when every
+ * GOP was sampled.
+ */
+struct SamplingEstimate {
+  int sampled_gops = 0;
+  int estimated_gops = 0;
+  int sampled_frames = 0;
+  int total_frames = 0;
+  bool has_bounds = false;
+  double total_bits = 0.0;
+  double bits_low = 0.0;
+  double bits_high = 0.0;
+  double total_error = 0.0;
+  double error_low = 0.0;
+  double error_high = 0.0;
+};
+
 /**
  * @brief Metadata about the video and analysis parameters
  */
@@ -129,6 +174,16 @@ struct VideoMetadata {
   std::string input_filename;
   std::chrono::system_clock::time_point analysis_time;
   std::string version = "2.0.0"; // Version of output format
+
+  // Stage timings, summed over the threads that ran each stage (empty when
+  // not measured)
+  std::vector<StageTiming> stage_timings;
+  std::vector<FrameTypeTiming> frame_type_timings;
+
+  // Set when only a sample of the GOPs is analyzed; the GOPs are then marked
+  // as sampled or estimated, and the estimate is filled at the end
+  bool sampling = false;
+  SamplingEstimate sampling_estimate;
 };
 
 /**
@@ -15,6 +15,17 @@
 
 namespace motion_search {
 
+void OutputWriter::write(const AnalysisResults &results) {
+  begin(results.metadata);
+  for (const auto &gop : results.gops) {
+    for (const auto &frame : gop.frames) {
+      onFrame(frame);
+    }
+    onGOPComplete(gop);
+  }
+  end(results.metadata);
+}
+
 std::unique_ptr<OutputWriter> createOutputWriter(const std::string &format,
                                                  DetailLevel detail_level,
                                                  std::ostream &out) {
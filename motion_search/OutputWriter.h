@@ -39,16 +39,46 @@ inline DetailLevel stringToDetailLevel(const std::string &level) {
 
 /**
  * @brief Abstract interface for output writers
+ *
+ * Results are streamed: begin() once, then every frame in display order
+ * through onFrame(), with onGOPComplete() after the last frame of each GOP,
+ * and end() once. Writers keep at most one GOP, so their memory does not
+ * grow with the length of the input.
  */
 class OutputWriter {
 public:
   virtual ~OutputWriter() = default;
 
   /**
-   * @brief Write the analysis results
+   * @brief Start the output
+   * @param metadata Metadata of the analysis; total_frames is the expected
+   *                 number of frames
+   */
+  virtual void begin(const VideoMetadata &metadata) = 0;
+
+  /**
+   * @brief Write or buffer the next frame in display order
+   */
+  virtual void onFrame(const FrameData &frame) = 0;
+
+  /**
+   * @brief Write the GOP that ended with the last frame
+   * @param gop The GOP statistics, with its frames
+   */
+  virtual void onGOPComplete(const GOPData &gop) = 0;
+
+  /**
+   * @brief Finish the output
+   * @param metadata Metadata of the analysis, with the stage timings when
+   *                 they were measured
+   */
+  virtual void end(const VideoMetadata &metadata) = 0;
+
+  /**
+   * @brief Write complete analysis results through the streaming interface
    * @param results The complete analysis results
    */
-  virtual void write(const AnalysisResults &results) = 0;
+  void write(const AnalysisResults &results);
 
 protected:
   OutputWriter(std::ostream &out, DetailLevel detail_level)
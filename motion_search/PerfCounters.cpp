@@ -0,0 +1,174 @@
+/*
+ Copyright (c) Meta Platforms, Inc. and affiliates.
+
+ This source code is licensed under the BSD3 license found in the
+ LICENSE file in the root directory of this source tree.
+ */
+
+#include "PerfCounters.h"
+
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const char *perf_event_name(int event) {
+  static const char *const names[NUM_PERF_EVENTS] = {
+      "cycles",
+      "instructions",
+      "llc_misses",
+      "dtlb_misses",
+  };
+  return names[event];
+}
+
+void frame_counts_t::add(const frame_counts_t &other) {
+  for (int e = 0; e < NUM_PERF_EVENTS; e++) {
+    available[e] = available[e] || other.available[e];
+  }
+  for (int t = 0; t < NUM_FRAME_TYPES; t++) {
+    for (int e = 0; e < NUM_PERF_EVENTS; e++) {
+      events[t][e] += other.events[t][e];
+    }
+    frames[t] += other.frames[t];
+    macroblocks[t] += other.macroblocks[t];
+  }
+}
+
+#if defined(__linux__)
+
+// Counters of a group are read at once: their number, the time the group was
+// enabled and the time it ran, then their values in the order they joined it
+static const uint64_t READ_FORMAT = PERF_FORMAT_GROUP |
+                                    PERF_FORMAT_TOTAL_TIME_ENABLED |
+                                    PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+static int open_counter(uint32_t type, uint64_t config, int group_fd) {
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.read_format = READ_FORMAT;
+  // Allowed with perf_event_paranoid up to 2
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+  return (int)syscall(SYS_perf_event_open, &attr, 0 /* this thread */,
+                      -1 /* any CPU */, group_fd, 0);
+}
+
+PerfCounters::PerfCounters(void) {
+  for (int &fd : m_fds) {
+    fd = -1;
+  }
+
+  // The cycles lead the group, in the order of the events
+  const int leader =
+      open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+  if (leader < 0) {
+    return;
+  }
+  m_fds[PERF_CYCLES] = leader;
+  m_fds[PERF_INSTRUCTIONS] =
+      open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, leader);
+  m_fds[PERF_LLC_MISSES] =
+      open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, leader);
+  m_fds[PERF_DTLB_MISSES] = open_counter(
+      PERF_TYPE_HW_CACHE,
+      PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+      leader);
+}
+
+PerfCounters::~PerfCounters(void) {
+  // The leader last
+  for (int e = NUM_PERF_EVENTS - 1; e >= 0; e--) {
+    if (m_fds[e] >= 0) {
+      close(m_fds[e]);
+    }
+  }
+}
+
+void PerfCounters::read(perf_sample_t *sample) const {
+  uint64_t data[3 + NUM_PERF_EVENTS];
+
+  memset(sample, 0, sizeof(*sample));
+  if (m_fds[PERF_CYCLES] < 0) {
+    return;
+  }
+
+  const ssize_t size = ::read(m_fds[PERF_CYCLES], data, sizeof(data));
+  if (size < (ssize_t)(3 * sizeof(uint64_t)) ||
+      size < (ssize_t)((3 + data[0]) * sizeof(uint64_t))) {
+    return;
+  }
+  sample->enabled = data[1];
+  sample->running = data[2];
+  uint64_t k = 0;
+  for (int e = 0; e < NUM_PERF_EVENTS && k < data[0]; e++) {
+    if (m_fds[e] >= 0) {
+      sample->values[e] = data[3 + k++];
+    }
+  }
+}
+
+#else
+
+PerfCounters::PerfCounters(void) {
+  for (int &fd : m_fds) {
+    fd = -1;
+  }
+}
+
+PerfCounters::~PerfCounters(void) {}
+
+void PerfCounters::read(perf_sample_t *sample) const {
+  memset(sample, 0, sizeof(*sample));
+}
+
+#endif
+
+bool PerfCounters::available(void) const {
+  return available(PERF_CYCLES) && available(PERF_INSTRUCTIONS);
+}
+
+CounterScope::CounterScope(const PerfCounters *counters,
+                           frame_counts_t &counts, char type, int frames,
+                           int64_t macroblocks)
+    : m_pCounters(counters), m_counts(counts),
+      m_type(frame_type_index(type)), m_frames(frames),
+      m_macroblocks(macroblocks) {
+  if (m_pCounters) {
+    m_pCounters->read(&m_begin);
+  }
+}
+
+CounterScope::~CounterScope(void) {
+  if (!m_pCounters) {
+    return;
+  }
+
+  perf_sample_t end;
+  m_pCounters->read(&end);
+  m_counts.frames[m_type] += m_frames;
+
+  // Nothing was counted when the PMU never scheduled the group
+  const uint64_t enabled = end.enabled - m_begin.enabled;
+  const uint64_t running = end.running - m_begin.running;
+  if (running == 0) {
+    return;
+  }
+
+  // Scale the counts of a multiplexed group to the whole scope
+  const double scale = (double)enabled / (double)running;
+  for (int e = 0; e < NUM_PERF_EVENTS; e++) {
+    const uint64_t count = end.values[e] - m_begin.values[e];
+    m_counts.events[m_type][e] += (uint64_t)((double)count * scale + 0.5);
+  }
+  m_counts.macroblocks[m_type] += m_macroblocks;
+}
@@ -0,0 +1,99 @@
+/*
+ Copyright (c) Meta Platforms, Inc. and affiliates.
+
+ This source code is licensed under the BSD3 license found in the
+ LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "StageTimer.h"
+
+#include <cstdint>
+
+// Hardware events counted around the search of each frame
+typedef enum {
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_LLC_MISSES,
+  PERF_DTLB_MISSES,
+  NUM_PERF_EVENTS
+} perf_event_t;
+
+// Name of an event in the output
+const char *perf_event_name(int event);
+
+// Raw values of the counters, with the time they were enabled and the time
+// they ran on the PMU, which is shorter when the kernel multiplexes them
+struct perf_sample_t {
+  uint64_t values[NUM_PERF_EVENTS];
+  uint64_t enabled;
+  uint64_t running;
+};
+
+// Event counts of the frames of each type, with the frames and macroblocks
+// they cover. Events the CPU or the kernel can't count are not available, and
+// the macroblocks are those of the frames whose events were counted.
+struct frame_counts_t {
+  bool available[NUM_PERF_EVENTS] = {};
+  uint64_t events[NUM_FRAME_TYPES][NUM_PERF_EVENTS] = {};
+  int frames[NUM_FRAME_TYPES] = {};
+  int64_t macroblocks[NUM_FRAME_TYPES] = {};
+
+  void add(const frame_counts_t &other);
+};
+
+/// Hardware event counters of the calling thread, through perf_event_open().
+///
+/// The counters are opened for the thread that constructs the object, and
+/// only count user-space events of that thread. They form one group led by
+/// the cycles, so the PMU always counts them over the same time windows. When
+/// the kernel refuses them (no Linux, perf_event_paranoid, containers,
+/// virtual machines), available() is false and the counters do nothing.
+class PerfCounters {
+public:
+  PerfCounters(void);
+
+  ~PerfCounters(void);
+
+  /// True when cycles and instructions can be counted
+  bool available(void) const;
+
+  /// Whether one event can be counted
+  bool available(int event) const { return m_fds[event] >= 0; }
+
+  /// Current value of every counter, read at once for the whole group;
+  /// unavailable ones read 0
+  void read(perf_sample_t *sample) const;
+
+private:
+  int m_fds[NUM_PERF_EVENTS];
+
+  PerfCounters(PerfCounters &) = delete;
+
+  PerfCounters &operator=(PerfCounters &) = delete;
+};
+
+/// Books the events counted from its construction to its destruction to
+/// the frames of one type, scaled to the time the counters were enabled when
+/// the kernel multiplexed them. When they didn't run at all, only the frames
+/// are booked. With no counters it does nothing.
+class CounterScope {
+public:
+  CounterScope(const PerfCounters *counters, frame_counts_t &counts,
+               char type, int frames, int64_t macroblocks);
+
+  ~CounterScope(void);
+
+private:
+  const PerfCounters *m_pCounters;
+  frame_counts_t &m_counts;
+  const int m_type;
+  const int m_frames;
+  const int64_t m_macroblocks;
+  perf_sample_t m_begin;
+
+  CounterScope(CounterScope &) = delete;
+
+  CounterScope &operator=(CounterScope &) = delete;
+};
@@ -0,0 +1,70 @@
+/*
+ Copyright (c) Meta Platforms, Inc. and affiliates.
+
+ This source code is licensed under the BSD3 license found in the
+ LICENSE file in the root directory of this source tree.
+ */
+
+#include "ScaledSequenceReader.h"
+
+#include "moments.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+ScaledSequenceReader::ScaledSequenceReader(IVideoSequenceReader *source,
+                                           int scale)
+    : m_pSource(source), m_scale(scale), m_dim(source->dim() / scale),
+      m_stride(m_dim.width + 2 * HORIZONTAL_PADDING) {
+  const DIM dim = source->dim();
+  const size_t frame_size = (size_t)source->stride() * dim.height * 3 / 2;
+  const size_t half_size = (size_t)(dim.width / 2) * (dim.height / 2);
+
+  m_pFrame = memory::AlignedAlloc<uint8_t>(frame_size);
+  if (m_scale == 4) {
+    m_pHalf = memory::AlignedAlloc<uint8_t>(half_size);
+  }
+  if (m_pFrame == NULL || (m_scale == 4 && m_pHalf == NULL)) {
+    fprintf(stderr, "Not enough memory (%zu bytes) for ScaledSequenceReader\n",
+            frame_size + half_size);
+    exit(-1);
+  }
+}
+
+// Decimate a plane by the scale, through the half resolution plane for 4
+void ScaledSequenceReader::decimate(uint8_t *pDst, ptrdiff_t dst_stride,
+                                    const uint8_t *pSrc, ptrdiff_t src_stride,
+                                    DIM src_dim) {
+  if (m_scale == 4) {
+    const DIM half = src_dim / 2;
+    decimate2x2(m_pHalf.get(), half.width, pSrc, src_stride, half.width,
+                half.height);
+    pSrc = m_pHalf.get();
+    src_stride = half.width;
+    src_dim = half;
+  }
+
+  const DIM out = src_dim / 2;
+  decimate2x2(pDst, dst_stride, pSrc, src_stride, out.width, out.height);
+}
+
+void ScaledSequenceReader::read(uint8_t *pY, uint8_t *pU, uint8_t *pV) {
+  const DIM dim = m_pSource->dim();
+  const ptrdiff_t stride = m_pSource->stride();
+  uint8_t *pSrcY = m_pFrame.get();
+  uint8_t *pSrcU = pSrcY + stride * dim.height;
+  uint8_t *pSrcV = pSrcU + (stride / 2) * (dim.height / 2);
+
+  // The source skips the chroma when the caller does
+  if (pU == NULL) {
+    m_pSource->read(pSrcY, NULL, NULL);
+  } else {
+    m_pSource->read(pSrcY, pSrcU, pSrcV);
+  }
+
+  decimate(pY, m_stride, pSrcY, stride, dim);
+  if (pU != NULL) {
+    decimate(pU, m_stride / 2, pSrcU, stride / 2, dim / 2);
+    decimate(pV, m_stride / 2, pSrcV, stride / 2, dim / 2);
+  }
+}
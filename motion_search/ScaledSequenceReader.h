@@ -0,0 +1,56 @@
+/*
+ Copyright (c) Meta Platforms, Inc. and affiliates.
+
+ This source code is licensed under the BSD3 license found in the
+ LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "IVideoSequenceReader.h"
+#include "common.h"
+#include "memory.h"
+
+/// Decimates the frames of another reader by 2 or 4 in both directions.
+///
+/// Every plane is read at full resolution into a buffer of this reader and
+/// reduced with the 2x2 box filter of decimate2x2(), twice for a scale of 4,
+/// so the analysis searches a quarter or a sixteenth of the pixels. Odd
+/// dimensions are rounded down, like DIM / scale. The source reader is not
+/// owned and must outlive this one.
+class ScaledSequenceReader : public IVideoSequenceReader {
+public:
+  ScaledSequenceReader(IVideoSequenceReader *source, int scale);
+  ~ScaledSequenceReader(void) = default;
+
+  void read(uint8_t *pY, uint8_t *pU, uint8_t *pV) override;
+
+  bool eof(void) override { return m_pSource->eof(); }
+  int nframes(void) override { return m_pSource->nframes(); }
+  int count(void) override { return m_pSource->count(); }
+  const DIM dim(void) override { return m_dim; }
+  ptrdiff_t stride(void) override { return m_stride; }
+
+  bool isOpen(void) override {
+    return m_pSource->isOpen() && m_dim.width && m_dim.height;
+  }
+
+  // Scales the reader can decimate by
+  static bool isValidScale(int scale) { return scale == 2 || scale == 4; }
+
+private:
+  IVideoSequenceReader *m_pSource;
+  const int m_scale;
+  const DIM m_dim;
+  const ptrdiff_t m_stride;
+
+  // Full resolution frame, and the half resolution plane of a scale of 4
+  memory::aligned_unique_ptr<uint8_t> m_pFrame;
+  memory::aligned_unique_ptr<uint8_t> m_pHalf;
+
+  void decimate(uint8_t *pDst, ptrdiff_t dst_stride, const uint8_t *pSrc,
+                ptrdiff_t src_stride, DIM src_dim);
+
+  ScaledSequenceReader(ScaledSequenceReader &) = delete;
+  ScaledSequenceReader &operator=(ScaledSequenceReader &) = delete;
+};
@@ -0,0 +1,106 @@
+/*
+ Copyright (c) Meta Platforms, Inc. and affiliates.
+
+ This source code is licensed under the BSD3 license found in the
+ LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Stages of the analysis with their own timer
+typedef enum {
+  STAGE_READ,
+  STAGE_BOUNDARY_EXTEND,
+  STAGE_INTRA_COSTS, // Only timed when the reader thread computes them
+  STAGE_PREDICT_SPATIAL,
+  STAGE_PREDICT_TEMPORAL,
+  STAGE_PREDICT_BIDIRECTIONAL,
+  STAGE_CONVERT,
+  STAGE_WRITE,
+  NUM_STAGES
+} stage_t;
+
+// Name of a stage in the output
+inline const char *stage_name(int stage) {
+  static const char *const names[NUM_STAGES] = {
+      "read",
+      "boundary_extend",
+      "intra_costs",
+      "predict_spatial",
+      "predict_temporal",
+      "predict_bidirectional",
+      "convert",
+      "write",
+  };
+  return names[stage];
+}
+
+// Frame types with a search time of their own
+#define NUM_FRAME_TYPES 3
+
+inline int frame_type_index(char type) {
+  return type == 'I' ? 0 : type == 'P' ? 1 : 2;
+}
+
+// Time spent in each stage, summed over the threads that ran it, and the
+// search time of the I-, P- and B-pictures
+struct stage_times_t {
+  int64_t ns[NUM_STAGES] = {};
+  int64_t calls[NUM_STAGES] = {};
+  int64_t type_ns[NUM_FRAME_TYPES] = {};
+  int type_frames[NUM_FRAME_TYPES] = {};
+
+  // Book one call of a stage; a frame type also books it as the search of a
+  // frame of that type
+  void record(stage_t stage, int64_t elapsed_ns, char type = 0) {
+    ns[stage] += elapsed_ns;
+    calls[stage]++;
+    if (type) {
+      type_ns[frame_type_index(type)] += elapsed_ns;
+      type_frames[frame_type_index(type)]++;
+    }
+  }
+
+  void add(const stage_times_t &other) {
+    for (int i = 0; i < NUM_STAGES; i++) {
+      ns[i] += other.ns[i];
+      calls[i] += other.calls[i];
+    }
+    for (int i = 0; i < NUM_FRAME_TYPES; i++) {
+      type_ns[i] += other.type_ns[i];
+      type_frames[i] += other.type_frames[i];
+    }
+  }
+};
+
+// Books the time from its construction to its destruction as one call of a
+// stage. The clock is read twice per call, so stages are timed per frame,
+// not per macroblock.
+class StageTimer {
+public:
+  StageTimer(stage_times_t &times, stage_t stage, char type = 0)
+      : m_times(times), m_stage(stage), m_type(type),
+        m_begin(std::chrono::steady_clock::now()) {}
+
+  ~StageTimer(void) {
+    const auto end = std::chrono::steady_clock::now();
+    m_times.record(
+        m_stage,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - m_begin)
+            .count(),
+        m_type);
+  }
+
+private:
+  stage_times_t &m_times;
+  const stage_t m_stage;
+  const char m_type;
+  const std::chrono::steady_clock::time_point m_begin;
+
+  StageTimer(StageTimer &) = delete;
+
+  StageTimer &operator=(StageTimer &) = delete;
+};
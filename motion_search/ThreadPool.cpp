@@ -0,0 +1,75 @@
+/*
+ Copyright (c) Meta Platforms, Inc. and affiliates.
+
+ This source code is licensed under the BSD3 license found in the
+ LICENSE file in the root directory of this source tree.
+ */
+
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int num_threads) {
+  for (int i = 1; i < num_threads; i++) {
+    m_workers.emplace_back(&ThreadPool::workerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool(void) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  for (auto &worker : m_workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)> &task) {
+  if (m_workers.empty() || count <= 1) {
+    for (int i = 0; i < count; i++) {
+      task(i);
+    }
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_task = &task;
+  m_count = count;
+  m_next = 0;
+  m_pending = count;
+  m_generation++;
+  m_wake.notify_all();
+
+  runTasks(lock);
+  m_done.wait(lock, [this] { return m_pending == 0; });
+  m_task = nullptr;
+}
+
+void ThreadPool::runTasks(std::unique_lock<std::mutex> &lock) {
+  while (m_next < m_count) {
+    const int index = m_next++;
+    const std::function<void(int)> *task = m_task;
+
+    lock.unlock();
+    (*task)(index);
+    lock.lock();
+
+    if (--m_pending == 0) {
+      m_done.notify_all();
+    }
+  }
+}
+
+void ThreadPool::workerLoop(void) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  uint64_t generation = 0;
+
+  for (;;) {
+    m_wake.wait(lock, [&] { return m_stop || m_generation != generation; });
+    if (m_stop) {
+      return;
+    }
+    generation = m_generation;
+    runTasks(lock);
+  }
+}
@@ -0,0 +1,52 @@
+/*
+ Copyright (c) Meta Platforms, Inc. and affiliates.
+
+ This source code is licensed under the BSD3 license found in the
+ LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Fixed-size pool of worker threads running indexed tasks.
+///
+/// parallelFor() hands out task indices in increasing order, so a task may
+/// block waiting on a task with a lower index without deadlocking the pool.
+/// The calling thread takes part in the work. Calls must not be nested.
+class ThreadPool {
+public:
+  ThreadPool(int num_threads);
+  ~ThreadPool(void);
+
+  /// Number of threads taking part in parallelFor(), including the caller
+  inline int size(void) { return (int)m_workers.size() + 1; }
+
+  /// Run task(0) .. task(count - 1) and return once all of them completed
+  void parallelFor(int count, const std::function<void(int)> &task);
+
+private:
+  std::vector<std::thread> m_workers;
+
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_done;
+
+  const std::function<void(int)> *m_task = nullptr;
+  int m_count = 0;
+  int m_next = 0;
+  int m_pending = 0;
+  uint64_t m_generation = 0;
+  bool m_stop = false;
+
+  void workerLoop(void);
+  void runTasks(std::unique_lock<std::mutex> &lock);
+
+  ThreadPool(ThreadPool &) = delete;
+  ThreadPool &operator=(ThreadPool &) = delete;
+};
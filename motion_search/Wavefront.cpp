@@ -0,0 +1,39 @@
+/*
+ Copyright (c) Meta Platforms, Inc. and affiliates.
+
+ This source code is licensed under the BSD3 license found in the
+ LICENSE file in the root directory of this source tree.
+ */
+
+#include "Wavefront.h"
+
+#include <algorithm>
+#include <thread>
+
+Wavefront::Wavefront(ThreadPool *pool, const DIM dim, int block_width,
+                     int block_height)
+    : m_pPool(pool), m_rows((dim.height + block_height - 1) / block_height),
+      m_cols((dim.width + block_width - 1) / block_width),
+      m_progress(new std::atomic<int>[(size_t)m_rows]) {}
+
+void Wavefront::run(const std::function<void(int)> &task) {
+  for (int row = 0; row < m_rows; row++) {
+    m_progress[row].store(0, std::memory_order_relaxed);
+  }
+
+  // The pool hands out rows in increasing order, so the row a task waits on
+  // has always been started
+  m_pPool->parallelFor(m_rows, task);
+}
+
+void Wavefront::sync(void *opaque, int row, int col) {
+  Wavefront *wf = (Wavefront *)opaque;
+
+  wf->m_progress[row].store(col, std::memory_order_release);
+  if (row > 0) {
+    const int needed = std::min(col + 2, wf->m_cols);
+    while (wf->m_progress[row - 1].load(std::memory_order_acquire) < needed) {
+      std::this_thread::yield();
+    }
+  }
+}
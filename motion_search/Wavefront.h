@@ -0,0 +1,44 @@
+/*
+ Copyright (c) Meta Platforms, Inc. and affiliates.
+
+ This source code is licensed under the BSD3 license found in the
+ LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "ThreadPool.h"
+#include "common.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+/// Searches the macroblock rows of a picture concurrently in wavefront order.
+///
+/// Row r may search macroblock c once row r - 1 has finished macroblock
+/// c + 1, so every macroblock sees the same left, top and top-right
+/// predictors as in a raster-order search, and the results are identical.
+class Wavefront {
+public:
+  Wavefront(ThreadPool *pool, const DIM dim, int block_width, int block_height);
+
+  inline int rows(void) { return m_rows; }
+
+  /// Run task(row) for every macroblock row and return once all are done
+  void run(const std::function<void(int)> &task);
+
+  /// row_sync_t callback for the *_rows() searches, with this as opaque
+  static void sync(void *opaque, int row, int col);
+
+private:
+  ThreadPool *m_pPool;
+  int m_rows;
+  int m_cols;
+
+  // Number of completed macroblocks of each row
+  std::unique_ptr<std::atomic<int>[]> m_progress;
+
+  Wavefront(Wavefront &) = delete;
+  Wavefront &operator=(Wavefront &) = delete;
+};
@@ -17,117 +17,185 @@ namespace motion_search {
 XMLWriter::XMLWriter(std::ostream &out, DetailLevel detail_level)
     : OutputWriter(out, detail_level) {}
 
-void XMLWriter::write(const AnalysisResults &results) {
-  XMLDocument doc;
+XMLWriter::~XMLWriter() = default;
+
+// The printer is driven element by element; its buffer is moved to the output
+// stream after each GOP.
+void XMLWriter::flush() {
+  out_ << printer_->CStr();
+  out_.flush();
+  printer_->ClearBuffer(false);
+}
+
+void XMLWriter::begin(const VideoMetadata &metadata) {
+  printer_.reset(new XMLPrinter());
+  sampling_ = metadata.sampling;
 
   // XML declaration
-  XMLDeclaration *decl = doc.NewDeclaration();
-  doc.InsertFirstChild(decl);
+  printer_->PushDeclaration("xml version=\"1.0\" encoding=\"UTF-8\"");
 
   // Root element
-  XMLElement *root = doc.NewElement("motion_analysis");
-  root->SetAttribute("version", results.metadata.version.c_str());
-  doc.InsertEndChild(root);
+  printer_->OpenElement("motion_analysis");
+  printer_->PushAttribute("version", metadata.version.c_str());
 
   // Metadata
-  XMLElement *metadata = doc.NewElement("metadata");
-  root->InsertEndChild(metadata);
+  printer_->OpenElement("metadata");
 
-  XMLElement *video = doc.NewElement("video");
-  video->SetAttribute("width", results.metadata.width);
-  video->SetAttribute("height", results.metadata.height);
-  video->SetAttribute("frames", results.metadata.total_frames);
-  metadata->InsertEndChild(video);
+  printer_->OpenElement("video");
+  printer_->PushAttribute("width", metadata.width);
+  printer_->PushAttribute("height", metadata.height);
+  printer_->PushAttribute("frames", metadata.total_frames);
+  printer_->CloseElement();
 
-  XMLElement *encoding = doc.NewElement("encoding");
-  encoding->SetAttribute("gop_size", results.metadata.gop_size);
-  encoding->SetAttribute("bframes", results.metadata.bframes);
-  metadata->InsertEndChild(encoding);
+  printer_->OpenElement("encoding");
+  printer_->PushAttribute("gop_size", metadata.gop_size);
+  printer_->PushAttribute("bframes", metadata.bframes);
+  printer_->CloseElement();
 
-  XMLElement *input = doc.NewElement("input");
-  input->SetAttribute("format", results.metadata.input_format.c_str());
-  input->SetAttribute("filename", results.metadata.input_filename.c_str());
-  metadata->InsertEndChild(input);
+  printer_->OpenElement("input");
+  printer_->PushAttribute("format", metadata.input_format.c_str());
+  printer_->PushAttribute("filename", metadata.input_filename.c_str());
+  printer_->CloseElement();
 
   // Format timestamp
   auto time_t_val =
-      std::chrono::system_clock::to_time_t(results.metadata.analysis_time);
+      std::chrono::system_clock::to_time_t(metadata.analysis_time);
   char time_str[100];
   std::strftime(time_str, sizeof(time_str), "%Y-%m-%dT%H:%M:%SZ",
                 std::gmtime(&time_t_val));
 
-  XMLElement *timestamp = doc.NewElement("timestamp");
-  timestamp->SetText(time_str);
-  metadata->InsertEndChild(timestamp);
+  printer_->OpenElement("timestamp");
+  printer_->PushText(time_str);
+  printer_->CloseElement();
+
+  printer_->CloseElement();
 
   // GOPs
-  XMLElement *gops = doc.NewElement("gops");
-  root->InsertEndChild(gops);
-
-  for (const auto &gop : results.gops) {
-    XMLElement *gop_elem = doc.NewElement("gop");
-    gop_elem->SetAttribute("num", gop.gop_num);
-    gop_elem->SetAttribute("start", gop.start_frame);
-    gop_elem->SetAttribute("end", gop.end_frame);
-    gop_elem->SetAttribute("total_bits", (int64_t)gop.total_bits);
-    gop_elem->SetAttribute("avg_complexity", gop.avg_complexity);
-    gop_elem->SetAttribute("i_frames", gop.i_frame_count);
-    gop_elem->SetAttribute("p_frames", gop.p_frame_count);
-    gop_elem->SetAttribute("b_frames", gop.b_frame_count);
-    gops->InsertEndChild(gop_elem);
-
-    // Add frames if detail level is FRAME
-    if (detail_level_ == DetailLevel::FRAME && !gop.frames.empty()) {
-      for (const auto &frame : gop.frames) {
-        XMLElement *frame_elem = doc.NewElement("frame");
-        frame_elem->SetAttribute("num", frame.frame_num);
-        frame_elem->SetAttribute("type", frameTypeToString(frame.type).c_str());
-        gop_elem->InsertEndChild(frame_elem);
-
-        // Complexity
-        XMLElement *complexity = doc.NewElement("complexity");
-        complexity->SetAttribute("spatial",
-                                 frame.complexity.spatial_complexity);
-        complexity->SetAttribute("motion", frame.complexity.motion_complexity);
-        complexity->SetAttribute("residual",
-                                 frame.complexity.residual_complexity);
-        complexity->SetAttribute("error_mse", frame.complexity.error_mse);
-        complexity->SetAttribute("unified",
-                                 frame.complexity.unified_complexity);
-        frame_elem->InsertEndChild(complexity);
-
-        // Block modes
-        XMLElement *block_modes = doc.NewElement("block_modes");
-        block_modes->SetAttribute("intra", frame.count_intra);
-        block_modes->SetAttribute("inter_p", frame.count_inter_p);
-        block_modes->SetAttribute("inter_b", frame.count_inter_b);
-        frame_elem->InsertEndChild(block_modes);
-
-        // Error
-        XMLElement *error = doc.NewElement("error");
-        error->SetAttribute("value", (int64_t)frame.error);
-        frame_elem->InsertEndChild(error);
-
-        // Bits
-        XMLElement *bits = doc.NewElement("bits");
-        bits->SetAttribute("estimated", (int64_t)frame.estimated_bits);
-        frame_elem->InsertEndChild(bits);
-
-        // MV stats
-        XMLElement *mv_stats = doc.NewElement("mv_stats");
-        mv_stats->SetAttribute("mean_magnitude", frame.mv_stats.mean_magnitude);
-        mv_stats->SetAttribute("max_magnitude", frame.mv_stats.max_magnitude);
-        mv_stats->SetAttribute("zero_count", frame.mv_stats.zero_mv_count);
-        mv_stats->SetAttribute("total_count", frame.mv_stats.total_mv_count);
-        frame_elem->InsertEndChild(mv_stats);
-      }
+  printer_->OpenElement("gops");
+  flush();
+}
+
+void XMLWriter::onFrame(const FrameData & /* frame */) {}
+
+void XMLWriter::onGOPComplete(const GOPData &gop) {
+  printer_->OpenElement("gop");
+  printer_->PushAttribute("num", gop.gop_num);
+  printer_->PushAttribute("start", gop.start_frame);
+  printer_->PushAttribute("end", gop.end_frame);
+  printer_->PushAttribute("total_bits", (int64_t)gop.total_bits);
+  printer_->PushAttribute("avg_complexity", gop.avg_complexity);
+  printer_->PushAttribute("i_frames", gop.i_frame_count);
+  printer_->PushAttribute("p_frames", gop.p_frame_count);
+  printer_->PushAttribute("b_frames", gop.b_frame_count);
+  if (sampling_) {
+    printer_->PushAttribute("sampled", gop.sampled);
+  }
+
+  // Add frames if detail level is FRAME
+  if (detail_level_ == DetailLevel::FRAME) {
+    for (const auto &frame : gop.frames) {
+      printer_->OpenElement("frame");
+      printer_->PushAttribute("num", frame.frame_num);
+      printer_->PushAttribute("type", frameTypeToString(frame.type).c_str());
+
+      // Complexity
+      printer_->OpenElement("complexity");
+      printer_->PushAttribute("spatial", frame.complexity.spatial_complexity);
+      printer_->PushAttribute("motion", frame.complexity.motion_complexity);
+      printer_->PushAttribute("residual",
+                              frame.complexity.residual_complexity);
+      printer_->PushAttribute("error_mse", frame.complexity.error_mse);
+      printer_->PushAttribute("unified", frame.complexity.unified_complexity);
+      printer_->CloseElement();
+
+      // Block modes
+      printer_->OpenElement("block_modes");
+      printer_->PushAttribute("intra", frame.count_intra);
+      printer_->PushAttribute("inter_p", frame.count_inter_p);
+      printer_->PushAttribute("inter_b", frame.count_inter_b);
+      printer_->CloseElement();
+
+      // Error
+      printer_->OpenElement("error");
+      printer_->PushAttribute("value", (int64_t)frame.error);
+      printer_->CloseElement();
+
+      // Bits
+      printer_->OpenElement("bits");
+      printer_->PushAttribute("estimated", (int64_t)frame.estimated_bits);
+      printer_->CloseElement();
+
+      // MV stats
+      printer_->OpenElement("mv_stats");
+      printer_->PushAttribute("mean_magnitude", frame.mv_stats.mean_magnitude);
+      printer_->PushAttribute("max_magnitude", frame.mv_stats.max_magnitude);
+      printer_->PushAttribute("zero_count", frame.mv_stats.zero_mv_count);
+      printer_->PushAttribute("total_count", frame.mv_stats.total_mv_count);
+      printer_->CloseElement();
+
+      printer_->CloseElement();
+    }
+  }
+
+  printer_->CloseElement();
+  flush();
+}
+
+void XMLWriter::end(const VideoMetadata &metadata) {
+  // Close gops
+  printer_->CloseElement();
+
+  // The totals extrapolated from the sampled GOPs follow the GOPs too
+  if (metadata.sampling) {
+    const SamplingEstimate &estimate = metadata.sampling_estimate;
+    printer_->OpenElement("sampling");
+    printer_->PushAttribute("sampled_gops", estimate.sampled_gops);
+    printer_->PushAttribute("estimated_gops", estimate.estimated_gops);
+    printer_->PushAttribute("sampled_frames", estimate.sampled_frames);
+    printer_->PushAttribute("total_frames", estimate.total_frames);
+    printer_->OpenElement("bits");
+    printer_->PushAttribute("estimate", estimate.total_bits);
+    if (estimate.has_bounds) {
+      printer_->PushAttribute("low", estimate.bits_low);
+      printer_->PushAttribute("high", estimate.bits_high);
+    }
+    printer_->CloseElement();
+    printer_->OpenElement("error");
+    printer_->PushAttribute("estimate", estimate.total_error);
+    if (estimate.has_bounds) {
+      printer_->PushAttribute("low", estimate.error_low);
+      printer_->PushAttribute("high", estimate.error_high);
+    }
+    printer_->CloseElement();
+    printer_->CloseElement();
+  }
+
+  // The metadata was written before the analysis, so the stage timings
+  // follow the GOPs
+  if (!metadata.stage_timings.empty()) {
+    printer_->OpenElement("timing");
+    for (const auto &stage : metadata.stage_timings) {
+      printer_->OpenElement("stage");
+      printer_->PushAttribute("name", stage.stage.c_str());
+      printer_->PushAttribute("calls", stage.calls);
+      printer_->PushAttribute("total_ms", stage.total_ms);
+      printer_->CloseElement();
+    }
+    for (const auto &type : metadata.frame_type_timings) {
+      printer_->OpenElement("frame_type");
+      printer_->PushAttribute("type", frameTypeToString(type.type).c_str());
+      printer_->PushAttribute("frames", type.frames);
+      printer_->PushAttribute("total_ms", type.total_ms);
+      printer_->PushAttribute("avg_ms", type.avg_ms);
+      printer_->CloseElement();
     }
+    printer_->CloseElement();
   }
 
-  // Print to string and write to output stream
-  XMLPrinter printer;
-  doc.Print(&printer);
-  out_ << printer.CStr() << std::endl;
+  // Close the root element
+  printer_->CloseElement();
+  out_ << printer_->CStr() << std::endl;
+  printer_.reset();
 }
 
 } // namespace motion_search
@@ -9,20 +9,37 @@
 
 #include "OutputWriter.h"
 
+#include <memory>
+
+namespace tinyxml2 {
+class XMLPrinter;
+}
+
 namespace motion_search {
 
 /**
  * @brief XML output writer
  *
  * Writes analysis results in XML format with rich metadata.
- * Supports both frame-level and GOP-level detail.
+ * Supports both frame-level and GOP-level detail. Each GOP is written
+ * when it completes; the metadata comes first, with the expected number
+ * of frames.
  */
 class XMLWriter : public OutputWriter {
 public:
   XMLWriter(std::ostream &out, DetailLevel detail_level);
-  ~XMLWriter() override = default;
+  ~XMLWriter() override;
+
+  void begin(const VideoMetadata &metadata) override;
+  void onFrame(const FrameData &frame) override;
+  void onGOPComplete(const GOPData &gop) override;
+  void end(const VideoMetadata &metadata) override;
+
+private:
+  std::unique_ptr<tinyxml2::XMLPrinter> printer_;
+  bool sampling_ = false;
 
-  void write(const AnalysisResults &results) override;
+  void flush();
 };
 
 } // namespace motion_search
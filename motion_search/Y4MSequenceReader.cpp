@@ -71,7 +71,21 @@ bool Y4MSequenceReader::Open(unique_file_t file, const std::string &path) {
   return YUVSequenceReader::Open(std::move(file), path, dim);
 }
 
+std::unique_ptr<YUVSequenceReader> Y4MSequenceReader::reopen(void) {
+  std::unique_ptr<Y4MSequenceReader> reader(new Y4MSequenceReader());
+  if (!reader->Open(unique_file_t(fopen(filename().c_str(), "rb")),
+                    filename())) {
+    return nullptr;
+  }
+
+  return reader;
+}
+
 void Y4MSequenceReader::readPicture(uint8_t *pY, uint8_t *pU, uint8_t *pV) {
   fseek(file(), (long)strlen(Parameters::Frame), SEEK_CUR);
   YUVSequenceReader::readPicture(pY, pU, pV);
 }
+
+size_t Y4MSequenceReader::frameSize(void) {
+  return strlen(Parameters::Frame) + YUVSequenceReader::frameSize();
+}
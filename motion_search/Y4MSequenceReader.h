@@ -20,9 +20,13 @@ public:
 
   bool Open(unique_file_t file, const std::string &path);
 
+  std::unique_ptr<YUVSequenceReader> reopen(void) override;
+
 protected:
   void readPicture(uint8_t *pY, uint8_t *pU, uint8_t *pV) override;
 
+  size_t frameSize(void) override;
+
 private:
   Y4MSequenceReader(Y4MSequenceReader &) = delete;
   Y4MSequenceReader &operator=(Y4MSequenceReader &) = delete;
@@ -9,16 +9,18 @@
 #include "YUVFrame.h"
 
 #include "frame.h"
+#include "motion_search.h"
 
 #include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 
-YUVFrame::YUVFrame(IVideoSequenceReader *rdr)
+YUVFrame::YUVFrame(IVideoSequenceReader *rdr, bool luma_only, int block_size)
     : m_dim(rdr->dim()), m_stride(rdr->dim().width + 2 * HORIZONTAL_PADDING),
-      m_padded_height(rdr->dim().height + 2 * VERTICAL_PADDING), m_pReader(rdr),
-      m_pos(-1) {
-  size_t frame_size = m_stride * m_padded_height * 3 * sizeof(uint8_t) / 2;
+      m_padded_height(rdr->dim().height + 2 * VERTICAL_PADDING),
+      m_block_size(block_size), m_pReader(rdr), m_pos(-1) {
+  size_t luma_size = (size_t)m_stride * m_padded_height * sizeof(uint8_t);
+  size_t frame_size = luma_only ? luma_size : luma_size * 3 / 2;
 
   m_pFrame = memory::AlignedAlloc<uint8_t>(frame_size);
   if (m_pFrame == NULL) {
@@ -32,8 +34,17 @@ YUVFrame::YUVFrame(IVideoSequenceReader *rdr)
   int cb_offset = cr_offset + (m_stride / 2) * (m_padded_height / 2);
 
   m_pY = m_pFrame.get() + luma_offset;
-  m_pU = m_pFrame.get() + cr_offset;
-  m_pV = m_pFrame.get() + cb_offset;
+  m_pU = luma_only ? NULL : m_pFrame.get() + cr_offset;
+  m_pV = luma_only ? NULL : m_pFrame.get() + cb_offset;
+
+  const size_t num_MBs = (size_t)(m_dim.width / m_block_size + 2) *
+                         ((m_dim.height + m_block_size - 1) / m_block_size + 2);
+  m_pIntraCosts = memory::AlignedAlloc<int>(num_MBs);
+  if (m_pIntraCosts == NULL) {
+    fprintf(stderr, "Not enough memory (%zu bytes) for intra costs\n",
+            num_MBs * sizeof(int));
+    exit(-1);
+  }
 }
 
 void YUVFrame::swapFrame(YUVFrame *other) {
@@ -42,15 +53,58 @@ void YUVFrame::swapFrame(YUVFrame *other) {
   std::swap(this->m_pU, other->m_pU);
   std::swap(this->m_pV, other->m_pV);
   std::swap(this->m_pos, other->m_pos);
+  std::swap(this->m_pIntraCosts, other->m_pIntraCosts);
+  std::swap(this->m_intra_valid, other->m_intra_valid);
+  std::swap(this->m_extended, other->m_extended);
+  std::swap(this->m_pPyramidPlanes, other->m_pPyramidPlanes);
+  std::swap(this->m_pyramid, other->m_pyramid);
+  std::swap(this->m_pyramid_valid, other->m_pyramid_valid);
 }
 
 void YUVFrame::readNextFrame(void) {
+  m_intra_valid = false;
+  m_extended = false;
+  m_pyramid_valid = false;
   m_pos = m_pReader->count();
   m_pReader->read(y(), u(), v());
 }
 
+const int *YUVFrame::intraCosts(void) {
+  const int firstMB = m_dim.width / m_block_size + 2 + 1;
+
+  if (!m_intra_valid) {
+    intra_costs(y(), m_stride, m_dim, m_block_size, m_block_size,
+                &m_pIntraCosts.get()[firstMB]);
+    m_intra_valid = true;
+  }
+
+  return &m_pIntraCosts.get()[firstMB];
+}
+
+const pyramid_t *YUVFrame::pyramid(void) {
+  if (!m_pyramid_valid) {
+    if (m_pPyramidPlanes == NULL) {
+      const size_t size = pyramid_size(m_dim);
+      m_pPyramidPlanes = memory::AlignedAlloc<uint8_t>(size);
+      if (m_pPyramidPlanes == NULL) {
+        fprintf(stderr, "Not enough memory (%zu bytes) for the pyramid\n",
+                size);
+        exit(-1);
+      }
+    }
+    build_pyramid(y(), m_stride, m_dim, m_pPyramidPlanes.get(), &m_pyramid);
+    m_pyramid_valid = true;
+  }
+
+  return &m_pyramid;
+}
+
 void YUVFrame::boundaryExtend(void) {
+  if (m_extended) {
+    return;
+  }
+
+  // Only luma is searched, so the chroma padding is left unfilled
   extend_frame(y(), m_stride, m_dim, HORIZONTAL_PADDING, VERTICAL_PADDING);
-  extend_frame(u(), m_stride >> 1, m_dim / 2, HOR_PADDING_UV, VER_PADDING_UV);
-  extend_frame(v(), m_stride >> 1, m_dim / 2, HOR_PADDING_UV, VER_PADDING_UV);
+  m_extended = true;
 }
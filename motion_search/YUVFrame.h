@@ -13,7 +13,11 @@
 
 class YUVFrame {
 public:
-  YUVFrame(IVideoSequenceReader *rdr);
+  // A luma-only frame stores just the Y plane: u() and v() are NULL and the
+  // reader skips the chroma of every frame read into it. The intra costs are
+  // those of the block_size macroblocks.
+  YUVFrame(IVideoSequenceReader *rdr, bool luma_only = false,
+           int block_size = MB_WIDTH);
   virtual ~YUVFrame(void) = default;
 
   inline uint8_t *y(void) { return m_pY; }
@@ -25,18 +29,41 @@ public:
 
   void swapFrame(YUVFrame *other);
   void readNextFrame(void);
+
+  // Fill the padding around the luma plane from its edges. Only the first
+  // call after a read does the work.
   void boundaryExtend(void);
+  inline bool isExtended(void) { return m_extended; }
+
+  // Intra cost of every macroblock (see intra_costs()), laid out from the
+  // first macroblock like the MotionVectorField planes. It is computed on
+  // first use and kept until the next frame is read into this buffer.
+  const int *intraCosts(void);
+  inline bool hasIntraCosts(void) { return m_intra_valid; }
+
+  // Half and quarter resolution luma (see pyramid_t). It is built on first
+  // use and kept until the next frame is read into this buffer.
+  const pyramid_t *pyramid(void);
 
 private:
   const DIM m_dim;
   const int m_stride = 0;
   const int m_padded_height = 0;
+  const int m_block_size = MB_WIDTH;
 
   memory::aligned_unique_ptr<uint8_t> m_pFrame;
   uint8_t *m_pY;
   uint8_t *m_pU;
   uint8_t *m_pV;
 
+  memory::aligned_unique_ptr<int> m_pIntraCosts;
+  bool m_intra_valid = false;
+  bool m_extended = false;
+
+  memory::aligned_unique_ptr<uint8_t> m_pPyramidPlanes;
+  pyramid_t m_pyramid = {};
+  bool m_pyramid_valid = false;
+
   IVideoSequenceReader *m_pReader;
 
   int m_pos;
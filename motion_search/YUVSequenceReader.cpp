@@ -9,8 +9,27 @@
 #include "YUVSequenceReader.h"
 #include "EOFException.h"
 
+#include <cstdint>
 #include <sys/stat.h>
 
+// Byte offsets of raw inputs pass 2 GB after a few hundred 4K frames, past
+// the long of fseek() and ftell() on LLP64 targets
+static int seek_file(FILE *file, int64_t offset, int origin) {
+#if defined(_WINDOWS)
+  return _fseeki64(file, offset, origin);
+#else
+  return fseeko(file, (off_t)offset, origin);
+#endif
+}
+
+static int64_t tell_file(FILE *file) {
+#if defined(_WINDOWS)
+  return _ftelli64(file);
+#else
+  return (int64_t)ftello(file);
+#endif
+}
+
 bool YUVSequenceReader::Open(unique_file_t file, const std::string &path,
                              const DIM dim) {
 
@@ -18,10 +37,39 @@ bool YUVSequenceReader::Open(unique_file_t file, const std::string &path,
   m_stride = dim.width + 2 * HORIZONTAL_PADDING;
   m_filename = path;
   m_file = std::move(file);
+  m_data_offset = m_file ? tell_file(m_file.get()) : 0;
+
+  return true;
+}
+
+bool YUVSequenceReader::seek(int frame) {
+  const int64_t offset = m_data_offset + (int64_t)frame * (int64_t)frameSize();
+  if (seek_file(m_file.get(), offset, SEEK_SET)) {
+    return false;
+  }
+  setCount(frame);
 
   return true;
 }
 
+std::unique_ptr<YUVSequenceReader> YUVSequenceReader::reopen(void) {
+  std::unique_ptr<YUVSequenceReader> reader(new YUVSequenceReader());
+  reader->Open(unique_file_t(fopen(m_filename.c_str(), "rb")), m_filename,
+               m_dim);
+  if (!reader->isOpen()) {
+    return nullptr;
+  }
+
+  return reader;
+}
+
+size_t YUVSequenceReader::frameSize(void) {
+  size_t luma = (size_t)m_dim.width * m_dim.height;
+  size_t chroma = (size_t)(m_dim.width / 2) * (m_dim.height / 2);
+
+  return luma + 2 * chroma;
+}
+
 void YUVSequenceReader::readComponent(uint8_t *pData, bool isLuma) {
   const uint32_t div = (uint32_t)(isLuma ? 1 : 2);
   uint32_t height = m_dim.height / div;
@@ -37,6 +85,16 @@ void YUVSequenceReader::readComponent(uint8_t *pData, bool isLuma) {
 
 void YUVSequenceReader::readPicture(uint8_t *pY, uint8_t *pU, uint8_t *pV) {
   readComponent(pY, true);
+  if (pU == NULL) {
+    // Skip the chroma planes, reading their last byte to catch a truncated
+    // frame
+    long chroma = (long)(m_dim.width / 2) * (m_dim.height / 2);
+    if (fseek(m_file.get(), 2 * chroma - 1, SEEK_CUR) ||
+        fgetc(m_file.get()) == EOF) {
+      throw EOFException();
+    }
+    return;
+  }
   readComponent(pU, false);
   readComponent(pV, false);
 }
@@ -47,6 +105,5 @@ int YUVSequenceReader::nframes(void) {
   struct stat buf;
   stat(m_filename.c_str(), &buf);
 
-  int picsize = m_dim.width * m_dim.height * 3 / 2;
-  return (buf.st_size / picsize);
+  return (int)((buf.st_size - m_data_offset) / (off_t)frameSize());
 }
@@ -22,6 +22,12 @@ public:
 
   bool Open(unique_file_t file, const std::string &path, const DIM dim);
 
+  // Position the reader at the start of the given frame
+  virtual bool seek(int frame);
+
+  // Open another reader on the same file, positioned at the first frame
+  virtual std::unique_ptr<YUVSequenceReader> reopen(void);
+
   bool eof(void) override;
   int nframes(void) override;
   const DIM dim(void) override { return m_dim; }
@@ -39,6 +45,10 @@ protected:
   void readPicture(uint8_t *pY, uint8_t *pU, uint8_t *pV) override;
 
   FILE *file(void) { return m_file.get(); }
+  const std::string &filename(void) { return m_filename; }
+
+  // Size of one frame in the file, including any per-frame header
+  virtual size_t frameSize(void);
 
 private:
   DIM m_dim = {0, 0};
@@ -46,6 +56,7 @@ private:
 
   std::string m_filename;
   unique_file_t m_file;
+  int64_t m_data_offset = 0;
 
   void readComponent(uint8_t *pData, bool isLuma);
 
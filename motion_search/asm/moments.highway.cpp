@@ -118,6 +118,290 @@ int fastSAD4_highway(FAST_SAD_FORMAL_ARGS) {
   return static_cast<int>(hn::ReduceSum(d16, sum16));
 }
 
+// Sum of the 16 bit lanes of an accumulator. ReduceSum() returns the lane
+// type, which the SAD of a 16 pixel wide block taller than 16 rows and the
+// sum of the differences of a 16x16 block overflow, so the lanes are added
+// in 32 bits.
+template <class D16> HWY_INLINE int SumOf16(D16, hn::Vec<D16> v) {
+  const hn::RepartitionToWide<D16> d32;
+  const auto sum32 =
+      hn::Add(hn::PromoteLowerTo(d32, v), hn::PromoteUpperTo(d32, v));
+  return static_cast<int>(hn::ReduceSum(d32, sum32));
+}
+
+// SAD with early termination, for any of the fixed widths above. The partial
+// sum is compared to min_SAD every FAST_SAD_EXIT_ROWS rows, and the remaining
+// rows are skipped once the candidate can no longer win. Like the C reference,
+// the result is exact below min_SAD and only guaranteed >= min_SAD otherwise.
+template <size_t kWidth>
+HWY_INLINE int EarlyExitSAD(const uint8_t *current, const uint8_t *reference,
+                            const ptrdiff_t stride, int block_height,
+                            int min_SAD) {
+  const hn::FixedTag<uint8_t, kWidth> d;
+  const hn::Repartition<uint16_t, decltype(d)> d16;
+
+  auto sum16 = hn::Zero(d16);
+  int sad = 0;
+
+  for (int i = block_height; i > 0;) {
+    const int rows = HWY_MIN(i, FAST_SAD_EXIT_ROWS);
+
+    for (int j = rows; j > 0; j--) {
+      auto diff = hn::AbsDiff(hn::LoadU(d, current), hn::LoadU(d, reference));
+      sum16 = hn::Add(sum16, hn::PromoteLowerTo(d16, diff));
+      sum16 = hn::Add(sum16, hn::PromoteUpperTo(d16, diff));
+
+      current += stride;
+      reference += stride;
+    }
+    i -= rows;
+
+    sad = SumOf16(d16, sum16);
+    if (sad >= min_SAD) {
+      break;
+    }
+  }
+
+  return sad;
+}
+
+// SAD with early termination - 16 byte width
+int fastSAD16_early_highway(FAST_SAD_FORMAL_ARGS) {
+  UNUSED(block_width);
+
+  return EarlyExitSAD<16>(current, reference, stride, block_height, min_SAD);
+}
+
+// SAD with early termination - 8 byte width
+int fastSAD8_early_highway(FAST_SAD_FORMAL_ARGS) {
+  UNUSED(block_width);
+
+  return EarlyExitSAD<8>(current, reference, stride, block_height, min_SAD);
+}
+
+// SAD with early termination - 4 byte width
+int fastSAD4_early_highway(FAST_SAD_FORMAL_ARGS) {
+  UNUSED(block_width);
+
+  return EarlyExitSAD<4>(current, reference, stride, block_height, min_SAD);
+}
+
+// Add the absolute differences of one row to a u16 accumulator
+template <class D16, class V>
+HWY_INLINE hn::Vec<D16> AddAbsDiff(D16 d16, hn::Vec<D16> sum, V curr, V ref) {
+  const auto diff = hn::AbsDiff(curr, ref);
+  sum = hn::Add(sum, hn::PromoteLowerTo(d16, diff));
+  return hn::Add(sum, hn::PromoteUpperTo(d16, diff));
+}
+
+// SADs of four reference positions. Each row of the current block is loaded
+// once for all four, and the rows are checked every FAST_SAD_EXIT_ROWS rows
+// like EarlyExitSAD; the group stops once none of them can win.
+template <size_t kWidth>
+HWY_INLINE void EarlyExitSADx4(const uint8_t *current,
+                               const uint8_t *const *references,
+                               const ptrdiff_t stride, int block_height,
+                               int min_SAD, int *SADs) {
+  const hn::FixedTag<uint8_t, kWidth> d;
+  const hn::Repartition<uint16_t, decltype(d)> d16;
+
+  const uint8_t *ref0 = references[0];
+  const uint8_t *ref1 = references[1];
+  const uint8_t *ref2 = references[2];
+  const uint8_t *ref3 = references[3];
+
+  auto sum0 = hn::Zero(d16);
+  auto sum1 = hn::Zero(d16);
+  auto sum2 = hn::Zero(d16);
+  auto sum3 = hn::Zero(d16);
+
+  for (int i = block_height; i > 0;) {
+    const int rows = HWY_MIN(i, FAST_SAD_EXIT_ROWS);
+
+    for (int j = rows; j > 0; j--) {
+      const auto curr = hn::LoadU(d, current);
+      sum0 = AddAbsDiff(d16, sum0, curr, hn::LoadU(d, ref0));
+      sum1 = AddAbsDiff(d16, sum1, curr, hn::LoadU(d, ref1));
+      sum2 = AddAbsDiff(d16, sum2, curr, hn::LoadU(d, ref2));
+      sum3 = AddAbsDiff(d16, sum3, curr, hn::LoadU(d, ref3));
+
+      current += stride;
+      ref0 += stride;
+      ref1 += stride;
+      ref2 += stride;
+      ref3 += stride;
+    }
+    i -= rows;
+
+    SADs[0] = SumOf16(d16, sum0);
+    SADs[1] = SumOf16(d16, sum1);
+    SADs[2] = SumOf16(d16, sum2);
+    SADs[3] = SumOf16(d16, sum3);
+    if (SADs[0] >= min_SAD && SADs[1] >= min_SAD && SADs[2] >= min_SAD &&
+        SADs[3] >= min_SAD) {
+      break;
+    }
+  }
+}
+
+// SADs of num_refs reference positions, in groups of four. A short last
+// group repeats its last reference, which leaves its early exit unchanged.
+template <size_t kWidth>
+HWY_INLINE void BatchedSAD(const uint8_t *current,
+                           const uint8_t *const *references, int num_refs,
+                           const ptrdiff_t stride, int block_height,
+                           int min_SAD, int *SADs) {
+  for (int k = 0; k < num_refs; k += 4) {
+    const uint8_t *group[4];
+    int group_SADs[4];
+
+    for (int n = 0; n < 4; n++) {
+      group[n] = references[HWY_MIN(k + n, num_refs - 1)];
+    }
+    EarlyExitSADx4<kWidth>(current, group, stride, block_height, min_SAD,
+                           group_SADs);
+    for (int n = 0; n < 4 && k + n < num_refs; n++) {
+      SADs[k + n] = group_SADs[n];
+    }
+  }
+}
+
+// Batched SADs - 16 byte width
+void fastSAD16_xN_highway(FAST_SAD_XN_FORMAL_ARGS) {
+  UNUSED(block_width);
+
+  BatchedSAD<16>(current, references, num_refs, stride, block_height, min_SAD,
+                 SADs);
+}
+
+// Batched SADs - 8 byte width
+void fastSAD8_xN_highway(FAST_SAD_XN_FORMAL_ARGS) {
+  UNUSED(block_width);
+
+  BatchedSAD<8>(current, references, num_refs, stride, block_height, min_SAD,
+                SADs);
+}
+
+// Batched SADs - 4 byte width
+void fastSAD4_xN_highway(FAST_SAD_XN_FORMAL_ARGS) {
+  UNUSED(block_width);
+
+  BatchedSAD<4>(current, references, num_refs, stride, block_height, min_SAD,
+                SADs);
+}
+
+// SADs of consecutive positions, 16 at a time. Each lane holds the SAD of
+// one position, so that one load of the reference serves the 16 positions
+// of a pixel of the current block, like mpsadbw; the sums need no reduction.
+// The u16 lanes are added to u32 ones before they can overflow.
+template <size_t kWidth>
+HWY_INLINE void SpanSAD(const uint8_t *current, const uint8_t *reference,
+                        const ptrdiff_t stride, int block_height,
+                        int num_offsets, int *SADs) {
+  const hn::FixedTag<uint8_t, 16> d;
+  const hn::Repartition<uint16_t, decltype(d)> d16;
+  const hn::Repartition<uint32_t, decltype(d)> d32;
+  const int N = (int)hn::Lanes(d);
+  const int M = (int)hn::Lanes(d32);
+  constexpr int kRows = 256 / (int)kWidth;
+
+  // Fewer positions than lanes would read past the last one
+  if (num_offsets < N) {
+    for (int k = 0; k < num_offsets; k++) {
+      int sum = 0;
+      for (int i = 0; i < block_height; i++) {
+        for (size_t j = 0; j < kWidth; j++) {
+          const int diff =
+              current[i * stride + j] - reference[i * stride + j + k];
+          sum += diff < 0 ? -diff : diff;
+        }
+      }
+      SADs[k] = sum;
+    }
+    return;
+  }
+
+  for (int k = 0; k < num_offsets; k += N) {
+    // The last group ends on the last position, and repeats some of the
+    // previous group
+    const int first = HWY_MIN(k, num_offsets - N);
+    const uint8_t *curr = current;
+    const uint8_t *ref = reference + first;
+
+    auto sum0 = hn::Zero(d32);
+    auto sum1 = hn::Zero(d32);
+    auto sum2 = hn::Zero(d32);
+    auto sum3 = hn::Zero(d32);
+
+    for (int i = block_height; i > 0;) {
+      const int rows = HWY_MIN(i, kRows);
+      auto lo = hn::Zero(d16);
+      auto hi = hn::Zero(d16);
+
+      for (int r = rows; r > 0; r--) {
+        for (size_t j = 0; j < kWidth; j++) {
+          const auto diff =
+              hn::AbsDiff(hn::Set(d, curr[j]), hn::LoadU(d, ref + j));
+          lo = hn::Add(lo, hn::PromoteLowerTo(d16, diff));
+          hi = hn::Add(hi, hn::PromoteUpperTo(d16, diff));
+        }
+        curr += stride;
+        ref += stride;
+      }
+      i -= rows;
+
+      sum0 = hn::Add(sum0, hn::PromoteLowerTo(d32, lo));
+      sum1 = hn::Add(sum1, hn::PromoteUpperTo(d32, lo));
+      sum2 = hn::Add(sum2, hn::PromoteLowerTo(d32, hi));
+      sum3 = hn::Add(sum3, hn::PromoteUpperTo(d32, hi));
+    }
+
+    HWY_ALIGN uint32_t lanes[16];
+    hn::Store(sum0, d32, lanes);
+    hn::Store(sum1, d32, lanes + M);
+    hn::Store(sum2, d32, lanes + 2 * M);
+    hn::Store(sum3, d32, lanes + 3 * M);
+    for (int n = k - first; n < N; n++) {
+      SADs[first + n] = static_cast<int>(lanes[n]);
+    }
+  }
+}
+
+// SADs of consecutive positions - 32 byte width
+void fastSAD32_span_highway(FAST_SAD_SPAN_FORMAL_ARGS) {
+  UNUSED(block_width);
+
+  SpanSAD<32>(current, reference, stride, block_height, num_offsets, SADs);
+}
+
+// SADs of consecutive positions - 16 byte width
+void fastSAD16_span_highway(FAST_SAD_SPAN_FORMAL_ARGS) {
+  UNUSED(block_width);
+
+  SpanSAD<16>(current, reference, stride, block_height, num_offsets, SADs);
+}
+
+// SADs of consecutive positions - 8 byte width
+void fastSAD8_span_highway(FAST_SAD_SPAN_FORMAL_ARGS) {
+  UNUSED(block_width);
+
+  SpanSAD<8>(current, reference, stride, block_height, num_offsets, SADs);
+}
+
+// SADs of consecutive positions - 4 byte width
+void fastSAD4_span_highway(FAST_SAD_SPAN_FORMAL_ARGS) {
+  UNUSED(block_width);
+
+  SpanSAD<4>(current, reference, stride, block_height, num_offsets, SADs);
+}
+
+// Energy of the DC of count pixels adding up to sum. The square of the sum
+// overflows an int from a 16x16 block of mean 182 on.
+HWY_INLINE int DCEnergy(int sum, int count) {
+  return static_cast<int>(
+      (static_cast<int64_t>(sum) * sum + (count >> 1)) / count);
+}
+
 // Variance - 16 byte width
 int fast_variance16_highway(FAST_VARIANCE_FORMAL_ARGS) {
   UNUSED(block_width);
@@ -152,11 +436,79 @@ int fast_variance16_highway(FAST_VARIANCE_FORMAL_ARGS) {
     current += stride;
   }
 
-  int sum = static_cast<int>(hn::ReduceSum(d16, sum16));
+  int sum = SumOf16(d16, sum16);
   int sum2 = static_cast<int>(hn::ReduceSum(d32, sum32));
 
   int temp = block_height << 4;
-  return sum2 - (sum * sum + (temp >> 1)) / temp;
+  return sum2 - DCEnergy(sum, temp);
+}
+
+// Remove the DC of the sums of a 16xH block and of its 8x8 quadrants, and
+// return the 16xH value
+HWY_INLINE int SplitAC(const int *sum, const int *sum2, int block_height,
+                       int *split) {
+  int total = 0;
+  int total2 = 0;
+
+  for (int q = 0; q < 4; q++) {
+    const int rows =
+        HWY_MAX(0, HWY_MIN(8, q < 2 ? block_height : block_height - 8));
+    const int temp = 8 * rows;
+    split[q] = temp ? sum2[q] - DCEnergy(sum[q], temp) : 0;
+    total += sum[q];
+    total2 += sum2[q];
+  }
+
+  const int temp = block_height << 4;
+  return total2 - DCEnergy(total, temp);
+}
+
+// Variance - 16 byte width, with its 8x8 quadrants. The lower and upper
+// halves of each row belong to the left and right quadrants.
+int fast_variance16_split_highway(FAST_VARIANCE_SPLIT_FORMAL_ARGS) {
+  const hn::FixedTag<uint8_t, 16> d;
+  const hn::Repartition<uint16_t, decltype(d)> d16;
+  const hn::Repartition<uint32_t, decltype(d)> d32;
+
+  int sum[4];
+  int sum2[4];
+
+  for (int band = 0; band < 2; band++) {
+    const int rows = band ? block_height - 8 : HWY_MIN(block_height, 8);
+
+    auto sum16_left = hn::Zero(d16);
+    auto sum16_right = hn::Zero(d16);
+    auto sum32_left = hn::Zero(d32);
+    auto sum32_right = hn::Zero(d32);
+
+    for (int i = rows; i > 0; i--) {
+      auto pixels = hn::LoadU(d, current);
+
+      auto pixels_lo = hn::PromoteLowerTo(d16, pixels);
+      auto pixels_hi = hn::PromoteUpperTo(d16, pixels);
+      sum16_left = hn::Add(sum16_left, pixels_lo);
+      sum16_right = hn::Add(sum16_right, pixels_hi);
+
+      auto lo32_lo = hn::PromoteLowerTo(d32, pixels_lo);
+      auto lo32_hi = hn::PromoteUpperTo(d32, pixels_lo);
+      auto hi32_lo = hn::PromoteLowerTo(d32, pixels_hi);
+      auto hi32_hi = hn::PromoteUpperTo(d32, pixels_hi);
+
+      sum32_left = hn::Add(sum32_left, hn::Mul(lo32_lo, lo32_lo));
+      sum32_left = hn::Add(sum32_left, hn::Mul(lo32_hi, lo32_hi));
+      sum32_right = hn::Add(sum32_right, hn::Mul(hi32_lo, hi32_lo));
+      sum32_right = hn::Add(sum32_right, hn::Mul(hi32_hi, hi32_hi));
+
+      current += stride;
+    }
+
+    sum[2 * band] = SumOf16(d16, sum16_left);
+    sum[2 * band + 1] = SumOf16(d16, sum16_right);
+    sum2[2 * band] = static_cast<int>(hn::ReduceSum(d32, sum32_left));
+    sum2[2 * band + 1] = static_cast<int>(hn::ReduceSum(d32, sum32_right));
+  }
+
+  return SplitAC(sum, sum2, block_height, split);
 }
 
 // Variance - 8 byte width
@@ -193,11 +545,11 @@ int fast_variance8_highway(FAST_VARIANCE_FORMAL_ARGS) {
     current += stride;
   }
 
-  int sum = static_cast<int>(hn::ReduceSum(d16, sum16));
+  int sum = SumOf16(d16, sum16);
   int sum2 = static_cast<int>(hn::ReduceSum(d32, sum32));
 
   int temp = block_height << 3;
-  return sum2 - (sum * sum + (temp >> 1)) / temp;
+  return sum2 - DCEnergy(sum, temp);
 }
 
 // Variance - 4 byte width
@@ -234,11 +586,11 @@ int fast_variance4_highway(FAST_VARIANCE_FORMAL_ARGS) {
     current += stride;
   }
 
-  int sum = static_cast<int>(hn::ReduceSum(d16, sum16));
+  int sum = SumOf16(d16, sum16);
   int sum2 = static_cast<int>(hn::ReduceSum(d32, sum32));
 
   int temp = block_height << 2;
-  return sum2 - (sum * sum + (temp >> 1)) / temp;
+  return sum2 - DCEnergy(sum, temp);
 }
 
 // MSE (Mean Squared Error) - 16 byte width
@@ -290,14 +642,72 @@ int fast_calc_mse16_highway(FAST_MSE_FORMAL_ARGS) {
   int sum2 = static_cast<int>(hn::ReduceSum(d32, sum32));
 
 #ifdef AC_ENERGY
-  int sum = static_cast<int>(hn::ReduceSum(d16, sum16));
+  int sum = SumOf16(d16, sum16);
   int temp = block_height << 4;
-  sum2 -= (sum * sum + (temp >> 1)) / temp;
+  sum2 -= DCEnergy(sum, temp);
 #endif
 
   return sum2;
 }
 
+// MSE - 16 byte width, with its 8x8 quadrants
+int fast_calc_mse16_split_highway(FAST_MSE_SPLIT_FORMAL_ARGS) {
+  const hn::FixedTag<uint8_t, 16> d;
+  const hn::Repartition<int16_t, decltype(d)> d16;
+  const hn::Repartition<int32_t, decltype(d)> d32;
+
+  int sum[4];
+  int sum2[4];
+
+  for (int band = 0; band < 2; band++) {
+    const int rows = band ? block_height - 8 : HWY_MIN(block_height, 8);
+
+    auto sum16_left = hn::Zero(d16);
+    auto sum16_right = hn::Zero(d16);
+    auto sum32_left = hn::Zero(d32);
+    auto sum32_right = hn::Zero(d32);
+
+    for (int i = rows; i > 0; i--) {
+      auto curr = hn::LoadU(d, current);
+      auto ref = hn::LoadU(d, reference);
+
+      auto diff_lo = hn::Sub(hn::PromoteLowerTo(d16, curr),
+                             hn::PromoteLowerTo(d16, ref));
+      auto diff_hi = hn::Sub(hn::PromoteUpperTo(d16, curr),
+                             hn::PromoteUpperTo(d16, ref));
+      sum16_left = hn::Add(sum16_left, diff_lo);
+      sum16_right = hn::Add(sum16_right, diff_hi);
+
+      auto diff_lo_lo = hn::PromoteLowerTo(d32, diff_lo);
+      auto diff_lo_hi = hn::PromoteUpperTo(d32, diff_lo);
+      auto diff_hi_lo = hn::PromoteLowerTo(d32, diff_hi);
+      auto diff_hi_hi = hn::PromoteUpperTo(d32, diff_hi);
+
+      sum32_left = hn::Add(sum32_left, hn::Mul(diff_lo_lo, diff_lo_lo));
+      sum32_left = hn::Add(sum32_left, hn::Mul(diff_lo_hi, diff_lo_hi));
+      sum32_right = hn::Add(sum32_right, hn::Mul(diff_hi_lo, diff_hi_lo));
+      sum32_right = hn::Add(sum32_right, hn::Mul(diff_hi_hi, diff_hi_hi));
+
+      current += stride;
+      reference += stride;
+    }
+
+    sum[2 * band] = SumOf16(d16, sum16_left);
+    sum[2 * band + 1] = SumOf16(d16, sum16_right);
+    sum2[2 * band] = static_cast<int>(hn::ReduceSum(d32, sum32_left));
+    sum2[2 * band + 1] = static_cast<int>(hn::ReduceSum(d32, sum32_right));
+  }
+
+#ifdef AC_ENERGY
+  return SplitAC(sum, sum2, block_height, split);
+#else
+  for (int q = 0; q < 4; q++) {
+    split[q] = sum2[q];
+  }
+  return sum2[0] + sum2[1] + sum2[2] + sum2[3];
+#endif
+}
+
 // MSE - 8 byte width
 int fast_calc_mse8_highway(FAST_MSE_FORMAL_ARGS) {
   UNUSED(block_width);
@@ -346,9 +756,9 @@ int fast_calc_mse8_highway(FAST_MSE_FORMAL_ARGS) {
   int sum2 = static_cast<int>(hn::ReduceSum(d32, sum32));
 
 #ifdef AC_ENERGY
-  int sum = static_cast<int>(hn::ReduceSum(d16, sum16));
+  int sum = SumOf16(d16, sum16);
   int temp = block_height << 3;
-  sum2 -= (sum * sum + (temp >> 1)) / temp;
+  sum2 -= DCEnergy(sum, temp);
 #endif
 
   return sum2;
@@ -402,14 +812,34 @@ int fast_calc_mse4_highway(FAST_MSE_FORMAL_ARGS) {
   int sum2 = static_cast<int>(hn::ReduceSum(d32, sum32));
 
 #ifdef AC_ENERGY
-  int sum = static_cast<int>(hn::ReduceSum(d16, sum16));
+  int sum = SumOf16(d16, sum16);
   int temp = block_height << 2;
-  sum2 -= (sum * sum + (temp >> 1)) / temp;
+  sum2 -= DCEnergy(sum, temp);
 #endif
 
   return sum2;
 }
 
+// Weighted interpolation of two references promoted to 16 bit lanes,
+// (ref1 * td_y + ref2 * td_x + 16384) >> 15. The weights add up to 32768, so
+// the products are computed in 32 bit lanes and the result narrowed back.
+template <class D16>
+HWY_INLINE hn::Vec<D16> Interpolate(D16 d16, hn::Vec<D16> ref1,
+                                    hn::Vec<D16> ref2, int td_y, int td_x) {
+  const hn::RepartitionToWide<D16> d32;
+  const auto td_y_vec = hn::Set(d32, td_y);
+  const auto td_x_vec = hn::Set(d32, td_x);
+  const auto offset = hn::Set(d32, 16384);
+
+  auto lo = hn::Add(hn::Mul(hn::PromoteLowerTo(d32, ref1), td_y_vec),
+                    hn::Mul(hn::PromoteLowerTo(d32, ref2), td_x_vec));
+  auto hi = hn::Add(hn::Mul(hn::PromoteUpperTo(d32, ref1), td_y_vec),
+                    hn::Mul(hn::PromoteUpperTo(d32, ref2), td_x_vec));
+  lo = hn::ShiftRight<15>(hn::Add(lo, offset));
+  hi = hn::ShiftRight<15>(hn::Add(hi, offset));
+  return hn::OrderedDemote2To(d16, lo, hi);
+}
+
 // Bidirectional MSE - 16 byte width
 int fast_bidir_mse16_highway(FAST_BIDIR_MSE_FORMAL_ARGS) {
   UNUSED(block_width);
@@ -424,8 +854,8 @@ int fast_bidir_mse16_highway(FAST_BIDIR_MSE_FORMAL_ARGS) {
 #endif
 
   // Temporal distance weights
-  const int16_t td_y = td->y;
-  const int16_t td_x = td->x;
+  const int td_y = td->y;
+  const int td_x = td->x;
 
   for (int i = block_height; i > 0; i--) {
     auto ref1 = hn::LoadU(d, reference1);
@@ -438,20 +868,8 @@ int fast_bidir_mse16_highway(FAST_BIDIR_MSE_FORMAL_ARGS) {
     auto ref2_hi = hn::PromoteUpperTo(d16, ref2);
 
     // Weighted interpolation: (ref1 * td_y + ref2 * td_x + 16384) >> 15
-    auto td_y_vec = hn::Set(d16, td_y);
-    auto td_x_vec = hn::Set(d16, td_x);
-
-    auto interp_lo =
-        hn::Add(hn::Mul(ref1_lo, td_y_vec), hn::Mul(ref2_lo, td_x_vec));
-    auto interp_hi =
-        hn::Add(hn::Mul(ref1_hi, td_y_vec), hn::Mul(ref2_hi, td_x_vec));
-
-    // Add 16384 and shift right by 15
-    auto offset = hn::Set(d16, 16384);
-    interp_lo = hn::Add(interp_lo, offset);
-    interp_hi = hn::Add(interp_hi, offset);
-    interp_lo = hn::ShiftRight<15>(interp_lo);
-    interp_hi = hn::ShiftRight<15>(interp_hi);
+    auto interp_lo = Interpolate(d16, ref1_lo, ref2_lo, td_y, td_x);
+    auto interp_hi = Interpolate(d16, ref1_hi, ref2_hi, td_y, td_x);
 
     // Load current and compute difference
     auto curr = hn::LoadU(d, current);
@@ -485,9 +903,9 @@ int fast_bidir_mse16_highway(FAST_BIDIR_MSE_FORMAL_ARGS) {
   int sum2 = static_cast<int>(hn::ReduceSum(d32, sum32));
 
 #ifdef AC_ENERGY
-  int sum = static_cast<int>(hn::ReduceSum(d16, sum16));
+  int sum = SumOf16(d16, sum16);
   int temp = block_height << 4;
-  sum2 -= (sum * sum + (temp >> 1)) / temp;
+  sum2 -= DCEnergy(sum, temp);
 #endif
 
   return sum2;
@@ -506,8 +924,8 @@ int fast_bidir_mse8_highway(FAST_BIDIR_MSE_FORMAL_ARGS) {
   auto sum16 = hn::Zero(d16);
 #endif
 
-  const int16_t td_y = td->y;
-  const int16_t td_x = td->x;
+  const int td_y = td->y;
+  const int td_x = td->x;
 
   for (int i = block_height; i > 0; i--) {
     auto ref1 = hn::LoadU(d, reference1);
@@ -519,19 +937,8 @@ int fast_bidir_mse8_highway(FAST_BIDIR_MSE_FORMAL_ARGS) {
     auto ref2_lo = hn::PromoteLowerTo(d16, ref2);
     auto ref2_hi = hn::PromoteUpperTo(d16, ref2);
 
-    auto td_y_vec = hn::Set(d16, td_y);
-    auto td_x_vec = hn::Set(d16, td_x);
-
-    auto interp_lo =
-        hn::Add(hn::Mul(ref1_lo, td_y_vec), hn::Mul(ref2_lo, td_x_vec));
-    auto interp_hi =
-        hn::Add(hn::Mul(ref1_hi, td_y_vec), hn::Mul(ref2_hi, td_x_vec));
-
-    auto offset = hn::Set(d16, 16384);
-    interp_lo = hn::Add(interp_lo, offset);
-    interp_hi = hn::Add(interp_hi, offset);
-    interp_lo = hn::ShiftRight<15>(interp_lo);
-    interp_hi = hn::ShiftRight<15>(interp_hi);
+    auto interp_lo = Interpolate(d16, ref1_lo, ref2_lo, td_y, td_x);
+    auto interp_hi = Interpolate(d16, ref1_hi, ref2_hi, td_y, td_x);
 
     auto curr = hn::LoadU(d, current);
     auto curr_lo = hn::PromoteLowerTo(d16, curr);
@@ -563,9 +970,9 @@ int fast_bidir_mse8_highway(FAST_BIDIR_MSE_FORMAL_ARGS) {
   int sum2 = static_cast<int>(hn::ReduceSum(d32, sum32));
 
 #ifdef AC_ENERGY
-  int sum = static_cast<int>(hn::ReduceSum(d16, sum16));
+  int sum = SumOf16(d16, sum16);
   int temp = block_height << 3;
-  sum2 -= (sum * sum + (temp >> 1)) / temp;
+  sum2 -= DCEnergy(sum, temp);
 #endif
 
   return sum2;
@@ -584,8 +991,8 @@ int fast_bidir_mse4_highway(FAST_BIDIR_MSE_FORMAL_ARGS) {
   auto sum16 = hn::Zero(d16);
 #endif
 
-  const int16_t td_y = td->y;
-  const int16_t td_x = td->x;
+  const int td_y = td->y;
+  const int td_x = td->x;
 
   for (int i = block_height; i > 0; i--) {
     auto ref1 = hn::LoadU(d, reference1);
@@ -597,19 +1004,8 @@ int fast_bidir_mse4_highway(FAST_BIDIR_MSE_FORMAL_ARGS) {
     auto ref2_lo = hn::PromoteLowerTo(d16, ref2);
     auto ref2_hi = hn::PromoteUpperTo(d16, ref2);
 
-    auto td_y_vec = hn::Set(d16, td_y);
-    auto td_x_vec = hn::Set(d16, td_x);
-
-    auto interp_lo =
-        hn::Add(hn::Mul(ref1_lo, td_y_vec), hn::Mul(ref2_lo, td_x_vec));
-    auto interp_hi =
-        hn::Add(hn::Mul(ref1_hi, td_y_vec), hn::Mul(ref2_hi, td_x_vec));
-
-    auto offset = hn::Set(d16, 16384);
-    interp_lo = hn::Add(interp_lo, offset);
-    interp_hi = hn::Add(interp_hi, offset);
-    interp_lo = hn::ShiftRight<15>(interp_lo);
-    interp_hi = hn::ShiftRight<15>(interp_hi);
+    auto interp_lo = Interpolate(d16, ref1_lo, ref2_lo, td_y, td_x);
+    auto interp_hi = Interpolate(d16, ref1_hi, ref2_hi, td_y, td_x);
 
     auto curr = hn::LoadU(d, current);
     auto curr_lo = hn::PromoteLowerTo(d16, curr);
@@ -641,14 +1037,45 @@ int fast_bidir_mse4_highway(FAST_BIDIR_MSE_FORMAL_ARGS) {
   int sum2 = static_cast<int>(hn::ReduceSum(d32, sum32));
 
 #ifdef AC_ENERGY
-  int sum = static_cast<int>(hn::ReduceSum(d16, sum16));
+  int sum = SumOf16(d16, sum16);
   int temp = block_height << 2;
-  sum2 -= (sum * sum + (temp >> 1)) / temp;
+  sum2 -= DCEnergy(sum, temp);
 #endif
 
   return sum2;
 }
 
+// 2x2 box filter decimation. The pixel pairs of each row are summed in
+// 16-bit lanes, which gives the same rounded average as the C version.
+void decimate2x2_highway(DECIMATE_FORMAL_ARGS) {
+  const hn::ScalableTag<uint8_t> d8;
+  const hn::Repartition<uint16_t, decltype(d8)> d16;
+  const hn::Rebind<uint8_t, decltype(d16)> d8h;
+  const int N = (int)hn::Lanes(d16);
+  const auto low = hn::Set(d16, 0x00FF);
+  const auto two = hn::Set(d16, 2);
+
+  for (int i = 0; i < height; i++) {
+    const uint8_t *row0 = src + 2 * i * src_stride;
+    const uint8_t *row1 = row0 + src_stride;
+    int j = 0;
+    for (; j + N <= width; j += N) {
+      const auto v0 = hn::BitCast(d16, hn::LoadU(d8, row0 + 2 * j));
+      const auto v1 = hn::BitCast(d16, hn::LoadU(d8, row1 + 2 * j));
+      auto sum = hn::Add(hn::And(v0, low), hn::ShiftRight<8>(v0));
+      sum = hn::Add(sum, hn::Add(hn::And(v1, low), hn::ShiftRight<8>(v1)));
+      const auto avg = hn::ShiftRight<2>(hn::Add(sum, two));
+      hn::StoreU(hn::DemoteTo(d8h, avg), d8h, dst + j);
+    }
+    for (; j < width; j++) {
+      dst[j] = (uint8_t)((row0[2 * j] + row0[2 * j + 1] + row1[2 * j] +
+                          row1[2 * j + 1] + 2) >>
+                         2);
+    }
+    dst += dst_stride;
+  }
+}
+
 } // namespace HWY_NAMESPACE
 } // namespace motion_search
 HWY_AFTER_NAMESPACE();
@@ -660,15 +1087,28 @@ namespace motion_search {
 HWY_EXPORT(fastSAD16_highway);
 HWY_EXPORT(fastSAD8_highway);
 HWY_EXPORT(fastSAD4_highway);
+HWY_EXPORT(fastSAD16_early_highway);
+HWY_EXPORT(fastSAD8_early_highway);
+HWY_EXPORT(fastSAD4_early_highway);
+HWY_EXPORT(fastSAD16_xN_highway);
+HWY_EXPORT(fastSAD8_xN_highway);
+HWY_EXPORT(fastSAD4_xN_highway);
+HWY_EXPORT(fastSAD32_span_highway);
+HWY_EXPORT(fastSAD16_span_highway);
+HWY_EXPORT(fastSAD8_span_highway);
+HWY_EXPORT(fastSAD4_span_highway);
 HWY_EXPORT(fast_variance16_highway);
 HWY_EXPORT(fast_variance8_highway);
 HWY_EXPORT(fast_variance4_highway);
+HWY_EXPORT(fast_variance16_split_highway);
 HWY_EXPORT(fast_calc_mse16_highway);
 HWY_EXPORT(fast_calc_mse8_highway);
 HWY_EXPORT(fast_calc_mse4_highway);
+HWY_EXPORT(fast_calc_mse16_split_highway);
 HWY_EXPORT(fast_bidir_mse16_highway);
 HWY_EXPORT(fast_bidir_mse8_highway);
 HWY_EXPORT(fast_bidir_mse4_highway);
+HWY_EXPORT(decimate2x2_highway);
 
 // C-compatible wrapper functions
 extern "C" {
@@ -685,6 +1125,46 @@ int fastSAD4_hwy(FAST_SAD_FORMAL_ARGS) {
   return HWY_DYNAMIC_DISPATCH(fastSAD4_highway)(FAST_SAD_ACTUAL_ARGS);
 }
 
+int fastSAD16_early_hwy(FAST_SAD_FORMAL_ARGS) {
+  return HWY_DYNAMIC_DISPATCH(fastSAD16_early_highway)(FAST_SAD_ACTUAL_ARGS);
+}
+
+int fastSAD8_early_hwy(FAST_SAD_FORMAL_ARGS) {
+  return HWY_DYNAMIC_DISPATCH(fastSAD8_early_highway)(FAST_SAD_ACTUAL_ARGS);
+}
+
+int fastSAD4_early_hwy(FAST_SAD_FORMAL_ARGS) {
+  return HWY_DYNAMIC_DISPATCH(fastSAD4_early_highway)(FAST_SAD_ACTUAL_ARGS);
+}
+
+void fastSAD16_xN_hwy(FAST_SAD_XN_FORMAL_ARGS) {
+  HWY_DYNAMIC_DISPATCH(fastSAD16_xN_highway)(FAST_SAD_XN_ACTUAL_ARGS);
+}
+
+void fastSAD8_xN_hwy(FAST_SAD_XN_FORMAL_ARGS) {
+  HWY_DYNAMIC_DISPATCH(fastSAD8_xN_highway)(FAST_SAD_XN_ACTUAL_ARGS);
+}
+
+void fastSAD4_xN_hwy(FAST_SAD_XN_FORMAL_ARGS) {
+  HWY_DYNAMIC_DISPATCH(fastSAD4_xN_highway)(FAST_SAD_XN_ACTUAL_ARGS);
+}
+
+void fastSAD32_span_hwy(FAST_SAD_SPAN_FORMAL_ARGS) {
+  HWY_DYNAMIC_DISPATCH(fastSAD32_span_highway)(FAST_SAD_SPAN_ACTUAL_ARGS);
+}
+
+void fastSAD16_span_hwy(FAST_SAD_SPAN_FORMAL_ARGS) {
+  HWY_DYNAMIC_DISPATCH(fastSAD16_span_highway)(FAST_SAD_SPAN_ACTUAL_ARGS);
+}
+
+void fastSAD8_span_hwy(FAST_SAD_SPAN_FORMAL_ARGS) {
+  HWY_DYNAMIC_DISPATCH(fastSAD8_span_highway)(FAST_SAD_SPAN_ACTUAL_ARGS);
+}
+
+void fastSAD4_span_hwy(FAST_SAD_SPAN_FORMAL_ARGS) {
+  HWY_DYNAMIC_DISPATCH(fastSAD4_span_highway)(FAST_SAD_SPAN_ACTUAL_ARGS);
+}
+
 int fast_variance16_hwy(FAST_VARIANCE_FORMAL_ARGS) {
   return HWY_DYNAMIC_DISPATCH(fast_variance16_highway)(
       FAST_VARIANCE_ACTUAL_ARGS);
@@ -700,6 +1180,11 @@ int fast_variance4_hwy(FAST_VARIANCE_FORMAL_ARGS) {
       FAST_VARIANCE_ACTUAL_ARGS);
 }
 
+int fast_variance16_split_hwy(FAST_VARIANCE_SPLIT_FORMAL_ARGS) {
+  return HWY_DYNAMIC_DISPATCH(fast_variance16_split_highway)(
+      FAST_VARIANCE_SPLIT_ACTUAL_ARGS);
+}
+
 int fast_calc_mse16_hwy(FAST_MSE_FORMAL_ARGS) {
   return HWY_DYNAMIC_DISPATCH(fast_calc_mse16_highway)(FAST_MSE_ACTUAL_ARGS);
 }
@@ -712,6 +1197,11 @@ int fast_calc_mse4_hwy(FAST_MSE_FORMAL_ARGS) {
   return HWY_DYNAMIC_DISPATCH(fast_calc_mse4_highway)(FAST_MSE_ACTUAL_ARGS);
 }
 
+int fast_calc_mse16_split_hwy(FAST_MSE_SPLIT_FORMAL_ARGS) {
+  return HWY_DYNAMIC_DISPATCH(fast_calc_mse16_split_highway)(
+      FAST_MSE_SPLIT_ACTUAL_ARGS);
+}
+
 int fast_bidir_mse16_hwy(FAST_BIDIR_MSE_FORMAL_ARGS) {
   return HWY_DYNAMIC_DISPATCH(fast_bidir_mse16_highway)(
       FAST_BIDIR_MSE_ACTUAL_ARGS);
@@ -727,6 +1217,10 @@ int fast_bidir_mse4_hwy(FAST_BIDIR_MSE_FORMAL_ARGS) {
       FAST_BIDIR_MSE_ACTUAL_ARGS);
 }
 
+void decimate2x2_hwy(DECIMATE_FORMAL_ARGS) {
+  HWY_DYNAMIC_DISPATCH(decimate2x2_highway)(DECIMATE_ACTUAL_ARGS);
+}
+
 } // extern "C"
 
 } // namespace motion_search
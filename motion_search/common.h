@@ -36,13 +36,9 @@ extern "C" {
 #define HOR_PADDING_UV (HORIZONTAL_PADDING / 2)
 #define VER_PADDING_UV (VERTICAL_PADDING / 2)
 
-// Currently, MB_WIDTH can take values 8 or 16
+// Default size of the square macroblocks; the searches take 8, 16, 32 or 64
+// at run time (see motion_search.h)
 #define MB_WIDTH 16
-// #define MB_WIDTH 8
-
-// SEARCH_MV switches between PMVFAST and full_search
-#define SEARCH_MV PMVFAST
-// #define SEARCH_MV full_search
 
 // There are 2 strategies for "median" predictor in PMVFAST, mean or median
 #define USE_MEAN
@@ -68,6 +64,12 @@ extern "C" {
 // We are weighting 16x16 MSE by -12.5%, since 8x8 will require more bits
 #define NORMALIZE(x) ((x * 7 + 4) >> 3)
 
+// Partition pruning leaves out the 8x8 searches of a macroblock when its 16x16
+// MSE is below PRUNE_MSE per pixel, or when its quadrant MSEs differ by less
+// than 1/PRUNE_SPREAD of the 16x16 MSE
+#define PRUNE_MSE 2
+#define PRUNE_SPREAD 32
+
 typedef struct MV {
   // y component first, since it corresponds to row
   // x component second - column
@@ -80,6 +82,35 @@ typedef struct DIM {
   int32_t height;
 } DIM;
 
+// Half (level 0) and quarter (level 1) resolution luma of a picture, each
+// level the 2x2 box filtered previous one, without padding
+#define PYRAMID_LEVELS 2
+
+typedef struct pyramid_t {
+  const unsigned char *planes[PYRAMID_LEVELS];
+  int strides[PYRAMID_LEVELS];
+  DIM dims[PYRAMID_LEVELS];
+} pyramid_t;
+
+// Strategies of motion_search_rows() and bidir_motion_search_rows()
+typedef enum {
+  ME_PMVFAST,    // Predictive motion vector field adaptive search
+  ME_EPZS,       // Enhanced predictive zonal search, square refinement
+  ME_HEXAGON,    // Large hexagon from the best predictor, small diamond
+  ME_EXHAUSTIVE, // Every vector within the padding around (0, 0)
+  NUM_ME_METHODS
+} me_method_t;
+
+// Name of a strategy on the command line and in the output
+const char *me_method_name(int method);
+
+// Strategy of a name, or -1 if there is none
+int me_method_from_name(const char *name);
+
+// Vectors searched around (0, 0) by ME_EXHAUSTIVE, as far as the padding
+#define EXHAUSTIVE_RANGE_X HORIZONTAL_PADDING
+#define EXHAUSTIVE_RANGE_Y VERTICAL_PADDING
+
 #ifdef __cplusplus
 } // extern "C" {
 
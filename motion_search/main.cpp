@@ -8,18 +8,25 @@
 
 #include "ComplexityAnalyzer.h"
 #include "DataConverter.h"
+#include "GOPParallelAnalyzer.h"
+#include "MacroblockWriter.h"
 #include "OutputWriter.h"
+#include "ScaledSequenceReader.h"
 #include "Y4MSequenceReader.h"
 #include "YUVSequenceReader.h"
 #ifdef HAVE_FFMPEG
 #include "FFmpegSequenceReader.h"
 #endif
+#ifdef HAVE_MMAP
+#include "MappedSequenceReader.h"
+#endif
 
 #include <algorithm>
 #include <chrono>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <stdexcept>
 
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
@@ -43,6 +50,43 @@ ABSL_FLAG(
     int32_t, gop_size, 150,
     "GOP (Group of Pictures) size for encoding simulation (default: 150)");
 ABSL_FLAG(int32_t, bframes, 0, "Number of consecutive B-frames (default: 0)");
+ABSL_FLAG(bool, pipeline, false,
+          "Read frames on a separate thread and search the B-frames of a "
+          "sub-GOP in parallel (default: false)");
+ABSL_FLAG(int32_t, threads, 1,
+          "Number of GOPs analyzed in parallel, for .yuv and .y4m inputs "
+          "(default: 1)");
+ABSL_FLAG(int32_t, row_threads, 1,
+          "Number of threads searching the macroblock rows of a frame in "
+          "wavefront order (default: 1)");
+ABSL_FLAG(std::string, scale, "1",
+          "Analyze the frames decimated to 1/2 or 1/4 of the width and "
+          "height, for approximate results (default: 1)");
+ABSL_FLAG(int32_t, sample_every, 0,
+          "Analyze every Nth GOP only, and extrapolate the totals from them "
+          "(default: 0, every GOP)");
+ABSL_FLAG(int32_t, sample_gops, 0,
+          "Analyze this many GOPs spread evenly over the input, and "
+          "extrapolate the totals from them (default: 0, every GOP)");
+ABSL_FLAG(bool, pyramid, false,
+          "Seed the search of every macroblock with a vector found on a "
+          "1/4 and 1/16 luma pyramid, for fast motion (default: false)");
+ABSL_FLAG(int32_t, skip_threshold, 0,
+          "Code the P-frame macroblocks whose SAD along the zero or the "
+          "predicted vector is below this per pixel without searching them "
+          "(default: 0, off)");
+ABSL_FLAG(bool, prune_partitions, false,
+          "Leave out the 8x8 searches of the macroblocks whose 16x16 error "
+          "is low or even across their quadrants (default: false)");
+ABSL_FLAG(std::string, me, "pmvfast",
+          "Motion search strategy of the P- and B-frames: pmvfast, epzs, "
+          "hexagon, exhaustive (default: pmvfast)");
+ABSL_FLAG(int32_t, block_size, MB_WIDTH,
+          "Width and height of the macroblocks of the search: 8, 16, 32 or "
+          "64 (default: 16)");
+ABSL_FLAG(bool, perf_counters, false,
+          "Count cycles, instructions, LLC and dTLB misses around the "
+          "processing of each frame type (default: false)");
 
 // Output options
 ABSL_FLAG(std::string, output, "",
@@ -52,10 +96,15 @@ ABSL_FLAG(std::string, format, "csv",
 ABSL_FLAG(std::string, detail, "frame",
           "Detail level: frame (per-frame data), gop (per-GOP data, default: "
           "frame)");
+ABSL_FLAG(std::string, mb_output, "",
+          "Binary file receiving the per-macroblock results (default: none)");
 
 // Input format options (Phase 3)
 ABSL_FLAG(bool, use_ffmpeg, false,
           "Use FFmpeg for input decoding (supports MP4, MKV, AVI, WebM, etc.)");
+ABSL_FLAG(bool, mmap, false,
+          "Read .yuv and .y4m inputs through a memory mapping, on POSIX "
+          "systems (default: false)");
 
 // Legacy support flags (mapped from old parser)
 ABSL_FLAG(int32_t, W, 0, "Legacy: same as --width");
@@ -69,16 +118,86 @@ namespace {
 struct CTX {
   std::string inputFile;
   std::string outputFile;
+  std::string mbOutputFile;
   int width = 0;
   int height = 0;
   int num_frames = 0;
   int gop_size = 150;
   int b_frames = 0;
+  bool pipeline = false;
+  int threads = 1;
+  int row_threads = 1;
+  int scale = 1;
+  gop_sampling_t sampling = {0, 0};
+  bool pyramid = false;
+  int skip_threshold = 0;
+  bool prune_partitions = false;
+  me_method_t method = ME_PMVFAST;
+  int block_size = MB_WIDTH;
+  bool perf_counters = false;
   bool use_ffmpeg = false;
+  bool use_mmap = false;
 };
 
+// Events per frame type, normalized by the instructions and macroblocks
+void printCounts(const frame_counts_t &counts) {
+  if (!counts.available[PERF_CYCLES] || !counts.available[PERF_INSTRUCTIONS]) {
+    std::cerr << "Hardware counters unavailable\n";
+    return;
+  }
+
+  static const char types[NUM_FRAME_TYPES] = {'I', 'P', 'B'};
+  std::cerr << "  type    frames       IPC  LLC misses/MB  dTLB misses/MB\n";
+  for (int t = 0; t < NUM_FRAME_TYPES; t++) {
+    if (!counts.frames[t]) {
+      continue;
+    }
+    const uint64_t *events = counts.events[t];
+    const double mbs = (double)counts.macroblocks[t];
+    // Nothing is counted when the PMU never ran the counters
+    const bool counted = events[PERF_CYCLES] != 0;
+    std::cerr << "  " << std::left << std::setw(4) << types[t] << std::right
+              << std::setw(10) << counts.frames[t] << std::setw(10);
+    if (counted) {
+      std::cerr << (double)events[PERF_INSTRUCTIONS] / events[PERF_CYCLES];
+    } else {
+      std::cerr << "n/a";
+    }
+    for (int e : {PERF_LLC_MISSES, PERF_DTLB_MISSES}) {
+      std::cerr << std::setw(e == PERF_LLC_MISSES ? 15 : 16);
+      if (counted && counts.available[e]) {
+        std::cerr << (double)events[e] / mbs;
+      } else {
+        std::cerr << "n/a";
+      }
+    }
+    std::cerr << "\n";
+  }
+}
+
+// Totals extrapolated from the sampled GOPs, with their 95% bounds
+void printEstimate(const motion_search::SamplingEstimate &estimate) {
+  std::cerr << "Sampled GOPs: " << estimate.sampled_gops << " of "
+            << estimate.sampled_gops + estimate.estimated_gops << " ("
+            << estimate.sampled_frames << " of " << estimate.total_frames
+            << " frames)\n";
+  std::cerr << std::fixed << std::setprecision(0);
+  std::cerr << "  estimated bits:  " << estimate.total_bits;
+  if (estimate.has_bounds) {
+    std::cerr << " [" << estimate.bits_low << ", " << estimate.bits_high
+              << "]";
+  }
+  std::cerr << "\n  estimated error: " << estimate.total_error;
+  if (estimate.has_bounds) {
+    std::cerr << " [" << estimate.error_low << ", " << estimate.error_high
+              << "]";
+  }
+  std::cerr << "\n" << std::setprecision(2);
+}
+
 std::unique_ptr<IVideoSequenceReader>
-getReader(const std::string &filename, const DIM dim, bool use_ffmpeg) {
+getReader(const std::string &filename, const DIM dim, bool use_ffmpeg,
+          bool use_mmap) {
   std::unique_ptr<IVideoSequenceReader> reader;
 
   // If FFmpeg is explicitly requested, use it
@@ -113,6 +232,23 @@ getReader(const std::string &filename, const DIM dim, bool use_ffmpeg) {
         return nullptr;
       }
 
+#ifdef HAVE_MMAP
+      if (use_mmap) {
+        std::unique_ptr<MappedSequenceReader> p(new MappedSequenceReader());
+        if (ext.compare(".yuv") == 0) {
+          p->Open(std::move(file), filename, dim);
+        } else {
+          p->Open(std::move(file), filename);
+        }
+        if (!p->isOpen()) {
+          return nullptr;
+        }
+        return p;
+      }
+#else
+      UNUSED(use_mmap);
+#endif
+
       if (ext.compare(".yuv") == 0) {
         std::unique_ptr<YUVSequenceReader> p(new YUVSequenceReader());
         if (p) {
@@ -256,6 +392,71 @@ void ParseAndValidateFlags(CTX &ctx,
     exit(1);
   }
 
+  ctx.pipeline = absl::GetFlag(FLAGS_pipeline);
+
+  // Validate thread count
+  ctx.threads = absl::GetFlag(FLAGS_threads);
+  if (ctx.threads < 1) {
+    std::cerr << "Error: Invalid number of threads specified (must be >= 1)\n";
+    exit(1);
+  }
+
+  ctx.row_threads = absl::GetFlag(FLAGS_row_threads);
+  if (ctx.row_threads < 1) {
+    std::cerr << "Error: Invalid number of row threads specified (must be >= "
+                 "1)\n";
+    exit(1);
+  }
+
+  const std::string scale = absl::GetFlag(FLAGS_scale);
+  if (scale == "1") {
+    ctx.scale = 1;
+  } else if (scale == "1/2") {
+    ctx.scale = 2;
+  } else if (scale == "1/4") {
+    ctx.scale = 4;
+  } else {
+    std::cerr << "Error: Invalid scale '" << scale << "'\n";
+    std::cerr << "Supported scales: 1, 1/2, 1/4\n";
+    exit(1);
+  }
+
+  ctx.sampling.interval = absl::GetFlag(FLAGS_sample_every);
+  ctx.sampling.budget = absl::GetFlag(FLAGS_sample_gops);
+  if (ctx.sampling.interval < 0 || ctx.sampling.budget < 0) {
+    std::cerr << "Error: Invalid GOP sampling (must be >= 0)\n";
+    exit(1);
+  }
+  if (ctx.sampling.interval > 0 && ctx.sampling.budget > 0) {
+    std::cerr << "Error: --sample_every and --sample_gops are exclusive\n";
+    exit(1);
+  }
+
+  ctx.pyramid = absl::GetFlag(FLAGS_pyramid);
+
+  ctx.skip_threshold = absl::GetFlag(FLAGS_skip_threshold);
+  if (ctx.skip_threshold < 0) {
+    std::cerr << "Error: Invalid skip threshold (must be >= 0)\n";
+    exit(1);
+  }
+  ctx.prune_partitions = absl::GetFlag(FLAGS_prune_partitions);
+
+  const std::string me = absl::GetFlag(FLAGS_me);
+  const int method = me_method_from_name(me.c_str());
+  if (method < 0) {
+    std::cerr << "Error: Invalid motion search strategy '" << me << "'\n";
+    std::cerr << "Supported strategies:";
+    for (int i = 0; i < NUM_ME_METHODS; i++) {
+      std::cerr << ' ' << me_method_name(i);
+    }
+    std::cerr << "\n";
+    exit(1);
+  }
+  ctx.method = (me_method_t)method;
+
+  ctx.block_size = absl::GetFlag(FLAGS_block_size);
+  ctx.perf_counters = absl::GetFlag(FLAGS_perf_counters);
+
   // Validate format
   std::string format = absl::GetFlag(FLAGS_format);
   if (format != "csv" && format != "json" && format != "xml") {
@@ -272,8 +473,11 @@ void ParseAndValidateFlags(CTX &ctx,
     exit(1);
   }
 
+  ctx.mbOutputFile = absl::GetFlag(FLAGS_mb_output);
+
   // Handle FFmpeg flag
   ctx.use_ffmpeg = absl::GetFlag(FLAGS_use_ffmpeg);
+  ctx.use_mmap = absl::GetFlag(FLAGS_mmap);
 
 #ifndef HAVE_FFMPEG
   if (ctx.use_ffmpeg) {
@@ -284,6 +488,13 @@ void ParseAndValidateFlags(CTX &ctx,
     exit(1);
   }
 #endif
+
+#ifndef HAVE_MMAP
+  if (ctx.use_mmap) {
+    std::cerr << "Error: --mmap is only supported on POSIX systems\n";
+    exit(1);
+  }
+#endif
 }
 
 } // namespace
@@ -330,8 +541,33 @@ int main(int argc, char *argv[]) {
       "  --frames=<n>     Number of frames to process (0 = all, default: 0)\n"
       "  --gop_size=<n>   GOP size for simulation (default: 150)\n"
       "  --bframes=<n>    Number of consecutive B-frames (default: 0)\n"
+      "  --pipeline       Overlap frame reading with the search and search "
+      "B-frames in parallel\n"
+      "  --threads=<n>    Number of GOPs analyzed in parallel (default: 1)\n"
+      "  --row_threads=<n> Number of threads searching the macroblock rows of "
+      "a frame (default: 1)\n"
+      "  --scale=<s>      Analyze the frames decimated to 1, 1/2 or 1/4 of "
+      "their size (default: 1)\n"
+      "  --sample_every=<n> Analyze every nth GOP and estimate the others\n"
+      "  --sample_gops=<n> Analyze n GOPs spread over the input and estimate "
+      "the others\n"
+      "  --pyramid        Seed the search with a coarse-to-fine pyramid "
+      "search\n"
+      "  --skip_threshold=<n> Code P-frame macroblocks below n SAD per pixel "
+      "without searching them\n"
+      "  --prune_partitions Skip the 8x8 searches unlikely to pay off\n"
+      "  --me=<method>    Motion search strategy: pmvfast, epzs, hexagon, "
+      "exhaustive (default: pmvfast)\n"
+      "  --block_size=<n> Macroblock size of the search: 8, 16, 32, 64 "
+      "(default: 16)\n"
+      "  --perf_counters  Report IPC and cache and TLB misses per macroblock "
+      "for each frame type\n"
       "  --format=<fmt>   Output format: csv, json, xml (default: csv)\n"
-      "  --detail=<lvl>   Detail level: frame, gop (default: frame)\n";
+      "  --detail=<lvl>   Detail level: frame, gop (default: frame)\n"
+      "  --mb_output=<file> Write the per-macroblock results to a binary "
+      "file\n"
+      "  --mmap           Read .yuv and .y4m inputs through a memory "
+      "mapping (POSIX only)\n";
 #ifdef HAVE_FFMPEG
   usage_message +=
       "  --use_ffmpeg     Use FFmpeg for input (supports MP4, MKV, AVI, WebM, "
@@ -359,8 +595,8 @@ int main(int argc, char *argv[]) {
   CTX ctx;
   ParseAndValidateFlags(ctx, positional_args);
 
-  auto reader =
-      getReader(ctx.inputFile, {ctx.width, ctx.height}, ctx.use_ffmpeg);
+  auto reader = getReader(ctx.inputFile, {ctx.width, ctx.height},
+                          ctx.use_ffmpeg, ctx.use_mmap);
   if (reader == nullptr) {
     std::cerr << "Error: Unsupported input format for " << ctx.inputFile
               << "\n";
@@ -377,19 +613,34 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
-  ComplexityAnalyzer analyzer(reader.get(), ctx.gop_size, ctx.num_frames,
-                              ctx.b_frames);
-
-  const auto begin = std::chrono::high_resolution_clock::now();
-  analyzer.analyze();
-  const auto end = std::chrono::high_resolution_clock::now();
+  // GOPs are closed, so seekable inputs can be split into GOP ranges
+  YUVSequenceReader *seekable = dynamic_cast<YUVSequenceReader *>(reader.get());
+  if (ctx.threads > 1 && seekable == nullptr) {
+    std::cerr << "Warning: --threads requires a .yuv or .y4m input, analyzing "
+                 "with one thread\n";
+  }
 
-  std::cerr << "Input file: '" << ctx.inputFile << "'\n";
-  std::cerr << "width: " << reader->dim().width << "\n";
-  std::cerr << "height: " << reader->dim().height << "\n";
+  // The analysis reads the decimated frames, while the output keeps the
+  // dimensions of the input
+  IVideoSequenceReader *input = reader.get();
+  std::unique_ptr<ScaledSequenceReader> scaled;
+  if (ctx.scale > 1) {
+    scaled.reset(new ScaledSequenceReader(reader.get(), ctx.scale));
+    if (scaled->dim().width < ctx.block_size ||
+        scaled->dim().height < ctx.block_size) {
+      std::cerr << "Error: The input is too small for --scale\n";
+      return 1;
+    }
+    input = scaled.get();
+  }
 
-  // Get analysis results
-  vector<complexity_info_t *> info = analyzer.getInfo();
+  // Checked by the analyzers too, but before any output is written
+  try {
+    check_block_size(input->dim(), ctx.block_size, ctx.pyramid);
+  } catch (const std::invalid_argument &e) {
+    std::cerr << "Error: " << e.what() << "\n";
+    return 1;
+  }
 
   // Determine input format from file extension
   std::string input_format;
@@ -401,11 +652,21 @@ int main(int argc, char *argv[]) {
     input_format = "unknown";
   }
 
-  // Convert to new format
-  motion_search::AnalysisResults results =
-      motion_search::DataConverter::convert(
-          info, reader->dim().width, reader->dim().height, ctx.gop_size,
-          ctx.b_frames, input_format, ctx.inputFile);
+  // The frame count is written before the analysis, so use the expected one
+  motion_search::VideoMetadata metadata;
+  metadata.width = reader->dim().width;
+  metadata.height = reader->dim().height;
+  metadata.total_frames = reader->nframes();
+  if (ctx.num_frames > 0 &&
+      (metadata.total_frames <= 0 || ctx.num_frames < metadata.total_frames)) {
+    metadata.total_frames = ctx.num_frames;
+  }
+  metadata.gop_size = ctx.gop_size;
+  metadata.bframes = ctx.b_frames;
+  metadata.input_format = input_format;
+  metadata.input_filename = ctx.inputFile;
+  metadata.analysis_time = std::chrono::system_clock::now();
+  metadata.sampling = ctx.sampling.interval > 1 || ctx.sampling.budget > 0;
 
   // Get output format and detail level
   std::string format = absl::GetFlag(FLAGS_format);
@@ -414,36 +675,147 @@ int main(int argc, char *argv[]) {
       motion_search::stringToDetailLevel(detail);
 
   // Open output stream
-  std::unique_ptr<std::ostream> out_stream;
   std::ofstream file_stream;
-
-  if (ctx.outputFile == "-") {
-    // Use stdout
-    out_stream.reset(&std::cout);
-  } else {
-    // Open file
+  if (ctx.outputFile != "-") {
     file_stream.open(ctx.outputFile);
     if (!file_stream) {
       std::cerr << "Error: Can't open output file " << ctx.outputFile << "\n";
       return 1;
     }
-    out_stream.reset(&file_stream);
   }
 
-  // Create and use output writer
+  // Macroblock records are written at the offset of their frame, so they can
+  // arrive in decode order
+  motion_search::MacroblockWriter mb_writer;
+  mb_callback_t mb_callback;
+  if (!ctx.mbOutputFile.empty()) {
+    if (!mb_writer.open(ctx.mbOutputFile, input->dim().width,
+                        input->dim().height, ctx.gop_size, ctx.b_frames,
+                        ctx.block_size)) {
+      std::cerr << "Error: Can't open macroblock output file "
+                << ctx.mbOutputFile << "\n";
+      return 1;
+    }
+    mb_callback = [&mb_writer](const mb_frame_info_t &info) {
+      mb_writer.writeFrame(info);
+    };
+  }
+
+  // Frames are written as the analysis completes them, in display order
+  const auto begin = std::chrono::high_resolution_clock::now();
+  stage_times_t times;
+  frame_counts_t counts;
+  motion_search::SamplingEstimate estimate;
+  int64_t skipped_MBs = 0;
+  int64_t P_frame_MBs = 0;
   try {
     auto writer = motion_search::createOutputWriter(
         format, detail_level,
         (ctx.outputFile == "-") ? std::cout : file_stream);
-    writer->write(results);
+    motion_search::StreamingConverter output(*writer, metadata);
+    // The bits and error of decimated frames are scaled by the ratio of the
+    // areas, to approximate those of the input
+    const int area = ctx.scale * ctx.scale;
+    auto callback = [&output, area, &skipped_MBs,
+                     &P_frame_MBs](const complexity_info_t &info) {
+      if (info.picType == 'P') {
+        skipped_MBs += info.count_skip;
+        P_frame_MBs += info.count_I + info.count_P;
+      }
+      complexity_info_t frame = info;
+      frame.bits *= area;
+      frame.error *= area;
+      output.addFrame(frame);
+    };
+    auto skip_callback = [&output](int first_frame, int frames) {
+      output.skipGOP(first_frame, frames);
+    };
+
+    output.begin();
+    if (ctx.threads > 1 && seekable != nullptr) {
+      GOPParallelAnalyzer analyzer(seekable, ctx.gop_size, ctx.num_frames,
+                                   ctx.b_frames, ctx.threads, ctx.pipeline,
+                                   ctx.row_threads);
+      analyzer.setScale(ctx.scale);
+      analyzer.setPyramid(ctx.pyramid);
+      analyzer.setSkipThreshold(ctx.skip_threshold);
+      analyzer.setPartitionPruning(ctx.prune_partitions);
+      analyzer.setSearchMethod(ctx.method);
+      analyzer.setBlockSize(ctx.block_size);
+      analyzer.setSampling(ctx.sampling);
+      analyzer.setFrameCallback(callback);
+      analyzer.setSkipCallback(skip_callback);
+      analyzer.setMacroblockCallback(mb_callback);
+      if (ctx.perf_counters) {
+        analyzer.enablePerfCounters();
+      }
+      analyzer.analyze();
+      times = analyzer.getTimes();
+      counts = analyzer.getCounts();
+    } else {
+      ComplexityAnalyzer analyzer(input, ctx.gop_size, ctx.num_frames,
+                                  ctx.b_frames, ctx.pipeline, ctx.row_threads,
+                                  ctx.block_size);
+      analyzer.setPyramid(ctx.pyramid);
+      analyzer.setSkipThreshold(ctx.skip_threshold);
+      analyzer.setPartitionPruning(ctx.prune_partitions);
+      analyzer.setSearchMethod(ctx.method);
+      analyzer.setSampling(ctx.sampling);
+      analyzer.setFrameCallback(callback);
+      analyzer.setSkipCallback(skip_callback);
+      analyzer.setMacroblockCallback(mb_callback);
+      if (ctx.perf_counters) {
+        analyzer.enablePerfCounters();
+      }
+      analyzer.analyze();
+      times = analyzer.getTimes();
+      counts = analyzer.getCounts();
+    }
+    output.end(&times);
+    times.add(output.times());
+    estimate = output.estimate();
+    mb_writer.close();
   } catch (const std::exception &e) {
     std::cerr << "Error writing output: " << e.what() << "\n";
     return 1;
   }
+  const auto end = std::chrono::high_resolution_clock::now();
+
+  std::cerr << "Input file: '" << ctx.inputFile << "'\n";
+  std::cerr << "width: " << reader->dim().width << "\n";
+  std::cerr << "height: " << reader->dim().height << "\n";
+  if (ctx.scale > 1) {
+    std::cerr << "scale: 1/" << ctx.scale << "\n";
+  }
 
   const std::chrono::duration<double, std::milli> duration = end - begin;
   std::cerr << "Execution time: " << std::fixed << std::setprecision(2)
             << duration.count() << " msec\n";
 
+  // Stages run concurrently with --pipeline and the thread options, so
+  // their sum can exceed the execution time
+  for (int i = 0; i < NUM_STAGES; i++) {
+    if (times.calls[i] > 0) {
+      std::cerr << "  " << std::left << std::setw(22) << stage_name(i)
+                << std::right << std::setw(12) << (double)times.ns[i] / 1e6
+                << " msec\n";
+    }
+  }
+
+  if (ctx.skip_threshold > 0) {
+    std::cerr << "Skipped searches: " << skipped_MBs << " of " << P_frame_MBs
+              << " P-frame macroblocks ("
+              << (P_frame_MBs ? 100.0 * skipped_MBs / P_frame_MBs : 0.0)
+              << "%)\n";
+  }
+
+  if (metadata.sampling) {
+    printEstimate(estimate);
+  }
+
+  if (ctx.perf_counters) {
+    printCounts(counts);
+  }
+
   return 0;
 }
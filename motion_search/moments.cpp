@@ -67,6 +67,119 @@ int fastSAD4_c(FAST_SAD_FORMAL_ARGS) {
   return partialSAD(FAST_SAD_ACTUAL_ARGS);
 }
 
+// WxH SADs of several reference positions, each using early termination
+static void partialSAD_xN(FAST_SAD_XN_FORMAL_ARGS) {
+  int diff;
+  int remaining;
+  int i, j, k;
+
+  for (k = 0; k < num_refs; k++) {
+    SADs[k] = 0;
+  }
+
+  remaining = num_refs;
+  for (i = 0; i < block_height && remaining > 0; i++) {
+    remaining = 0;
+    for (k = 0; k < num_refs; k++) {
+      const uint8_t *reference = references[k] + i * stride;
+
+      if (SADs[k] >= min_SAD) {
+        continue;
+      }
+      for (j = 0; j < block_width; j++) {
+        diff = abs(current[j] - reference[j]);
+        SADs[k] += diff;
+      }
+      remaining += SADs[k] < min_SAD;
+    }
+    current += stride;
+  }
+}
+
+void fastSAD64_xN_c(FAST_SAD_XN_FORMAL_ARGS) {
+  partialSAD_xN(FAST_SAD_XN_ACTUAL_ARGS);
+}
+
+void fastSAD32_xN_c(FAST_SAD_XN_FORMAL_ARGS) {
+  partialSAD_xN(FAST_SAD_XN_ACTUAL_ARGS);
+}
+
+void fastSAD16_xN_c(FAST_SAD_XN_FORMAL_ARGS) {
+  partialSAD_xN(FAST_SAD_XN_ACTUAL_ARGS);
+}
+
+void fastSAD8_xN_c(FAST_SAD_XN_FORMAL_ARGS) {
+  partialSAD_xN(FAST_SAD_XN_ACTUAL_ARGS);
+}
+
+void fastSAD4_xN_c(FAST_SAD_XN_FORMAL_ARGS) {
+  partialSAD_xN(FAST_SAD_XN_ACTUAL_ARGS);
+}
+
+// WxH SADs of consecutive horizontal positions. Each pixel of the current
+// block is compared with the run of reference pixels of 16 positions at a
+// time, which compilers keep in vector registers. The last run is moved back
+// to end at the last position, so no pixel past it is read.
+template <int WIDTH> static void spanSAD(FAST_SAD_SPAN_FORMAL_ARGS) {
+  int i, j, k;
+
+  UNUSED(block_width);
+
+  if (num_offsets < 16) {
+    for (k = 0; k < num_offsets; k++) {
+      SADs[k] = 0;
+    }
+    for (i = block_height; i > 0; i--) {
+      for (j = 0; j < WIDTH; j++) {
+        const int pixel = current[j];
+        for (k = 0; k < num_offsets; k++) {
+          SADs[k] += abs(pixel - reference[j + k]);
+        }
+      }
+      current += stride;
+      reference += stride;
+    }
+    return;
+  }
+
+  for (int run = 0; run < num_offsets; run += 16) {
+    const int first = (run + 16 <= num_offsets) ? run : num_offsets - 16;
+    const uint8_t *curr = current;
+    const uint8_t *ref = reference + first;
+    int sums[16] = {};
+
+    for (i = block_height; i > 0; i--) {
+      for (j = 0; j < WIDTH; j++) {
+        const int pixel = curr[j];
+        for (k = 0; k < 16; k++) {
+          sums[k] += abs(pixel - ref[j + k]);
+        }
+      }
+      curr += stride;
+      ref += stride;
+    }
+    for (k = run - first; k < 16; k++) {
+      SADs[first + k] = sums[k];
+    }
+  }
+}
+
+void fastSAD32_span_c(FAST_SAD_SPAN_FORMAL_ARGS) {
+  spanSAD<32>(FAST_SAD_SPAN_ACTUAL_ARGS);
+}
+
+void fastSAD16_span_c(FAST_SAD_SPAN_FORMAL_ARGS) {
+  spanSAD<16>(FAST_SAD_SPAN_ACTUAL_ARGS);
+}
+
+void fastSAD8_span_c(FAST_SAD_SPAN_FORMAL_ARGS) {
+  spanSAD<8>(FAST_SAD_SPAN_ACTUAL_ARGS);
+}
+
+void fastSAD4_span_c(FAST_SAD_SPAN_FORMAL_ARGS) {
+  spanSAD<4>(FAST_SAD_SPAN_ACTUAL_ARGS);
+}
+
 // Return block variance, multiplied by block_width*block_height
 static int variance(FAST_VARIANCE_FORMAL_ARGS) {
   int i, j;
@@ -84,8 +197,17 @@ static int variance(FAST_VARIANCE_FORMAL_ARGS) {
     current += stride;
   }
 
+  // The square of the sum overflows an int from 32x32 blocks on
   temp = block_height * block_width;
-  return sum2 - (sum * sum + (temp >> 1)) / temp;
+  return sum2 - (int)(((int64_t)sum * sum + (temp >> 1)) / temp);
+}
+
+int fast_variance64_c(FAST_VARIANCE_FORMAL_ARGS) {
+  return variance(FAST_VARIANCE_ACTUAL_ARGS);
+}
+
+int fast_variance32_c(FAST_VARIANCE_FORMAL_ARGS) {
+  return variance(FAST_VARIANCE_ACTUAL_ARGS);
 }
 
 int fast_variance16_c(FAST_VARIANCE_FORMAL_ARGS) {
@@ -100,6 +222,51 @@ int fast_variance4_c(FAST_VARIANCE_FORMAL_ARGS) {
   return variance(FAST_VARIANCE_ACTUAL_ARGS);
 }
 
+// Remove the DC of the sums of a 16xH block and of its 8x8 quadrants, and
+// return the 16xH value
+static int split_ac(const int *sum, const int *sum2, int block_height,
+                    int *split) {
+  int q;
+  int temp;
+  int rows;
+  int total = 0;
+  int total2 = 0;
+
+  for (q = 0; q < 4; q++) {
+    rows = q < 2 ? block_height : block_height - 8;
+    rows = rows < 0 ? 0 : (rows > 8 ? 8 : rows);
+    temp = 8 * rows;
+    split[q] =
+        temp ? sum2[q] - (int)(((int64_t)sum[q] * sum[q] + (temp >> 1)) / temp)
+             : 0;
+    total += sum[q];
+    total2 += sum2[q];
+  }
+
+  // The square of the sum overflows an int on bright 16x16 blocks
+  temp = block_height * 16;
+  return total2 - (int)(((int64_t)total * total + (temp >> 1)) / temp);
+}
+
+int fast_variance16_split_c(FAST_VARIANCE_SPLIT_FORMAL_ARGS) {
+  int i, j, q;
+  int temp;
+  int sum[4] = {0, 0, 0, 0};
+  int sum2[4] = {0, 0, 0, 0};
+
+  for (i = 0; i < block_height; i++) {
+    for (j = 0; j < 16; j++) {
+      q = (i < 8 ? 0 : 2) + (j >> 3);
+      temp = current[j];
+      sum[q] += temp;
+      sum2[q] += temp * temp;
+    }
+    current += stride;
+  }
+
+  return split_ac(sum, sum2, block_height, split);
+}
+
 // Sum of square differences
 static int calc_mse(FAST_MSE_FORMAL_ARGS) {
   int i, j;
@@ -127,11 +294,19 @@ static int calc_mse(FAST_MSE_FORMAL_ARGS) {
 
 #ifdef AC_ENERGY
   temp = block_height * block_width;
-  sum2 -= (sum * sum + (temp >> 1)) / temp;
+  sum2 -= (int)(((int64_t)sum * sum + (temp >> 1)) / temp);
 #endif // AC_ENERGY
   return sum2;
 }
 
+int fast_calc_mse64_c(FAST_MSE_FORMAL_ARGS) {
+  return calc_mse(FAST_MSE_ACTUAL_ARGS);
+}
+
+int fast_calc_mse32_c(FAST_MSE_FORMAL_ARGS) {
+  return calc_mse(FAST_MSE_ACTUAL_ARGS);
+}
+
 int fast_calc_mse16_c(FAST_MSE_FORMAL_ARGS) {
   return calc_mse(FAST_MSE_ACTUAL_ARGS);
 }
@@ -144,6 +319,33 @@ int fast_calc_mse4_c(FAST_MSE_FORMAL_ARGS) {
   return calc_mse(FAST_MSE_ACTUAL_ARGS);
 }
 
+int fast_calc_mse16_split_c(FAST_MSE_SPLIT_FORMAL_ARGS) {
+  int i, j, q;
+  int temp;
+  int sum[4] = {0, 0, 0, 0};
+  int sum2[4] = {0, 0, 0, 0};
+
+  for (i = 0; i < block_height; i++) {
+    for (j = 0; j < 16; j++) {
+      q = (i < 8 ? 0 : 2) + (j >> 3);
+      temp = current[j] - reference[j];
+      sum[q] += temp;
+      sum2[q] += temp * temp;
+    }
+    current += stride;
+    reference += stride;
+  }
+
+#ifdef AC_ENERGY
+  return split_ac(sum, sum2, block_height, split);
+#else
+  for (q = 0; q < 4; q++) {
+    split[q] = sum2[q];
+  }
+  return sum2[0] + sum2[1] + sum2[2] + sum2[3];
+#endif // AC_ENERGY
+}
+
 // Sum of square differences after bi-directional interpolation; we assume
 // td1+td2 = 32768
 static int bidir_mse(FAST_BIDIR_MSE_FORMAL_ARGS) {
@@ -175,11 +377,19 @@ static int bidir_mse(FAST_BIDIR_MSE_FORMAL_ARGS) {
 
 #ifdef AC_ENERGY
   temp = block_height * block_width;
-  sum2 -= (sum * sum + (temp >> 1)) / temp;
+  sum2 -= (int)(((int64_t)sum * sum + (temp >> 1)) / temp);
 #endif // AC_ENERGY
   return sum2;
 }
 
+int fast_bidir_mse64_c(FAST_BIDIR_MSE_FORMAL_ARGS) {
+  return bidir_mse(FAST_BIDIR_MSE_ACTUAL_ARGS);
+}
+
+int fast_bidir_mse32_c(FAST_BIDIR_MSE_FORMAL_ARGS) {
+  return bidir_mse(FAST_BIDIR_MSE_ACTUAL_ARGS);
+}
+
 int fast_bidir_mse16_c(FAST_BIDIR_MSE_FORMAL_ARGS) {
   return bidir_mse(FAST_BIDIR_MSE_ACTUAL_ARGS);
 }
@@ -191,3 +401,18 @@ int fast_bidir_mse8_c(FAST_BIDIR_MSE_FORMAL_ARGS) {
 int fast_bidir_mse4_c(FAST_BIDIR_MSE_FORMAL_ARGS) {
   return bidir_mse(FAST_BIDIR_MSE_ACTUAL_ARGS);
 }
+
+void decimate2x2_c(DECIMATE_FORMAL_ARGS) {
+  int i, j;
+
+  for (i = 0; i < height; i++) {
+    const uint8_t *row0 = src + 2 * i * src_stride;
+    const uint8_t *row1 = row0 + src_stride;
+    for (j = 0; j < width; j++) {
+      dst[j] = (uint8_t)((row0[2 * j] + row0[2 * j + 1] + row1[2 * j] +
+                          row1[2 * j + 1] + 2) >>
+                         2);
+    }
+    dst += dst_stride;
+  }
+}
@@ -17,16 +17,82 @@
 
 // Highway SIMD implementations (cross-platform, auto-dispatching)
 
+// The searches pass a running min_SAD, so use the early-exit SAD kernels
 int fastSAD16(FAST_SAD_FORMAL_ARGS) {
-  return fastSAD16_hwy(FAST_SAD_ACTUAL_ARGS);
+  return fastSAD16_early_hwy(FAST_SAD_ACTUAL_ARGS);
 }
 
 int fastSAD8(FAST_SAD_FORMAL_ARGS) {
-  return fastSAD8_hwy(FAST_SAD_ACTUAL_ARGS);
+  return fastSAD8_early_hwy(FAST_SAD_ACTUAL_ARGS);
 }
 
 int fastSAD4(FAST_SAD_FORMAL_ARGS) {
-  return fastSAD4_hwy(FAST_SAD_ACTUAL_ARGS);
+  return fastSAD4_early_hwy(FAST_SAD_ACTUAL_ARGS);
+}
+
+// The wider blocks are summed over 16 pixel wide strips. A strip that reaches
+// min_SAD makes the sum reach it too, so the sum follows the fastSAD rule.
+static void strips_SAD_xN(FAST_SAD_XN_FORMAL_ARGS) {
+  const uint8_t *strip_refs[FAST_SAD_MAX_REFS];
+  int strip_SADs[FAST_SAD_MAX_REFS];
+
+  fastSAD16_xN_hwy(current, references, num_refs, stride, 16, block_height,
+                   min_SAD, SADs);
+  for (int x = 16; x < block_width; x += 16) {
+    for (int k = 0; k < num_refs; k++) {
+      strip_refs[k] = references[k] + x;
+    }
+    fastSAD16_xN_hwy(current + x, strip_refs, num_refs, stride, 16,
+                     block_height, min_SAD, strip_SADs);
+    for (int k = 0; k < num_refs; k++) {
+      SADs[k] += strip_SADs[k];
+    }
+  }
+}
+
+void fastSAD64_xN(FAST_SAD_XN_FORMAL_ARGS) {
+  strips_SAD_xN(FAST_SAD_XN_ACTUAL_ARGS);
+}
+
+void fastSAD32_xN(FAST_SAD_XN_FORMAL_ARGS) {
+  strips_SAD_xN(FAST_SAD_XN_ACTUAL_ARGS);
+}
+
+void fastSAD16_xN(FAST_SAD_XN_FORMAL_ARGS) {
+  fastSAD16_xN_hwy(FAST_SAD_XN_ACTUAL_ARGS);
+}
+
+void fastSAD8_xN(FAST_SAD_XN_FORMAL_ARGS) {
+  fastSAD8_xN_hwy(FAST_SAD_XN_ACTUAL_ARGS);
+}
+
+void fastSAD4_xN(FAST_SAD_XN_FORMAL_ARGS) {
+  fastSAD4_xN_hwy(FAST_SAD_XN_ACTUAL_ARGS);
+}
+
+void fastSAD32_span(FAST_SAD_SPAN_FORMAL_ARGS) {
+  fastSAD32_span_hwy(FAST_SAD_SPAN_ACTUAL_ARGS);
+}
+
+void fastSAD16_span(FAST_SAD_SPAN_FORMAL_ARGS) {
+  fastSAD16_span_hwy(FAST_SAD_SPAN_ACTUAL_ARGS);
+}
+
+void fastSAD8_span(FAST_SAD_SPAN_FORMAL_ARGS) {
+  fastSAD8_span_hwy(FAST_SAD_SPAN_ACTUAL_ARGS);
+}
+
+void fastSAD4_span(FAST_SAD_SPAN_FORMAL_ARGS) {
+  fastSAD4_span_hwy(FAST_SAD_SPAN_ACTUAL_ARGS);
+}
+
+// The wider variances and MSEs are computed once per block, in C
+int fast_variance64(FAST_VARIANCE_FORMAL_ARGS) {
+  return fast_variance64_c(FAST_VARIANCE_ACTUAL_ARGS);
+}
+
+int fast_variance32(FAST_VARIANCE_FORMAL_ARGS) {
+  return fast_variance32_c(FAST_VARIANCE_ACTUAL_ARGS);
 }
 
 int fast_variance16(FAST_VARIANCE_FORMAL_ARGS) {
@@ -41,6 +107,18 @@ int fast_variance4(FAST_VARIANCE_FORMAL_ARGS) {
   return fast_variance4_hwy(FAST_VARIANCE_ACTUAL_ARGS);
 }
 
+int fast_variance16_split(FAST_VARIANCE_SPLIT_FORMAL_ARGS) {
+  return fast_variance16_split_hwy(FAST_VARIANCE_SPLIT_ACTUAL_ARGS);
+}
+
+int fast_calc_mse64(FAST_MSE_FORMAL_ARGS) {
+  return fast_calc_mse64_c(FAST_MSE_ACTUAL_ARGS);
+}
+
+int fast_calc_mse32(FAST_MSE_FORMAL_ARGS) {
+  return fast_calc_mse32_c(FAST_MSE_ACTUAL_ARGS);
+}
+
 int fast_calc_mse16(FAST_MSE_FORMAL_ARGS) {
   return fast_calc_mse16_hwy(FAST_MSE_ACTUAL_ARGS);
 }
@@ -53,6 +131,18 @@ int fast_calc_mse4(FAST_MSE_FORMAL_ARGS) {
   return fast_calc_mse4_hwy(FAST_MSE_ACTUAL_ARGS);
 }
 
+int fast_calc_mse16_split(FAST_MSE_SPLIT_FORMAL_ARGS) {
+  return fast_calc_mse16_split_hwy(FAST_MSE_SPLIT_ACTUAL_ARGS);
+}
+
+int fast_bidir_mse64(FAST_BIDIR_MSE_FORMAL_ARGS) {
+  return fast_bidir_mse64_c(FAST_BIDIR_MSE_ACTUAL_ARGS);
+}
+
+int fast_bidir_mse32(FAST_BIDIR_MSE_FORMAL_ARGS) {
+  return fast_bidir_mse32_c(FAST_BIDIR_MSE_ACTUAL_ARGS);
+}
+
 int fast_bidir_mse16(FAST_BIDIR_MSE_FORMAL_ARGS) {
   return fast_bidir_mse16_hwy(FAST_BIDIR_MSE_ACTUAL_ARGS);
 }
@@ -65,6 +155,10 @@ int fast_bidir_mse4(FAST_BIDIR_MSE_FORMAL_ARGS) {
   return fast_bidir_mse4_hwy(FAST_BIDIR_MSE_ACTUAL_ARGS);
 }
 
+void decimate2x2(DECIMATE_FORMAL_ARGS) {
+  decimate2x2_hwy(DECIMATE_ACTUAL_ARGS);
+}
+
 #else
 
 // Pure C reference implementations (portable, slower)
@@ -77,6 +171,50 @@ int fastSAD8(FAST_SAD_FORMAL_ARGS) { return fastSAD8_c(FAST_SAD_ACTUAL_ARGS); }
 
 int fastSAD4(FAST_SAD_FORMAL_ARGS) { return fastSAD4_c(FAST_SAD_ACTUAL_ARGS); }
 
+void fastSAD64_xN(FAST_SAD_XN_FORMAL_ARGS) {
+  fastSAD64_xN_c(FAST_SAD_XN_ACTUAL_ARGS);
+}
+
+void fastSAD32_xN(FAST_SAD_XN_FORMAL_ARGS) {
+  fastSAD32_xN_c(FAST_SAD_XN_ACTUAL_ARGS);
+}
+
+void fastSAD16_xN(FAST_SAD_XN_FORMAL_ARGS) {
+  fastSAD16_xN_c(FAST_SAD_XN_ACTUAL_ARGS);
+}
+
+void fastSAD8_xN(FAST_SAD_XN_FORMAL_ARGS) {
+  fastSAD8_xN_c(FAST_SAD_XN_ACTUAL_ARGS);
+}
+
+void fastSAD4_xN(FAST_SAD_XN_FORMAL_ARGS) {
+  fastSAD4_xN_c(FAST_SAD_XN_ACTUAL_ARGS);
+}
+
+void fastSAD32_span(FAST_SAD_SPAN_FORMAL_ARGS) {
+  fastSAD32_span_c(FAST_SAD_SPAN_ACTUAL_ARGS);
+}
+
+void fastSAD16_span(FAST_SAD_SPAN_FORMAL_ARGS) {
+  fastSAD16_span_c(FAST_SAD_SPAN_ACTUAL_ARGS);
+}
+
+void fastSAD8_span(FAST_SAD_SPAN_FORMAL_ARGS) {
+  fastSAD8_span_c(FAST_SAD_SPAN_ACTUAL_ARGS);
+}
+
+void fastSAD4_span(FAST_SAD_SPAN_FORMAL_ARGS) {
+  fastSAD4_span_c(FAST_SAD_SPAN_ACTUAL_ARGS);
+}
+
+int fast_variance64(FAST_VARIANCE_FORMAL_ARGS) {
+  return fast_variance64_c(FAST_VARIANCE_ACTUAL_ARGS);
+}
+
+int fast_variance32(FAST_VARIANCE_FORMAL_ARGS) {
+  return fast_variance32_c(FAST_VARIANCE_ACTUAL_ARGS);
+}
+
 int fast_variance16(FAST_VARIANCE_FORMAL_ARGS) {
   return fast_variance16_c(FAST_VARIANCE_ACTUAL_ARGS);
 }
@@ -89,6 +227,18 @@ int fast_variance4(FAST_VARIANCE_FORMAL_ARGS) {
   return fast_variance4_c(FAST_VARIANCE_ACTUAL_ARGS);
 }
 
+int fast_variance16_split(FAST_VARIANCE_SPLIT_FORMAL_ARGS) {
+  return fast_variance16_split_c(FAST_VARIANCE_SPLIT_ACTUAL_ARGS);
+}
+
+int fast_calc_mse64(FAST_MSE_FORMAL_ARGS) {
+  return fast_calc_mse64_c(FAST_MSE_ACTUAL_ARGS);
+}
+
+int fast_calc_mse32(FAST_MSE_FORMAL_ARGS) {
+  return fast_calc_mse32_c(FAST_MSE_ACTUAL_ARGS);
+}
+
 int fast_calc_mse16(FAST_MSE_FORMAL_ARGS) {
   return fast_calc_mse16_c(FAST_MSE_ACTUAL_ARGS);
 }
@@ -101,6 +251,18 @@ int fast_calc_mse4(FAST_MSE_FORMAL_ARGS) {
   return fast_calc_mse4_c(FAST_MSE_ACTUAL_ARGS);
 }
 
+int fast_calc_mse16_split(FAST_MSE_SPLIT_FORMAL_ARGS) {
+  return fast_calc_mse16_split_c(FAST_MSE_SPLIT_ACTUAL_ARGS);
+}
+
+int fast_bidir_mse64(FAST_BIDIR_MSE_FORMAL_ARGS) {
+  return fast_bidir_mse64_c(FAST_BIDIR_MSE_ACTUAL_ARGS);
+}
+
+int fast_bidir_mse32(FAST_BIDIR_MSE_FORMAL_ARGS) {
+  return fast_bidir_mse32_c(FAST_BIDIR_MSE_ACTUAL_ARGS);
+}
+
 int fast_bidir_mse16(FAST_BIDIR_MSE_FORMAL_ARGS) {
   return fast_bidir_mse16_c(FAST_BIDIR_MSE_ACTUAL_ARGS);
 }
@@ -113,4 +275,8 @@ int fast_bidir_mse4(FAST_BIDIR_MSE_FORMAL_ARGS) {
   return fast_bidir_mse4_c(FAST_BIDIR_MSE_ACTUAL_ARGS);
 }
 
+void decimate2x2(DECIMATE_FORMAL_ARGS) {
+  decimate2x2_c(DECIMATE_ACTUAL_ARGS);
+}
+
 #endif // USE_HIGHWAY_SIMD
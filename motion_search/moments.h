@@ -23,29 +23,96 @@ extern "C" {
 #define FAST_SAD_ACTUAL_ARGS                                                   \
   current, reference, stride, block_width, block_height, min_SAD
 
+// The SAD may stop early once it reaches min_SAD. The result is exact when
+// it is below min_SAD, and only guaranteed to be >= min_SAD otherwise.
 int fastSAD16(FAST_SAD_FORMAL_ARGS);
 int fastSAD8(FAST_SAD_FORMAL_ARGS);
 int fastSAD4(FAST_SAD_FORMAL_ARGS);
 
+// Number of rows between two min_SAD checks of the early-exit SIMD kernels
+#define FAST_SAD_EXIT_ROWS 4
+
+// SADs of one block against num_refs reference positions, sharing the loads
+// of the current block. Each SADs[k] follows the fastSAD rule above for the
+// same min_SAD, so a search that keeps the first candidate below its running
+// minimum picks the same one as with num_refs fastSAD calls.
+#define FAST_SAD_XN_FORMAL_ARGS                                                \
+  const uint8_t *current, const uint8_t *const *references, int num_refs,      \
+      const ptrdiff_t stride, int block_width, int block_height, int min_SAD,  \
+      int *SADs
+#define FAST_SAD_XN_ACTUAL_ARGS                                                \
+  current, references, num_refs, stride, block_width, block_height, min_SAD,   \
+      SADs
+
+// Largest num_refs of the batched SADs
+#define FAST_SAD_MAX_REFS 8
+
+// The 64 and 32 pixel wide kernels serve the larger block sizes of the
+// searches; they have no split or single reference variants
+void fastSAD64_xN(FAST_SAD_XN_FORMAL_ARGS);
+void fastSAD32_xN(FAST_SAD_XN_FORMAL_ARGS);
+void fastSAD16_xN(FAST_SAD_XN_FORMAL_ARGS);
+void fastSAD8_xN(FAST_SAD_XN_FORMAL_ARGS);
+void fastSAD4_xN(FAST_SAD_XN_FORMAL_ARGS);
+
+// SADs of one block at num_offsets consecutive horizontal positions,
+// SADs[k] for reference + k, without early exit. Like the mpsadbw
+// instruction, one load of the reference serves several positions; only the
+// pixels of the positions are read. block_width * block_height is at most
+// 32 * 64.
+#define FAST_SAD_SPAN_FORMAL_ARGS                                              \
+  const uint8_t *current, const uint8_t *reference, const ptrdiff_t stride,    \
+      int block_width, int block_height, int num_offsets, int *SADs
+#define FAST_SAD_SPAN_ACTUAL_ARGS                                              \
+  current, reference, stride, block_width, block_height, num_offsets, SADs
+
+void fastSAD32_span(FAST_SAD_SPAN_FORMAL_ARGS);
+void fastSAD16_span(FAST_SAD_SPAN_FORMAL_ARGS);
+void fastSAD8_span(FAST_SAD_SPAN_FORMAL_ARGS);
+void fastSAD4_span(FAST_SAD_SPAN_FORMAL_ARGS);
+
 #define FAST_VARIANCE_FORMAL_ARGS                                              \
   const uint8_t *current, const ptrdiff_t stride, int block_width,             \
       int block_height
 #define FAST_VARIANCE_ACTUAL_ARGS current, stride, block_width, block_height
 
+int fast_variance64(FAST_VARIANCE_FORMAL_ARGS);
+int fast_variance32(FAST_VARIANCE_FORMAL_ARGS);
 int fast_variance16(FAST_VARIANCE_FORMAL_ARGS);
 int fast_variance8(FAST_VARIANCE_FORMAL_ARGS);
 int fast_variance4(FAST_VARIANCE_FORMAL_ARGS);
 
+// Variance of a 16xH block and, from the same pass, of its 8x8 quadrants in
+// split[0..3] (top-left, top-right, bottom-left, bottom-right). The top
+// quadrants are min(H, 8) rows high and the bottom ones get the rest; an
+// empty quadrant has variance 0.
+#define FAST_VARIANCE_SPLIT_FORMAL_ARGS                                        \
+  const uint8_t *current, const ptrdiff_t stride, int block_height, int *split
+#define FAST_VARIANCE_SPLIT_ACTUAL_ARGS current, stride, block_height, split
+
+int fast_variance16_split(FAST_VARIANCE_SPLIT_FORMAL_ARGS);
+
 #define FAST_MSE_FORMAL_ARGS                                                   \
   const uint8_t *current, const uint8_t *reference, const ptrdiff_t stride,    \
       int block_width, int block_height
 #define FAST_MSE_ACTUAL_ARGS                                                   \
   current, reference, stride, block_width, block_height
 
+int fast_calc_mse64(FAST_MSE_FORMAL_ARGS);
+int fast_calc_mse32(FAST_MSE_FORMAL_ARGS);
 int fast_calc_mse16(FAST_MSE_FORMAL_ARGS);
 int fast_calc_mse8(FAST_MSE_FORMAL_ARGS);
 int fast_calc_mse4(FAST_MSE_FORMAL_ARGS);
 
+// MSE of a 16xH block and of its quadrants, split like the variance above
+#define FAST_MSE_SPLIT_FORMAL_ARGS                                             \
+  const uint8_t *current, const uint8_t *reference, const ptrdiff_t stride,    \
+      int block_height, int *split
+#define FAST_MSE_SPLIT_ACTUAL_ARGS                                             \
+  current, reference, stride, block_height, split
+
+int fast_calc_mse16_split(FAST_MSE_SPLIT_FORMAL_ARGS);
+
 #define FAST_BIDIR_MSE_FORMAL_ARGS                                             \
   const uint8_t *current, const uint8_t *reference1,                           \
       const uint8_t *reference2, const ptrdiff_t stride, int block_width,      \
@@ -53,10 +120,22 @@ int fast_calc_mse4(FAST_MSE_FORMAL_ARGS);
 #define FAST_BIDIR_MSE_ACTUAL_ARGS                                             \
   current, reference1, reference2, stride, block_width, block_height, td
 
+int fast_bidir_mse64(FAST_BIDIR_MSE_FORMAL_ARGS);
+int fast_bidir_mse32(FAST_BIDIR_MSE_FORMAL_ARGS);
 int fast_bidir_mse16(FAST_BIDIR_MSE_FORMAL_ARGS);
 int fast_bidir_mse8(FAST_BIDIR_MSE_FORMAL_ARGS);
 int fast_bidir_mse4(FAST_BIDIR_MSE_FORMAL_ARGS);
 
+// 2x2 box filter decimation: every pixel of the width x height destination
+// is the rounded average of a 2x2 block of the source, which must have
+// 2 * width columns and 2 * height rows
+#define DECIMATE_FORMAL_ARGS                                                   \
+  uint8_t *dst, const ptrdiff_t dst_stride, const uint8_t *src,                \
+      const ptrdiff_t src_stride, int width, int height
+#define DECIMATE_ACTUAL_ARGS dst, dst_stride, src, src_stride, width, height
+
+void decimate2x2(DECIMATE_FORMAL_ARGS);
+
 /*
     declare reference functions
 */
@@ -65,18 +144,41 @@ int fastSAD16_c(FAST_SAD_FORMAL_ARGS);
 int fastSAD8_c(FAST_SAD_FORMAL_ARGS);
 int fastSAD4_c(FAST_SAD_FORMAL_ARGS);
 
+void fastSAD64_xN_c(FAST_SAD_XN_FORMAL_ARGS);
+void fastSAD32_xN_c(FAST_SAD_XN_FORMAL_ARGS);
+void fastSAD16_xN_c(FAST_SAD_XN_FORMAL_ARGS);
+void fastSAD8_xN_c(FAST_SAD_XN_FORMAL_ARGS);
+void fastSAD4_xN_c(FAST_SAD_XN_FORMAL_ARGS);
+
+void fastSAD32_span_c(FAST_SAD_SPAN_FORMAL_ARGS);
+void fastSAD16_span_c(FAST_SAD_SPAN_FORMAL_ARGS);
+void fastSAD8_span_c(FAST_SAD_SPAN_FORMAL_ARGS);
+void fastSAD4_span_c(FAST_SAD_SPAN_FORMAL_ARGS);
+
+int fast_variance64_c(FAST_VARIANCE_FORMAL_ARGS);
+int fast_variance32_c(FAST_VARIANCE_FORMAL_ARGS);
 int fast_variance16_c(FAST_VARIANCE_FORMAL_ARGS);
 int fast_variance8_c(FAST_VARIANCE_FORMAL_ARGS);
 int fast_variance4_c(FAST_VARIANCE_FORMAL_ARGS);
 
+int fast_variance16_split_c(FAST_VARIANCE_SPLIT_FORMAL_ARGS);
+
+int fast_calc_mse64_c(FAST_MSE_FORMAL_ARGS);
+int fast_calc_mse32_c(FAST_MSE_FORMAL_ARGS);
 int fast_calc_mse16_c(FAST_MSE_FORMAL_ARGS);
 int fast_calc_mse8_c(FAST_MSE_FORMAL_ARGS);
 int fast_calc_mse4_c(FAST_MSE_FORMAL_ARGS);
 
+int fast_calc_mse16_split_c(FAST_MSE_SPLIT_FORMAL_ARGS);
+
+int fast_bidir_mse64_c(FAST_BIDIR_MSE_FORMAL_ARGS);
+int fast_bidir_mse32_c(FAST_BIDIR_MSE_FORMAL_ARGS);
 int fast_bidir_mse16_c(FAST_BIDIR_MSE_FORMAL_ARGS);
 int fast_bidir_mse8_c(FAST_BIDIR_MSE_FORMAL_ARGS);
 int fast_bidir_mse4_c(FAST_BIDIR_MSE_FORMAL_ARGS);
 
+void decimate2x2_c(DECIMATE_FORMAL_ARGS);
+
 /*
     declare Highway SIMD functions
 */
@@ -85,18 +187,37 @@ int fastSAD16_hwy(FAST_SAD_FORMAL_ARGS);
 int fastSAD8_hwy(FAST_SAD_FORMAL_ARGS);
 int fastSAD4_hwy(FAST_SAD_FORMAL_ARGS);
 
+int fastSAD16_early_hwy(FAST_SAD_FORMAL_ARGS);
+int fastSAD8_early_hwy(FAST_SAD_FORMAL_ARGS);
+int fastSAD4_early_hwy(FAST_SAD_FORMAL_ARGS);
+
+void fastSAD16_xN_hwy(FAST_SAD_XN_FORMAL_ARGS);
+void fastSAD8_xN_hwy(FAST_SAD_XN_FORMAL_ARGS);
+void fastSAD4_xN_hwy(FAST_SAD_XN_FORMAL_ARGS);
+
+void fastSAD32_span_hwy(FAST_SAD_SPAN_FORMAL_ARGS);
+void fastSAD16_span_hwy(FAST_SAD_SPAN_FORMAL_ARGS);
+void fastSAD8_span_hwy(FAST_SAD_SPAN_FORMAL_ARGS);
+void fastSAD4_span_hwy(FAST_SAD_SPAN_FORMAL_ARGS);
+
 int fast_variance16_hwy(FAST_VARIANCE_FORMAL_ARGS);
 int fast_variance8_hwy(FAST_VARIANCE_FORMAL_ARGS);
 int fast_variance4_hwy(FAST_VARIANCE_FORMAL_ARGS);
 
+int fast_variance16_split_hwy(FAST_VARIANCE_SPLIT_FORMAL_ARGS);
+
 int fast_calc_mse16_hwy(FAST_MSE_FORMAL_ARGS);
 int fast_calc_mse8_hwy(FAST_MSE_FORMAL_ARGS);
 int fast_calc_mse4_hwy(FAST_MSE_FORMAL_ARGS);
 
+int fast_calc_mse16_split_hwy(FAST_MSE_SPLIT_FORMAL_ARGS);
+
 int fast_bidir_mse16_hwy(FAST_BIDIR_MSE_FORMAL_ARGS);
 int fast_bidir_mse8_hwy(FAST_BIDIR_MSE_FORMAL_ARGS);
 int fast_bidir_mse4_hwy(FAST_BIDIR_MSE_FORMAL_ARGS);
 
+void decimate2x2_hwy(DECIMATE_FORMAL_ARGS);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -11,7 +11,10 @@
 #include "common.h"
 #include "moments.h"
 
+#include <algorithm>
+#include <climits>
 #include <cstdlib>
+#include <cstring>
 
 #define RANGE_CLIP(low, val, high)                                             \
   ((int16_t)((val) < (low) ? (low) : ((val) > (high) ? (high) : (val))))
@@ -20,16 +23,85 @@ typedef struct diamond_offset_t {
   MV mv;
 } diamond_offset_t;
 
-typedef int (*t_SAD)(FAST_SAD_FORMAL_ARGS);
+typedef void (*t_SAD_xN)(FAST_SAD_XN_FORMAL_ARGS);
+typedef void (*t_SAD_span)(FAST_SAD_SPAN_FORMAL_ARGS);
+
+// Vectors of the quadrants of the last macroblock searched exhaustively,
+// found with its own, for the quadrant searches that follow. Only the
+// num_quadrants quadrants at offsets[] share the window of the macroblock.
+typedef struct quadrant_cache_t {
+  const unsigned char *current;
+  const unsigned char *reference;
+  int num_quadrants;
+  int offsets[4];
+  MV MVs[4];
+  int SADs[4];
+} quadrant_cache_t;
+
+// The picture being searched, to locate a block from its pointer, the size of
+// its macroblocks, their pyramid vectors against the reference, or NULL, and
+// the quadrant vectors of the exhaustive search
+typedef struct search_area_t {
+  const unsigned char *origin;
+  DIM dim;
+  int block_size;
+  const MV *seeds;
+  quadrant_cache_t *quadrants;
+} search_area_t;
+
+// Motion vectors that keep a block inside the padded reference picture
+typedef struct search_window_t {
+  MV min;
+  MV max;
+} search_window_t;
+
+static void get_search_window(search_window_t *window,
+                              const search_area_t *area,
+                              const unsigned char *current, int stride,
+                              int block_width, int block_height) {
+  const ptrdiff_t offset = current - area->origin;
+  const int pos_y = (int)(offset / stride);
+  const int pos_x = (int)(offset % stride);
+
+  window->min.y = (int16_t)(-VERTICAL_PADDING - pos_y);
+  window->min.x = (int16_t)(-HORIZONTAL_PADDING - pos_x);
+  window->max.y =
+      (int16_t)(area->dim.height + VERTICAL_PADDING - block_height - pos_y);
+  window->max.x =
+      (int16_t)(area->dim.width + HORIZONTAL_PADDING - block_width - pos_x);
+}
+
+// Pyramid vector of the macroblock holding the block at current
+static MV get_seed(const search_area_t *area, const unsigned char *current,
+                   int stride) {
+  const ptrdiff_t offset = current - area->origin;
+  const int pos_y = (int)(offset / stride);
+  const int pos_x = (int)(offset % stride);
+  const int stride_MB = area->dim.width / area->block_size + 2;
+
+  return area->seeds[(pos_y / area->block_size) * stride_MB +
+                     pos_x / area->block_size];
+}
+
+static void clip_to_window(MV *mv, const search_window_t *window) {
+  mv->y = RANGE_CLIP(window->min.y, mv->y, window->max.y);
+  mv->x = RANGE_CLIP(window->min.x, mv->x, window->max.x);
+}
 
 static int diamond_search(unsigned char *current, unsigned char *reference,
                           int stride, MV *motion_vector, int block_width,
                           int block_height, const diamond_offset_t *offset,
                           const int search_size, int min_SAD,
-                          const diamond_offset_t *next_diamond, t_SAD SAD) {
+                          const diamond_offset_t *next_diamond,
+                          t_SAD_xN SAD_xN, const search_window_t *window) {
   // Large diamond has 9 search locations
   int SAD_val[9];
+  const uint8_t *refs[FAST_SAD_MAX_REFS];
+  int SADs[FAST_SAD_MAX_REFS];
+  int positions[FAST_SAD_MAX_REFS];
+  int num_refs;
   int min_ind;
+  int first;
   int i, j;
   const diamond_offset_t *ptr = next_diamond;
 
@@ -39,11 +111,31 @@ static int diamond_search(unsigned char *current, unsigned char *reference,
     }
     SAD_val[0] = min_SAD;
     min_ind = 0;
-    for (i++; i < search_size; i++) {
+
+    // The positions not covered by the previous diamond share one call;
+    // positions outside the padded reference are never picked
+    first = i + 1;
+    num_refs = 0;
+    for (i = first; i < search_size; i++) {
       j = ptr[i].mv.y;
-      SAD_val[j] =
-          SAD(current, reference + offset[j].mv.y * stride + offset[j].mv.x,
-              stride, block_width, block_height, min_SAD);
+      const int y = motion_vector->y + offset[j].mv.y;
+      const int x = motion_vector->x + offset[j].mv.x;
+      if (y < window->min.y || y > window->max.y || x < window->min.x ||
+          x > window->max.x) {
+        SAD_val[j] = INT_MAX;
+        continue;
+      }
+      positions[num_refs] = j;
+      refs[num_refs++] = reference + offset[j].mv.y * stride + offset[j].mv.x;
+    }
+    if (num_refs > 0) {
+      SAD_xN(current, refs, num_refs, stride, block_width, block_height,
+             min_SAD, SADs);
+    }
+
+    for (i = 0; i < num_refs; i++) {
+      j = positions[i];
+      SAD_val[j] = SADs[i];
       if (SAD_val[j] < min_SAD) {
         min_SAD = SAD_val[j];
         min_ind = j;
@@ -152,9 +244,6 @@ static const diamond_offset_t next_large_diamond[9 * 9] = {
     {3, 0}, {2, 8}, {4, 6}, {0, 7}, {1, 1}, {5, 5}, {6, 6}, {7, 7}, {8, 8},
     {4, 0}, {3, 2}, {5, 6}, {1, 2}, {7, 6}, {0, 8}, {3, 3}, {4, 4}, {5, 5}};
 
-#define SIMPLE_SEARCH 0
-
-#if SIMPLE_SEARCH
 /*
   x4 x3 x2
   x5 x0 x1
@@ -170,23 +259,40 @@ static const diamond_offset_t next_small_block[9 * 9] = {
     {7, 0}, {6, 5}, {8, 1}, {5, 4}, {1, 2}, {0, 3}, {4, 4}, {3, 3}, {2, 2},
     {8, 0}, {1, 3}, {7, 5}, {0, 4}, {4, 4}, {3, 3}, {2, 2}, {5, 5}, {6, 6},
     {1, 0}, {2, 3}, {8, 7}, {3, 4}, {7, 6}, {0, 5}, {4, 4}, {5, 5}, {6, 6},
-    {7, 0}, {2, 1}, {4, 3}, {0, 6}, {1, 1}, {3, 3}, {5, 5}, {6, 6}, {8, 8},
-    {6, 0}, {1, 2}, {3, 4}, {0, 7}, {2, 2}, {4, 4}, {5, 5}, {7, 7}, {8, 8},
-    {5, 0}, {1, 3}, {2, 4}, {0, 8}, {3, 3}, {4, 4}, {6, 6}, {7, 7}, {8, 8}};
-#endif // SIMPLE_SEARCH
+    {1, 7}, {2, 0}, {3, 5}, {0, 6}, {4, 4}, {5, 5}, {6, 6}, {7, 7}, {8, 8},
+    {2, 1}, {1, 8}, {3, 0}, {4, 5}, {5, 6}, {0, 7}, {6, 6}, {7, 7}, {8, 8},
+    {3, 1}, {4, 0}, {5, 7}, {0, 8}, {1, 1}, {2, 2}, {6, 6}, {7, 7}, {8, 8}};
+
+/*
+     x3    x2
+  x4    x0    x1
+     x5    x6
+*/
+static const diamond_offset_t large_hexagon[7] = {
+    {0, 0}, {0, 2}, {-2, 1}, {-2, -1}, {0, -2}, {2, -1}, {2, 1}};
+static const diamond_offset_t next_large_hexagon[7 * 7] = {
+    {0, 0}, {1, 1}, {2, 2}, {3, 3}, {4, 4}, {5, 5}, {6, 6},
+    {3, 2}, {4, 0}, {5, 6}, {0, 1}, {1, 1}, {2, 2}, {6, 6},
+    {4, 3}, {5, 0}, {6, 1}, {0, 2}, {1, 1}, {2, 2}, {3, 3},
+    {1, 2}, {5, 4}, {6, 0}, {0, 3}, {2, 2}, {3, 3}, {4, 4},
+    {1, 0}, {2, 3}, {6, 5}, {0, 4}, {3, 3}, {4, 4}, {5, 5},
+    {1, 6}, {2, 0}, {3, 4}, {0, 5}, {4, 4}, {5, 5}, {6, 6},
+    {2, 1}, {3, 0}, {4, 5}, {0, 6}, {1, 1}, {5, 5}, {6, 6}};
 
 static int PMVFAST(unsigned char *current, unsigned char *reference, int stride,
                    MV *motion_vectors, int block_width, int block_height,
-                   int *SADs, t_SAD SAD) {
+                   int *SADs, t_SAD_xN SAD_xN, const search_area_t *area) {
   int area_multiplier = block_width * block_height;
   static const int T = 1; // PMVFAST first threshold, per pixel
-  int temp_SAD;
   int min_SAD;
   MV median;
   int median_norm;
   int T1;
   int T2;
-  int stride_MB = (stride - 2 * HORIZONTAL_PADDING) / MB_WIDTH + 2;
+  int stride_MB = area->dim.width / area->block_size + 2;
+  search_window_t window;
+
+  get_search_window(&window, area, current, stride, block_width, block_height);
 
   // predictors are the MV: (0,0), (motion_vector[-1]:left),
   // (motion_vector[-mv_stride]:top), (motion_vector[-mv_stride+1]:top_right),
@@ -194,60 +300,42 @@ static int PMVFAST(unsigned char *current, unsigned char *reference, int stride,
   // find mean or median of predictors
   calc_median(&motion_vectors[-1], &motion_vectors[-stride_MB],
               &motion_vectors[-stride_MB + 1], &median);
+  clip_to_window(&median, &window);
   // calulate SAD of median
-  min_SAD = SAD(current, reference + median.y * stride + median.x, stride,
-                block_width, block_height, 65535);
+  const uint8_t *median_ref = reference + median.y * stride + median.x;
+  SAD_xN(current, &median_ref, 1, stride, block_width, block_height, INT_MAX,
+         &min_SAD);
   if (min_SAD >= T * area_multiplier) {
     // calculate SAD of other predictors
     // find minimum of the SAD of predictors left, top, top_right and store it
     // in T1 find the best SAD of all the predictors
-    //  Center (0, 0)
-    median_norm = abs(median.x) + abs(median.y);
-    temp_SAD =
-        SAD(current, reference, stride, block_width, block_height, min_SAD);
-    if (temp_SAD < min_SAD) {
-      min_SAD = temp_SAD;
-      median.y = 0;
-      median.x = 0;
-    }
-    // Left
-    temp_SAD =
-        SAD(current,
-            reference + motion_vectors[-1].y * stride + motion_vectors[-1].x,
-            stride, block_width, block_height, min_SAD);
-    if (temp_SAD < min_SAD) {
-      min_SAD = temp_SAD;
-      median.y = motion_vectors[-1].y;
-      median.x = motion_vectors[-1].x;
-    }
-    // Top
-    temp_SAD = SAD(current,
-                   reference + motion_vectors[-stride_MB].y * stride +
-                       motion_vectors[-stride_MB].x,
-                   stride, block_width, block_height, min_SAD);
-    if (temp_SAD < min_SAD) {
-      min_SAD = temp_SAD;
-      median.y = motion_vectors[-stride_MB].y;
-      median.x = motion_vectors[-stride_MB].x;
+    MV predictors[6] = {{0, 0},
+                        motion_vectors[-1],
+                        motion_vectors[-stride_MB],
+                        motion_vectors[-stride_MB + 1],
+                        motion_vectors[0]};
+    int num_predictors = 5;
+    const uint8_t *refs[6];
+    int predictor_SADs[6];
+
+    // Center (0, 0), left, top, top-right and temporal prediction, and the
+    // pyramid vector when there is one, all scored against the median SAD in
+    // one call
+    if (area->seeds != NULL) {
+      predictors[num_predictors++] = get_seed(area, current, stride);
     }
-    // Top-right
-    temp_SAD = SAD(current,
-                   reference + motion_vectors[-stride_MB + 1].y * stride +
-                       motion_vectors[-stride_MB + 1].x,
-                   stride, block_width, block_height, min_SAD);
-    if (temp_SAD < min_SAD) {
-      min_SAD = temp_SAD;
-      median.y = motion_vectors[-stride_MB + 1].y;
-      median.x = motion_vectors[-stride_MB + 1].x;
+    median_norm = abs(median.x) + abs(median.y);
+    for (int i = 0; i < num_predictors; i++) {
+      clip_to_window(&predictors[i], &window);
+      refs[i] = reference + predictors[i].y * stride + predictors[i].x;
     }
-    // Temporal prediction
-    temp_SAD = SAD(
-        current, reference + motion_vectors[0].y * stride + motion_vectors[0].x,
-        stride, block_width, block_height, min_SAD);
-    if (temp_SAD < min_SAD) {
-      min_SAD = temp_SAD;
-      median.y = motion_vectors[0].y;
-      median.x = motion_vectors[0].x;
+    SAD_xN(current, refs, num_predictors, stride, block_width, block_height,
+           min_SAD, predictor_SADs);
+    for (int i = 0; i < num_predictors; i++) {
+      if (predictor_SADs[i] < min_SAD) {
+        min_SAD = predictor_SADs[i];
+        median = predictors[i];
+      }
     }
     T1 = SADs[-1];
     if (SADs[-stride_MB] < T1) {
@@ -267,12 +355,6 @@ static int PMVFAST(unsigned char *current, unsigned char *reference, int stride,
     // }
 
     if (min_SAD >= T1) {
-#if SIMPLE_SEARCH
-      min_SAD =
-          diamond_search(current, reference + median.y * stride + median.x,
-                         stride, &median, block_width, block_height,
-                         small_block, 9, min_SAD, next_small_block, SAD);
-#else
       // if(T2>7*area_multiplier)
       //	T2 = 7*area_multiplier;
       if (T2 >= 6 * area_multiplier && median_norm == 0) {
@@ -280,14 +362,15 @@ static int PMVFAST(unsigned char *current, unsigned char *reference, int stride,
         min_SAD =
             diamond_search(current, reference + median.y * stride + median.x,
                            stride, &median, block_width, block_height,
-                           large_diamond, 9, min_SAD, next_large_diamond, SAD);
+                           large_diamond, 9, min_SAD, next_large_diamond,
+                           SAD_xN, &window);
       }
       // small-diamond search
       min_SAD =
           diamond_search(current, reference + median.y * stride + median.x,
                          stride, &median, block_width, block_height,
-                         small_diamond, 5, min_SAD, next_small_diamond, SAD);
-#endif
+                         small_diamond, 5, min_SAD, next_small_diamond,
+                         SAD_xN, &window);
     }
   }
   motion_vectors[0].y = median.y;
@@ -296,6 +379,513 @@ static int PMVFAST(unsigned char *current, unsigned char *reference, int stride,
   return min_SAD;
 }
 
+// Lowest SAD of the predictors of a block, clipped to the window, with the
+// predictor in best. Only SADs below min_SAD are taken.
+static int best_predictor(unsigned char *current, unsigned char *reference,
+                          int stride, int block_width, int block_height,
+                          MV *predictors, int num_predictors, t_SAD_xN SAD_xN,
+                          const search_window_t *window, int min_SAD,
+                          MV *best) {
+  const uint8_t *refs[FAST_SAD_MAX_REFS];
+  int SADs[FAST_SAD_MAX_REFS];
+
+  for (int i = 0; i < num_predictors; i++) {
+    clip_to_window(&predictors[i], window);
+    refs[i] = reference + predictors[i].y * stride + predictors[i].x;
+  }
+  SAD_xN(current, refs, num_predictors, stride, block_width, block_height,
+         min_SAD, SADs);
+  for (int i = 0; i < num_predictors; i++) {
+    if (SADs[i] < min_SAD) {
+      min_SAD = SADs[i];
+      *best = predictors[i];
+    }
+  }
+
+  return min_SAD;
+}
+
+// EPZS: the median predictor first, then the zero, left, top, top-right,
+// top-left, collocated and pyramid predictors. Each stage ends the search
+// under a threshold, the second one adapted to the SADs of the neighbours;
+// the best predictor is then refined with the square pattern.
+static int EPZS(unsigned char *current, unsigned char *reference, int stride,
+                MV *motion_vectors, int block_width, int block_height,
+                int *SADs, t_SAD_xN SAD_xN, const search_area_t *area) {
+  const int area_multiplier = block_width * block_height;
+  const int stride_MB = area->dim.width / area->block_size + 2;
+  search_window_t window;
+  MV best = {0, 0};
+  int min_SAD;
+  int T2;
+
+  get_search_window(&window, area, current, stride, block_width, block_height);
+
+  calc_median(&motion_vectors[-1], &motion_vectors[-stride_MB],
+              &motion_vectors[-stride_MB + 1], &best);
+  min_SAD = best_predictor(current, reference, stride, block_width,
+                           block_height, &best, 1, SAD_xN, &window, INT_MAX,
+                           &best);
+  if (min_SAD >= area_multiplier) {
+    MV predictors[7] = {{0, 0},
+                        motion_vectors[-1],
+                        motion_vectors[-stride_MB],
+                        motion_vectors[-stride_MB + 1],
+                        motion_vectors[-stride_MB - 1],
+                        motion_vectors[0]};
+    int num_predictors = 6;
+
+    if (area->seeds != NULL) {
+      predictors[num_predictors++] = get_seed(area, current, stride);
+    }
+    min_SAD = best_predictor(current, reference, stride, block_width,
+                             block_height, predictors, num_predictors, SAD_xN,
+                             &window, min_SAD, &best);
+
+    // 1.2 times the lowest SAD of the neighbours, plus half a unit per pixel
+    T2 = std::min(SADs[-1], std::min(SADs[-stride_MB], SADs[-stride_MB + 1]));
+    T2 += T2 / 5 + area_multiplier / 2;
+    if (min_SAD >= T2) {
+      min_SAD = diamond_search(current, reference + best.y * stride + best.x,
+                               stride, &best, block_width, block_height,
+                               small_block, 9, min_SAD, next_small_block,
+                               SAD_xN, &window);
+    }
+  }
+  motion_vectors[0] = best;
+
+  return min_SAD;
+}
+
+// Hexagon-based search: the best of the median, zero, neighbour, collocated
+// and pyramid predictors, moved by the large hexagon until its center is the
+// best, then refined with the small diamond
+static int hexagon(unsigned char *current, unsigned char *reference,
+                   int stride, MV *motion_vectors, int block_width,
+                   int block_height, int * /* SADs */, t_SAD_xN SAD_xN,
+                   const search_area_t *area) {
+  const int stride_MB = area->dim.width / area->block_size + 2;
+  search_window_t window;
+  MV predictors[6] = {{0, 0}, {0, 0}, motion_vectors[-1],
+                      motion_vectors[-stride_MB],
+                      motion_vectors[-stride_MB + 1], motion_vectors[0]};
+  int num_predictors = 6;
+  MV best = {0, 0};
+  int min_SAD;
+
+  get_search_window(&window, area, current, stride, block_width, block_height);
+
+  calc_median(&motion_vectors[-1], &motion_vectors[-stride_MB],
+              &motion_vectors[-stride_MB + 1], &predictors[0]);
+  if (area->seeds != NULL) {
+    // The collocated vector makes room for the pyramid vector
+    predictors[num_predictors - 1] = get_seed(area, current, stride);
+  }
+  min_SAD = best_predictor(current, reference, stride, block_width,
+                           block_height, predictors, num_predictors, SAD_xN,
+                           &window, INT_MAX, &best);
+  min_SAD = diamond_search(current, reference + best.y * stride + best.x,
+                           stride, &best, block_width, block_height,
+                           large_hexagon, 7, min_SAD, next_large_hexagon,
+                           SAD_xN, &window);
+  min_SAD = diamond_search(current, reference + best.y * stride + best.x,
+                           stride, &best, block_width, block_height,
+                           small_diamond, 5, min_SAD, next_small_diamond,
+                           SAD_xN, &window);
+  motion_vectors[0] = best;
+
+  return min_SAD;
+}
+
+// The search strategies share one signature, so that the row loops below are
+// instantiated once per strategy and call it directly
+typedef int (*t_search)(unsigned char *current, unsigned char *reference,
+                        int stride, MV *motion_vectors, int block_width,
+                        int block_height, int *SADs, t_SAD_xN SAD_xN,
+                        const search_area_t *area);
+
+const char *me_method_name(int method) {
+  static const char *const names[NUM_ME_METHODS] = {
+      "pmvfast",
+      "epzs",
+      "hexagon",
+      "exhaustive",
+  };
+  return names[method];
+}
+
+int me_method_from_name(const char *name) {
+  for (int i = 0; i < NUM_ME_METHODS; i++) {
+    if (strcmp(name, me_method_name(i)) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Kernels of the blocks WIDTH pixels wide. The row loops below are
+// instantiated once per block size, so that every kernel of a block and of its
+// quadrants is known at compile time and called directly.
+template <int WIDTH> struct kernels_t;
+
+template <> struct kernels_t<64> {
+  static constexpr t_SAD_xN SAD_xN = fastSAD64_xN;
+  static constexpr int (*variance)(FAST_VARIANCE_FORMAL_ARGS) = fast_variance64;
+  static constexpr int (*mse)(FAST_MSE_FORMAL_ARGS) = fast_calc_mse64;
+  static constexpr int (*bidir_mse)(FAST_BIDIR_MSE_FORMAL_ARGS) =
+      fast_bidir_mse64;
+};
+
+template <> struct kernels_t<32> {
+  static constexpr t_SAD_xN SAD_xN = fastSAD32_xN;
+  static constexpr t_SAD_span SAD_span = fastSAD32_span;
+  static constexpr int (*variance)(FAST_VARIANCE_FORMAL_ARGS) = fast_variance32;
+  static constexpr int (*mse)(FAST_MSE_FORMAL_ARGS) = fast_calc_mse32;
+  static constexpr int (*bidir_mse)(FAST_BIDIR_MSE_FORMAL_ARGS) =
+      fast_bidir_mse32;
+};
+
+template <> struct kernels_t<16> {
+  static constexpr t_SAD_xN SAD_xN = fastSAD16_xN;
+  static constexpr t_SAD_span SAD_span = fastSAD16_span;
+  static constexpr int (*variance)(FAST_VARIANCE_FORMAL_ARGS) = fast_variance16;
+  static constexpr int (*mse)(FAST_MSE_FORMAL_ARGS) = fast_calc_mse16;
+  static constexpr int (*bidir_mse)(FAST_BIDIR_MSE_FORMAL_ARGS) =
+      fast_bidir_mse16;
+};
+
+template <> struct kernels_t<8> {
+  static constexpr t_SAD_xN SAD_xN = fastSAD8_xN;
+  static constexpr t_SAD_span SAD_span = fastSAD8_span;
+  static constexpr int (*variance)(FAST_VARIANCE_FORMAL_ARGS) = fast_variance8;
+  static constexpr int (*mse)(FAST_MSE_FORMAL_ARGS) = fast_calc_mse8;
+  static constexpr int (*bidir_mse)(FAST_BIDIR_MSE_FORMAL_ARGS) =
+      fast_bidir_mse8;
+};
+
+template <> struct kernels_t<4> {
+  static constexpr t_SAD_xN SAD_xN = fastSAD4_xN;
+  static constexpr t_SAD_span SAD_span = fastSAD4_span;
+  static constexpr int (*variance)(FAST_VARIANCE_FORMAL_ARGS) = fast_variance4;
+  static constexpr int (*mse)(FAST_MSE_FORMAL_ARGS) = fast_calc_mse4;
+  static constexpr int (*bidir_mse)(FAST_BIDIR_MSE_FORMAL_ARGS) =
+      fast_bidir_mse4;
+};
+
+// Vectors of a row scored by one call of the span kernels
+#define SPAN_VECTORS 16
+
+// Scores every vector of [min_x, max_x] x [min_y, max_y] for the parts of a
+// block, HALF pixels wide, in num_columns columns and in a band of top rows
+// above a band of bottom rows (none if bottom is 0), and for the whole block,
+// their sum. MVs and SADs hold the parts in raster order, then the block; ties
+// go to (0, 0), then to the first vector in raster order.
+//
+// The sum of a part bounds its SAD from below by its difference with the sum
+// of the reference pixels under it, so the runs of SPAN_VECTORS vectors where
+// no bound is below the best SAD of its part, nor their total below that of the
+// block, are skipped. The column sums of each band, for the reference rows
+// under the vectors of a row, are kept from one row to the next: adjacent
+// vectors share them, and the next row only adds and removes one line.
+template <int HALF>
+static void score_parts(const unsigned char *current,
+                        const unsigned char *reference, int stride,
+                        int num_columns, int top, int bottom, int min_x,
+                        int max_x, int min_y, int max_y, MV *MVs, int *SADs) {
+  constexpr t_SAD_span SAD_span = kernels_t<HALF>::SAD_span;
+  const int num_bands = bottom > 0 ? 2 : 1;
+  const int num_parts = num_bands * num_columns;
+  const int heights[2] = {top, bottom};
+  const int num_offsets = max_x - min_x + 1;
+  const int num_sums = num_offsets + (num_columns - 1) * HALF;
+  const int num_pixels = num_sums + HALF - 1;
+  int current_sums[4];
+  int columns[2][2 * EXHAUSTIVE_RANGE_X + 2 * HALF];
+  int sums[2][2 * EXHAUSTIVE_RANGE_X + HALF + 1];
+  int span_SADs[4][SPAN_VECTORS];
+  int offsets[4];
+
+  for (int p = 0; p < num_parts; p++) {
+    const int band = p / num_columns;
+    offsets[p] = band * top * stride + (p % num_columns) * HALF;
+    current_sums[p] = 0;
+    for (int i = 0; i < heights[band]; i++) {
+      for (int j = 0; j < HALF; j++) {
+        current_sums[p] += current[offsets[p] + i * stride + j];
+      }
+    }
+  }
+
+  // (0, 0) first, so that it wins the ties
+  SADs[num_parts] = 0;
+  for (int p = 0; p < num_parts; p++) {
+    SAD_span(current + offsets[p], reference + offsets[p], stride, HALF,
+             heights[p / num_columns], 1, &SADs[p]);
+    SADs[num_parts] += SADs[p];
+  }
+  for (int p = 0; p <= num_parts; p++) {
+    MVs[p].y = MVs[p].x = 0;
+  }
+
+  const unsigned char *row = reference + min_y * stride + min_x;
+  for (int band = 0; band < num_bands; band++) {
+    const unsigned char *line = row + band * top * stride;
+    for (int c = 0; c < num_pixels; c++) {
+      columns[band][c] = 0;
+    }
+    for (int i = 0; i < heights[band]; i++, line += stride) {
+      for (int c = 0; c < num_pixels; c++) {
+        columns[band][c] += line[c];
+      }
+    }
+  }
+
+  for (int y = min_y; y <= max_y; y++, row += stride) {
+    for (int band = 0; band < num_bands; band++) {
+      int sum = 0;
+      for (int c = 0; c < HALF - 1; c++) {
+        sum += columns[band][c];
+      }
+      for (int c = 0; c < num_sums; c++) {
+        sum += columns[band][c + HALF - 1];
+        sums[band][c] = sum;
+        sum -= columns[band][c];
+      }
+    }
+
+    for (int first = 0; first < num_offsets; first += SPAN_VECTORS) {
+      const int n = std::min(SPAN_VECTORS, num_offsets - first);
+      bool block = false;
+      bool parts[4] = {false, false, false, false};
+
+      for (int k = first; k < first + n; k++) {
+        int bound = 0;
+        for (int p = 0; p < num_parts; p++) {
+          const int part_bound =
+              abs(current_sums[p] -
+                  sums[p / num_columns][k + (p % num_columns) * HALF]);
+          parts[p] = parts[p] || part_bound < SADs[p];
+          bound += part_bound;
+        }
+        block = block || bound < SADs[num_parts];
+      }
+
+      // The block needs the SADs of every part
+      for (int p = 0; p < num_parts; p++) {
+        if (block || parts[p]) {
+          SAD_span(current + offsets[p], row + first + offsets[p], stride, HALF,
+                   heights[p / num_columns], n, span_SADs[p]);
+        }
+      }
+      for (int k = 0; k < n; k++) {
+        for (int p = 0; p < num_parts; p++) {
+          if ((block || parts[p]) && span_SADs[p][k] < SADs[p]) {
+            SADs[p] = span_SADs[p][k];
+            MVs[p].y = (int16_t)y;
+            MVs[p].x = (int16_t)(min_x + first + k);
+          }
+        }
+        if (block) {
+          int SAD = 0;
+          for (int p = 0; p < num_parts; p++) {
+            SAD += span_SADs[p][k];
+          }
+          if (SAD < SADs[num_parts]) {
+            SADs[num_parts] = SAD;
+            MVs[num_parts].y = (int16_t)y;
+            MVs[num_parts].x = (int16_t)(min_x + first + k);
+          }
+        }
+      }
+    }
+
+    // The column sums of the next row of vectors
+    if (y < max_y) {
+      for (int band = 0; band < num_bands; band++) {
+        const unsigned char *leaving = row + band * top * stride;
+        const unsigned char *entering = leaving + heights[band] * stride;
+        for (int c = 0; c < num_pixels; c++) {
+          columns[band][c] += entering[c] - leaving[c];
+        }
+      }
+    }
+  }
+}
+
+// Every vector within EXHAUSTIVE_RANGE_X and EXHAUSTIVE_RANGE_Y of (0, 0) that
+// keeps the macroblock inside the padded reference. Its quadrants are scored
+// with it, over the same vectors, and the quadrant searches that follow take
+// their vectors from area->quadrants when those are all the vectors of their
+// own window. A block found there in no macroblock is scored on its own.
+template <int BLOCK>
+static int exhaustive(unsigned char *current, unsigned char *reference,
+                      int stride, MV *motion_vectors, int block_width,
+                      int block_height, int * /* SADs */,
+                      t_SAD_xN /* SAD_xN */, const search_area_t *area) {
+  constexpr int HALF = BLOCK / 2;
+  quadrant_cache_t *const cache = area->quadrants;
+  search_window_t window;
+  MV MVs[5];
+  int SADs[5];
+
+  if (block_width == HALF && cache->current != NULL) {
+    for (int q = 0; q < cache->num_quadrants; q++) {
+      if (current == cache->current + cache->offsets[q] &&
+          reference == cache->reference + cache->offsets[q]) {
+        motion_vectors[0] = cache->MVs[q];
+        return cache->SADs[q];
+      }
+    }
+  }
+
+  get_search_window(&window, area, current, stride, block_width, block_height);
+  const int min_x = std::max(-EXHAUSTIVE_RANGE_X, (int)window.min.x);
+  const int max_x = std::min(EXHAUSTIVE_RANGE_X, (int)window.max.x);
+  const int min_y = std::max(-EXHAUSTIVE_RANGE_Y, (int)window.min.y);
+  const int max_y = std::min(EXHAUSTIVE_RANGE_Y, (int)window.max.y);
+
+  if (block_width == HALF) {
+    score_parts<HALF>(current, reference, stride, 1, block_height, 0, min_x,
+                      max_x, min_y, max_y, MVs, SADs);
+    motion_vectors[0] = MVs[0];
+    return SADs[0];
+  }
+
+  // The quadrants are split like those of the row loops
+  const int top = std::min(block_height, HALF);
+  const int num_parts = block_height > HALF ? 4 : 2;
+  const int offsets[4] = {0, HALF, HALF * stride, HALF * stride + HALF};
+  score_parts<HALF>(current, reference, stride, 2, top, block_height - top,
+                    min_x, max_x, min_y, max_y, MVs, SADs);
+
+  // The window of the quadrants is that of the macroblock, but for the left
+  // ones, which reach HALF pixels further right: in the last column of a
+  // picture whose width isn't a multiple of BLOCK, they are searched on
+  // their own
+  const bool left_differs =
+      std::min(EXHAUSTIVE_RANGE_X, window.max.x + HALF) != max_x;
+  cache->current = current;
+  cache->reference = reference;
+  cache->num_quadrants = 0;
+  for (int q = 0; q < num_parts; q++) {
+    if (left_differs && (q & 1) == 0) {
+      continue;
+    }
+    cache->offsets[cache->num_quadrants] = offsets[q];
+    cache->MVs[cache->num_quadrants] = MVs[q];
+    cache->SADs[cache->num_quadrants] = SADs[q];
+    cache->num_quadrants++;
+  }
+  motion_vectors[0] = MVs[num_parts];
+
+  return SADs[num_parts];
+}
+
+// Variance of a BLOCKxH block and of its quadrants, split like
+// fast_variance16_split(), which is the kernel of the 16x16 blocks
+template <int BLOCK>
+static int variance_split(const unsigned char *current, int stride,
+                          int block_height, int *split) {
+  constexpr int HALF = BLOCK / 2;
+
+  if constexpr (BLOCK == 16) {
+    return fast_variance16_split(current, stride, block_height, split);
+  } else {
+    const int top = std::min(block_height, HALF);
+    const int bottom = block_height - top;
+    const int below = HALF * stride;
+
+    split[0] = kernels_t<HALF>::variance(current, stride, HALF, top);
+    split[1] = kernels_t<HALF>::variance(current + HALF, stride, HALF, top);
+    split[2] = split[3] = 0;
+    if (bottom > 0) {
+      split[2] =
+          kernels_t<HALF>::variance(current + below, stride, HALF, bottom);
+      split[3] = kernels_t<HALF>::variance(current + below + HALF, stride,
+                                           HALF, bottom);
+    }
+    return kernels_t<BLOCK>::variance(current, stride, BLOCK, block_height);
+  }
+}
+
+// MSE of a BLOCKxH block and of its quadrants, split like
+// fast_calc_mse16_split(), which is the kernel of the 16x16 blocks
+template <int BLOCK>
+static int mse_split(const unsigned char *current,
+                     const unsigned char *reference, int stride,
+                     int block_height, int *split) {
+  constexpr int HALF = BLOCK / 2;
+
+  if constexpr (BLOCK == 16) {
+    return fast_calc_mse16_split(current, reference, stride, block_height,
+                                 split);
+  } else {
+    const int top = std::min(block_height, HALF);
+    const int bottom = block_height - top;
+    const int below = HALF * stride;
+
+    split[0] = kernels_t<HALF>::mse(current, reference, stride, HALF, top);
+    split[1] = kernels_t<HALF>::mse(current + HALF, reference + HALF, stride,
+                                    HALF, top);
+    split[2] = split[3] = 0;
+    if (bottom > 0) {
+      split[2] = kernels_t<HALF>::mse(current + below, reference + below,
+                                      stride, HALF, bottom);
+      split[3] = kernels_t<HALF>::mse(current + below + HALF,
+                                      reference + below + HALF, stride, HALF,
+                                      bottom);
+    }
+    return kernels_t<BLOCK>::mse(current, reference, stride, BLOCK,
+                                 block_height);
+  }
+}
+
+// Lower SAD of a BLOCKxH block along the zero vector and along the vector
+// predicted from its left, top and top-right neighbours, which is stored in mv
+template <int BLOCK>
+static int static_SAD(unsigned char *current, unsigned char *reference,
+                      int stride, const MV *motion_vectors, int block_height,
+                      const search_area_t *area, MV *mv) {
+  int stride_MB = area->dim.width / BLOCK + 2;
+  search_window_t window;
+  MV predictors[2] = {{0, 0}, {0, 0}};
+  const uint8_t *refs[2];
+  int SADs[2];
+
+  get_search_window(&window, area, current, stride, BLOCK, block_height);
+  calc_median(&motion_vectors[-1], &motion_vectors[-stride_MB],
+              &motion_vectors[-stride_MB + 1], &predictors[1]);
+  clip_to_window(&predictors[1], &window);
+  for (int i = 0; i < 2; i++) {
+    refs[i] = reference + predictors[i].y * stride + predictors[i].x;
+  }
+  kernels_t<BLOCK>::SAD_xN(current, refs, 2, stride, BLOCK, block_height,
+                           INT_MAX, SADs);
+
+  *mv = predictors[SADs[1] < SADs[0] ? 1 : 0];
+  return SADs[1] < SADs[0] ? SADs[1] : SADs[0];
+}
+
+// Whether the 8x8 searches of a macroblock can be left out after its 16x16
+// search. The 8x8 mode has to take an eighth off the 16x16 MSE to be chosen,
+// which is unlikely when that MSE is already low, or spread evenly over the
+// quadrants so that no quadrant has a better vector of its own.
+template <int BLOCK>
+static int prune_8x8(int mse16, const int *split, int block_height) {
+  const int quadrants = block_height > BLOCK / 2 ? 4 : 2;
+  int min_split = split[0];
+  int max_split = split[0];
+
+  if (mse16 < PRUNE_MSE * BLOCK * block_height) {
+    return 1;
+  }
+  for (int q = 1; q < quadrants; q++) {
+    min_split = split[q] < min_split ? split[q] : min_split;
+    max_split = split[q] > max_split ? split[q] : max_split;
+  }
+  return (max_split - min_split) * PRUNE_SPREAD < mse16;
+}
+
 static void interpolate_mv(MV *mv1, MV *pMV, const DIM dim, int block_width,
                            int block_height, int pos_x, int pos_y, short td1) {
   mv1->y = (td1 * pMV->y + 16384) >> 15;
@@ -318,17 +908,192 @@ static void copy_mv(MV *mv2, MV *mv1) {
   mv2->x = mv1->x;
 }
 
-int spatial_search(unsigned char *current, unsigned char *reference, int stride,
-                   const DIM dim, int block_width, int block_height,
-                   MV *motion_vectors, int *SADs, int *mses,
-                   unsigned char *MB_modes, int *count_I, int *bits) {
-  UNUSED(reference);
-  UNUSED(motion_vectors);
-  UNUSED(SADs);
+// MSE of quadrant q of a macroblock at its 8x8 vector mv. When the 8x8 search
+// stayed on the 16x16 vector mv16, the quadrant MSE from the 16x16 pass in
+// split[] is reused.
+template <int BLOCK>
+static int quadrant_mse(unsigned char *current, unsigned char *reference,
+                        int stride, int block_height, const MV *mv,
+                        const MV *mv16, const int *split, int q) {
+  constexpr int HALF = BLOCK / 2;
+
+  if (mv->y == mv16->y && mv->x == mv16->x) {
+    return split[q];
+  }
+
+  const int offset = (q >> 1) * HALF * stride + (q & 1) * HALF;
+  return kernels_t<HALF>::mse(current + offset,
+                              reference + offset + mv->y * stride + mv->x,
+                              stride, HALF, block_height);
+}
 
+// Intra cost of the macroblock at current: the variance of the 16x16 block,
+// or the sum of the 8x8 variances when that is cheaper
+template <int BLOCK>
+static int intra_cost(unsigned char *current, int stride, int block_height) {
+  int block_mse16, block_mse8;
+  int split[4];
+
+  // Try 16x16 mode first, with 8x8 mode from the same pass
+  block_mse16 = variance_split<BLOCK>(current, stride, block_height, split);
+  block_mse8 = split[0] + split[1] + split[2] + split[3];
+  if (block_mse8 < NORMALIZE(block_mse16)) {
+    return block_mse8;
+  }
+  return block_mse16;
+}
+
+// Index of a block size in the tables of the instances below
+static int block_size_index(int block_size) {
+  switch (block_size) {
+  case 8:
+    return 0;
+  case 32:
+    return 2;
+  case 64:
+    return 3;
+  default:
+    return 1;
+  }
+}
+
+template <int BLOCK>
+static void intra_costs_t(unsigned char *current, int stride, const DIM dim,
+                          int block_width, int block_height, int *costs) {
   int i, j;
-  int block_mse, line_mse, mse;
-  int stride_MB = dim.width / MB_WIDTH + 2;
+  int stride_MB = dim.width / BLOCK + 2;
+  int mbx;
+
+  for (i = 0; i < dim.height; i += block_height) {
+    // Special case for 1920x1080 - works for all non-multiple of MBs height
+    if (i > dim.height - block_height) {
+      block_height = dim.height - i;
+    }
+    for (j = 0, mbx = 0; j < dim.width; j += block_width, mbx++) {
+      costs[mbx] = intra_cost<BLOCK>(current + j, stride, block_height);
+    }
+    current += block_height * stride;
+    costs += stride_MB;
+  }
+}
+
+void intra_costs(unsigned char *current, int stride, const DIM dim,
+                 int block_width, int block_height, int *costs) {
+  static decltype(&intra_costs_t<MB_WIDTH>) const costs_of[] = {
+      intra_costs_t<8>,
+      intra_costs_t<16>,
+      intra_costs_t<32>,
+      intra_costs_t<64>,
+  };
+
+  costs_of[block_size_index(block_width)](current, stride, dim, block_width,
+                                          block_height, costs);
+}
+
+size_t pyramid_size(const DIM dim) {
+  size_t size = 0;
+  DIM level = dim;
+
+  for (int i = 0; i < PYRAMID_LEVELS; i++) {
+    level = level / 2;
+    size += (size_t)level.width * level.height;
+  }
+  return size;
+}
+
+void build_pyramid(const unsigned char *luma, int stride, const DIM dim,
+                   unsigned char *buffer, pyramid_t *pyramid) {
+  DIM level = dim;
+
+  for (int i = 0; i < PYRAMID_LEVELS; i++) {
+    level = level / 2;
+    decimate2x2(buffer, level.width, luma, stride, level.width, level.height);
+    pyramid->planes[i] = buffer;
+    pyramid->strides[i] = level.width;
+    pyramid->dims[i] = level;
+    luma = buffer;
+    stride = level.width;
+    buffer += (size_t)level.width * level.height;
+  }
+}
+
+// Best vector of the block of macroblock (mbx, mby) in one level, within
+// range of mv and with the block inside the picture. The center is scored
+// first, so ties keep it. mv is left as is when the block doesn't fit.
+static void level_search(const pyramid_t *current, const pyramid_t *reference,
+                         int block_size, int level, int mbx, int mby,
+                         int range, MV *mv) {
+  const int size = block_size >> (level + 1);
+  const int stride = current->strides[level];
+  const DIM dim = current->dims[level];
+  const int pos_x = mbx * size;
+  const int pos_y = mby * size;
+
+  if (pos_x + size > dim.width || pos_y + size > dim.height) {
+    return;
+  }
+
+  const int min_y = std::max(-pos_y, mv->y - range);
+  const int max_y = std::min(dim.height - size - pos_y, mv->y + range);
+  const int min_x = std::max(-pos_x, mv->x - range);
+  const int max_x = std::min(dim.width - size - pos_x, mv->x + range);
+  const unsigned char *cur = current->planes[level] + pos_y * stride + pos_x;
+  const unsigned char *ref = reference->planes[level] + pos_y * stride + pos_x;
+  const t_SAD_xN SAD_xN = size == 32   ? fastSAD32_xN
+                          : size == 16 ? fastSAD16_xN
+                          : size == 8  ? fastSAD8_xN
+                                       : fastSAD4_xN;
+  const uint8_t *level_ref;
+  MV best;
+  int best_SAD;
+
+  best.y = RANGE_CLIP(min_y, mv->y, max_y);
+  best.x = RANGE_CLIP(min_x, mv->x, max_x);
+  level_ref = ref + best.y * stride + best.x;
+  SAD_xN(cur, &level_ref, 1, stride, size, size, INT_MAX, &best_SAD);
+  for (int y = min_y; y <= max_y && best_SAD > 0; y++) {
+    for (int x = min_x; x <= max_x; x++) {
+      int SAD_val;
+      level_ref = ref + y * stride + x;
+      SAD_xN(cur, &level_ref, 1, stride, size, size, best_SAD, &SAD_val);
+      if (SAD_val < best_SAD) {
+        best_SAD = SAD_val;
+        best.y = (int16_t)y;
+        best.x = (int16_t)x;
+      }
+    }
+  }
+  *mv = best;
+}
+
+void pyramid_search(const pyramid_t *current, const pyramid_t *reference,
+                    const DIM dim, int block_size, MV *seeds) {
+  const int stride_MB = dim.width / block_size + 2;
+  const int mbs_x = (dim.width + block_size - 1) / block_size;
+  const int mbs_y = (dim.height + block_size - 1) / block_size;
+
+  for (int mby = 0; mby < mbs_y; mby++) {
+    for (int mbx = 0; mbx < mbs_x; mbx++) {
+      MV mv = {0, 0};
+      for (int level = PYRAMID_LEVELS - 1; level >= 0; level--) {
+        level_search(current, reference, block_size, level, mbx, mby,
+                     level == PYRAMID_LEVELS - 1 ? PYRAMID_RANGE : 1, &mv);
+        mv.y *= 2;
+        mv.x *= 2;
+      }
+      seeds[mby * stride_MB + mbx] = mv;
+    }
+  }
+}
+
+template <int BLOCK>
+static int spatial_search_t(unsigned char *current, int stride, const DIM dim,
+                            int block_width, int block_height, int *mses,
+                            unsigned char *MB_modes, int *count_I, int *bits) {
+  int i, j;
+  int block_mse, mse;
+  int64_t line_mse;
+  int stride_MB = dim.width / BLOCK + 2;
   int mbx;
   int val, k;
 
@@ -342,27 +1107,7 @@ int spatial_search(unsigned char *current, unsigned char *reference, int stride,
     }
     line_mse = 0;
     for (j = 0, mbx = 0; j < dim.width; j += block_width, mbx++) {
-      int block_mse16, block_mse8;
-
-      // Try 16x16 mode first
-      block_mse16 = fast_variance16(current + j, stride, 16, block_height);
-      // Now 8x8 mode
-      if (block_height > 8) {
-        block_mse8 = fast_variance8(current + j, stride, 8, 8);
-        block_mse8 += fast_variance8(current + 8 + j, stride, 8, 8);
-        block_mse8 += fast_variance8(current + 8 * stride + j, stride, 8,
-                                     block_height - 8);
-        block_mse8 += fast_variance8(current + 8 * stride + 8 + j, stride, 8,
-                                     block_height - 8);
-      } else {
-        block_mse8 = fast_variance8(current + j, stride, 8, block_height);
-        block_mse8 += fast_variance8(current + 8 + j, stride, 8, block_height);
-      }
-      if (block_mse8 < NORMALIZE(block_mse16)) {
-        block_mse = block_mse8;
-      } else {
-        block_mse = block_mse16;
-      }
+      block_mse = intra_cost<BLOCK>(current + j, stride, block_height);
       mses[mbx] = block_mse;
       line_mse += block_mse;
       MB_modes[mbx] = 0;
@@ -371,7 +1116,7 @@ int spatial_search(unsigned char *current, unsigned char *reference, int stride,
       (*bits) += k;
     }
     (*count_I) += mbx;
-    mse += (line_mse + 128) >> 8;
+    mse += (int)((line_mse + 128) >> 8);
     current += block_height * stride;
     mses += stride_MB;
     MB_modes += stride_MB;
@@ -380,22 +1125,73 @@ int spatial_search(unsigned char *current, unsigned char *reference, int stride,
   return mse;
 }
 
+int spatial_search(unsigned char *current, unsigned char *reference, int stride,
+                   const DIM dim, int block_width, int block_height,
+                   MV *motion_vectors, int *SADs, int *mses,
+                   unsigned char *MB_modes, int *count_I, int *bits) {
+  UNUSED(reference);
+  UNUSED(motion_vectors);
+  UNUSED(SADs);
+
+  static decltype(&spatial_search_t<MB_WIDTH>) const searches[] = {
+      spatial_search_t<8>,
+      spatial_search_t<16>,
+      spatial_search_t<32>,
+      spatial_search_t<64>,
+  };
+
+  return searches[block_size_index(block_width)](
+      current, stride, dim, block_width, block_height, mses, MB_modes,
+      count_I, bits);
+}
+
 int motion_search(unsigned char *current, unsigned char *reference, int stride,
                   const DIM dim, int block_width, int block_height,
                   MV *motion_vectors, int *SADs, int *mses,
                   unsigned char *MB_modes, int *count_I, int *count_P,
                   int *bits) {
+  *count_I = *count_P = 0;
+  *bits = 0;
+  return motion_search_rows(current, reference, stride, dim, block_width,
+                            block_height, 0, INT_MAX, motion_vectors, SADs,
+                            mses, MB_modes, NULL, NULL, ME_PMVFAST, 0, 0,
+                            count_I, count_P, NULL, bits, NULL, NULL);
+}
+
+template <int BLOCK, t_search SEARCH>
+static int
+motion_search_rows_t(unsigned char *current, unsigned char *reference,
+                     int stride, const DIM dim, int block_width,
+                     int block_height, int first_row, int last_row,
+                     MV *motion_vectors, int *SADs, int *mses,
+                     unsigned char *MB_modes, const int *intra, const MV *seeds,
+                     int prune, int skip_threshold, int *count_I, int *count_P,
+                     int *count_skip, int *bits, row_sync_t sync,
+                     void *opaque) {
+  constexpr int HALF = BLOCK / 2;
+  constexpr t_SAD_xN SAD_xN = kernels_t<BLOCK>::SAD_xN;
+  constexpr t_SAD_xN half_SAD_xN = kernels_t<HALF>::SAD_xN;
+  quadrant_cache_t quadrants = {};
+  const search_area_t area = {current, dim, BLOCK, seeds, &quadrants};
   int i, j;
+  int row;
   int temp_SAD;
-  int block_mse, line_mse, mse;
-  int stride_MB = dim.width / MB_WIDTH + 2;
+  int block_mse, mse;
+  int64_t line_mse;
+  int stride_MB = dim.width / BLOCK + 2;
   int mbx;
   int val, k;
 
+  current += first_row * block_height * stride;
+  reference += first_row * block_height * stride;
+  SADs += first_row * stride_MB;
+  motion_vectors += first_row * stride_MB;
+  mses += first_row * stride_MB;
+  MB_modes += first_row * stride_MB;
+
   mse = 0;
-  *count_I = *count_P = 0;
-  *bits = 0;
-  for (i = 0; i < dim.height; i += block_height) {
+  for (i = first_row * block_height, row = first_row;
+       i < dim.height && row < last_row; i += block_height, row++) {
     // Special case for 1920x1080 - works for all non-multiple of MBs height
     if (i > dim.height - block_height) {
       block_height = dim.height - i;
@@ -404,95 +1200,106 @@ int motion_search(unsigned char *current, unsigned char *reference, int stride,
     for (j = 0, mbx = 0; j < dim.width; j += block_width, mbx++) {
       int var;
       int block_mse16, block_mse8;
+      int split[4];
       MV backup_MV;
       int backup_SAD;
 
-      // Try 16x16 mode first
-      block_mse16 = fast_variance16(current + j, stride, 16, block_height);
-      // Now 8x8 mode
-      if (block_height > 8) {
-        block_mse8 = fast_variance8(current + j, stride, 8, 8);
-        block_mse8 += fast_variance8(current + 8 + j, stride, 8, 8);
-        block_mse8 += fast_variance8(current + 8 * stride + j, stride, 8,
-                                     block_height - 8);
-        block_mse8 += fast_variance8(current + 8 * stride + 8 + j, stride, 8,
-                                     block_height - 8);
-      } else {
-        block_mse8 = fast_variance8(current + j, stride, 8, block_height);
-        block_mse8 += fast_variance8(current + 8 + j, stride, 8, block_height);
+      if (sync != NULL) {
+        sync(opaque, row, mbx);
       }
-      if (block_mse8 < NORMALIZE(block_mse16)) {
-        var = block_mse8;
+
+      // A block that barely changed along the zero or the predicted vector is
+      // coded P with it, without the search, the 8x8 modes and the intra cost
+      if (skip_threshold > 0) {
+        MV skip_MV;
+        temp_SAD = static_SAD<BLOCK>(current + j, reference + j, stride,
+                                     &motion_vectors[mbx], block_height, &area,
+                                     &skip_MV);
+        if (temp_SAD < skip_threshold * BLOCK * block_height) {
+          copy_mv(&motion_vectors[mbx], &skip_MV);
+          SADs[mbx] = temp_SAD;
+          MB_modes[mbx] = 1;
+          (*count_P)++;
+          (*count_skip)++;
+          block_mse = kernels_t<BLOCK>::mse(
+              current + j, reference + j + skip_MV.y * stride + skip_MV.x,
+              stride, BLOCK, block_height);
+          mses[mbx] = block_mse;
+          line_mse += block_mse;
+          for (val = 1, k = 0; val <= block_mse; k++, val <<= 1) {
+          }
+          (*bits) += k;
+          continue;
+        }
+      }
+
+      if (intra != NULL) {
+        var = intra[row * stride_MB + mbx];
       } else {
-        var = block_mse16;
+        var = intra_cost<BLOCK>(current + j, stride, block_height);
       }
       // Try 16x16 mode first
-      temp_SAD =
-          SEARCH_MV(current + j, reference + j, stride, &motion_vectors[mbx],
-                    16, block_height, &SADs[mbx], fastSAD16);
-      block_mse16 =
-          fast_calc_mse16(current + j,
-                          reference + j + motion_vectors[mbx].y * stride +
-                              motion_vectors[mbx].x,
-                          stride, 16, block_height);
+      temp_SAD = SEARCH(current + j, reference + j, stride,
+                        &motion_vectors[mbx], BLOCK, block_height, &SADs[mbx],
+                        SAD_xN, &area);
+      block_mse16 = mse_split<BLOCK>(
+          current + j,
+          reference + j + motion_vectors[mbx].y * stride +
+              motion_vectors[mbx].x,
+          stride, block_height, split);
       copy_mv(&backup_MV, &motion_vectors[mbx]);
       backup_SAD = temp_SAD;
       // Now 8x8 mode
-      if (block_height > 8) {
-        temp_SAD = SEARCH_MV(current + j, reference + j, stride,
-                             &motion_vectors[mbx], 8, 8, &SADs[mbx], fastSAD8);
-        block_mse8 =
-            fast_calc_mse8(current + j,
-                           reference + j + motion_vectors[mbx].y * stride +
-                               motion_vectors[mbx].x,
-                           stride, 8, 8);
+      if (prune && prune_8x8<BLOCK>(block_mse16, split, block_height)) {
+        block_mse8 = INT_MAX;
+      } else if (block_height > HALF) {
+        temp_SAD = SEARCH(current + j, reference + j, stride,
+                          &motion_vectors[mbx], HALF, HALF, &SADs[mbx],
+                          half_SAD_xN, &area);
+        block_mse8 = quadrant_mse<BLOCK>(current + j, reference + j, stride,
+                                         HALF, &motion_vectors[mbx],
+                                         &backup_MV, split, 0);
         copy_mv(&motion_vectors[mbx], &backup_MV);
-        temp_SAD = SEARCH_MV(current + 8 + j, reference + 8 + j, stride,
-                             &motion_vectors[mbx], 8, 8, &SADs[mbx], fastSAD8);
-        block_mse8 +=
-            fast_calc_mse8(current + 8 + j,
-                           reference + 8 + j + motion_vectors[mbx].y * stride +
-                               motion_vectors[mbx].x,
-                           stride, 8, 8);
+        temp_SAD = SEARCH(current + HALF + j, reference + HALF + j, stride,
+                          &motion_vectors[mbx], HALF, HALF, &SADs[mbx],
+                          half_SAD_xN, &area);
+        block_mse8 += quadrant_mse<BLOCK>(current + j, reference + j, stride,
+                                          HALF, &motion_vectors[mbx],
+                                          &backup_MV, split, 1);
         copy_mv(&motion_vectors[mbx], &backup_MV);
-        temp_SAD = SEARCH_MV(
-            current + 8 * stride + j, reference + 8 * stride + j, stride,
-            &motion_vectors[mbx], 8, block_height - 8, &SADs[mbx], fastSAD8);
-        block_mse8 += fast_calc_mse8(current + 8 * stride + j,
-                                     reference + 8 * stride + j +
-                                         motion_vectors[mbx].y * stride +
-                                         motion_vectors[mbx].x,
-                                     stride, 8, block_height - 8);
+        temp_SAD = SEARCH(current + HALF * stride + j,
+                          reference + HALF * stride + j, stride,
+                          &motion_vectors[mbx], HALF, block_height - HALF,
+                          &SADs[mbx], half_SAD_xN, &area);
+        block_mse8 += quadrant_mse<BLOCK>(current + j, reference + j, stride,
+                                          block_height - HALF,
+                                          &motion_vectors[mbx], &backup_MV,
+                                          split, 2);
         copy_mv(&motion_vectors[mbx], &backup_MV);
-        temp_SAD = SEARCH_MV(current + 8 * stride + 8 + j,
-                             reference + 8 * stride + 8 + j, stride,
-                             &motion_vectors[mbx], 8, block_height - 8,
-                             &SADs[mbx], fastSAD8);
-        block_mse8 += fast_calc_mse8(current + 8 * stride + 8 + j,
-                                     reference + 8 * stride + 8 + j +
-                                         motion_vectors[mbx].y * stride +
-                                         motion_vectors[mbx].x,
-                                     stride, 8, block_height - 8);
+        temp_SAD = SEARCH(current + HALF * stride + HALF + j,
+                          reference + HALF * stride + HALF + j, stride,
+                          &motion_vectors[mbx], HALF, block_height - HALF,
+                          &SADs[mbx], half_SAD_xN, &area);
+        block_mse8 += quadrant_mse<BLOCK>(current + j, reference + j, stride,
+                                          block_height - HALF,
+                                          &motion_vectors[mbx], &backup_MV,
+                                          split, 3);
         copy_mv(&motion_vectors[mbx], &backup_MV);
         temp_SAD = backup_SAD;
       } else {
-        temp_SAD =
-            SEARCH_MV(current + j, reference + j, stride, &motion_vectors[mbx],
-                      8, block_height, &SADs[mbx], fastSAD8);
-        block_mse8 =
-            fast_calc_mse8(current + j,
-                           reference + j + motion_vectors[mbx].y * stride +
-                               motion_vectors[mbx].x,
-                           stride, 8, block_height);
+        temp_SAD = SEARCH(current + j, reference + j, stride,
+                          &motion_vectors[mbx], HALF, block_height, &SADs[mbx],
+                          half_SAD_xN, &area);
+        block_mse8 = quadrant_mse<BLOCK>(current + j, reference + j, stride,
+                                         block_height, &motion_vectors[mbx],
+                                         &backup_MV, split, 0);
         copy_mv(&motion_vectors[mbx], &backup_MV);
-        temp_SAD = SEARCH_MV(current + 8 + j, reference + 8 + j, stride,
-                             &motion_vectors[mbx], 8, block_height, &SADs[mbx],
-                             fastSAD8);
-        block_mse8 +=
-            fast_calc_mse8(current + 8 + j,
-                           reference + 8 + j + motion_vectors[mbx].y * stride +
-                               motion_vectors[mbx].x,
-                           stride, 8, block_height);
+        temp_SAD = SEARCH(current + HALF + j, reference + HALF + j, stride,
+                          &motion_vectors[mbx], HALF, block_height, &SADs[mbx],
+                          half_SAD_xN, &area);
+        block_mse8 += quadrant_mse<BLOCK>(current + j, reference + j, stride,
+                                          block_height, &motion_vectors[mbx],
+                                          &backup_MV, split, 1);
         copy_mv(&motion_vectors[mbx], &backup_MV);
         temp_SAD = backup_SAD;
       }
@@ -520,7 +1327,10 @@ int motion_search(unsigned char *current, unsigned char *reference, int stride,
       }
       (*bits) += k;
     }
-    mse += (line_mse + 128) >> 8;
+    if (sync != NULL) {
+      sync(opaque, row, mbx);
+    }
+    mse += (int)((line_mse + 128) >> 8);
     current += block_height * stride;
     reference += block_height * stride;
     SADs += stride_MB;
@@ -532,7 +1342,6 @@ int motion_search(unsigned char *current, unsigned char *reference, int stride,
   return mse;
 }
 
-// Assume td1+td2 = 32768 = 2^15
 int bidir_motion_search(unsigned char *current, unsigned char *reference1,
                         unsigned char *reference2, int stride, const DIM dim,
                         int block_width, int block_height, MV *P_motion_vectors,
@@ -540,18 +1349,59 @@ int bidir_motion_search(unsigned char *current, unsigned char *reference1,
                         int *SADs2, int *mses, unsigned char *MB_modes,
                         short td1, short td2, int *count_I, int *count_P,
                         int *count_B, int *bits) {
+  *count_I = *count_P = *count_B = 0;
+  *bits = 0;
+  return bidir_motion_search_rows(current, reference1, reference2, stride, dim,
+                                  block_width, block_height, 0, INT_MAX,
+                                  P_motion_vectors, motion_vectors1,
+                                  motion_vectors2, SADs1, SADs2, mses, MB_modes,
+                                  NULL, NULL, NULL, ME_PMVFAST, 0, td1, td2,
+                                  count_I, count_P, count_B, bits, NULL, NULL);
+}
+
+// Assume td1+td2 = 32768 = 2^15
+template <int BLOCK, t_search SEARCH>
+static int bidir_motion_search_rows_t(
+    unsigned char *current, unsigned char *reference1,
+    unsigned char *reference2, int stride, const DIM dim, int block_width,
+    int block_height, int first_row, int last_row, MV *P_motion_vectors,
+    MV *motion_vectors1, MV *motion_vectors2, int *SADs1, int *SADs2,
+    int *mses, unsigned char *MB_modes, const int *intra, const MV *seeds1,
+    const MV *seeds2, int prune, short td1, short td2, int *count_I,
+    int *count_P, int *count_B, int *bits, row_sync_t sync, void *opaque) {
+  constexpr int HALF = BLOCK / 2;
+  constexpr t_SAD_xN SAD_xN = kernels_t<BLOCK>::SAD_xN;
+  constexpr t_SAD_xN half_SAD_xN = kernels_t<HALF>::SAD_xN;
+  constexpr auto bidir_mse = kernels_t<BLOCK>::bidir_mse;
+  constexpr auto half_bidir_mse = kernels_t<HALF>::bidir_mse;
+  // The searches in each reference try the pyramid vectors against it
+  quadrant_cache_t quadrants = {};
+  const search_area_t area1 = {current, dim, BLOCK, seeds1, &quadrants};
+  const search_area_t area2 = {current, dim, BLOCK, seeds2, &quadrants};
   int i, j;
-  int block_mse, block_mse1, block_mse2, line_mse, mse;
-  int stride_MB = dim.width / MB_WIDTH + 2;
+  int row;
+  int block_mse, block_mse1, block_mse2, mse;
+  int64_t line_mse;
+  int stride_MB = dim.width / BLOCK + 2;
   int mbx;
   MV td = {td1, td2};
   int temp_SAD;
   int val, k;
 
+  current += first_row * block_height * stride;
+  reference1 += first_row * block_height * stride;
+  reference2 += first_row * block_height * stride;
+  P_motion_vectors += first_row * stride_MB;
+  motion_vectors1 += first_row * stride_MB;
+  motion_vectors2 += first_row * stride_MB;
+  SADs1 += first_row * stride_MB;
+  SADs2 += first_row * stride_MB;
+  mses += first_row * stride_MB;
+  MB_modes += first_row * stride_MB;
+
   mse = 0;
-  *count_I = *count_P = *count_B = 0;
-  *bits = 0;
-  for (i = 0; i < dim.height; i += block_height) {
+  for (i = first_row * block_height, row = first_row;
+       i < dim.height && row < last_row; i += block_height, row++) {
     // Special case for 1920x1080 - works for all non-multiple of MBs height
     if (i > dim.height - block_height) {
       block_height = dim.height - i;
@@ -562,30 +1412,22 @@ int bidir_motion_search(unsigned char *current, unsigned char *reference1,
       MV *mv1 = &motion_vectors1[mbx];
       MV *mv2 = &motion_vectors2[mbx];
       int block_mse16, block_mse8;
+      int split[4];
       MV backup_MV;
-      MV tempMV1[4];
-      MV tempMV2[4];
+      MV tempMV1[4] = {};
+      MV tempMV2[4] = {};
       int tempMSEs[4];
       int backup_SAD;
+      int pruned;
 
-      // Try 16x16 mode first
-      block_mse16 = fast_variance16(current + j, stride, 16, block_height);
-      // Now 8x8 mode
-      if (block_height > 8) {
-        block_mse8 = fast_variance8(current + j, stride, 8, 8);
-        block_mse8 += fast_variance8(current + 8 + j, stride, 8, 8);
-        block_mse8 += fast_variance8(current + 8 * stride + j, stride, 8,
-                                     block_height - 8);
-        block_mse8 += fast_variance8(current + 8 * stride + 8 + j, stride, 8,
-                                     block_height - 8);
-      } else {
-        block_mse8 = fast_variance8(current + j, stride, 8, block_height);
-        block_mse8 += fast_variance8(current + 8 + j, stride, 8, block_height);
+      if (sync != NULL) {
+        sync(opaque, row, mbx);
       }
-      if (block_mse8 < NORMALIZE(block_mse16)) {
-        var = block_mse8;
+
+      if (intra != NULL) {
+        var = intra[row * stride_MB + mbx];
       } else {
-        var = block_mse16;
+        var = intra_cost<BLOCK>(current + j, stride, block_height);
       }
 
       if (td1 <= td2) {
@@ -593,61 +1435,63 @@ int bidir_motion_search(unsigned char *current, unsigned char *reference1,
                        block_height, j, i, td1);
 
         // Try 16x16 mode first
-        temp_SAD = SEARCH_MV(current + j, reference1 + j, stride, mv1, 16,
-                             block_height, &SADs1[mbx], fastSAD16);
-        block_mse16 = fast_calc_mse16(current + j,
-                                      reference1 + j + mv1->y * stride + mv1->x,
-                                      stride, 16, block_height);
+        temp_SAD = SEARCH(current + j, reference1 + j, stride, mv1, BLOCK,
+                          block_height, &SADs1[mbx], SAD_xN, &area1);
+        block_mse16 = mse_split<BLOCK>(
+            current + j, reference1 + j + mv1->y * stride + mv1->x, stride,
+            block_height, split);
         copy_mv(&backup_MV, mv1);
         backup_SAD = temp_SAD;
-        // Now 8x8 mode
-        if (block_height > 8) {
-          temp_SAD = SEARCH_MV(current + j, reference1 + j, stride, mv1, 8, 8,
-                               &SADs1[mbx], fastSAD8);
-          tempMSEs[0] = fast_calc_mse8(
-              current + j, reference1 + j + mv1->y * stride + mv1->x, stride, 8,
-              8);
+        // Now 8x8 mode, unless pruned on the 16x16 MSE of this reference
+        pruned = prune && prune_8x8<BLOCK>(block_mse16, split, block_height);
+        if (pruned) {
+          tempMSEs[0] = tempMSEs[1] = tempMSEs[2] = tempMSEs[3] = 0;
+        } else if (block_height > HALF) {
+          temp_SAD = SEARCH(current + j, reference1 + j, stride, mv1, HALF,
+                            HALF, &SADs1[mbx], half_SAD_xN, &area1);
+          tempMSEs[0] = quadrant_mse<BLOCK>(current + j, reference1 + j, stride,
+                                            HALF, mv1, &backup_MV, split, 0);
           copy_mv(&tempMV1[0], mv1);
           copy_mv(mv1, &backup_MV);
-          temp_SAD = SEARCH_MV(current + 8 + j, reference1 + 8 + j, stride, mv1,
-                               8, 8, &SADs1[mbx], fastSAD8);
-          tempMSEs[1] = fast_calc_mse8(
-              current + 8 + j, reference1 + 8 + j + mv1->y * stride + mv1->x,
-              stride, 8, 8);
+          temp_SAD = SEARCH(current + HALF + j, reference1 + HALF + j, stride,
+                            mv1, HALF, HALF, &SADs1[mbx], half_SAD_xN, &area1);
+          tempMSEs[1] = quadrant_mse<BLOCK>(current + j, reference1 + j, stride,
+                                            HALF, mv1, &backup_MV, split, 1);
           copy_mv(&tempMV1[1], mv1);
           copy_mv(mv1, &backup_MV);
-          temp_SAD = SEARCH_MV(current + 8 * stride + j,
-                               reference1 + 8 * stride + j, stride, mv1, 8,
-                               block_height - 8, &SADs1[mbx], fastSAD8);
-          tempMSEs[2] = fast_calc_mse8(current + 8 * stride + j,
-                                       reference1 + 8 * stride + j +
-                                           mv1->y * stride + mv1->x,
-                                       stride, 8, block_height - 8);
+          temp_SAD = SEARCH(current + HALF * stride + j,
+                            reference1 + HALF * stride + j, stride, mv1, HALF,
+                            block_height - HALF, &SADs1[mbx], half_SAD_xN,
+                            &area1);
+          tempMSEs[2] = quadrant_mse<BLOCK>(current + j, reference1 + j, stride,
+                                            block_height - HALF, mv1,
+                                            &backup_MV, split, 2);
           copy_mv(&tempMV1[2], mv1);
           copy_mv(mv1, &backup_MV);
-          temp_SAD = SEARCH_MV(current + 8 * stride + 8 + j,
-                               reference1 + 8 * stride + 8 + j, stride, mv1, 8,
-                               block_height - 8, &SADs1[mbx], fastSAD8);
-          tempMSEs[3] = fast_calc_mse8(current + 8 * stride + 8 + j,
-                                       reference1 + 8 * stride + 8 + j +
-                                           mv1->y * stride + mv1->x,
-                                       stride, 8, block_height - 8);
+          temp_SAD = SEARCH(current + HALF * stride + HALF + j,
+                            reference1 + HALF * stride + HALF + j, stride, mv1,
+                            HALF, block_height - HALF, &SADs1[mbx], half_SAD_xN,
+                            &area1);
+          tempMSEs[3] = quadrant_mse<BLOCK>(current + j, reference1 + j, stride,
+                                            block_height - HALF, mv1,
+                                            &backup_MV, split, 3);
           copy_mv(&tempMV1[3], mv1);
           copy_mv(mv1, &backup_MV);
           temp_SAD = backup_SAD;
         } else {
-          temp_SAD = SEARCH_MV(current + j, reference1 + j, stride, mv1, 8,
-                               block_height, &SADs1[mbx], fastSAD8);
-          tempMSEs[0] = fast_calc_mse8(
-              current + j, reference1 + j + mv1->y * stride + mv1->x, stride, 8,
-              block_height);
+          temp_SAD = SEARCH(current + j, reference1 + j, stride, mv1, HALF,
+                            block_height, &SADs1[mbx], half_SAD_xN, &area1);
+          tempMSEs[0] = quadrant_mse<BLOCK>(current + j, reference1 + j, stride,
+                                            block_height, mv1, &backup_MV,
+                                            split, 0);
           copy_mv(&tempMV1[0], mv1);
           copy_mv(mv1, &backup_MV);
-          temp_SAD = SEARCH_MV(current + 8 + j, reference1 + 8 + j, stride, mv1,
-                               8, block_height, &SADs1[mbx], fastSAD8);
-          tempMSEs[1] = fast_calc_mse8(
-              current + 8 + j, reference1 + 8 + j + mv1->y * stride + mv1->x,
-              stride, 8, block_height);
+          temp_SAD = SEARCH(current + HALF + j, reference1 + HALF + j, stride,
+                            mv1, HALF, block_height, &SADs1[mbx], half_SAD_xN,
+                            &area1);
+          tempMSEs[1] = quadrant_mse<BLOCK>(current + j, reference1 + j, stride,
+                                            block_height, mv1, &backup_MV,
+                                            split, 1);
           copy_mv(&tempMV1[1], mv1);
           copy_mv(mv1, &backup_MV);
           temp_SAD = backup_SAD;
@@ -665,82 +1509,86 @@ int bidir_motion_search(unsigned char *current, unsigned char *reference1,
                          block_height, j, i);
 
         // Try 16x16 mode first
-        temp_SAD = SEARCH_MV(current + j, reference2 + j, stride, mv2, 16,
-                             block_height, &SADs2[mbx], fastSAD16);
-        block_mse16 = fast_calc_mse16(current + j,
-                                      reference2 + j + mv2->y * stride + mv2->x,
-                                      stride, 16, block_height);
+        temp_SAD = SEARCH(current + j, reference2 + j, stride, mv2, BLOCK,
+                          block_height, &SADs2[mbx], SAD_xN, &area2);
+        block_mse16 = mse_split<BLOCK>(
+            current + j, reference2 + j + mv2->y * stride + mv2->x, stride,
+            block_height, split);
         copy_mv(&backup_MV, mv2);
         backup_SAD = temp_SAD;
-        // Now 8x8 mode
-        if (block_height > 8) {
-          temp_SAD = SEARCH_MV(current + j, reference2 + j, stride, mv2, 8, 8,
-                               &SADs2[mbx], fastSAD8);
-          block_mse8 = fast_calc_mse8(current + j,
-                                      reference2 + j + mv2->y * stride + mv2->x,
-                                      stride, 8, 8);
-          if (block_mse8 < tempMSEs[0]) {
-            tempMSEs[0] = block_mse8;
-          }
-          copy_mv(&tempMV2[0], mv2);
-          copy_mv(mv2, &backup_MV);
-          temp_SAD = SEARCH_MV(current + 8 + j, reference2 + 8 + j, stride, mv2,
-                               8, 8, &SADs2[mbx], fastSAD8);
-          block_mse8 = fast_calc_mse8(
-              current + 8 + j, reference2 + 8 + j + mv2->y * stride + mv2->x,
-              stride, 8, 8);
-          if (block_mse8 < tempMSEs[1]) {
-            tempMSEs[1] = block_mse8;
-          }
-          copy_mv(&tempMV2[1], mv2);
-          copy_mv(mv2, &backup_MV);
-          temp_SAD = SEARCH_MV(current + 8 * stride + j,
-                               reference2 + 8 * stride + j, stride, mv2, 8,
-                               block_height - 8, &SADs2[mbx], fastSAD8);
-          block_mse8 = fast_calc_mse8(current + 8 * stride + j,
-                                      reference2 + 8 * stride + j +
-                                          mv2->y * stride + mv2->x,
-                                      stride, 8, block_height - 8);
-          if (block_mse8 < tempMSEs[2]) {
-            tempMSEs[2] = block_mse8;
-          }
-          copy_mv(&tempMV2[2], mv2);
-          copy_mv(mv2, &backup_MV);
-          temp_SAD = SEARCH_MV(current + 8 * stride + 8 + j,
-                               reference2 + 8 * stride + 8 + j, stride, mv2, 8,
-                               block_height - 8, &SADs2[mbx], fastSAD8);
-          block_mse8 = fast_calc_mse8(current + 8 * stride + 8 + j,
-                                      reference2 + 8 * stride + 8 + j +
-                                          mv2->y * stride + mv2->x,
-                                      stride, 8, block_height - 8);
-          if (block_mse8 < tempMSEs[3]) {
-            tempMSEs[3] = block_mse8;
-          }
-          copy_mv(&tempMV2[3], mv2);
-          copy_mv(mv2, &backup_MV);
-          temp_SAD = backup_SAD;
-        } else {
-          temp_SAD = SEARCH_MV(current + j, reference2 + j, stride, mv2, 8,
-                               block_height, &SADs2[mbx], fastSAD8);
-          block_mse8 = fast_calc_mse8(current + j,
-                                      reference2 + j + mv2->y * stride + mv2->x,
-                                      stride, 8, block_height);
-          if (block_mse8 < tempMSEs[0]) {
-            tempMSEs[0] = block_mse8;
+        // Now 8x8 mode, unless pruned with the other reference
+        if (!pruned) {
+          if (block_height > HALF) {
+            temp_SAD = SEARCH(current + j, reference2 + j, stride, mv2, HALF,
+                              HALF, &SADs2[mbx], half_SAD_xN, &area2);
+            block_mse8 = quadrant_mse<BLOCK>(current + j, reference2 + j,
+                                             stride, HALF, mv2, &backup_MV,
+                                             split, 0);
+            if (block_mse8 < tempMSEs[0]) {
+              tempMSEs[0] = block_mse8;
+            }
+            copy_mv(&tempMV2[0], mv2);
+            copy_mv(mv2, &backup_MV);
+            temp_SAD = SEARCH(current + HALF + j, reference2 + HALF + j, stride,
+                              mv2, HALF, HALF, &SADs2[mbx], half_SAD_xN,
+                              &area2);
+            block_mse8 = quadrant_mse<BLOCK>(current + j, reference2 + j,
+                                             stride, HALF, mv2, &backup_MV,
+                                             split, 1);
+            if (block_mse8 < tempMSEs[1]) {
+              tempMSEs[1] = block_mse8;
+            }
+            copy_mv(&tempMV2[1], mv2);
+            copy_mv(mv2, &backup_MV);
+            temp_SAD = SEARCH(current + HALF * stride + j,
+                              reference2 + HALF * stride + j, stride, mv2, HALF,
+                              block_height - HALF, &SADs2[mbx], half_SAD_xN,
+                              &area2);
+            block_mse8 = quadrant_mse<BLOCK>(current + j, reference2 + j,
+                                             stride, block_height - HALF, mv2,
+                                             &backup_MV, split, 2);
+            if (block_mse8 < tempMSEs[2]) {
+              tempMSEs[2] = block_mse8;
+            }
+            copy_mv(&tempMV2[2], mv2);
+            copy_mv(mv2, &backup_MV);
+            temp_SAD = SEARCH(current + HALF * stride + HALF + j,
+                              reference2 + HALF * stride + HALF + j, stride,
+                              mv2, HALF, block_height - HALF, &SADs2[mbx],
+                              half_SAD_xN, &area2);
+            block_mse8 = quadrant_mse<BLOCK>(current + j, reference2 + j,
+                                             stride, block_height - HALF, mv2,
+                                             &backup_MV, split, 3);
+            if (block_mse8 < tempMSEs[3]) {
+              tempMSEs[3] = block_mse8;
+            }
+            copy_mv(&tempMV2[3], mv2);
+            copy_mv(mv2, &backup_MV);
+            temp_SAD = backup_SAD;
+          } else {
+            temp_SAD = SEARCH(current + j, reference2 + j, stride, mv2, HALF,
+                              block_height, &SADs2[mbx], half_SAD_xN, &area2);
+            block_mse8 = quadrant_mse<BLOCK>(current + j, reference2 + j,
+                                             stride, block_height, mv2,
+                                             &backup_MV, split, 0);
+            if (block_mse8 < tempMSEs[0]) {
+              tempMSEs[0] = block_mse8;
+            }
+            copy_mv(&tempMV2[0], mv2);
+            copy_mv(mv2, &backup_MV);
+            temp_SAD = SEARCH(current + HALF + j, reference2 + HALF + j, stride,
+                              mv2, HALF, block_height, &SADs2[mbx], half_SAD_xN,
+                              &area2);
+            block_mse8 = quadrant_mse<BLOCK>(current + j, reference2 + j,
+                                             stride, block_height, mv2,
+                                             &backup_MV, split, 1);
+            if (block_mse8 < tempMSEs[1]) {
+              tempMSEs[1] = block_mse8;
+            }
+            copy_mv(&tempMV2[1], mv2);
+            copy_mv(mv2, &backup_MV);
+            temp_SAD = backup_SAD;
           }
-          copy_mv(&tempMV2[0], mv2);
-          copy_mv(mv2, &backup_MV);
-          temp_SAD = SEARCH_MV(current + 8 + j, reference2 + 8 + j, stride, mv2,
-                               8, block_height, &SADs2[mbx], fastSAD8);
-          block_mse8 = fast_calc_mse8(
-              current + 8 + j, reference2 + 8 + j + mv2->y * stride + mv2->x,
-              stride, 8, block_height);
-          if (block_mse8 < tempMSEs[1]) {
-            tempMSEs[1] = block_mse8;
-          }
-          copy_mv(&tempMV2[1], mv2);
-          copy_mv(mv2, &backup_MV);
-          temp_SAD = backup_SAD;
         }
         block_mse2 = block_mse16;
 
@@ -754,61 +1602,63 @@ int bidir_motion_search(unsigned char *current, unsigned char *reference1,
                        block_height, j, i, -td2);
 
         // Try 16x16 mode first
-        temp_SAD = SEARCH_MV(current + j, reference2 + j, stride, mv2, 16,
-                             block_height, &SADs2[mbx], fastSAD16);
-        block_mse16 = fast_calc_mse16(current + j,
-                                      reference2 + j + mv2->y * stride + mv2->x,
-                                      stride, 16, block_height);
+        temp_SAD = SEARCH(current + j, reference2 + j, stride, mv2, BLOCK,
+                          block_height, &SADs2[mbx], SAD_xN, &area2);
+        block_mse16 = mse_split<BLOCK>(
+            current + j, reference2 + j + mv2->y * stride + mv2->x, stride,
+            block_height, split);
         copy_mv(&backup_MV, mv2);
         backup_SAD = temp_SAD;
-        // Now 8x8 mode
-        if (block_height > 8) {
-          temp_SAD = SEARCH_MV(current + j, reference2 + j, stride, mv2, 8, 8,
-                               &SADs2[mbx], fastSAD8);
-          tempMSEs[0] = fast_calc_mse8(
-              current + j, reference2 + j + mv2->y * stride + mv2->x, stride, 8,
-              8);
+        // Now 8x8 mode, unless pruned on the 16x16 MSE of this reference
+        pruned = prune && prune_8x8<BLOCK>(block_mse16, split, block_height);
+        if (pruned) {
+          tempMSEs[0] = tempMSEs[1] = tempMSEs[2] = tempMSEs[3] = 0;
+        } else if (block_height > HALF) {
+          temp_SAD = SEARCH(current + j, reference2 + j, stride, mv2, HALF,
+                            HALF, &SADs2[mbx], half_SAD_xN, &area2);
+          tempMSEs[0] = quadrant_mse<BLOCK>(current + j, reference2 + j, stride,
+                                            HALF, mv2, &backup_MV, split, 0);
           copy_mv(&tempMV2[0], mv2);
           copy_mv(mv2, &backup_MV);
-          temp_SAD = SEARCH_MV(current + 8 + j, reference2 + 8 + j, stride, mv2,
-                               8, 8, &SADs2[mbx], fastSAD8);
-          tempMSEs[1] = fast_calc_mse8(
-              current + 8 + j, reference2 + 8 + j + mv2->y * stride + mv2->x,
-              stride, 8, 8);
+          temp_SAD = SEARCH(current + HALF + j, reference2 + HALF + j, stride,
+                            mv2, HALF, HALF, &SADs2[mbx], half_SAD_xN, &area2);
+          tempMSEs[1] = quadrant_mse<BLOCK>(current + j, reference2 + j, stride,
+                                            HALF, mv2, &backup_MV, split, 1);
           copy_mv(&tempMV2[1], mv2);
           copy_mv(mv2, &backup_MV);
-          temp_SAD = SEARCH_MV(current + 8 * stride + j,
-                               reference2 + 8 * stride + j, stride, mv2, 8,
-                               block_height - 8, &SADs2[mbx], fastSAD8);
-          tempMSEs[2] = fast_calc_mse8(current + 8 * stride + j,
-                                       reference2 + 8 * stride + j +
-                                           mv2->y * stride + mv2->x,
-                                       stride, 8, block_height - 8);
+          temp_SAD = SEARCH(current + HALF * stride + j,
+                            reference2 + HALF * stride + j, stride, mv2, HALF,
+                            block_height - HALF, &SADs2[mbx], half_SAD_xN,
+                            &area2);
+          tempMSEs[2] = quadrant_mse<BLOCK>(current + j, reference2 + j, stride,
+                                            block_height - HALF, mv2,
+                                            &backup_MV, split, 2);
           copy_mv(&tempMV2[2], mv2);
           copy_mv(mv2, &backup_MV);
-          temp_SAD = SEARCH_MV(current + 8 * stride + 8 + j,
-                               reference2 + 8 * stride + 8 + j, stride, mv2, 8,
-                               block_height - 8, &SADs2[mbx], fastSAD8);
-          tempMSEs[3] = fast_calc_mse8(current + 8 * stride + 8 + j,
-                                       reference2 + 8 * stride + 8 + j +
-                                           mv2->y * stride + mv2->x,
-                                       stride, 8, block_height - 8);
+          temp_SAD = SEARCH(current + HALF * stride + HALF + j,
+                            reference2 + HALF * stride + HALF + j, stride, mv2,
+                            HALF, block_height - HALF, &SADs2[mbx], half_SAD_xN,
+                            &area2);
+          tempMSEs[3] = quadrant_mse<BLOCK>(current + j, reference2 + j, stride,
+                                            block_height - HALF, mv2,
+                                            &backup_MV, split, 3);
           copy_mv(&tempMV2[3], mv2);
           copy_mv(mv2, &backup_MV);
           temp_SAD = backup_SAD;
         } else {
-          temp_SAD = SEARCH_MV(current + j, reference2 + j, stride, mv2, 8,
-                               block_height, &SADs2[mbx], fastSAD8);
-          tempMSEs[0] = fast_calc_mse8(
-              current + j, reference2 + j + mv2->y * stride + mv2->x, stride, 8,
-              block_height);
+          temp_SAD = SEARCH(current + j, reference2 + j, stride, mv2, HALF,
+                            block_height, &SADs2[mbx], half_SAD_xN, &area2);
+          tempMSEs[0] = quadrant_mse<BLOCK>(current + j, reference2 + j, stride,
+                                            block_height, mv2, &backup_MV,
+                                            split, 0);
           copy_mv(&tempMV2[0], mv2);
           copy_mv(mv2, &backup_MV);
-          temp_SAD = SEARCH_MV(current + 8 + j, reference2 + 8 + j, stride, mv2,
-                               8, block_height, &SADs2[mbx], fastSAD8);
-          tempMSEs[1] = fast_calc_mse8(
-              current + 8 + j, reference2 + 8 + j + mv2->y * stride + mv2->x,
-              stride, 8, block_height);
+          temp_SAD = SEARCH(current + HALF + j, reference2 + HALF + j, stride,
+                            mv2, HALF, block_height, &SADs2[mbx], half_SAD_xN,
+                            &area2);
+          tempMSEs[1] = quadrant_mse<BLOCK>(current + j, reference2 + j, stride,
+                                            block_height, mv2, &backup_MV,
+                                            split, 1);
           copy_mv(&tempMV2[1], mv2);
           copy_mv(mv2, &backup_MV);
           temp_SAD = backup_SAD;
@@ -826,147 +1676,159 @@ int bidir_motion_search(unsigned char *current, unsigned char *reference1,
                          block_height, j, i);
 
         // Try 16x16 mode first
-        temp_SAD = SEARCH_MV(current + j, reference1 + j, stride, mv1, 16,
-                             block_height, &SADs1[mbx], fastSAD16);
-        block_mse16 = fast_calc_mse16(current + j,
-                                      reference1 + j + mv1->y * stride + mv1->x,
-                                      stride, 16, block_height);
+        temp_SAD = SEARCH(current + j, reference1 + j, stride, mv1, BLOCK,
+                          block_height, &SADs1[mbx], SAD_xN, &area1);
+        block_mse16 = mse_split<BLOCK>(
+            current + j, reference1 + j + mv1->y * stride + mv1->x, stride,
+            block_height, split);
         copy_mv(&backup_MV, mv1);
         backup_SAD = temp_SAD;
-        // Now 8x8 mode
-        if (block_height > 8) {
-          temp_SAD = SEARCH_MV(current + j, reference1 + j, stride, mv1, 8, 8,
-                               &SADs1[mbx], fastSAD8);
-          block_mse8 = fast_calc_mse8(current + j,
-                                      reference1 + j + mv1->y * stride + mv1->x,
-                                      stride, 8, 8);
+        // Now 8x8 mode, unless pruned with the other reference
+        if (!pruned) {
+          if (block_height > HALF) {
+            temp_SAD = SEARCH(current + j, reference1 + j, stride, mv1, HALF,
+                              HALF, &SADs1[mbx], half_SAD_xN, &area1);
+            block_mse8 = quadrant_mse<BLOCK>(current + j, reference1 + j,
+                                             stride, HALF, mv1, &backup_MV,
+                                             split, 0);
+            if (block_mse8 < tempMSEs[0]) {
+              tempMSEs[0] = block_mse8;
+            }
+            copy_mv(&tempMV1[0], mv1);
+            copy_mv(mv1, &backup_MV);
+            temp_SAD = SEARCH(current + HALF + j, reference1 + HALF + j, stride,
+                              mv1, HALF, HALF, &SADs1[mbx], half_SAD_xN,
+                              &area1);
+            block_mse8 = quadrant_mse<BLOCK>(current + j, reference1 + j,
+                                             stride, HALF, mv1, &backup_MV,
+                                             split, 1);
+            if (block_mse8 < tempMSEs[1]) {
+              tempMSEs[1] = block_mse8;
+            }
+            copy_mv(&tempMV1[1], mv1);
+            copy_mv(mv1, &backup_MV);
+            temp_SAD = SEARCH(current + HALF * stride + j,
+                              reference1 + HALF * stride + j, stride, mv1, HALF,
+                              block_height - HALF, &SADs1[mbx], half_SAD_xN,
+                              &area1);
+            block_mse8 = quadrant_mse<BLOCK>(current + j, reference1 + j,
+                                             stride, block_height - HALF, mv1,
+                                             &backup_MV, split, 2);
+            if (block_mse8 < tempMSEs[2]) {
+              tempMSEs[2] = block_mse8;
+            }
+            copy_mv(&tempMV1[2], mv1);
+            copy_mv(mv1, &backup_MV);
+            temp_SAD = SEARCH(current + HALF * stride + HALF + j,
+                              reference1 + HALF * stride + HALF + j, stride,
+                              mv1, HALF, block_height - HALF, &SADs1[mbx],
+                              half_SAD_xN, &area1);
+            block_mse8 = quadrant_mse<BLOCK>(current + j, reference1 + j,
+                                             stride, block_height - HALF, mv1,
+                                             &backup_MV, split, 3);
+            if (block_mse8 < tempMSEs[3]) {
+              tempMSEs[3] = block_mse8;
+            }
+            copy_mv(&tempMV1[3], mv1);
+            copy_mv(mv1, &backup_MV);
+            temp_SAD = backup_SAD;
+          } else {
+            temp_SAD = SEARCH(current + j, reference1 + j, stride, mv1, HALF,
+                              block_height, &SADs1[mbx], half_SAD_xN, &area1);
+            block_mse8 = quadrant_mse<BLOCK>(current + j, reference1 + j,
+                                             stride, block_height, mv1,
+                                             &backup_MV, split, 0);
+            if (block_mse8 < tempMSEs[0]) {
+              tempMSEs[0] = block_mse8;
+            }
+            copy_mv(&tempMV1[0], mv1);
+            copy_mv(mv1, &backup_MV);
+            temp_SAD = SEARCH(current + HALF + j, reference1 + HALF + j, stride,
+                              mv1, HALF, block_height, &SADs1[mbx], half_SAD_xN,
+                              &area1);
+            block_mse8 = quadrant_mse<BLOCK>(current + j, reference1 + j,
+                                             stride, block_height, mv1,
+                                             &backup_MV, split, 1);
+            if (block_mse8 < tempMSEs[1]) {
+              tempMSEs[1] = block_mse8;
+            }
+            copy_mv(&tempMV1[1], mv1);
+            copy_mv(mv1, &backup_MV);
+            temp_SAD = backup_SAD;
+          }
+        }
+        block_mse1 = block_mse16;
+
+        if (block_mse1 < var) {
+          SADs1[mbx] = temp_SAD;
+        } else {
+          SADs1[mbx] = 0;
+        }
+      }
+      // Try 16x16 mode first
+      block_mse16 = bidir_mse(&current[j],
+                              &reference1[j + mv1->y * stride + mv1->x],
+                              &reference2[j + mv2->y * stride + mv2->x], stride,
+                              BLOCK, block_height, &td);
+      // Now 8x8 mode
+      if (!pruned) {
+        if (block_height > HALF) {
+          block_mse8 = half_bidir_mse(
+              &current[j],
+              &reference1[j + tempMV1[0].y * stride + tempMV1[0].x],
+              &reference2[j + tempMV2[0].y * stride + tempMV2[0].x], stride,
+              HALF, HALF, &td);
           if (block_mse8 < tempMSEs[0]) {
             tempMSEs[0] = block_mse8;
           }
-          copy_mv(&tempMV1[0], mv1);
-          copy_mv(mv1, &backup_MV);
-          temp_SAD = SEARCH_MV(current + 8 + j, reference1 + 8 + j, stride, mv1,
-                               8, 8, &SADs1[mbx], fastSAD8);
-          block_mse8 = fast_calc_mse8(
-              current + 8 + j, reference1 + 8 + j + mv1->y * stride + mv1->x,
-              stride, 8, 8);
+          block_mse8 = half_bidir_mse(
+              &current[j + HALF],
+              &reference1[j + tempMV1[1].y * stride + tempMV1[1].x + HALF],
+              &reference2[j + tempMV2[1].y * stride + tempMV2[1].x + HALF],
+              stride, HALF, HALF, &td);
           if (block_mse8 < tempMSEs[1]) {
             tempMSEs[1] = block_mse8;
           }
-          copy_mv(&tempMV1[1], mv1);
-          copy_mv(mv1, &backup_MV);
-          temp_SAD = SEARCH_MV(current + 8 * stride + j,
-                               reference1 + 8 * stride + j, stride, mv1, 8,
-                               block_height - 8, &SADs1[mbx], fastSAD8);
-          block_mse8 = fast_calc_mse8(current + 8 * stride + j,
-                                      reference1 + 8 * stride + j +
-                                          mv1->y * stride + mv1->x,
-                                      stride, 8, block_height - 8);
+          block_mse8 = half_bidir_mse(
+              &current[j + HALF * stride],
+              &reference1[j + (HALF + tempMV1[2].y) * stride + tempMV1[2].x],
+              &reference2[j + (HALF + tempMV2[2].y) * stride + tempMV2[2].x],
+              stride, HALF, block_height - HALF, &td);
           if (block_mse8 < tempMSEs[2]) {
             tempMSEs[2] = block_mse8;
           }
-          copy_mv(&tempMV1[2], mv1);
-          copy_mv(mv1, &backup_MV);
-          temp_SAD = SEARCH_MV(current + 8 * stride + 8 + j,
-                               reference1 + 8 * stride + 8 + j, stride, mv1, 8,
-                               block_height - 8, &SADs1[mbx], fastSAD8);
-          block_mse8 = fast_calc_mse8(current + 8 * stride + 8 + j,
-                                      reference1 + 8 * stride + 8 + j +
-                                          mv1->y * stride + mv1->x,
-                                      stride, 8, block_height - 8);
+          block_mse8 = half_bidir_mse(
+              &current[j + HALF * stride + HALF],
+              &reference1[j + (HALF + tempMV1[3].y) * stride + tempMV1[3].x +
+                          HALF],
+              &reference2[j + (HALF + tempMV2[3].y) * stride + tempMV2[3].x +
+                          HALF],
+              stride, HALF, block_height - HALF, &td);
           if (block_mse8 < tempMSEs[3]) {
             tempMSEs[3] = block_mse8;
           }
-          copy_mv(&tempMV1[3], mv1);
-          copy_mv(mv1, &backup_MV);
-          temp_SAD = backup_SAD;
         } else {
-          temp_SAD = SEARCH_MV(current + j, reference1 + j, stride, mv1, 8,
-                               block_height, &SADs1[mbx], fastSAD8);
-          block_mse8 = fast_calc_mse8(current + j,
-                                      reference1 + j + mv1->y * stride + mv1->x,
-                                      stride, 8, block_height);
+          block_mse8 = half_bidir_mse(
+              &current[j],
+              &reference1[j + tempMV1[0].y * stride + tempMV1[0].x],
+              &reference2[j + tempMV2[0].y * stride + tempMV2[0].x], stride,
+              HALF, block_height, &td);
           if (block_mse8 < tempMSEs[0]) {
             tempMSEs[0] = block_mse8;
           }
-          copy_mv(&tempMV1[0], mv1);
-          copy_mv(mv1, &backup_MV);
-          temp_SAD = SEARCH_MV(current + 8 + j, reference1 + 8 + j, stride, mv1,
-                               8, block_height, &SADs1[mbx], fastSAD8);
-          block_mse8 = fast_calc_mse8(
-              current + 8 + j, reference1 + 8 + j + mv1->y * stride + mv1->x,
-              stride, 8, block_height);
+          block_mse8 = half_bidir_mse(
+              &current[j + HALF],
+              &reference1[j + tempMV1[1].y * stride + tempMV1[1].x + HALF],
+              &reference2[j + tempMV2[1].y * stride + tempMV2[1].x + HALF],
+              stride, HALF, block_height, &td);
           if (block_mse8 < tempMSEs[1]) {
             tempMSEs[1] = block_mse8;
           }
-          copy_mv(&tempMV1[1], mv1);
-          copy_mv(mv1, &backup_MV);
-          temp_SAD = backup_SAD;
-        }
-        block_mse1 = block_mse16;
-
-        if (block_mse1 < var) {
-          SADs1[mbx] = temp_SAD;
-        } else {
-          SADs1[mbx] = 0;
         }
       }
-      // Try 16x16 mode first
-      block_mse16 = fast_bidir_mse16(&current[j],
-                                     &reference1[j + mv1->y * stride + mv1->x],
-                                     &reference2[j + mv2->y * stride + mv2->x],
-                                     stride, 16, block_height, &td);
-      // Now 8x8 mode
-      if (block_height > 8) {
-        block_mse8 = fast_bidir_mse8(
-            &current[j], &reference1[j + tempMV1[0].y * stride + tempMV1[0].x],
-            &reference2[j + tempMV2[0].y * stride + tempMV2[0].x], stride, 8, 8,
-            &td);
-        if (block_mse8 < tempMSEs[0]) {
-          tempMSEs[0] = block_mse8;
-        }
-        block_mse8 = fast_bidir_mse8(
-            &current[j + 8],
-            &reference1[j + tempMV1[1].y * stride + tempMV1[1].x + 8],
-            &reference2[j + tempMV2[1].y * stride + tempMV2[1].x + 8], stride,
-            8, 8, &td);
-        if (block_mse8 < tempMSEs[1]) {
-          tempMSEs[1] = block_mse8;
-        }
-        block_mse8 = fast_bidir_mse8(
-            &current[j + 8 * stride],
-            &reference1[j + (8 + tempMV1[2].y) * stride + tempMV1[2].x],
-            &reference2[j + (8 + tempMV2[2].y) * stride + tempMV2[2].x], stride,
-            8, block_height - 8, &td);
-        if (block_mse8 < tempMSEs[2]) {
-          tempMSEs[2] = block_mse8;
-        }
-        block_mse8 = fast_bidir_mse8(
-            &current[j + 8 * stride + 8],
-            &reference1[j + (8 + tempMV1[3].y) * stride + tempMV1[3].x + 8],
-            &reference2[j + (8 + tempMV2[3].y) * stride + tempMV2[3].x + 8],
-            stride, 8, block_height - 8, &td);
-        if (block_mse8 < tempMSEs[3]) {
-          tempMSEs[3] = block_mse8;
-        }
-      } else {
-        block_mse8 = fast_bidir_mse8(
-            &current[j], &reference1[j + tempMV1[0].y * stride + tempMV1[0].x],
-            &reference2[j + tempMV2[0].y * stride + tempMV2[0].x], stride, 8,
-            block_height, &td);
-        if (block_mse8 < tempMSEs[0]) {
-          tempMSEs[0] = block_mse8;
-        }
-        block_mse8 = fast_bidir_mse8(
-            &current[j + 8],
-            &reference1[j + tempMV1[1].y * stride + tempMV1[1].x + 8],
-            &reference2[j + tempMV2[1].y * stride + tempMV2[1].x + 8], stride,
-            8, block_height, &td);
-        if (block_mse8 < tempMSEs[1]) {
-          tempMSEs[1] = block_mse8;
-        }
-      }
-      block_mse8 = tempMSEs[0] + tempMSEs[1] + tempMSEs[2] + tempMSEs[3];
+      block_mse8 = pruned ? INT_MAX
+                          : tempMSEs[0] + tempMSEs[1] + tempMSEs[2] +
+                                tempMSEs[3];
 
       if (block_mse16 < block_mse1 && block_mse16 < block_mse2) {
         MB_modes[mbx] = 3;
@@ -1013,7 +1875,10 @@ int bidir_motion_search(unsigned char *current, unsigned char *reference1,
       }
       (*bits) += k;
     }
-    mse += (line_mse + 128) >> 8;
+    if (sync != NULL) {
+      sync(opaque, row, mbx);
+    }
+    mse += (int)((line_mse + 128) >> 8);
     current += block_height * stride;
     reference1 += block_height * stride;
     reference2 += block_height * stride;
@@ -1028,3 +1893,60 @@ int bidir_motion_search(unsigned char *current, unsigned char *reference1,
 
   return mse;
 }
+
+// The row loops of one block size, in the order of me_method_t
+#define ME_ROWS_OF_SIZE(rows_t, size)                                          \
+  {                                                                            \
+    rows_t<size, PMVFAST>, rows_t<size, EPZS>, rows_t<size, hexagon>,          \
+        rows_t<size, exhaustive<size>>                                         \
+  }
+
+int motion_search_rows(unsigned char *current, unsigned char *reference,
+                       int stride, const DIM dim, int block_width,
+                       int block_height, int first_row, int last_row,
+                       MV *motion_vectors, int *SADs, int *mses,
+                       unsigned char *MB_modes, const int *intra,
+                       const MV *seeds, me_method_t method, int prune,
+                       int skip_threshold, int *count_I, int *count_P,
+                       int *count_skip, int *bits, row_sync_t sync,
+                       void *opaque) {
+  static decltype(&motion_search_rows_t<MB_WIDTH, PMVFAST>) const
+      rows[][NUM_ME_METHODS] = {
+          ME_ROWS_OF_SIZE(motion_search_rows_t, 8),
+          ME_ROWS_OF_SIZE(motion_search_rows_t, 16),
+          ME_ROWS_OF_SIZE(motion_search_rows_t, 32),
+          ME_ROWS_OF_SIZE(motion_search_rows_t, 64),
+      };
+
+  return rows[block_size_index(block_width)][method](
+      current, reference, stride, dim, block_width, block_height, first_row,
+      last_row, motion_vectors, SADs, mses, MB_modes, intra, seeds, prune,
+      skip_threshold, count_I, count_P, count_skip, bits, sync, opaque);
+}
+
+int bidir_motion_search_rows(unsigned char *current, unsigned char *reference1,
+                             unsigned char *reference2, int stride,
+                             const DIM dim, int block_width, int block_height,
+                             int first_row, int last_row, MV *P_motion_vectors,
+                             MV *motion_vectors1, MV *motion_vectors2,
+                             int *SADs1, int *SADs2, int *mses,
+                             unsigned char *MB_modes, const int *intra,
+                             const MV *seeds1, const MV *seeds2,
+                             me_method_t method, int prune, short td1,
+                             short td2, int *count_I, int *count_P,
+                             int *count_B, int *bits, row_sync_t sync,
+                             void *opaque) {
+  static decltype(&bidir_motion_search_rows_t<MB_WIDTH, PMVFAST>) const
+      rows[][NUM_ME_METHODS] = {
+          ME_ROWS_OF_SIZE(bidir_motion_search_rows_t, 8),
+          ME_ROWS_OF_SIZE(bidir_motion_search_rows_t, 16),
+          ME_ROWS_OF_SIZE(bidir_motion_search_rows_t, 32),
+          ME_ROWS_OF_SIZE(bidir_motion_search_rows_t, 64),
+      };
+
+  return rows[block_size_index(block_width)][method](
+      current, reference1, reference2, stride, dim, block_width, block_height,
+      first_row, last_row, P_motion_vectors, motion_vectors1, motion_vectors2,
+      SADs1, SADs2, mses, MB_modes, intra, seeds1, seeds2, prune, td1, td2,
+      count_I, count_P, count_B, bits, sync, opaque);
+}
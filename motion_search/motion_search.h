@@ -13,6 +13,39 @@
 extern "C" {
 #endif
 
+// Called before macroblock `col` of row `row` is searched, once every
+// macroblock left of it is done, and once more with col set to the number of
+// macroblocks in the row when the row is complete. PMVFAST predicts from the
+// left, top and top-right neighbours, so a row-parallel caller must not
+// return before the row above has completed macroblock col + 1.
+typedef void (*row_sync_t)(void *opaque, int row, int col);
+
+// Vectors searched around (0, 0) in the quarter resolution pyramid level
+#define PYRAMID_RANGE 8
+
+// Bytes of the levels of a picture of the given dimensions
+size_t pyramid_size(const DIM dim);
+
+// Build the levels of a picture into buffer, of pyramid_size() bytes
+void build_pyramid(const unsigned char *luma, int stride, const DIM dim,
+                   unsigned char *buffer, pyramid_t *pyramid);
+
+// Coarse-to-fine vector of every block_size macroblock, laid out like
+// motion_vectors: an exhaustive search of PYRAMID_RANGE around (0, 0) in the
+// quarter resolution level, refined by one pixel in the half resolution level
+// and scaled to full resolution. Macroblocks that don't fit a level keep the
+// vector of the level above. block_size is 16 at least, so that the quarter
+// resolution blocks are 4 pixels wide at least.
+void pyramid_search(const pyramid_t *current, const pyramid_t *reference,
+                    const DIM dim, int block_size, MV *seeds);
+
+// The searches below take square macroblocks: block_width and block_height are
+// both 8, 16, 32 or 64, and the macroblock planes have dim.width / block_width
+// + 2 entries per row. Each size has its own instance of the row loops, with
+// the kernels of the blocks and of their quadrants fixed at compile time. The
+// 16x16 and 8x8 modes below are those of the default MB_WIDTH; other sizes
+// split their blocks in quadrants the same way.
+
 int spatial_search(unsigned char *current, unsigned char *reference, int stride,
                    const DIM dim, int block_width, int block_height,
                    MV *motion_vectors, int *SADs, int *mses,
@@ -30,6 +63,45 @@ int bidir_motion_search(unsigned char *current, unsigned char *reference1,
                         short td1, short td2, int *count_I, int *count_P,
                         int *count_B, int *bits);
 
+// Intra cost of every macroblock of a picture, laid out like mses. These are
+// the costs the searches compare the inter modes against.
+void intra_costs(unsigned char *current, int stride, const DIM dim,
+                 int block_width, int block_height, int *costs);
+
+// Search macroblock rows [first_row, last_row) only. The counters and bits are
+// added to, not reset; the return value is the MSE of those rows. intra holds
+// the intra_costs() of the current picture, or is NULL to compute them here.
+// seeds holds the pyramid_search() vectors of every macroblock against its
+// reference, tried as one more predictor, or is NULL. prune leaves out the 8x8
+// searches of the macroblocks whose 16x16 MSE is low or spread evenly over
+// their quadrants (see PRUNE_MSE). A macroblock whose SAD along the zero or
+// the predicted vector is below skip_threshold per pixel is coded P with that
+// vector right away, and counted in count_skip as well; with a threshold of 0
+// every macroblock is searched and count_skip may be NULL. method picks the
+// search of every block; motion_search() and bidir_motion_search() use
+// ME_PMVFAST. sync may be NULL when the rows are searched by a single thread.
+int motion_search_rows(unsigned char *current, unsigned char *reference,
+                       int stride, const DIM dim, int block_width,
+                       int block_height, int first_row, int last_row,
+                       MV *motion_vectors, int *SADs, int *mses,
+                       unsigned char *MB_modes, const int *intra,
+                       const MV *seeds, me_method_t method, int prune,
+                       int skip_threshold, int *count_I, int *count_P,
+                       int *count_skip, int *bits, row_sync_t sync,
+                       void *opaque);
+int bidir_motion_search_rows(unsigned char *current, unsigned char *reference1,
+                             unsigned char *reference2, int stride,
+                             const DIM dim, int block_width, int block_height,
+                             int first_row, int last_row, MV *P_motion_vectors,
+                             MV *motion_vectors1, MV *motion_vectors2,
+                             int *SADs1, int *SADs2, int *mses,
+                             unsigned char *MB_modes, const int *intra,
+                             const MV *seeds1, const MV *seeds2,
+                             me_method_t method, int prune, short td1,
+                             short td2, int *count_I, int *count_P,
+                             int *count_B, int *bits, row_sync_t sync,
+                             void *opaque);
+
 #ifdef __cplusplus
 }
 #endif
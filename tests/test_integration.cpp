@@ -4,13 +4,29 @@
  */
 
 #include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
 #include <gtest/gtest.h>
 #include <string>
 #include <sys/stat.h>
+#include <tuple>
+#include <vector>
 
 #include "ComplexityAnalyzer.h"
+#include "DataConverter.h"
+#include "EOFException.h"
+#include "GOPParallelAnalyzer.h"
+#include "MacroblockWriter.h"
+#ifdef HAVE_MMAP
+#include "MappedSequenceReader.h"
+#endif
+#include "OutputWriter.h"
+#include "ScaledSequenceReader.h"
 #include "Y4MSequenceReader.h"
+#include "YUVFrame.h"
 #include "YUVSequenceReader.h"
 #include "common.h"
 
@@ -28,6 +44,51 @@ protected:
     return unique_file_t(fp);
   }
 
+  // Analysis of the first 10 frames of a 320x180 YUV file with GOPs of 10
+  // and 2 B-frames; configure() sets up the analyzer before it runs
+  std::vector<complexity_info_t>
+  analyzeClip(const std::string &path,
+              const std::function<void(ComplexityAnalyzer &)> &configure,
+              bool pipelined = false, int row_threads = 1,
+              int block_size = MB_WIDTH) {
+    DIM dim = {320, 180};
+    YUVSequenceReader reader;
+    reader.Open(openFile(path), path, dim);
+    ComplexityAnalyzer analyzer(&reader, 10, 10, 2, pipelined, row_threads,
+                                block_size);
+    analyzer.setVerbose(false);
+    configure(analyzer);
+    analyzer.analyze();
+    return analyzer.getInfo();
+  }
+
+  // The analyses of analyzeClip() run serially, pipelined, and with
+  // wavefront rows, in that order
+  std::vector<std::vector<complexity_info_t>>
+  analyzeSchedules(const std::string &path,
+                   const std::function<void(ComplexityAnalyzer &)> &configure,
+                   int block_size = MB_WIDTH) {
+    return {analyzeClip(path, configure, false, 1, block_size),
+            analyzeClip(path, configure, true, 1, block_size),
+            analyzeClip(path, configure, false, 4, block_size)};
+  }
+
+  // Expect two analyses to give the same frames and macroblock decisions
+  void expectSameResults(const std::vector<complexity_info_t> &expected,
+                         const std::vector<complexity_info_t> &actual) {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+      EXPECT_EQ(expected[i].picNum, actual[i].picNum);
+      EXPECT_EQ(expected[i].picType, actual[i].picType);
+      EXPECT_EQ(expected[i].error, actual[i].error);
+      EXPECT_EQ(expected[i].bits, actual[i].bits);
+      EXPECT_EQ(expected[i].count_I, actual[i].count_I);
+      EXPECT_EQ(expected[i].count_P, actual[i].count_P);
+      EXPECT_EQ(expected[i].count_B, actual[i].count_B);
+      EXPECT_EQ(expected[i].count_skip, actual[i].count_skip);
+    }
+  }
+
   std::string test_data_dir;
 };
 
@@ -91,8 +152,8 @@ TEST_F(IntegrationTest, ComplexityAnalyzer_BasicAnalysis) {
 
   // First frame should be I-frame
   if (info.size() > 0) {
-    EXPECT_EQ('I', info[0]->picType) << "First frame should be I-frame";
-    EXPECT_EQ(0, info[0]->picNum) << "First frame number should be 0";
+    EXPECT_EQ('I', info[0].picType) << "First frame should be I-frame";
+    EXPECT_EQ(0, info[0].picNum) << "First frame number should be 0";
   }
 }
 
@@ -117,15 +178,15 @@ TEST_F(IntegrationTest, ComplexityAnalyzer_FrameTypes) {
 
   // Verify frame types
   for (size_t i = 0; i < info.size(); i++) {
-    EXPECT_TRUE(info[i]->picType == 'I' || info[i]->picType == 'P' ||
-                info[i]->picType == 'B')
-        << "Invalid picture type at frame " << i << ": " << info[i]->picType;
+    EXPECT_TRUE(info[i].picType == 'I' || info[i].picType == 'P' ||
+                info[i].picType == 'B')
+        << "Invalid picture type at frame " << i << ": " << info[i].picType;
   }
 
   // With no B-frames, we should only see I and P frames
   bool has_b_frame = false;
   for (size_t i = 0; i < info.size(); i++) {
-    if (info[i]->picType == 'B') {
+    if (info[i].picType == 'B') {
       has_b_frame = true;
       break;
     }
@@ -158,11 +219,11 @@ TEST_F(IntegrationTest, ComplexityAnalyzer_WithBFrames) {
   bool has_b_frame = false;
 
   for (size_t i = 0; i < info.size(); i++) {
-    if (info[i]->picType == 'I')
+    if (info[i].picType == 'I')
       has_i_frame = true;
-    if (info[i]->picType == 'P')
+    if (info[i].picType == 'P')
       has_p_frame = true;
-    if (info[i]->picType == 'B')
+    if (info[i].picType == 'B')
       has_b_frame = true;
   }
 
@@ -171,6 +232,32 @@ TEST_F(IntegrationTest, ComplexityAnalyzer_WithBFrames) {
   EXPECT_TRUE(has_b_frame) << "Should have B-frames when b_frames=1";
 }
 
+TEST_F(IntegrationTest, ComplexityAnalyzer_DisplayOrder) {
+  std::string test_file = test_data_dir + "/testsrc.yuv";
+
+  if (!fileExists(test_file)) {
+    GTEST_SKIP() << "Test file not found: " << test_file;
+  }
+
+  DIM dim = {320, 180};
+  YUVSequenceReader reader;
+  reader.Open(openFile(test_file), test_file, dim);
+
+  // P-pictures are searched before the B-pictures they follow in display
+  ComplexityAnalyzer analyzer(&reader, 6, 0, 2);
+  analyzer.setVerbose(false);
+  analyzer.analyze();
+
+  const auto &info = analyzer.getInfo();
+  ASSERT_GT(info.size(), 6u);
+
+  const char expected[] = "IBBPBP";
+  for (size_t i = 0; i < info.size(); i++) {
+    EXPECT_EQ((int)i, info[i].picNum);
+    EXPECT_EQ(expected[i % 6], info[i].picType) << "Frame " << i;
+  }
+}
+
 TEST_F(IntegrationTest, ComplexityAnalyzer_OutputValidity) {
   std::string test_file = test_data_dir + "/testsrc.yuv";
 
@@ -190,12 +277,12 @@ TEST_F(IntegrationTest, ComplexityAnalyzer_OutputValidity) {
 
   for (size_t i = 0; i < info.size(); i++) {
     // Verify all output fields are reasonable
-    EXPECT_GE(info[i]->picNum, 0) << "Picture number should be non-negative";
-    EXPECT_GE(info[i]->bits, 0) << "Bits should be non-negative";
-    EXPECT_GE(info[i]->error, 0) << "Error should be non-negative";
-    EXPECT_GE(info[i]->count_I, 0) << "I-block count should be non-negative";
-    EXPECT_GE(info[i]->count_P, 0) << "P-block count should be non-negative";
-    EXPECT_GE(info[i]->count_B, 0) << "B-block count should be non-negative";
+    EXPECT_GE(info[i].picNum, 0) << "Picture number should be non-negative";
+    EXPECT_GE(info[i].bits, 0) << "Bits should be non-negative";
+    EXPECT_GE(info[i].error, 0) << "Error should be non-negative";
+    EXPECT_GE(info[i].count_I, 0) << "I-block count should be non-negative";
+    EXPECT_GE(info[i].count_P, 0) << "P-block count should be non-negative";
+    EXPECT_GE(info[i].count_B, 0) << "B-block count should be non-negative";
   }
 }
 
@@ -228,13 +315,13 @@ TEST_F(IntegrationTest, ComplexityAnalyzer_ConsistentResults) {
       << "Both runs should analyze same number of frames";
 
   for (size_t i = 0; i < info1.size(); i++) {
-    EXPECT_EQ(info1[i]->picNum, info2[i]->picNum);
-    EXPECT_EQ(info1[i]->picType, info2[i]->picType);
-    EXPECT_EQ(info1[i]->error, info2[i]->error);
-    EXPECT_EQ(info1[i]->bits, info2[i]->bits);
-    EXPECT_EQ(info1[i]->count_I, info2[i]->count_I);
-    EXPECT_EQ(info1[i]->count_P, info2[i]->count_P);
-    EXPECT_EQ(info1[i]->count_B, info2[i]->count_B);
+    EXPECT_EQ(info1[i].picNum, info2[i].picNum);
+    EXPECT_EQ(info1[i].picType, info2[i].picType);
+    EXPECT_EQ(info1[i].error, info2[i].error);
+    EXPECT_EQ(info1[i].bits, info2[i].bits);
+    EXPECT_EQ(info1[i].count_I, info2[i].count_I);
+    EXPECT_EQ(info1[i].count_P, info2[i].count_P);
+    EXPECT_EQ(info1[i].count_B, info2[i].count_B);
   }
 }
 
@@ -259,11 +346,904 @@ TEST_F(IntegrationTest, ComplexityAnalyzer_SmallGOP) {
   ASSERT_EQ(10, info.size()) << "Should analyze all 10 frames";
 
   // First frame should be I-frame
-  EXPECT_EQ('I', info[0]->picType);
+  EXPECT_EQ('I', info[0].picType);
 
   // Frame at GOP boundary should be I-frame
   if (info.size() > 5) {
-    EXPECT_EQ('I', info[5]->picType)
+    EXPECT_EQ('I', info[5].picType)
         << "Frame at GOP boundary should be I-frame";
   }
 }
+
+TEST_F(IntegrationTest, ComplexityAnalyzer_PipelinedMatchesSerial) {
+  std::string test_file = test_data_dir + "/testsrc.yuv";
+
+  if (!fileExists(test_file)) {
+    GTEST_SKIP() << "Test file not found: " << test_file;
+  }
+
+  DIM dim = {320, 180};
+
+  YUVSequenceReader reader1;
+  reader1.Open(openFile(test_file), test_file, dim);
+  ComplexityAnalyzer serial(&reader1, 5, 10, 2);
+  serial.analyze();
+  auto info1 = serial.getInfo();
+
+  YUVSequenceReader reader2;
+  reader2.Open(openFile(test_file), test_file, dim);
+  ComplexityAnalyzer pipelined(&reader2, 5, 10, 2, true);
+  pipelined.analyze();
+  auto info2 = pipelined.getInfo();
+
+  // Reading ahead and searching B-frames in parallel must not change results
+  ASSERT_EQ(info1.size(), info2.size());
+
+  for (size_t i = 0; i < info1.size(); i++) {
+    EXPECT_EQ(info1[i].picNum, info2[i].picNum);
+    EXPECT_EQ(info1[i].picType, info2[i].picType);
+    EXPECT_EQ(info1[i].error, info2[i].error);
+    EXPECT_EQ(info1[i].bits, info2[i].bits);
+    EXPECT_EQ(info1[i].count_I, info2[i].count_I);
+    EXPECT_EQ(info1[i].count_P, info2[i].count_P);
+    EXPECT_EQ(info1[i].count_B, info2[i].count_B);
+  }
+}
+
+TEST_F(IntegrationTest, GOPParallelAnalyzer_MatchesSerial) {
+  std::string test_file = test_data_dir + "/testsrc.y4m";
+
+  if (!fileExists(test_file)) {
+    GTEST_SKIP() << "Test file not found: " << test_file;
+  }
+
+  Y4MSequenceReader reader1;
+  reader1.Open(openFile(test_file), test_file);
+  ComplexityAnalyzer serial(&reader1, 3, 0, 1);
+  serial.analyze();
+  auto info1 = serial.getInfo();
+
+  Y4MSequenceReader reader2;
+  reader2.Open(openFile(test_file), test_file);
+  GOPParallelAnalyzer parallel(&reader2, 3, 0, 1, 4);
+  parallel.analyze();
+  auto info2 = parallel.getInfo();
+
+  // GOPs are closed, so analyzing them separately must not change results
+  ASSERT_EQ(info1.size(), info2.size());
+
+  for (size_t i = 0; i < info1.size(); i++) {
+    EXPECT_EQ(info1[i].picNum, info2[i].picNum);
+    EXPECT_EQ(info1[i].picType, info2[i].picType);
+    EXPECT_EQ(info1[i].error, info2[i].error);
+    EXPECT_EQ(info1[i].bits, info2[i].bits);
+    EXPECT_EQ(info1[i].count_I, info2[i].count_I);
+    EXPECT_EQ(info1[i].count_P, info2[i].count_P);
+    EXPECT_EQ(info1[i].count_B, info2[i].count_B);
+  }
+}
+
+TEST_F(IntegrationTest, ComplexityAnalyzer_WavefrontMatchesSerial) {
+  std::string test_file = test_data_dir + "/testsrc.yuv";
+
+  if (!fileExists(test_file)) {
+    GTEST_SKIP() << "Test file not found: " << test_file;
+  }
+
+  DIM dim = {320, 180};
+
+  YUVSequenceReader reader1;
+  reader1.Open(openFile(test_file), test_file, dim);
+  ComplexityAnalyzer serial(&reader1, 10, 10, 2);
+  serial.analyze();
+  auto info1 = serial.getInfo();
+
+  YUVSequenceReader reader2;
+  reader2.Open(openFile(test_file), test_file, dim);
+  ComplexityAnalyzer wavefront(&reader2, 10, 10, 2, false, 4);
+  wavefront.analyze();
+  auto info2 = wavefront.getInfo();
+
+  // Rows only start once the row above provided their predictors
+  ASSERT_EQ(info1.size(), info2.size());
+
+  for (size_t i = 0; i < info1.size(); i++) {
+    EXPECT_EQ(info1[i].picNum, info2[i].picNum);
+    EXPECT_EQ(info1[i].picType, info2[i].picType);
+    EXPECT_EQ(info1[i].error, info2[i].error);
+    EXPECT_EQ(info1[i].bits, info2[i].bits);
+    EXPECT_EQ(info1[i].count_I, info2[i].count_I);
+    EXPECT_EQ(info1[i].count_P, info2[i].count_P);
+    EXPECT_EQ(info1[i].count_B, info2[i].count_B);
+  }
+}
+
+#ifdef HAVE_MMAP
+TEST_F(IntegrationTest, MappedReader_MatchesStdioReaders) {
+  std::string yuv_file = test_data_dir + "/testsrc.yuv";
+  std::string y4m_file = test_data_dir + "/testsrc.y4m";
+
+  if (!fileExists(yuv_file) || !fileExists(y4m_file)) {
+    GTEST_SKIP() << "Test files not found in " << test_data_dir;
+  }
+
+  DIM dim = {320, 180};
+
+  YUVSequenceReader yuv_reader;
+  yuv_reader.Open(openFile(yuv_file), yuv_file, dim);
+  MappedSequenceReader mapped_yuv;
+  ASSERT_TRUE(mapped_yuv.Open(openFile(yuv_file), yuv_file, dim));
+
+  Y4MSequenceReader y4m_reader;
+  y4m_reader.Open(openFile(y4m_file), y4m_file);
+  MappedSequenceReader mapped_y4m;
+  ASSERT_TRUE(mapped_y4m.Open(openFile(y4m_file), y4m_file));
+  EXPECT_TRUE(mapped_y4m.isOpen());
+  EXPECT_EQ(y4m_reader.dim().width, mapped_y4m.dim().width);
+  EXPECT_EQ(y4m_reader.dim().height, mapped_y4m.dim().height);
+
+  YUVSequenceReader *readers[2][2] = {{&yuv_reader, &mapped_yuv},
+                                      {&y4m_reader, &mapped_y4m}};
+  for (auto &pair : readers) {
+    ASSERT_EQ(pair[0]->nframes(), pair[1]->nframes());
+    ASSERT_GT(pair[1]->nframes(), 2);
+
+    // Start at the last frames to exercise the frame index
+    const int first = pair[1]->nframes() - 2;
+    ASSERT_TRUE(pair[0]->seek(first));
+    ASSERT_TRUE(pair[1]->seek(first));
+
+    const ptrdiff_t stride = pair[0]->stride();
+    const size_t luma = (size_t)(stride * pair[0]->dim().height);
+    std::vector<uint8_t> planes[2];
+    for (int frame = first; frame < pair[0]->nframes(); frame++) {
+      for (int k = 0; k < 2; k++) {
+        planes[k].assign(luma * 3 / 2, 0);
+        uint8_t *pY = planes[k].data();
+        pair[k]->read(pY, pY + luma, pY + luma * 5 / 4);
+      }
+      EXPECT_EQ(planes[0], planes[1]) << "Frame " << frame << " differs";
+    }
+    EXPECT_TRUE(pair[1]->eof());
+    EXPECT_THROW(pair[1]->read(planes[1].data(), planes[1].data(),
+                               planes[1].data()),
+                 EOFException);
+  }
+}
+
+#endif // HAVE_MMAP
+
+TEST_F(IntegrationTest, Readers_LumaOnlyMatchesFullRead) {
+  std::string yuv_file = test_data_dir + "/testsrc.yuv";
+  std::string y4m_file = test_data_dir + "/testsrc.y4m";
+
+  if (!fileExists(yuv_file) || !fileExists(y4m_file)) {
+    GTEST_SKIP() << "Test files not found in " << test_data_dir;
+  }
+
+  DIM dim = {320, 180};
+
+  YUVSequenceReader full_yuv, luma_yuv;
+  full_yuv.Open(openFile(yuv_file), yuv_file, dim);
+  luma_yuv.Open(openFile(yuv_file), yuv_file, dim);
+  Y4MSequenceReader full_y4m, luma_y4m;
+  full_y4m.Open(openFile(y4m_file), y4m_file);
+  luma_y4m.Open(openFile(y4m_file), y4m_file);
+  std::vector<std::vector<YUVSequenceReader *>> readers = {
+      {&full_yuv, &luma_yuv}, {&full_y4m, &luma_y4m}};
+#ifdef HAVE_MMAP
+  MappedSequenceReader full_mapped, luma_mapped;
+  ASSERT_TRUE(full_mapped.Open(openFile(y4m_file), y4m_file));
+  ASSERT_TRUE(luma_mapped.Open(openFile(y4m_file), y4m_file));
+  readers.push_back({&full_mapped, &luma_mapped});
+#endif
+  for (auto &pair : readers) {
+    YUVFrame full(pair[0]);
+    YUVFrame luma(pair[1], true);
+    EXPECT_EQ(nullptr, luma.u());
+    EXPECT_EQ(nullptr, luma.v());
+
+    const int stride = full.stride();
+    int frames = 0;
+    try {
+      for (;;) {
+        full.readNextFrame();
+        luma.readNextFrame();
+        for (int y = 0; y < dim.height; y++) {
+          ASSERT_EQ(0, memcmp(full.y() + y * stride, luma.y() + y * stride,
+                              dim.width))
+              << "Frame " << frames << " row " << y << " differs";
+        }
+        frames++;
+      }
+    } catch (EOFException &) {
+    }
+    EXPECT_EQ(pair[0]->nframes(), frames);
+    EXPECT_EQ(pair[0]->count(), pair[1]->count());
+  }
+}
+
+TEST_F(IntegrationTest, StreamingOutput_MatchesBatchOutput) {
+  std::string test_file = test_data_dir + "/testsrc.y4m";
+
+  if (!fileExists(test_file)) {
+    GTEST_SKIP() << "Test file not found: " << test_file;
+  }
+
+  Y4MSequenceReader reader1;
+  reader1.Open(openFile(test_file), test_file);
+  ComplexityAnalyzer batch(&reader1, 4, 0, 2);
+  batch.setVerbose(false);
+  batch.analyze();
+  motion_search::AnalysisResults results =
+      motion_search::DataConverter::convert(batch.getInfo(), 320, 180, 4, 2,
+                                            "y4m", test_file);
+
+  for (const char *format : {"csv", "json", "xml"}) {
+    for (auto detail : {motion_search::DetailLevel::FRAME,
+                        motion_search::DetailLevel::GOP}) {
+      std::ostringstream expected;
+      motion_search::createOutputWriter(format, detail, expected)
+          ->write(results);
+
+      // Stream the frames from the single and the GOP-parallel analyzers
+      for (int threads : {1, 3}) {
+        Y4MSequenceReader reader2;
+        reader2.Open(openFile(test_file), test_file);
+
+        std::ostringstream streamed;
+        auto writer = motion_search::createOutputWriter(format, detail,
+                                                        streamed);
+        motion_search::StreamingConverter output(*writer, results.metadata);
+        auto callback = [&output](const complexity_info_t &info) {
+          output.addFrame(info);
+        };
+
+        output.begin();
+        if (threads > 1) {
+          GOPParallelAnalyzer analyzer(&reader2, 4, 0, 2, threads);
+          analyzer.setFrameCallback(callback);
+          analyzer.analyze();
+          EXPECT_TRUE(analyzer.getInfo().empty());
+        } else {
+          ComplexityAnalyzer analyzer(&reader2, 4, 0, 2);
+          analyzer.setVerbose(false);
+          analyzer.setFrameCallback(callback);
+          analyzer.analyze();
+          EXPECT_TRUE(analyzer.getInfo().empty());
+        }
+        output.end();
+
+        EXPECT_EQ(results.metadata.total_frames, output.frameCount());
+        EXPECT_EQ(expected.str(), streamed.str())
+            << format << " output differs with " << threads << " threads";
+      }
+    }
+  }
+}
+
+// Test the per-macroblock dump against the per-frame results
+TEST_F(IntegrationTest, MacroblockWriter_MatchesFrameResults) {
+  std::string test_file = test_data_dir + "/testsrc.y4m";
+
+  if (!fileExists(test_file)) {
+    GTEST_SKIP() << "Test file not found: " << test_file;
+  }
+
+  const std::string dump_file = ::testing::TempDir() + "/mb_dump.bin";
+  std::vector<complexity_info_t> info;
+  {
+    Y4MSequenceReader reader;
+    reader.Open(openFile(test_file), test_file);
+    motion_search::MacroblockWriter writer;
+    ASSERT_TRUE(writer.open(dump_file, 320, 180, 4, 2));
+
+    // Several GOPs write their frames concurrently
+    GOPParallelAnalyzer analyzer(&reader, 4, 0, 2, 3);
+    analyzer.setMacroblockCallback([&writer](const mb_frame_info_t &frame) {
+      writer.writeFrame(frame);
+    });
+    analyzer.analyze();
+    writer.close();
+    info = analyzer.getInfo();
+  }
+  ASSERT_FALSE(info.empty());
+
+  std::ifstream in(dump_file, std::ios::binary);
+  std::string data((std::istreambuf_iterator<char>(in)),
+                   std::istreambuf_iterator<char>());
+  std::remove(dump_file.c_str());
+  ASSERT_GE(data.size(), sizeof(motion_search::MacroblockFileHeader));
+
+  motion_search::MacroblockFileHeader header;
+  memcpy(&header, data.data(), sizeof(header));
+  EXPECT_EQ(0, memcmp(header.magic, "MSMBDUMP", 8));
+  EXPECT_EQ(motion_search::MacroblockLayout::VERSION, header.version);
+  EXPECT_EQ(320, header.width);
+  EXPECT_EQ(180, header.height);
+  EXPECT_EQ(20, header.mbs_x);
+  EXPECT_EQ(12, header.mbs_y);
+  EXPECT_EQ((int)info.size(), header.frame_count);
+
+  const int num_mbs = header.mbs_x * header.mbs_y;
+  const motion_search::MacroblockLayout layout(num_mbs);
+  ASSERT_EQ(layout.frameSize(), header.frame_size);
+  ASSERT_EQ(header.header_size + info.size() * header.frame_size, data.size());
+
+  for (size_t n = 0; n < info.size(); n++) {
+    const char *record =
+        data.data() + header.header_size + n * header.frame_size;
+    motion_search::MacroblockFrameHeader frame;
+    memcpy(&frame, record, sizeof(frame));
+    EXPECT_EQ((int)n, frame.frame_num);
+    EXPECT_EQ(info[n].picType, frame.type);
+    EXPECT_EQ(info[n].bits, frame.bits);
+    EXPECT_EQ(info[n].error, frame.error);
+
+    const unsigned char *modes =
+        reinterpret_cast<const unsigned char *>(record + layout.modeOffset());
+    int count_I = 0, count_P = 0, count_B = 0;
+    for (int i = 0; i < num_mbs; i++) {
+      if (modes[i] == 0) {
+        count_I++;
+      } else if (modes[i] <= 2) {
+        count_P++;
+      } else {
+        count_B++;
+      }
+    }
+    EXPECT_EQ(info[n].count_I, count_I) << "frame " << n;
+    EXPECT_EQ(info[n].count_P, count_P) << "frame " << n;
+    EXPECT_EQ(info[n].count_B, count_B) << "frame " << n;
+
+    // I-pictures have no motion
+    if (frame.type == 'I') {
+      std::vector<char> zeros(layout.modeOffset() - layout.sadOffset(0), 0);
+      EXPECT_EQ(0, memcmp(record + layout.sadOffset(0), zeros.data(),
+                          zeros.size()));
+    }
+  }
+}
+
+// Test that the stage timers count every frame, and reach the output
+TEST_F(IntegrationTest, StageTimes_CountFramesAndReachOutput) {
+  std::string test_file = test_data_dir + "/testsrc.y4m";
+
+  if (!fileExists(test_file)) {
+    GTEST_SKIP() << "Test file not found: " << test_file;
+  }
+
+  for (bool pipelined : {false, true}) {
+    Y4MSequenceReader reader;
+    reader.Open(openFile(test_file), test_file);
+
+    motion_search::VideoMetadata metadata;
+    metadata.width = 320;
+    metadata.height = 180;
+    std::ostringstream json_out;
+    auto writer = motion_search::createOutputWriter(
+        "json", motion_search::DetailLevel::FRAME, json_out);
+    motion_search::StreamingConverter output(*writer, metadata);
+
+    int frames[NUM_FRAME_TYPES] = {0, 0, 0};
+    ComplexityAnalyzer analyzer(&reader, 4, 0, 2, pipelined);
+    analyzer.setVerbose(false);
+    analyzer.setFrameCallback([&](const complexity_info_t &info) {
+      frames[frame_type_index((char)info.picType)]++;
+      output.addFrame(info);
+    });
+
+    output.begin();
+    analyzer.analyze();
+    const stage_times_t times = analyzer.getTimes();
+    output.end(&times);
+
+    EXPECT_EQ(frames[0], times.calls[STAGE_PREDICT_SPATIAL]);
+    EXPECT_EQ(frames[1], times.calls[STAGE_PREDICT_TEMPORAL]);
+    EXPECT_EQ(frames[2], times.calls[STAGE_PREDICT_BIDIRECTIONAL]);
+    for (int i = 0; i < NUM_FRAME_TYPES; i++) {
+      EXPECT_EQ(frames[i], times.type_frames[i]);
+    }
+    EXPECT_GE(times.calls[STAGE_READ], output.frameCount());
+    EXPECT_GE(times.calls[STAGE_BOUNDARY_EXTEND], frames[0] + frames[1]);
+    EXPECT_GT(times.ns[STAGE_PREDICT_TEMPORAL], 0);
+    EXPECT_GE(output.times().calls[STAGE_CONVERT], output.frameCount());
+    EXPECT_GE(output.times().calls[STAGE_WRITE], output.frameCount());
+
+    const std::string json = json_out.str();
+    EXPECT_NE(std::string::npos, json.find("\"timing\""));
+    EXPECT_NE(std::string::npos, json.find("\"predict_bidirectional\""));
+    EXPECT_NE(std::string::npos, json.find("\"avg_ms\""));
+  }
+}
+
+// Test that counting hardware events leaves the results unchanged, and that
+// the B-frames searched on the pool threads of --pipeline are counted
+TEST_F(IntegrationTest, PerfCounters_DoNotChangeResults) {
+  std::string test_file = test_data_dir + "/testsrc.y4m";
+
+  if (!fileExists(test_file)) {
+    GTEST_SKIP() << "Test file not found: " << test_file;
+  }
+
+  for (bool pipelined : {false, true}) {
+    SCOPED_TRACE(pipelined ? "pipelined" : "serial");
+    std::vector<complexity_info_t> results[2];
+    frame_counts_t counts;
+    bool enabled = false;
+    for (int counted = 0; counted < 2; counted++) {
+      Y4MSequenceReader reader;
+      reader.Open(openFile(test_file), test_file);
+
+      ComplexityAnalyzer analyzer(&reader, 4, 0, 2, pipelined);
+      analyzer.setVerbose(false);
+      if (counted) {
+        enabled = analyzer.enablePerfCounters();
+      }
+      analyzer.analyze();
+      results[counted] = analyzer.getInfo();
+      counts = analyzer.getCounts();
+    }
+
+    ASSERT_EQ(results[0].size(), results[1].size());
+    for (size_t i = 0; i < results[0].size(); i++) {
+      EXPECT_EQ(results[0][i].picType, results[1][i].picType);
+      EXPECT_EQ(results[0][i].error, results[1][i].error);
+      EXPECT_EQ(results[0][i].bits, results[1][i].bits);
+    }
+
+    // The kernel may refuse the counters; nothing is counted then
+    int frames = 0;
+    int b_frames = 0;
+    for (int t = 0; t < NUM_FRAME_TYPES; t++) {
+      frames += counts.frames[t];
+    }
+    for (const complexity_info_t &info : results[1]) {
+      b_frames += info.picType == 'B';
+    }
+    if (enabled) {
+      EXPECT_TRUE(counts.available[PERF_CYCLES]);
+      EXPECT_EQ((int)results[1].size(), frames);
+      EXPECT_EQ(b_frames, counts.frames[frame_type_index('B')]);
+      EXPECT_GT(counts.events[frame_type_index('P')][PERF_CYCLES], 0u);
+      EXPECT_EQ(counts.frames[frame_type_index('I')] * 20 * 12,
+                counts.macroblocks[frame_type_index('I')]);
+    } else {
+      EXPECT_FALSE(counts.available[PERF_CYCLES]);
+      EXPECT_EQ(0, frames);
+    }
+  }
+}
+
+// Test that the scaled reader decimates the frames of its source and that
+// the analysis runs on them
+TEST_F(IntegrationTest, ScaledReader_DecimatesFrames) {
+  std::string test_file = test_data_dir + "/testsrc.y4m";
+
+  if (!fileExists(test_file)) {
+    GTEST_SKIP() << "Test file not found: " << test_file;
+  }
+
+  for (int scale : {2, 4}) {
+    Y4MSequenceReader full_reader;
+    full_reader.Open(openFile(test_file), test_file);
+    Y4MSequenceReader source;
+    source.Open(openFile(test_file), test_file);
+    ScaledSequenceReader reader(&source, scale);
+
+    ASSERT_TRUE(reader.isOpen());
+    EXPECT_EQ(320 / scale, reader.dim().width);
+    EXPECT_EQ(180 / scale, reader.dim().height);
+    EXPECT_EQ(source.nframes(), reader.nframes());
+
+    // Each pixel is the average of its scale x scale block, give or take
+    // the rounding of the two passes of a scale of 4
+    YUVFrame full(&full_reader);
+    YUVFrame scaled(&reader);
+    full.readNextFrame();
+    scaled.readNextFrame();
+    EXPECT_EQ(1, reader.count());
+    for (int y = 0; y < reader.dim().height; y++) {
+      for (int x = 0; x < reader.dim().width; x++) {
+        int sum = 0;
+        for (int i = 0; i < scale; i++) {
+          for (int j = 0; j < scale; j++) {
+            sum += full.y()[(y * scale + i) * full.stride() + x * scale + j];
+          }
+        }
+        const int avg = (sum + scale * scale / 2) / (scale * scale);
+        ASSERT_NEAR(avg, scaled.y()[y * scaled.stride() + x], 1)
+            << "scale " << scale << " x " << x << " y " << y;
+      }
+    }
+  }
+
+  // The analysis gives a result per frame of the input
+  Y4MSequenceReader full_reader;
+  full_reader.Open(openFile(test_file), test_file);
+  ComplexityAnalyzer full(&full_reader, 4, 0, 2);
+  full.setVerbose(false);
+  full.analyze();
+
+  Y4MSequenceReader source;
+  source.Open(openFile(test_file), test_file);
+  ScaledSequenceReader reader(&source, 2);
+  ComplexityAnalyzer scaled(&reader, 4, 0, 2);
+  scaled.setVerbose(false);
+  scaled.analyze();
+
+  ASSERT_EQ(full.getInfo().size(), scaled.getInfo().size());
+  for (size_t i = 0; i < full.getInfo().size(); i++) {
+    EXPECT_EQ(full.getInfo()[i].picType, scaled.getInfo()[i].picType);
+    EXPECT_GT(scaled.getInfo()[i].bits, 0);
+  }
+}
+
+// Test that pyramid seeding gives the same results however the pictures are
+// scheduled, and that the seeded search doesn't code more intra macroblocks
+TEST_F(IntegrationTest, Pyramid_MatchesAcrossSchedules) {
+  std::string test_file = test_data_dir + "/testsrc.yuv";
+
+  if (!fileExists(test_file)) {
+    GTEST_SKIP() << "Test file not found: " << test_file;
+  }
+
+  const auto results =
+      analyzeSchedules(test_file, [](ComplexityAnalyzer &analyzer) {
+        analyzer.setPyramid(true);
+      });
+  for (size_t k = 1; k < results.size(); k++) {
+    expectSameResults(results[0], results[k]);
+  }
+
+  const auto unseeded = analyzeClip(test_file, [](ComplexityAnalyzer &) {});
+
+  int count_I[2] = {0, 0};
+  ASSERT_EQ(results[0].size(), unseeded.size());
+  for (size_t i = 0; i < unseeded.size(); i++) {
+    count_I[0] += results[0][i].count_I;
+    count_I[1] += unseeded[i].count_I;
+  }
+  EXPECT_LE(count_I[0], count_I[1]);
+}
+
+// Test that sampling analyzes the planned GOPs exactly as a full analysis
+// does, and reports the skipped ones in order, whether the reader seeks past
+// them (Y4M) or reads them (scaled), with read-ahead or not
+TEST_F(IntegrationTest, Sampling_MatchesFullAnalysisOfSampledGOPs) {
+  std::string test_file = test_data_dir + "/testsrc.y4m";
+
+  if (!fileExists(test_file)) {
+    GTEST_SKIP() << "Test file not found: " << test_file;
+  }
+
+  // 5 GOPs of 2 frames: every other GOP, or 2 GOPs centered in halves
+  const gop_sampling_t plans[2] = {{2, 0}, {0, 2}};
+  const std::vector<int> expected_gops[2] = {{0, 2, 4}, {1, 3}};
+
+  for (int scaled = 0; scaled < 2; scaled++) {
+    Y4MSequenceReader full_reader;
+    full_reader.Open(openFile(test_file), test_file);
+    ScaledSequenceReader full_scaled(&full_reader, 2);
+    ComplexityAnalyzer full(
+        scaled ? (IVideoSequenceReader *)&full_scaled : &full_reader, 2, 0,
+        1);
+    full.setVerbose(false);
+    full.analyze();
+    const auto &all = full.getInfo();
+    ASSERT_EQ(10u, all.size());
+
+    for (int p = 0; p < 2; p++) {
+      for (int pipelined = 0; pipelined < 2; pipelined++) {
+        Y4MSequenceReader reader;
+        reader.Open(openFile(test_file), test_file);
+        ScaledSequenceReader scaled_reader(&reader, 2);
+        ComplexityAnalyzer analyzer(
+            scaled ? (IVideoSequenceReader *)&scaled_reader : &reader, 2, 0, 1,
+            pipelined);
+        analyzer.setVerbose(false);
+        analyzer.setSampling(plans[p]);
+
+        // Frames and skipped GOPs arrive in display order
+        std::vector<int> order;
+        std::vector<complexity_info_t> frames;
+        analyzer.setFrameCallback([&](const complexity_info_t &info) {
+          order.push_back(info.picNum);
+          frames.push_back(info);
+        });
+        analyzer.setSkipCallback([&](int first_frame, int num_frames) {
+          EXPECT_EQ(2, num_frames);
+          order.push_back(first_frame);
+          order.push_back(first_frame + 1);
+        });
+        analyzer.analyze();
+
+        std::vector<int> display(10);
+        for (int i = 0; i < 10; i++) {
+          display[i] = i;
+        }
+        EXPECT_EQ(display, order);
+
+        ASSERT_EQ(2 * expected_gops[p].size(), frames.size());
+        for (size_t i = 0; i < frames.size(); i++) {
+          const complexity_info_t &expected =
+              all[(size_t)(expected_gops[p][i / 2] * 2 + (int)(i % 2))];
+          EXPECT_EQ(expected.picNum, frames[i].picNum);
+          EXPECT_EQ(expected.picType, frames[i].picType);
+          EXPECT_EQ(expected.error, frames[i].error);
+          EXPECT_EQ(expected.bits, frames[i].bits);
+        }
+      }
+    }
+  }
+
+  // GOP-parallel ranges are skipped the same way
+  Y4MSequenceReader reader;
+  reader.Open(openFile(test_file), test_file);
+  GOPParallelAnalyzer analyzer(&reader, 2, 0, 1, 3);
+  analyzer.setSampling(plans[0]);
+  std::vector<int> skipped;
+  analyzer.setSkipCallback(
+      [&](int first_frame, int) { skipped.push_back(first_frame); });
+  analyzer.analyze();
+  EXPECT_EQ(6u, analyzer.getInfo().size());
+  EXPECT_EQ(std::vector<int>({2, 6}), skipped);
+
+  // The GOP output marks the skipped GOPs, and the estimate covers them
+  Y4MSequenceReader reader2;
+  reader2.Open(openFile(test_file), test_file);
+  motion_search::VideoMetadata metadata;
+  metadata.width = 320;
+  metadata.height = 180;
+  metadata.sampling = true;
+  std::ostringstream csv;
+  auto writer = motion_search::createOutputWriter(
+      "csv", motion_search::DetailLevel::GOP, csv);
+  motion_search::StreamingConverter output(*writer, metadata);
+  ComplexityAnalyzer sampled(&reader2, 2, 0, 1);
+  sampled.setVerbose(false);
+  sampled.setSampling(plans[0]);
+  sampled.setFrameCallback(
+      [&output](const complexity_info_t &info) { output.addFrame(info); });
+  sampled.setSkipCallback([&output](int first_frame, int frames) {
+    output.skipGOP(first_frame, frames);
+  });
+  output.begin();
+  sampled.analyze();
+  output.end();
+
+  std::vector<std::string> marks;
+  std::istringstream lines(csv.str());
+  std::string line;
+  std::getline(lines, line);
+  EXPECT_EQ("sampled", line.substr(line.rfind(',') + 1));
+  while (std::getline(lines, line)) {
+    marks.push_back(line.substr(0, line.find(',')) + ":" +
+                    line.substr(line.rfind(',') + 1));
+  }
+  EXPECT_EQ(std::vector<std::string>({"0:1", "1:0", "2:1", "3:0", "4:1"}),
+            marks);
+
+  const motion_search::SamplingEstimate estimate = output.estimate();
+  EXPECT_EQ(3, estimate.sampled_gops);
+  EXPECT_EQ(2, estimate.estimated_gops);
+  EXPECT_EQ(10, estimate.total_frames);
+  EXPECT_TRUE(estimate.has_bounds);
+  EXPECT_LE(estimate.bits_low, estimate.total_bits);
+  EXPECT_GE(estimate.bits_high, estimate.total_bits);
+}
+
+// Test the totals extrapolated from the sampled GOPs and their bounds
+TEST_F(IntegrationTest, SampleEstimator_ExtrapolatesTotals) {
+  auto gop = [](int frames, int64_t bits, int64_t error) {
+    motion_search::GOPData data;
+    data.frames.resize((size_t)frames);
+    data.total_bits = bits;
+    data.total_error = error;
+    return data;
+  };
+
+  // Every GOP sampled: the totals are exact
+  motion_search::SampleEstimator all;
+  all.addSampled(gop(10, 1000, 50));
+  all.addSampled(gop(10, 1400, 70));
+  motion_search::SamplingEstimate estimate = all.estimate();
+  EXPECT_TRUE(estimate.has_bounds);
+  EXPECT_DOUBLE_EQ(2400.0, estimate.total_bits);
+  EXPECT_DOUBLE_EQ(2400.0, estimate.bits_low);
+  EXPECT_DOUBLE_EQ(2400.0, estimate.bits_high);
+
+  // Half of the GOPs, with a shorter last one: 100 bits per frame
+  motion_search::SampleEstimator half;
+  half.addSampled(gop(10, 900, 40));
+  half.addEstimated(10);
+  half.addSampled(gop(10, 1100, 60));
+  half.addEstimated(5);
+  estimate = half.estimate();
+  EXPECT_EQ(2, estimate.sampled_gops);
+  EXPECT_EQ(2, estimate.estimated_gops);
+  EXPECT_EQ(20, estimate.sampled_frames);
+  EXPECT_EQ(35, estimate.total_frames);
+  EXPECT_TRUE(estimate.has_bounds);
+  EXPECT_DOUBLE_EQ(3500.0, estimate.total_bits);
+  EXPECT_DOUBLE_EQ(175.0, estimate.total_error);
+  EXPECT_LT(estimate.bits_low, estimate.total_bits);
+  EXPECT_GE(estimate.bits_low, 2000.0);
+  EXPECT_GT(estimate.bits_high, estimate.total_bits);
+
+  // A single sampled GOP gives no bounds
+  motion_search::SampleEstimator single;
+  single.addSampled(gop(10, 1000, 50));
+  single.addEstimated(10);
+  estimate = single.estimate();
+  EXPECT_FALSE(estimate.has_bounds);
+  EXPECT_DOUBLE_EQ(2000.0, estimate.total_bits);
+}
+
+// Test that skipping the search of static macroblocks gives the same results
+// however the pictures are scheduled, and only ever skips in P-frames
+TEST_F(IntegrationTest, StaticSkip_MatchesAcrossSchedules) {
+  std::string test_file = test_data_dir + "/testsrc.yuv";
+
+  if (!fileExists(test_file)) {
+    GTEST_SKIP() << "Test file not found: " << test_file;
+  }
+
+  const auto results =
+      analyzeSchedules(test_file, [](ComplexityAnalyzer &analyzer) {
+        analyzer.setSkipThreshold(2);
+      });
+
+  int skipped = 0;
+  for (size_t i = 0; i < results[0].size(); i++) {
+    if (results[0][i].picType == 'P') {
+      EXPECT_LE(results[0][i].count_skip, results[0][i].count_P);
+      skipped += results[0][i].count_skip;
+    } else {
+      EXPECT_EQ(0, results[0][i].count_skip);
+    }
+  }
+  EXPECT_GT(skipped, 0) << "The test clip has a static background";
+
+  for (size_t k = 1; k < results.size(); k++) {
+    expectSameResults(results[0], results[k]);
+  }
+}
+
+// Test that partition pruning gives the same results however the pictures
+// are scheduled, and stays close to the search of every partition
+TEST_F(IntegrationTest, PartitionPruning_MatchesAcrossSchedules) {
+  std::string test_file = test_data_dir + "/testsrc.yuv";
+
+  if (!fileExists(test_file)) {
+    GTEST_SKIP() << "Test file not found: " << test_file;
+  }
+
+  const auto results =
+      analyzeSchedules(test_file, [](ComplexityAnalyzer &analyzer) {
+        analyzer.setPartitionPruning(true);
+      });
+  for (size_t k = 1; k < results.size(); k++) {
+    expectSameResults(results[0], results[k]);
+  }
+
+  const auto unpruned =
+      analyzeClip(test_file, [](ComplexityAnalyzer &analyzer) {
+        analyzer.setPartitionPruning(false);
+      });
+
+  int64_t bits[2] = {0, 0};
+  int64_t error[2] = {0, 0};
+  ASSERT_EQ(results[0].size(), unpruned.size());
+  for (size_t i = 0; i < unpruned.size(); i++) {
+    bits[0] += results[0][i].bits;
+    bits[1] += unpruned[i].bits;
+    error[0] += results[0][i].error;
+    error[1] += unpruned[i].error;
+  }
+  EXPECT_NEAR((double)bits[0] / bits[1], 1.0, 0.01);
+  EXPECT_NEAR((double)error[0] / error[1], 1.0, 0.01);
+}
+
+// Search strategy and macroblock size of the analyses
+class ScheduleTest
+    : public IntegrationTest,
+      public ::testing::WithParamInterface<std::tuple<int, int>> {};
+
+// Test that every search strategy gives the same results however the
+// pictures are scheduled, GOP-parallel analysis included, in macroblocks of
+// every size, and that the defaults are those of the analyzers without a
+// strategy or size
+TEST_P(ScheduleTest, MatchAcrossSchedules) {
+  std::string test_file = test_data_dir + "/testsrc.yuv";
+
+  if (!fileExists(test_file)) {
+    GTEST_SKIP() << "Test file not found: " << test_file;
+  }
+
+  const me_method_t method = (me_method_t)std::get<0>(GetParam());
+  const int size = std::get<1>(GetParam());
+  DIM dim = {320, 180};
+
+  auto results = analyzeSchedules(
+      test_file,
+      [method](ComplexityAnalyzer &analyzer) {
+        analyzer.setSearchMethod(method);
+      },
+      size);
+  {
+    YUVSequenceReader reader;
+    reader.Open(openFile(test_file), test_file, dim);
+    GOPParallelAnalyzer analyzer(&reader, 10, 10, 2, 2);
+    analyzer.setSearchMethod(method);
+    analyzer.setBlockSize(size);
+    analyzer.analyze();
+    results.push_back(analyzer.getInfo());
+  }
+
+  const int num_MBs = (dim.width / size) * ((dim.height + size - 1) / size);
+  for (const auto &info : results[0]) {
+    EXPECT_EQ(num_MBs, info.count_I + info.count_P + info.count_B);
+  }
+  for (size_t k = 1; k < results.size(); k++) {
+    expectSameResults(results[0], results[k]);
+  }
+
+  if (method == ME_PMVFAST && size == MB_WIDTH) {
+    YUVSequenceReader reader;
+    reader.Open(openFile(test_file), test_file, dim);
+    ComplexityAnalyzer analyzer(&reader, 10, 10, 2);
+    analyzer.setVerbose(false);
+    analyzer.analyze();
+    expectSameResults(analyzer.getInfo(), results[0]);
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    MethodsAndBlockSizes, ScheduleTest,
+    ::testing::Combine(::testing::Range(0, (int)NUM_ME_METHODS),
+                       ::testing::Values(8, 16, 32, 64)),
+    [](const ::testing::TestParamInfo<ScheduleTest::ParamType> &info) {
+      return std::string(me_method_name(std::get<0>(info.param))) + "_" +
+             std::to_string(std::get<1>(info.param));
+    });
+
+// Test that the analyzers reject the block sizes the kernels don't support,
+// the pyramid on blocks too small for its levels, and macroblocks that would
+// overhang the picture past its padding
+TEST_F(IntegrationTest, BlockSizes_RejectedByAnalyzers) {
+  std::string test_file = test_data_dir + "/testsrc.yuv";
+
+  if (!fileExists(test_file)) {
+    GTEST_SKIP() << "Test file not found: " << test_file;
+  }
+
+  DIM dim = {320, 180};
+  YUVSequenceReader reader;
+  reader.Open(openFile(test_file), test_file, dim);
+
+  for (int size : {0, 4, 12, 128}) {
+    EXPECT_THROW(ComplexityAnalyzer(&reader, 10, 10, 2, false, 1, size),
+                 std::invalid_argument)
+        << "size " << size;
+  }
+
+  ComplexityAnalyzer small(&reader, 10, 10, 2, false, 1, 8);
+  EXPECT_THROW(small.setPyramid(true), std::invalid_argument);
+  EXPECT_NO_THROW(small.setPyramid(false));
+
+  // A quarter of the width is 80 pixels, 48 short of two 64 pixel blocks
+  ScaledSequenceReader scaled(&reader, 4);
+  EXPECT_THROW(ComplexityAnalyzer(&scaled, 10, 10, 2, false, 1, 64),
+               std::invalid_argument);
+  EXPECT_NO_THROW(ComplexityAnalyzer(&scaled, 10, 10, 2, false, 1, 32));
+
+  GOPParallelAnalyzer parallel(&reader, 10, 10, 2, 2);
+  parallel.setBlockSize(8);
+  parallel.setPyramid(true);
+  EXPECT_THROW(parallel.analyze(), std::invalid_argument);
+  parallel.setPyramid(false);
+  parallel.setScale(4);
+  parallel.setBlockSize(64);
+  EXPECT_THROW(parallel.analyze(), std::invalid_argument);
+}
@@ -174,6 +174,206 @@ TEST_F(MomentsTest, SAD_EarlyTermination) {
   EXPECT_GE(sad_opt, min_SAD);
 }
 
+TEST_F(MomentsTest, SAD_EarlyTerminationRandomData) {
+  const int stride = 64;
+  std::vector<uint8_t> current(stride * 16);
+  std::vector<uint8_t> reference(stride * 16);
+  int (*const sad_fns[])(FAST_SAD_FORMAL_ARGS) = {fastSAD16, fastSAD8,
+                                                  fastSAD4};
+  const int sizes[] = {16, 8, 4};
+
+  for (int iter = 0; iter < 100; iter++) {
+    fillRandom(current.data(), current.size());
+    fillRandom(reference.data(), reference.size());
+
+    for (int k = 0; k < 3; k++) {
+      const int n = sizes[k];
+      int full = fastSAD16_c(current.data(), reference.data(), stride, n, n,
+                             INT32_MAX);
+
+      // Below min_SAD the result is exact, otherwise at least min_SAD
+      EXPECT_EQ(full, sad_fns[k](current.data(), reference.data(), stride, n,
+                                 n, full + 1))
+          << "SAD" << n << " iteration " << iter;
+      EXPECT_GE(sad_fns[k](current.data(), reference.data(), stride, n, n,
+                           full / 2),
+                full / 2)
+          << "SAD" << n << " iteration " << iter;
+    }
+  }
+}
+
+TEST_F(MomentsTest, SAD_ShortAndSaturatedBlocks) {
+  const int stride = 64;
+  std::vector<uint8_t> current(stride * 16);
+  std::vector<uint8_t> reference(stride * 16);
+  int (*const sad_fns[])(FAST_SAD_FORMAL_ARGS) = {fastSAD16, fastSAD8,
+                                                  fastSAD4};
+  const int sizes[] = {16, 8, 4};
+
+  for (int pattern = 0; pattern < 2; pattern++) {
+    // The largest differences, then random ones
+    if (pattern == 0) {
+      fillConstant(current.data(), stride, 16, stride, 0);
+      fillConstant(reference.data(), stride, 16, stride, 255);
+    } else {
+      fillRandom(current.data(), current.size());
+      fillRandom(reference.data(), reference.size());
+    }
+
+    for (int k = 0; k < 3; k++) {
+      const int n = sizes[k];
+      // Heights that end between two early exit checks
+      for (int height : {n, n - 1, n / 2 + 1, 1}) {
+        int full = 0;
+        for (int y = 0; y < height; y++) {
+          for (int x = 0; x < n; x++) {
+            full += abs(current[y * stride + x] - reference[y * stride + x]);
+          }
+        }
+
+        EXPECT_EQ(full, sad_fns[k](current.data(), reference.data(), stride,
+                                   n, height, INT32_MAX))
+            << "SAD" << n << " height " << height << " pattern " << pattern;
+      }
+    }
+  }
+}
+
+TEST_F(MomentsTest, SADxN_MatchesSingleSAD) {
+  const int stride = 64;
+  std::vector<uint8_t> current(stride * 16);
+  std::vector<uint8_t> reference(stride * 32);
+  void (*const sad_fns[])(FAST_SAD_XN_FORMAL_ARGS) = {
+      fastSAD16_xN, fastSAD8_xN, fastSAD4_xN, fastSAD16_xN_c};
+  const int sizes[] = {16, 8, 4, 16};
+
+  for (int iter = 0; iter < 100; iter++) {
+    fillRandom(current.data(), current.size());
+    fillRandom(reference.data(), reference.size());
+
+    for (int k = 0; k < 4; k++) {
+      const int n = sizes[k];
+      const int num_refs = 1 + iter % FAST_SAD_MAX_REFS;
+      const uint8_t *refs[FAST_SAD_MAX_REFS];
+      int full[FAST_SAD_MAX_REFS];
+      int SADs[FAST_SAD_MAX_REFS];
+
+      for (int r = 0; r < num_refs; r++) {
+        refs[r] = reference.data() + (r % 3) * 5 * stride + r * 4;
+        full[r] = fastSAD16_c(current.data(), refs[r], stride, n, n, INT32_MAX);
+      }
+
+      // Without a threshold, every SAD is exact
+      sad_fns[k](current.data(), refs, num_refs, stride, n, n, INT32_MAX,
+                 SADs);
+      for (int r = 0; r < num_refs; r++) {
+        EXPECT_EQ(full[r], SADs[r]) << "SAD" << n << "_xN ref " << r;
+      }
+
+      // With one of the SADs as threshold, the ones below it are exact
+      const int min_SAD = full[num_refs / 2];
+      sad_fns[k](current.data(), refs, num_refs, stride, n, n, min_SAD, SADs);
+      for (int r = 0; r < num_refs; r++) {
+        if (full[r] < min_SAD) {
+          EXPECT_EQ(full[r], SADs[r]) << "SAD" << n << "_xN ref " << r;
+        } else {
+          EXPECT_GE(SADs[r], min_SAD) << "SAD" << n << "_xN ref " << r;
+        }
+      }
+    }
+  }
+}
+
+TEST_F(MomentsTest, SADxN_WideBlocks) {
+  const int stride = 128;
+  std::vector<uint8_t> current(stride * 64);
+  std::vector<uint8_t> reference(stride * 80);
+  void (*const sad_fns[])(FAST_SAD_XN_FORMAL_ARGS) = {
+      fastSAD64_xN, fastSAD32_xN, fastSAD64_xN_c, fastSAD32_xN_c};
+  const int sizes[] = {64, 32, 64, 32};
+
+  for (int iter = 0; iter < 20; iter++) {
+    fillRandom(current.data(), current.size());
+    fillRandom(reference.data(), reference.size());
+
+    for (int k = 0; k < 4; k++) {
+      const int n = sizes[k];
+      // Blocks cut at the bottom of the picture are shorter
+      const int height = iter % 2 ? n : n - 12;
+      const int num_refs = 1 + iter % FAST_SAD_MAX_REFS;
+      const uint8_t *refs[FAST_SAD_MAX_REFS];
+      int full[FAST_SAD_MAX_REFS];
+      int SADs[FAST_SAD_MAX_REFS];
+
+      for (int r = 0; r < num_refs; r++) {
+        refs[r] = reference.data() + (r % 3) * 5 * stride + r * 4;
+        full[r] = 0;
+        for (int y = 0; y < height; y++) {
+          for (int x = 0; x < n; x++) {
+            full[r] +=
+                abs(current[y * stride + x] - refs[r][y * stride + x]);
+          }
+        }
+      }
+
+      sad_fns[k](current.data(), refs, num_refs, stride, n, height, INT32_MAX,
+                 SADs);
+      for (int r = 0; r < num_refs; r++) {
+        EXPECT_EQ(full[r], SADs[r]) << "SAD" << n << "_xN ref " << r;
+      }
+
+      const int min_SAD = full[num_refs / 2];
+      sad_fns[k](current.data(), refs, num_refs, stride, n, height, min_SAD,
+                 SADs);
+      for (int r = 0; r < num_refs; r++) {
+        if (full[r] < min_SAD) {
+          EXPECT_EQ(full[r], SADs[r]) << "SAD" << n << "_xN ref " << r;
+        } else {
+          EXPECT_GE(SADs[r], min_SAD) << "SAD" << n << "_xN ref " << r;
+        }
+      }
+    }
+  }
+}
+
+TEST_F(MomentsTest, SADSpan_MatchesSAD) {
+  const int stride = 128;
+  std::vector<uint8_t> current(stride * 32);
+  std::vector<uint8_t> reference(stride * 32);
+  void (*const span_fns[])(FAST_SAD_SPAN_FORMAL_ARGS) = {
+      fastSAD32_span,   fastSAD16_span,   fastSAD8_span,   fastSAD4_span,
+      fastSAD32_span_c, fastSAD16_span_c, fastSAD8_span_c, fastSAD4_span_c};
+  const int sizes[] = {32, 16, 8, 4, 32, 16, 8, 4};
+  // Fewer positions than a vector, whole vectors, and a partial last one
+  const int counts[] = {5, 16, 23, 65};
+
+  for (int iter = 0; iter < 8; iter++) {
+    fillRandom(current.data(), current.size());
+    fillRandom(reference.data(), reference.size());
+
+    for (int k = 0; k < 8; k++) {
+      const int n = sizes[k];
+      const int height = iter % 2 ? n : n / 2;
+      const int num_offsets = counts[iter % 4];
+      int SADs[65];
+
+      span_fns[k](current.data(), reference.data(), stride, n, height,
+                  num_offsets, SADs);
+      for (int o = 0; o < num_offsets; o++) {
+        int full = 0;
+        for (int y = 0; y < height; y++) {
+          for (int x = 0; x < n; x++) {
+            full += abs(current[y * stride + x] -
+                        reference[y * stride + x + o]);
+          }
+        }
+        EXPECT_EQ(full, SADs[o]) << "SAD" << n << "_span offset " << o;
+      }
+    }
+  }
+}
+
 // ============================================================================
 // Variance Tests
 // ============================================================================
@@ -253,6 +453,60 @@ TEST_F(MomentsTest, Variance16_Gradient) {
   EXPECT_EQ(var_c, var_opt);
 }
 
+TEST_F(MomentsTest, Variance16Split_MatchesQuadrants) {
+  const int stride = 64;
+  std::vector<uint8_t> data(stride * 16);
+
+  fillRandom(data.data(), data.size());
+
+  // Full macroblocks, and the short bottom row of e.g. 1080p
+  for (int block_height : {16, 12, 8, 4}) {
+    const int top = block_height < 8 ? block_height : 8;
+    const int bottom = block_height - top;
+    int split_c[4];
+    int split_opt[4];
+
+    int var_c = fast_variance16_split_c(data.data(), stride, block_height,
+                                        split_c);
+    int var_opt =
+        fast_variance16_split(data.data(), stride, block_height, split_opt);
+
+    EXPECT_EQ(fast_variance16_c(data.data(), stride, 16, block_height), var_c);
+    EXPECT_EQ(fast_variance8_c(data.data(), stride, 8, top), split_c[0]);
+    EXPECT_EQ(fast_variance8_c(data.data() + 8, stride, 8, top), split_c[1]);
+    if (bottom > 0) {
+      EXPECT_EQ(fast_variance8_c(data.data() + 8 * stride, stride, 8, bottom),
+                split_c[2]);
+      EXPECT_EQ(
+          fast_variance8_c(data.data() + 8 * stride + 8, stride, 8, bottom),
+          split_c[3]);
+    } else {
+      EXPECT_EQ(0, split_c[2]);
+      EXPECT_EQ(0, split_c[3]);
+    }
+
+    EXPECT_EQ(var_c, var_opt) << "height " << block_height;
+    for (int q = 0; q < 4; q++) {
+      EXPECT_EQ(split_c[q], split_opt[q]) << "height " << block_height;
+    }
+  }
+}
+
+TEST_F(MomentsTest, Variance64_Checkerboard) {
+  const int stride = 64;
+  std::vector<uint8_t> data(stride * 64);
+
+  // The square of the sum of a 64x64 block overflows an int
+  fillCheckerboard(data.data(), 64, 64, stride);
+
+  EXPECT_EQ(64 * 64 * 255 * 255 / 4,
+            fast_variance64(data.data(), stride, 64, 64));
+  EXPECT_EQ(32 * 32 * 255 * 255 / 4,
+            fast_variance32(data.data(), stride, 32, 32));
+  EXPECT_EQ(fast_variance64_c(data.data(), stride, 64, 64),
+            fast_variance64(data.data(), stride, 64, 64));
+}
+
 // ============================================================================
 // MSE (Mean Squared Error) Tests
 // ============================================================================
@@ -328,6 +582,59 @@ TEST_F(MomentsTest, MSE16_IdenticalBlocks) {
   EXPECT_EQ(mse_c, mse_opt);
 }
 
+TEST_F(MomentsTest, MSE16Split_MatchesQuadrants) {
+  const int stride = 64;
+  std::vector<uint8_t> current(stride * 16);
+  std::vector<uint8_t> reference(stride * 16);
+
+  fillRandom(current.data(), current.size());
+  fillRandom(reference.data(), reference.size());
+
+  for (int block_height : {16, 12, 8, 4}) {
+    const int top = block_height < 8 ? block_height : 8;
+    const int bottom = block_height - top;
+    const uint8_t *cur = current.data();
+    const uint8_t *ref = reference.data();
+    int split_c[4];
+    int split_opt[4];
+
+    int mse_c =
+        fast_calc_mse16_split_c(cur, ref, stride, block_height, split_c);
+    int mse_opt =
+        fast_calc_mse16_split(cur, ref, stride, block_height, split_opt);
+
+    EXPECT_EQ(fast_calc_mse16_c(cur, ref, stride, 16, block_height), mse_c);
+    EXPECT_EQ(fast_calc_mse8_c(cur, ref, stride, 8, top), split_c[0]);
+    EXPECT_EQ(fast_calc_mse8_c(cur + 8, ref + 8, stride, 8, top), split_c[1]);
+    if (bottom > 0) {
+      EXPECT_EQ(fast_calc_mse8_c(cur + 8 * stride, ref + 8 * stride, stride,
+                                 8, bottom),
+                split_c[2]);
+      EXPECT_EQ(fast_calc_mse8_c(cur + 8 * stride + 8, ref + 8 * stride + 8,
+                                 stride, 8, bottom),
+                split_c[3]);
+    }
+
+    EXPECT_EQ(mse_c, mse_opt) << "height " << block_height;
+    for (int q = 0; q < 4; q++) {
+      EXPECT_EQ(split_c[q], split_opt[q]) << "height " << block_height;
+    }
+  }
+}
+
+TEST_F(MomentsTest, MSE64_Checkerboard) {
+  const int stride = 64;
+  std::vector<uint8_t> current(stride * 64);
+  std::vector<uint8_t> reference(stride * 64, 0);
+
+  fillCheckerboard(current.data(), 64, 64, stride);
+
+  EXPECT_EQ(64 * 64 * 255 * 255 / 4,
+            fast_calc_mse64(current.data(), reference.data(), stride, 64, 64));
+  EXPECT_EQ(32 * 32 * 255 * 255 / 4,
+            fast_calc_mse32(current.data(), reference.data(), stride, 32, 32));
+}
+
 // ============================================================================
 // Bidirectional MSE Tests
 // ============================================================================
@@ -401,6 +708,170 @@ TEST_F(MomentsTest, BidirMSE4_RandomData) {
       << "BidirMSE4 optimized version differs from reference";
 }
 
+TEST_F(MomentsTest, BidirMSE64_RandomData) {
+  const int stride = 64;
+  std::vector<uint8_t> current(stride * 64);
+  std::vector<uint8_t> ref1(stride * 64);
+  std::vector<uint8_t> ref2(stride * 64);
+
+  fillRandom(current.data(), current.size());
+  fillRandom(ref1.data(), ref1.size());
+  fillRandom(ref2.data(), ref2.size());
+
+  MV td = {1, 2};
+
+  EXPECT_EQ(fast_bidir_mse64_c(current.data(), ref1.data(), ref2.data(),
+                               stride, 64, 64, &td),
+            fast_bidir_mse64(current.data(), ref1.data(), ref2.data(), stride,
+                             64, 64, &td));
+  EXPECT_EQ(fast_bidir_mse32_c(current.data(), ref1.data(), ref2.data(),
+                               stride, 32, 32, &td),
+            fast_bidir_mse32(current.data(), ref1.data(), ref2.data(), stride,
+                             32, 32, &td));
+}
+
+// The weights of the B-pictures add up to 32768, so the products of the
+// interpolation don't fit in 16 bits
+TEST_F(MomentsTest, BidirMSE_InterpolationWeights) {
+  const int stride = 64;
+  std::vector<uint8_t> current(stride * 64);
+  std::vector<uint8_t> ref1(stride * 64);
+  std::vector<uint8_t> ref2(stride * 64);
+
+  fillRandom(current.data(), current.size());
+  fillRandom(ref1.data(), ref1.size());
+  fillRandom(ref2.data(), ref2.size());
+  const uint8_t *cur = current.data();
+  const uint8_t *r1 = ref1.data();
+  const uint8_t *r2 = ref2.data();
+
+  // One B-frame, then the first and second of two
+  for (MV td : {MV{16384, 16384}, MV{10923, 21845}, MV{21845, 10923}}) {
+    EXPECT_EQ(fast_bidir_mse64_c(cur, r1, r2, stride, 64, 64, &td),
+              fast_bidir_mse64(cur, r1, r2, stride, 64, 64, &td))
+        << td.y;
+    EXPECT_EQ(fast_bidir_mse32_c(cur, r1, r2, stride, 32, 32, &td),
+              fast_bidir_mse32(cur, r1, r2, stride, 32, 32, &td))
+        << td.y;
+    EXPECT_EQ(fast_bidir_mse16_c(cur, r1, r2, stride, 16, 16, &td),
+              fast_bidir_mse16(cur, r1, r2, stride, 16, 16, &td))
+        << td.y;
+    EXPECT_EQ(fast_bidir_mse8_c(cur, r1, r2, stride, 8, 8, &td),
+              fast_bidir_mse8(cur, r1, r2, stride, 8, 8, &td))
+        << td.y;
+    EXPECT_EQ(fast_bidir_mse4_c(cur, r1, r2, stride, 4, 4, &td),
+              fast_bidir_mse4(cur, r1, r2, stride, 4, 4, &td))
+        << td.y;
+  }
+}
+
+// ============================================================================
+// DC Removal Tests
+// ============================================================================
+
+// The square of the sum of a 16x16 block overflows an int from a mean of 182
+// on, so flat bright blocks must still have no AC energy
+TEST_F(MomentsTest, Moments_BrightFlatBlocks) {
+  const int stride = 64;
+  std::vector<uint8_t> bright(stride * 16);
+  std::vector<uint8_t> black(stride * 16, 0);
+  const uint8_t *cur = bright.data();
+  const uint8_t *ref = black.data();
+  MV td = {0, 0};
+
+  for (int value : {182, 255}) {
+    fillConstant(bright.data(), 16, 16, stride, static_cast<uint8_t>(value));
+
+    EXPECT_EQ(0, fast_variance16_c(cur, stride, 16, 16)) << value;
+    EXPECT_EQ(0, fast_calc_mse16_c(cur, ref, stride, 16, 16)) << value;
+    EXPECT_EQ(0, fast_bidir_mse16_c(cur, ref, ref, stride, 16, 16, &td))
+        << value;
+    EXPECT_EQ(0, fast_variance16(cur, stride, 16, 16)) << value;
+    EXPECT_EQ(0, fast_variance8(cur, stride, 8, 8)) << value;
+    EXPECT_EQ(0, fast_variance4(cur, stride, 4, 4)) << value;
+    EXPECT_EQ(0, fast_calc_mse16(cur, ref, stride, 16, 16)) << value;
+    EXPECT_EQ(0, fast_calc_mse8(cur, ref, stride, 8, 8)) << value;
+    EXPECT_EQ(0, fast_calc_mse4(cur, ref, stride, 4, 4)) << value;
+    EXPECT_EQ(0, fast_bidir_mse16(cur, ref, ref, stride, 16, 16, &td))
+        << value;
+    EXPECT_EQ(0, fast_bidir_mse8(cur, ref, ref, stride, 8, 8, &td)) << value;
+    EXPECT_EQ(0, fast_bidir_mse4(cur, ref, ref, stride, 4, 4, &td)) << value;
+
+    for (int block_height : {16, 12}) {
+      int split_c[4];
+      int split_opt[4];
+      EXPECT_EQ(0, fast_variance16_split_c(cur, stride, block_height,
+                                           split_c));
+      EXPECT_EQ(0, fast_variance16_split(cur, stride, block_height,
+                                         split_opt));
+      for (int q = 0; q < 4; q++) {
+        EXPECT_EQ(0, split_c[q]) << value;
+        EXPECT_EQ(0, split_opt[q]) << value;
+      }
+      EXPECT_EQ(0, fast_calc_mse16_split_c(cur, ref, stride, block_height,
+                                           split_c));
+      EXPECT_EQ(0, fast_calc_mse16_split(cur, ref, stride, block_height,
+                                         split_opt));
+      for (int q = 0; q < 4; q++) {
+        EXPECT_EQ(0, split_c[q]) << value;
+        EXPECT_EQ(0, split_opt[q]) << value;
+      }
+    }
+  }
+
+  // Bright textured blocks, against the 64 bit sums of the plain kernels
+  for (size_t i = 0; i < bright.size(); i++) {
+    bright[i] = static_cast<uint8_t>(192 + dist(rng) % 64);
+  }
+  int split_c[4];
+  int split_opt[4];
+  const int var = fast_variance16_c(cur, stride, 16, 16);
+  EXPECT_EQ(var, fast_variance16(cur, stride, 16, 16));
+  EXPECT_EQ(var, fast_variance16_split_c(cur, stride, 16, split_c));
+  EXPECT_EQ(var, fast_variance16_split(cur, stride, 16, split_opt));
+  const int mse = fast_calc_mse16_c(cur, ref, stride, 16, 16);
+  EXPECT_EQ(mse, fast_calc_mse16(cur, ref, stride, 16, 16));
+  EXPECT_EQ(mse, fast_calc_mse16_split_c(cur, ref, stride, 16, split_c));
+  EXPECT_EQ(mse, fast_calc_mse16_split(cur, ref, stride, 16, split_opt));
+  EXPECT_EQ(fast_bidir_mse16_c(cur, ref, ref, stride, 16, 16, &td),
+            fast_bidir_mse16(cur, ref, ref, stride, 16, 16, &td));
+}
+
+// ============================================================================
+// Decimation Tests
+// ============================================================================
+
+TEST_F(MomentsTest, Decimate2x2_RandomData) {
+  const int src_stride = 160;
+  const int dst_stride = 80;
+  std::vector<uint8_t> src(src_stride * 32);
+
+  fillRandom(src.data(), src.size());
+
+  // Widths with and without a partial vector at the end of the rows
+  for (int width : {64, 37, 7}) {
+    std::vector<uint8_t> dst_c(dst_stride * 16, 0);
+    std::vector<uint8_t> dst_opt(dst_stride * 16, 0);
+
+    decimate2x2_c(dst_c.data(), dst_stride, src.data(), src_stride, width, 16);
+    decimate2x2(dst_opt.data(), dst_stride, src.data(), src_stride, width, 16);
+
+    for (int y = 0; y < 16; y++) {
+      const uint8_t *row0 = src.data() + 2 * y * src_stride;
+      const uint8_t *row1 = row0 + src_stride;
+      for (int x = 0; x < width; x++) {
+        const int avg = (row0[2 * x] + row0[2 * x + 1] + row1[2 * x] +
+                         row1[2 * x + 1] + 2) >>
+                        2;
+        ASSERT_EQ(avg, dst_c[y * dst_stride + x]) << "x " << x << " y " << y;
+      }
+      // Nothing is written past the width
+      EXPECT_EQ(0, dst_c[y * dst_stride + width]);
+    }
+    EXPECT_EQ(dst_c, dst_opt) << "width " << width;
+  }
+}
+
 // ============================================================================
 // Stress Tests with Multiple Iterations
 // ============================================================================
@@ -4,6 +4,7 @@
  */
 
 #include <algorithm>
+#include <climits>
 #include <cstring>
 #include <gtest/gtest.h>
 #include <vector>
@@ -438,3 +439,615 @@ TEST_F(MotionSearchTest, SpatialSearch_NonSquareFrame) {
 
   EXPECT_GE(result, 0) << "Result (MSE) should be non-negative";
 }
+
+// The costs of a row of 64x64 blocks of 4K video add up past INT_MAX before
+// the row is scaled down
+TEST_F(MotionSearchTest, SpatialSearch_WideRowOfLargeBlocks) {
+  const int width = 3840;
+  const int height = 64;
+  const int size = 64;
+  const int pad_x = HORIZONTAL_PADDING;
+  const int pad_y = VERTICAL_PADDING;
+  const int stride = width + 2 * pad_x;
+  const int total_height = height + 2 * pad_y;
+
+  std::vector<uint8_t> frame(stride * total_height);
+
+  uint8_t *center = frame.data() + pad_y * stride + pad_x;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      center[y * stride + x] = (x + y) % 2 ? 255 : 0;
+    }
+  }
+
+  DIM dim = {width, height};
+  extend_frame(center, stride, dim, pad_x, pad_y);
+
+  int stride_MB = width / size + 2;
+  std::vector<MV> motion_vectors(stride_MB);
+  std::vector<int> SADs(stride_MB);
+  std::vector<int> mses(stride_MB);
+  std::vector<unsigned char> MB_modes(stride_MB);
+  int count_I = 0;
+  int bits = 0;
+
+  int result = spatial_search(center, center, stride, dim, size, size,
+                              motion_vectors.data(), SADs.data(), mses.data(),
+                              MB_modes.data(), &count_I, &bits);
+
+  int64_t line_mse = 0;
+  for (int x = 0; x < width / size; x++) {
+    EXPECT_EQ(size * size * 255 * 255 / 4, mses[x]) << "block " << x;
+    line_mse += mses[x];
+  }
+  EXPECT_GT(line_mse, INT_MAX);
+  EXPECT_EQ((line_mse + 128) >> 8, result);
+}
+
+TEST_F(MotionSearchTest, MotionSearch_CachedIntraCosts) {
+  const int width = 64;
+  const int height = 40;
+  const int pad_x = HORIZONTAL_PADDING;
+  const int pad_y = VERTICAL_PADDING;
+  const int stride = width + 2 * pad_x;
+  const int total_height = height + 2 * pad_y;
+
+  std::vector<uint8_t> cur_frame(stride * total_height);
+  std::vector<uint8_t> ref_frame(stride * total_height);
+
+  uint8_t *current = cur_frame.data() + pad_y * stride + pad_x;
+  uint8_t *reference = ref_frame.data() + pad_y * stride + pad_x;
+
+  // Noisy content so that some blocks are coded intra
+  unsigned int seed = 12345;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      seed = seed * 1103515245 + 12345;
+      current[y * stride + x] = static_cast<uint8_t>(seed >> 16);
+    }
+  }
+  copyWithOffset(reference, current, width, height, stride, 2, 1);
+
+  DIM dim = {width, height};
+  extend_frame(current, stride, dim, pad_x, pad_y);
+  extend_frame(reference, stride, dim, pad_x, pad_y);
+
+  int stride_MB = width / MB_WIDTH + 2;
+  int padded_height_MB = (height + MB_WIDTH - 1) / MB_WIDTH + 2;
+  int array_size = stride_MB * padded_height_MB;
+  int firstMB = stride_MB + 1;
+
+  std::vector<int> intra(array_size);
+  intra_costs(current, stride, dim, block_width, block_height,
+              intra.data() + firstMB);
+
+  std::vector<MV> MVs[2];
+  std::vector<int> SADs[2];
+  std::vector<int> mses[2];
+  std::vector<unsigned char> MB_modes[2];
+  int count_I[2] = {0, 0};
+  int count_P[2] = {0, 0};
+  int bits[2] = {0, 0};
+  int result[2];
+
+  for (int k = 0; k < 2; k++) {
+    MVs[k].assign(array_size, MV());
+    SADs[k].assign(array_size, 65535);
+    mses[k].assign(array_size, 0);
+    MB_modes[k].assign(array_size, 0);
+    result[k] = motion_search_rows(
+        current, reference, stride, dim, block_width, block_height, 0,
+        INT_MAX, MVs[k].data() + firstMB, SADs[k].data() + firstMB,
+        mses[k].data(), MB_modes[k].data(), k ? intra.data() + firstMB : NULL,
+        NULL, ME_PMVFAST, 0, 0, &count_I[k], &count_P[k], NULL, &bits[k], NULL,
+        NULL);
+  }
+
+  EXPECT_GT(count_I[0], 0) << "Test content should have intra blocks";
+  EXPECT_EQ(result[0], result[1]);
+  EXPECT_EQ(count_I[0], count_I[1]);
+  EXPECT_EQ(count_P[0], count_P[1]);
+  EXPECT_EQ(bits[0], bits[1]);
+  EXPECT_EQ(mses[0], mses[1]);
+  EXPECT_EQ(MB_modes[0], MB_modes[1]);
+}
+
+TEST_F(MotionSearchTest, MotionSearch_SkipsStaticBlocks) {
+  const int width = 64;
+  const int height = 48;
+  const int pad_x = HORIZONTAL_PADDING;
+  const int pad_y = VERTICAL_PADDING;
+  const int stride = width + 2 * pad_x;
+  const int total_height = height + 2 * pad_y;
+
+  std::vector<uint8_t> cur_frame(stride * total_height);
+  std::vector<uint8_t> ref_frame(stride * total_height);
+
+  uint8_t *current = cur_frame.data() + pad_y * stride + pad_x;
+  uint8_t *reference = ref_frame.data() + pad_y * stride + pad_x;
+
+  // The left half is unchanged, the right half is new noise
+  unsigned int seed = 12345;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      seed = seed * 1103515245 + 12345;
+      current[y * stride + x] = static_cast<uint8_t>(seed >> 16);
+      seed = seed * 1103515245 + 12345;
+      reference[y * stride + x] = x < width / 2
+                                      ? current[y * stride + x]
+                                      : static_cast<uint8_t>(seed >> 16);
+    }
+  }
+
+  DIM dim = {width, height};
+  extend_frame(current, stride, dim, pad_x, pad_y);
+  extend_frame(reference, stride, dim, pad_x, pad_y);
+
+  int stride_MB = width / MB_WIDTH + 2;
+  int padded_height_MB = (height + MB_WIDTH - 1) / MB_WIDTH + 2;
+  int array_size = stride_MB * padded_height_MB;
+  int firstMB = stride_MB + 1;
+
+  std::vector<MV> MVs[2];
+  std::vector<int> mses[2];
+  std::vector<unsigned char> MB_modes[2];
+  int count_I[2] = {0, 0};
+  int count_P[2] = {0, 0};
+  int count_skip[2] = {0, 0};
+  int bits[2] = {0, 0};
+
+  for (int k = 0; k < 2; k++) {
+    std::vector<int> SADs(array_size, 65535);
+    MVs[k].assign(array_size, MV());
+    mses[k].assign(array_size, 0);
+    MB_modes[k].assign(array_size, 0);
+    motion_search_rows(current, reference, stride, dim, block_width,
+                       block_height, 0, INT_MAX, MVs[k].data() + firstMB,
+                       SADs.data() + firstMB, mses[k].data(),
+                       MB_modes[k].data(), NULL, NULL, ME_PMVFAST, 0, k,
+                       &count_I[k], &count_P[k], &count_skip[k], &bits[k],
+                       NULL, NULL);
+  }
+
+  // Only the macroblocks of the left half skip the search, with the result
+  // the search finds for them
+  EXPECT_EQ(0, count_skip[0]);
+  EXPECT_EQ((width / 2 / block_width) * (height / block_height),
+            count_skip[1]);
+  EXPECT_EQ(count_I[0], count_I[1]);
+  EXPECT_EQ(count_P[0], count_P[1]);
+  EXPECT_EQ(bits[0], bits[1]);
+  for (int y = 0; y < height / block_height; y++) {
+    for (int x = 0; x < width / 2 / block_width; x++) {
+      const int mb = y * stride_MB + x;
+      EXPECT_EQ(1, MB_modes[1][mb]);
+      EXPECT_EQ(0, mses[1][mb]);
+      EXPECT_EQ(0, MVs[1][firstMB + mb].x);
+      EXPECT_EQ(0, MVs[1][firstMB + mb].y);
+    }
+  }
+}
+
+TEST_F(MotionSearchTest, MotionSearch_StaysInsidePadding) {
+  const int width = 64;
+  const int height = 48;
+  const int pad_x = HORIZONTAL_PADDING;
+  const int pad_y = VERTICAL_PADDING;
+  const int stride = width + 2 * pad_x;
+  const int total_height = height + 2 * pad_y;
+  const MV far = {100, 0};
+
+  std::vector<uint8_t> cur_frame(stride * total_height);
+  uint8_t *current = cur_frame.data() + pad_y * stride + pad_x;
+  fillPattern(current, width, height, stride);
+
+  // Memory past the padded reference holds a perfect match for every block
+  std::vector<uint8_t> ref_frame(stride * (total_height + far.y + height));
+  uint8_t *reference = ref_frame.data() + pad_y * stride + pad_x;
+  copyWithOffset(reference, current, width, height, stride, 3, 5);
+  fillPattern(reference + far.y * stride, width, height, stride);
+
+  DIM dim = {width, height};
+  extend_frame(current, stride, dim, pad_x, pad_y);
+  extend_frame(reference, stride, dim, pad_x, pad_y);
+
+  int stride_MB = width / MB_WIDTH + 2;
+  int padded_height_MB = (height + MB_WIDTH - 1) / MB_WIDTH + 2;
+  int array_size = stride_MB * padded_height_MB;
+  int firstMB = stride_MB + 1;
+
+  // Predictors pointing past the padding must not be searched
+  std::vector<MV> motion_vectors(array_size, far);
+  std::vector<int> SADs(array_size, 65535);
+  std::vector<int> mses(array_size);
+  std::vector<unsigned char> MB_modes(array_size);
+  int count_I = 0;
+  int count_P = 0;
+  int bits = 0;
+
+  motion_search(current, reference, stride, dim, block_width, block_height,
+                motion_vectors.data() + firstMB, SADs.data() + firstMB,
+                mses.data(), MB_modes.data(), &count_I, &count_P, &bits);
+
+  for (int y = 0; y < height / block_height; y++) {
+    for (int x = 0; x < width / block_width; x++) {
+      const MV &mv = motion_vectors[firstMB + y * stride_MB + x];
+      EXPECT_GE(y * block_height + mv.y, -pad_y);
+      EXPECT_LE(y * block_height + mv.y + block_height, height + pad_y);
+      EXPECT_GE(x * block_width + mv.x, -pad_x);
+      EXPECT_LE(x * block_width + mv.x + block_width, width + pad_x);
+    }
+  }
+}
+
+TEST_F(MotionSearchTest, MotionSearch_PyramidSeedsFindFastPan) {
+  const int width = 128;
+  const int height = 96;
+  const int pad_x = HORIZONTAL_PADDING;
+  const int pad_y = VERTICAL_PADDING;
+  const int stride = width + 2 * pad_x;
+  const int total_height = height + 2 * pad_y;
+  const MV pan = {12, 20};
+
+  std::vector<uint8_t> cur_frame(stride * total_height);
+  std::vector<uint8_t> ref_frame(stride * total_height);
+
+  uint8_t *current = cur_frame.data() + pad_y * stride + pad_x;
+  uint8_t *reference = ref_frame.data() + pad_y * stride + pad_x;
+
+  // Smooth noise, so that the pyramid keeps the texture, moving further
+  // than the diamond search reaches from the zero predictors
+  unsigned int seed = 4321;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      seed = seed * 1103515245 + 12345;
+      reference[y * stride + x] = static_cast<uint8_t>(seed >> 16);
+    }
+  }
+  for (int y = 0; y < height; y++) {
+    for (int x = 1; x < width; x++) {
+      reference[y * stride + x] = static_cast<uint8_t>(
+          (reference[y * stride + x] + reference[y * stride + x - 1]) / 2);
+    }
+  }
+  copyWithOffset(current, reference, width, height, stride, pan.x, pan.y);
+
+  DIM dim = {width, height};
+  std::vector<uint8_t> cur_levels(pyramid_size(dim));
+  std::vector<uint8_t> ref_levels(pyramid_size(dim));
+  pyramid_t cur_pyramid, ref_pyramid;
+  build_pyramid(current, stride, dim, cur_levels.data(), &cur_pyramid);
+  build_pyramid(reference, stride, dim, ref_levels.data(), &ref_pyramid);
+  extend_frame(current, stride, dim, pad_x, pad_y);
+  extend_frame(reference, stride, dim, pad_x, pad_y);
+
+  int stride_MB = width / MB_WIDTH + 2;
+  int padded_height_MB = (height + MB_WIDTH - 1) / MB_WIDTH + 2;
+  int array_size = stride_MB * padded_height_MB;
+  int firstMB = stride_MB + 1;
+
+  std::vector<MV> seeds(array_size, MV());
+  pyramid_search(&cur_pyramid, &ref_pyramid, dim, MB_WIDTH,
+                 seeds.data() + firstMB);
+
+  // Macroblocks whose match is inside the reference
+  for (int y = 0; y < (height - pan.y) / MB_WIDTH; y++) {
+    for (int x = 0; x < (width - pan.x) / MB_WIDTH; x++) {
+      const MV &mv = seeds[firstMB + y * stride_MB + x];
+      EXPECT_EQ(mv.y, pan.y) << "MB (" << x << ", " << y << ")";
+      EXPECT_EQ(mv.x, pan.x) << "MB (" << x << ", " << y << ")";
+    }
+  }
+
+  int count_P[2] = {0, 0};
+  int result[2];
+  for (int k = 0; k < 2; k++) {
+    std::vector<MV> MVs(array_size, MV());
+    std::vector<int> SADs(array_size, 65535);
+    std::vector<int> mses(array_size, 0);
+    std::vector<unsigned char> MB_modes(array_size, 0);
+    int count_I = 0;
+    int bits = 0;
+
+    result[k] = motion_search_rows(
+        current, reference, stride, dim, block_width, block_height, 0,
+        INT_MAX, MVs.data() + firstMB, SADs.data() + firstMB, mses.data(),
+        MB_modes.data(), NULL, k ? seeds.data() + firstMB : NULL, ME_PMVFAST,
+        0, 0, &count_I, &count_P[k], NULL, &bits, NULL, NULL);
+  }
+
+  EXPECT_GT(count_P[1], count_P[0])
+      << "Seeding should find the pan for more macroblocks";
+  EXPECT_LT(result[1], result[0]);
+}
+
+TEST_F(MotionSearchTest, MotionSearch_StrategiesFindTranslation) {
+  const int width = 96;
+  const int height = 64;
+  const int pad_x = HORIZONTAL_PADDING;
+  const int pad_y = VERTICAL_PADDING;
+  const int stride = width + 2 * pad_x;
+  const int total_height = height + 2 * pad_y;
+  const MV pan = {3, -5};
+
+  std::vector<uint8_t> cur_frame(stride * total_height);
+  std::vector<uint8_t> ref_frame(stride * total_height);
+
+  uint8_t *current = cur_frame.data() + pad_y * stride + pad_x;
+  uint8_t *reference = ref_frame.data() + pad_y * stride + pad_x;
+
+  // Noise smoothed in both directions, so that every strategy can descend
+  // to the match from the zero predictors
+  unsigned int seed = 2024;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      seed = seed * 1103515245 + 12345;
+      reference[y * stride + x] = static_cast<uint8_t>(seed >> 16);
+    }
+  }
+  for (int pass = 0; pass < 3; pass++) {
+    for (int y = 0; y < height; y++) {
+      for (int x = 1; x < width; x++) {
+        reference[y * stride + x] = static_cast<uint8_t>(
+            (reference[y * stride + x] + reference[y * stride + x - 1]) / 2);
+      }
+    }
+    for (int y = 1; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        reference[y * stride + x] = static_cast<uint8_t>(
+            (reference[y * stride + x] + reference[(y - 1) * stride + x]) /
+            2);
+      }
+    }
+  }
+  copyWithOffset(current, reference, width, height, stride, pan.x, pan.y);
+
+  DIM dim = {width, height};
+  extend_frame(current, stride, dim, pad_x, pad_y);
+  extend_frame(reference, stride, dim, pad_x, pad_y);
+
+  int stride_MB = width / MB_WIDTH + 2;
+  int padded_height_MB = (height + MB_WIDTH - 1) / MB_WIDTH + 2;
+  int array_size = stride_MB * padded_height_MB;
+  int firstMB = stride_MB + 1;
+
+  for (int method = 0; method < NUM_ME_METHODS; method++) {
+    std::vector<MV> MVs(array_size, MV());
+    std::vector<int> SADs(array_size, 65535);
+    std::vector<int> mses(array_size, 0);
+    std::vector<unsigned char> MB_modes(array_size, 0);
+    int count_I = 0;
+    int count_P = 0;
+    int bits = 0;
+
+    motion_search_rows(current, reference, stride, dim, block_width,
+                       block_height, 0, INT_MAX, MVs.data() + firstMB,
+                       SADs.data() + firstMB, mses.data(), MB_modes.data(),
+                       NULL, NULL, (me_method_t)method, 0, 0, &count_I,
+                       &count_P, NULL, &bits, NULL, NULL);
+
+    // Macroblocks whose match is inside the reference
+    for (int y = 0; y < (height - pan.y) / MB_WIDTH; y++) {
+      for (int x = (-pan.x + MB_WIDTH - 1) / MB_WIDTH; x < width / MB_WIDTH;
+           x++) {
+        const MV &mv = MVs[firstMB + y * stride_MB + x];
+        EXPECT_EQ(pan.y, mv.y) << me_method_name(method) << " MB (" << x
+                               << ", " << y << ")";
+        EXPECT_EQ(pan.x, mv.x) << me_method_name(method) << " MB (" << x
+                               << ", " << y << ")";
+      }
+    }
+  }
+}
+
+TEST_F(MotionSearchTest, MotionSearch_BlockSizesFindTranslation) {
+  const int width = 128;
+  const int height = 128;
+  const int pad_x = HORIZONTAL_PADDING;
+  const int pad_y = VERTICAL_PADDING;
+  const int stride = width + 2 * pad_x;
+  const int total_height = height + 2 * pad_y;
+  const MV pan = {6, 4};
+
+  std::vector<uint8_t> cur_frame(stride * total_height);
+  std::vector<uint8_t> ref_frame(stride * total_height);
+
+  uint8_t *current = cur_frame.data() + pad_y * stride + pad_x;
+  uint8_t *reference = ref_frame.data() + pad_y * stride + pad_x;
+
+  unsigned int seed = 77;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      seed = seed * 1103515245 + 12345;
+      reference[y * stride + x] = static_cast<uint8_t>(seed >> 16);
+    }
+  }
+  for (int pass = 0; pass < 3; pass++) {
+    for (int y = 0; y < height; y++) {
+      for (int x = 1; x < width; x++) {
+        reference[y * stride + x] = static_cast<uint8_t>(
+            (reference[y * stride + x] + reference[y * stride + x - 1]) / 2);
+      }
+    }
+    for (int y = 1; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        reference[y * stride + x] = static_cast<uint8_t>(
+            (reference[y * stride + x] + reference[(y - 1) * stride + x]) /
+            2);
+      }
+    }
+  }
+  copyWithOffset(current, reference, width, height, stride, pan.x, pan.y);
+
+  DIM dim = {width, height};
+  extend_frame(current, stride, dim, pad_x, pad_y);
+  extend_frame(reference, stride, dim, pad_x, pad_y);
+
+  for (int size : {8, 16, 32, 64}) {
+    int stride_MB = width / size + 2;
+    int padded_height_MB = (height + size - 1) / size + 2;
+    int array_size = stride_MB * padded_height_MB;
+    int firstMB = stride_MB + 1;
+
+    std::vector<MV> MVs(array_size, MV());
+    std::vector<int> SADs(array_size, INT_MAX);
+    std::vector<int> mses(array_size, 0);
+    std::vector<unsigned char> MB_modes(array_size, 0);
+    int count_I = 0;
+    int count_P = 0;
+    int bits = 0;
+
+    motion_search_rows(current, reference, stride, dim, size, size, 0,
+                       INT_MAX, MVs.data() + firstMB, SADs.data() + firstMB,
+                       mses.data(), MB_modes.data(), NULL, NULL, ME_PMVFAST,
+                       0, 0, &count_I, &count_P, NULL, &bits, NULL, NULL);
+
+    EXPECT_EQ((width / size) * (height / size), count_I + count_P)
+        << "size " << size;
+
+    // Macroblocks whose match is inside the reference
+    for (int y = 0; y < (height - pan.y) / size; y++) {
+      for (int x = 0; x < (width - pan.x) / size; x++) {
+        const MV &mv = MVs[firstMB + y * stride_MB + x];
+        EXPECT_EQ(pan.y, mv.y)
+            << "size " << size << " MB (" << x << ", " << y << ")";
+        EXPECT_EQ(pan.x, mv.x)
+            << "size " << size << " MB (" << x << ", " << y << ")";
+      }
+    }
+  }
+}
+
+TEST_F(MotionSearchTest, MotionSearch_ExhaustiveFindsFarTranslation) {
+  const int width = 128;
+  const int height = 96;
+  const int pad_x = HORIZONTAL_PADDING;
+  const int pad_y = VERTICAL_PADDING;
+  const int stride = width + 2 * pad_x;
+  const int total_height = height + 2 * pad_y;
+  // Near the edges of the padding, in raw noise that no descent can follow
+  const MV pan = {-20, 29};
+
+  std::vector<uint8_t> cur_frame(stride * total_height);
+  std::vector<uint8_t> ref_frame(stride * total_height);
+
+  uint8_t *current = cur_frame.data() + pad_y * stride + pad_x;
+  uint8_t *reference = ref_frame.data() + pad_y * stride + pad_x;
+
+  unsigned int seed = 4242;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      seed = seed * 1103515245 + 12345;
+      reference[y * stride + x] = static_cast<uint8_t>(seed >> 16);
+    }
+  }
+  copyWithOffset(current, reference, width, height, stride, pan.x, pan.y);
+
+  DIM dim = {width, height};
+  extend_frame(current, stride, dim, pad_x, pad_y);
+  extend_frame(reference, stride, dim, pad_x, pad_y);
+
+  for (int size : {8, 16}) {
+    int stride_MB = width / size + 2;
+    int padded_height_MB = (height + size - 1) / size + 2;
+    int array_size = stride_MB * padded_height_MB;
+    int firstMB = stride_MB + 1;
+
+    std::vector<MV> MVs(array_size, MV());
+    std::vector<int> SADs(array_size, INT_MAX);
+    std::vector<int> mses(array_size, 0);
+    std::vector<unsigned char> MB_modes(array_size, 0);
+    int count_I = 0;
+    int count_P = 0;
+    int bits = 0;
+
+    motion_search_rows(current, reference, stride, dim, size, size, 0,
+                       INT_MAX, MVs.data() + firstMB, SADs.data() + firstMB,
+                       mses.data(), MB_modes.data(), NULL, NULL, ME_EXHAUSTIVE,
+                       0, 0, &count_I, &count_P, NULL, &bits, NULL, NULL);
+
+    // Macroblocks whose match is inside the reference
+    for (int y = (-pan.y + size - 1) / size; y < height / size; y++) {
+      for (int x = 0; x < (width - pan.x) / size; x++) {
+        const MV &mv = MVs[firstMB + y * stride_MB + x];
+        EXPECT_EQ(pan.y, mv.y)
+            << "size " << size << " MB (" << x << ", " << y << ")";
+        EXPECT_EQ(pan.x, mv.x)
+            << "size " << size << " MB (" << x << ", " << y << ")";
+        EXPECT_EQ(0, SADs[firstMB + y * stride_MB + x])
+            << "size " << size << " MB (" << x << ", " << y << ")";
+      }
+    }
+  }
+}
+
+// The left quadrants of the last macroblock of a row reach further right than
+// the macroblock when the width isn't a multiple of its size, so their
+// exhaustive search covers vectors the macroblock can't use
+TEST_F(MotionSearchTest, MotionSearch_ExhaustiveQuadrantsPastLastColumn) {
+  const int width = 72;
+  const int height = 32;
+  const int size = 16;
+  const int pad_x = HORIZONTAL_PADDING;
+  const int pad_y = VERTICAL_PADDING;
+  const int stride = width + 2 * pad_x;
+  const int total_height = height + 2 * pad_y;
+  // Beyond the reach of the last macroblock, 8 pixels past the picture
+  const int far_x = HORIZONTAL_PADDING - 4;
+  const int last_x = width / size * size;
+
+  std::vector<uint8_t> cur_frame(stride * total_height);
+  std::vector<uint8_t> ref_frame(stride * total_height);
+
+  uint8_t *current = cur_frame.data() + pad_y * stride + pad_x;
+  uint8_t *reference = ref_frame.data() + pad_y * stride + pad_x;
+
+  // Noise over the padding too, where the macroblocks of the last column
+  // overhang the picture and the vectors point
+  unsigned int seed = 2024;
+  for (auto &pixel : ref_frame) {
+    seed = seed * 1103515245 + 12345;
+    pixel = static_cast<uint8_t>(seed >> 16);
+  }
+  cur_frame = ref_frame;
+  for (int y = 0; y < size / 2; y++) {
+    for (int x = last_x; x < last_x + size / 2; x++) {
+      current[y * stride + x] = reference[y * stride + x + far_x];
+    }
+  }
+
+  DIM dim = {width, height};
+  int stride_MB = width / size + 2;
+  int padded_height_MB = (height + size - 1) / size + 2;
+  int array_size = stride_MB * padded_height_MB;
+  int firstMB = stride_MB + 1;
+
+  std::vector<MV> MVs(array_size, MV());
+  std::vector<int> SADs(array_size, INT_MAX);
+  std::vector<int> mses(array_size, 0);
+  std::vector<unsigned char> MB_modes(array_size, 0);
+  int count_I = 0;
+  int count_P = 0;
+  int bits = 0;
+
+  int mse = motion_search_rows(
+      current, reference, stride, dim, size, size, 0, INT_MAX,
+      MVs.data() + firstMB, SADs.data() + firstMB, mses.data(),
+      MB_modes.data(), NULL, NULL, ME_EXHAUSTIVE, 0, 0, &count_I, &count_P,
+      NULL, &bits, NULL, NULL);
+
+  // Every quadrant has an exact match within its own window
+  EXPECT_EQ(0, mse);
+  for (int y = 0; y < height / size; y++) {
+    for (int x = 0; x <= width / size; x++) {
+      EXPECT_EQ(0, mses[y * stride_MB + x]) << "MB (" << x << ", " << y << ")";
+    }
+  }
+}
+
+TEST_F(MotionSearchTest, MotionSearch_MethodNames) {
+  for (int method = 0; method < NUM_ME_METHODS; method++) {
+    EXPECT_EQ(method, me_method_from_name(me_method_name(method)));
+  }
+  EXPECT_EQ(-1, me_method_from_name("full"));
+}